@@ -1,12 +1,40 @@
-cbuffer TransformBuffer {
-	float4x4 world;
+// Once per view
+cbuffer TransformBuffer : register(b0) {
 	float4x4 view_projection;
+	float4x4 motion_view_projection; // This frame and the last one without the jitter, for the motion vectors
+	float4x4 previous_view_projection;
+	float4 cluster_scale; // Tiles per pixel in x and y, scale and bias of the slice (see light_clusters.h)
+	float4 cluster_viewport; // Top left corner of the viewport, in pixels
+	uint4 cluster_grid; // Tiles in x and y, slices (0 if there are no clusters), first cell of the view
+	float4 camera_right; // Right and up direction of the view, for the particles
+	float4 camera_up;
+};
+
+// Once per object, same as scene_draw_item_t in scene.h. Only uploaded when the object moved
+cbuffer ObjectBuffer : register(b1) {
+	float4x4 world;
+	float4x4 previous_world; // Where the object was in the last frame, for the motion vectors
 	float4x4 rotation;
-	float4 light_vector;
-	float4 light_color;
-	float4 ambient_color;
+	float4 face_light[6]; // Ambient plus sun of the faces facing +x, -x, +y, -y, +z and -z, lit on the CPU
 };
 
+// Same as light_t in light_clusters.h
+struct light_t {
+	float3 position;
+	float range;
+	float3 color;
+	uint type;
+	float3 direction;
+	float spot_cos_outer;
+	float spot_cos_inner;
+	float3 padding;
+};
+
+// Filled once per frame on the CPU, see light_clusters.h
+StructuredBuffer<light_t> lights : register(t0);
+StructuredBuffer<uint2> light_cells : register(t1); // Offset and count of the light indices of each cell
+StructuredBuffer<uint> light_indices : register(t2);
+
 struct vsIn {
 	float4 position  : SV_POSITION;
 	float4 normal : NORMAL;
@@ -14,24 +42,203 @@ struct vsIn {
 
 struct psIn {
 	float4 pos   : SV_POSITION;
-	float4 color : COLOR;
+	float3 world_pos : POSITION;
+	float3 normal : NORMAL;
+	float3 sun : COLOR; // Ambient and sun light of the face
+	float depth : DEPTH; // Distance along the view direction
+	float4 current_pos : TEXCOORD0; // Without the jitter, in this frame and the last one
+	float4 previous_pos : TEXCOORD1;
 };
 
 psIn VShader(vsIn input) {
 	psIn output;
 
 	// Calculate the position
-	output.pos = mul(mul(input.position, world), view_projection);
+	float4 world_pos = mul(input.position, world);
+	output.pos = mul(world_pos, view_projection);
+	output.world_pos = world_pos.xyz;
+	output.depth = output.pos.w;
+	output.current_pos = mul(world_pos, motion_view_projection);
+	output.previous_pos = mul(mul(input.position, previous_world), previous_view_projection);
+
+	// The sun lights a face the same everywhere, which was already computed for each face of the object. The
+	// normals of the cube mesh point along the axes, which tells us the face
+	float3 n = input.normal.xyz;
+	uint face = n.x != 0.0f ? (n.x > 0.0f ? 0 : 1) : (n.y != 0.0f ? (n.y > 0.0f ? 2 : 3) : (n.z > 0.0f ? 4 : 5));
+	output.sun = face_light[face].rgb;
 
-	// Calculate the color
-	output.color = ambient_color;
-	float4 norm = normalize(mul(rotation, input.normal));
-	float diffuse_brightness = saturate(dot(norm, light_vector));
-	output.color += light_color * diffuse_brightness;
+	// The lights of the scene are done per pixel, so we pass on the normal
+	output.normal = mul(rotation, input.normal).xyz;
 
 	return output;
 }
 
-float4 PShader(psIn input) : SV_TARGET{
-	return input.color;
-}
\ No newline at end of file
+// Same as LightShade in light_clusters.cpp
+float3 ShadeLight(light_t light, float3 world_pos, float3 normal) {
+	float3 to_light = light.position - world_pos;
+	float distance = length(to_light);
+	if (distance >= light.range) {
+		return float3(0, 0, 0);
+	}
+	to_light /= distance;
+
+	float falloff = 1.0f - distance / light.range;
+	float brightness = falloff * falloff * saturate(dot(normal, to_light));
+	if (light.type == 1) {
+		brightness *= saturate((dot(-to_light, light.direction) - light.spot_cos_outer) / (light.spot_cos_inner - light.spot_cos_outer));
+	}
+	return light.color * brightness;
+}
+
+struct psOut {
+	float4 color : SV_TARGET0;
+	float2 motion : SV_TARGET1; // Only used with temporal upscaling, see temporal_upscale.h
+};
+
+psOut PShader(psIn input) {
+	float3 normal = normalize(input.normal);
+
+	// The ambient light and the sun, from the vertex shader
+	float3 color = input.sun;
+
+	// The lights of the cell the pixel is in
+	if (cluster_grid.z > 0) {
+		uint2 tile = min((uint2)((input.pos.xy - cluster_viewport.xy) * cluster_scale.xy), cluster_grid.xy - 1);
+		uint slice = (uint)clamp(log(input.depth) * cluster_scale.z + cluster_scale.w, 0.0f, (float)(cluster_grid.z - 1));
+		uint2 cell = light_cells[cluster_grid.w + (slice * cluster_grid.y + tile.y) * cluster_grid.x + tile.x];
+		for (uint i = 0; i < cell.y; i++) {
+			color += ShadeLight(lights[light_indices[cell.x + i]], input.world_pos, normal);
+		}
+	}
+
+	// Where the pixel was on the screen in the last frame, in texture coordinates (y down). That's the motion of
+	// the view and of the object itself
+	psOut output;
+	output.color = float4(color, 1.0f);
+	output.motion = (input.current_pos.xy / input.current_pos.w - input.previous_pos.xy / input.previous_pos.w) * float2(0.5f, -0.5f);
+	return output;
+}
+
+// One particle per instance, see particle_instance_t in particles.h
+struct particleIn {
+	float4 center_size : SV_POSITION; // Half the width of the quad in w
+	float4 color : COLOR;
+	uint corner : SV_VertexID;
+};
+
+struct particlePsIn {
+	float4 pos : SV_POSITION;
+	float4 color : COLOR;
+	float2 offset : TEXCOORD; // Position in the quad, from -1 to 1
+};
+
+particlePsIn PartVShader(particleIn input) {
+	particlePsIn output;
+
+	// The 4 vertices of the triangle strip are the corners of a quad that faces the view, in clockwise order
+	float2 offset = float2((input.corner & 1) ? 1.0f : -1.0f, (input.corner & 2) ? -1.0f : 1.0f);
+	float3 world_pos = input.center_size.xyz + (camera_right.xyz * offset.x + camera_up.xyz * offset.y) * input.center_size.w;
+	output.pos = mul(float4(world_pos, 1.0f), view_projection);
+	output.color = input.color;
+	output.offset = offset;
+
+	return output;
+}
+
+float4 PartPShader(particlePsIn input) : SV_TARGET{
+	// Round, and brightest in the middle
+	float falloff = saturate(1.0f - dot(input.offset, input.offset));
+	return float4(input.color.rgb, input.color.a * falloff);
+}
+
+// Once per view with temporal upscaling, same as upscale_constants_t in source.cpp
+cbuffer UpscaleBuffer : register(b2) {
+	float4 upscale_jitter; // Jitter in pixels of the internal resolution (x, y), the blend (z), 1 if there is history (w)
+	uint4 upscale_size; // Internal width and height, width and height of the swapchain
+	float4 upscale_reject; // How quickly history that had to be clamped is forgotten (x)
+};
+
+// The view rendered at the internal resolution, and the output of the last frame
+Texture2D<float4> upscale_color : register(t3);
+Texture2D<float2> upscale_motion : register(t4);
+Texture2D<float4> upscale_history : register(t5);
+
+float4 UpscaleVShader(uint id : SV_VertexID) : SV_POSITION {
+	// A triangle from (-1, 1) to (3, 1) and (-1, -3) covers the whole viewport
+	float2 corner = float2((id << 1) & 2, id & 2);
+	return float4(corner * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+}
+
+// Same as TemporalSampleCatmullRom in temporal_upscale.cpp
+float4 UpscaleSampleCatmullRom(float2 position, int2 size) {
+	position -= 0.5f;
+	float2 base = floor(position);
+	float2 t = position - base;
+	float2 weights[4] = {
+		t * (-0.5f + t * (1.0f - 0.5f * t)),
+		1.0f + t * t * (-2.5f + 1.5f * t),
+		t * (0.5f + t * (2.0f - 1.5f * t)),
+		t * t * (-0.5f + 0.5f * t),
+	};
+
+	float4 result = float4(0, 0, 0, 0);
+	for (int j = 0; j < 4; j++) {
+		int row = clamp((int)base.y - 1 + j, 0, size.y - 1);
+		float4 row_sum = float4(0, 0, 0, 0);
+		for (int i = 0; i < 4; i++) {
+			int column = clamp((int)base.x - 1 + i, 0, size.x - 1);
+			row_sum += upscale_history.Load(int3(column, row, 0)) * weights[i].x;
+		}
+		result += row_sum * weights[j].y;
+	}
+	return result;
+}
+
+struct upscaleOut {
+	float4 color : SV_TARGET0; // The swapchain
+	float4 history : SV_TARGET1; // The history of the next frame
+};
+
+// Same as TemporalUpscaleResolve in temporal_upscale.cpp, for one pixel of the swapchain
+upscaleOut UpscalePShader(float4 pos : SV_POSITION) {
+	int2 input_size = (int2)upscale_size.xy;
+	int2 output_size = (int2)upscale_size.zw;
+
+	// The new sample closest to the center of the output pixel
+	float2 uv = pos.xy / (float2)output_size;
+	float2 position = uv * (float2)input_size;
+	int2 input = clamp((int2)floor(position - upscale_jitter.xy), int2(0, 0), input_size - 1);
+	float2 offset = (float2)input + 0.5f + upscale_jitter.xy - position;
+	float4 current = upscale_color.Load(int3(input, 0));
+	float weight = exp(-2.29f * dot(offset, offset));
+
+	// Where the pixel was in the last frame, clamped to the new samples around it. The alpha of the history is the
+	// number of samples in it, which goes down the further the clamp had to move it
+	float2 previous_uv = uv - upscale_motion.Load(int3(input, 0));
+	float4 result = current;
+	float samples = weight;
+	if (upscale_jitter.w > 0.0f && all(previous_uv >= 0.0f) && all(previous_uv <= 1.0f)) {
+		float4 previous = UpscaleSampleCatmullRom(previous_uv * (float2)output_size, output_size);
+		float history_samples = max(previous.a, 0.0f);
+		float4 low = current;
+		float4 high = current;
+		for (int y = -1; y <= 1; y++) {
+			for (int x = -1; x <= 1; x++) {
+				float4 neighbor = upscale_color.Load(int3(clamp(input + int2(x, y), int2(0, 0), input_size - 1), 0));
+				low = min(low, neighbor);
+				high = max(high, neighbor);
+			}
+		}
+		float4 clamped = clamp(previous, low, high);
+		history_samples *= exp(-upscale_reject.x * dot(abs(clamped.rgb - previous.rgb), float3(1.0f, 1.0f, 1.0f)));
+
+		float blend = max(weight / (history_samples + weight), upscale_jitter.z * weight);
+		result = lerp(clamped, current, blend);
+		samples = min(history_samples + weight, 1.0f / upscale_jitter.z);
+	}
+
+	upscaleOut output;
+	output.color = float4(result.rgb, 1.0f);
+	output.history = float4(result.rgb, samples);
+	return output;
+}
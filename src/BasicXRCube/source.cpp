@@ -18,8 +18,35 @@
 #include <openxr/openxr_platform.h>
 
 // Other includes
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string>
 #include <vector>
 
+// XRCore includes
+#include "core_time.h"
+#include "frame_capture.h"
+#include "frame_pacer.h"
+#include "frame_schedule.h"
+#include "image_recorder.h"
+#include "input_snapshot.h"
+#include "job_system.h"
+#include "late_latch.h"
+#include "light_clusters.h"
+#include "meshlet.h"
+#include "occlusion.h"
+#include "particles.h"
+#include "pose_cache.h"
+#include "quad_layer.h"
+#include "resource_registry.h"
+#include "scene.h"
+#include "simulation.h"
+#include "temporal_upscale.h"
+#include "vertex_format.h"
+#include "view_layout.h"
+#include "xr_math.h"
+
 
 //###################################################################################################################
 // Structs & Typedefs
@@ -33,8 +60,28 @@ struct swapchain_t {
 	XrSwapchain handle;
 	int32_t width;
 	int32_t height;
+	uint32_t array_size; // Views that share the swapchain, one per array slice (see view_layout.h)
 	std::vector<XrSwapchainImageD3D11KHR> swapchain_images;
-	std::vector<swapchain_data_t> swapchain_data;
+	std::vector<swapchain_data_t> swapchain_data; // One per image and array slice, at image * array_size + slice
+};
+
+// D3D11 timestamp queries to measure how long the GPU took for some work. The results are only
+// available a few frames later, so each timer has a small ring of query sets
+const uint32_t gpu_timer_slots = 4;
+
+struct gpu_timer_t {
+	ID3D11Query* disjoint[gpu_timer_slots]; // Tells us the timestamp frequency, and if the timestamps are usable
+	ID3D11Query* begin[gpu_timer_slots];
+	ID3D11Query* end[gpu_timer_slots];
+	bool pending[gpu_timer_slots]; // Set while we still wait for the results of a slot
+	uint32_t next;
+};
+
+// A panel that is shown as its own quad layer instead of being rendered into the projection layer
+struct quad_layer_t {
+	quad_panel_t panel;
+	swapchain_t swapchain;
+	gpu_timer_t gpu_timer;
 };
 
 struct vertex_t {
@@ -42,20 +89,67 @@ struct vertex_t {
 	float norm_x, norm_y, norm_z; // Normal Vector
 };
 
-typedef struct RGBA {
-	FLOAT r;
-	FLOAT g;
-	FLOAT b;
-	FLOAT a;
-} RGBA;
+// The layout of vertex_t. The input layout, the stride and the CPU code that reads vertices are all derived
+// from this (see vertex_format.h), so if vertex_t changes, this has to change with it
+typedef vertex_format<
+	vertex_attribute<vertex_semantic_position, vertex_component_float3>,
+	vertex_attribute<vertex_semantic_normal, vertex_component_float3>> app_vertex_format;
+static_assert(sizeof(vertex_t) == app_vertex_format::stride, "app_vertex_format needs to match vertex_t");
+static_assert(offsetof(vertex_t, norm_x) == app_vertex_format::Attribute(vertex_semantic_normal).offset, "app_vertex_format needs to match vertex_t");
 
+// 16 bit indices are enough for meshes of up to 65536 vertices
+typedef uint16_t app_index_t;
+
+// The constants of a view (b0 in the shaders). The constants of each object (b1) are its scene_draw_item_t,
+// which has its own constant buffer, see DrawD3DObject
 struct const_buffer_t {
-	DirectX::XMFLOAT4X4 world;
-	DirectX::XMFLOAT4X4 view_projection;
-	DirectX::XMFLOAT4X4 rotation;
-	DirectX::XMFLOAT4 light_vector;
-	RGBA light_color;
-	RGBA ambient_color;
+	xr_mat4_t view_projection;
+
+	// The view-projection of this frame and of the last one, both without the jitter. The shaders write the motion
+	// vector of each pixel from them, for the temporal upscaling (see temporal_upscale.h)
+	xr_mat4_t motion_view_projection;
+	xr_mat4_t previous_view_projection;
+
+	// Which cell of the light clusters a pixel is in, see light_clusters.h and PShader
+	DirectX::XMFLOAT4 cluster_scale;
+	DirectX::XMFLOAT4 cluster_viewport;
+	uint32_t cluster_grid[4];
+
+	// The right and up direction of the view, the particles are quads along these (see PartVShader)
+	DirectX::XMFLOAT4 camera_right;
+	DirectX::XMFLOAT4 camera_up;
+};
+
+// The part of the meshlet stream an object draws, see CullMeshlets
+struct meshlet_draw_t {
+	uint32_t first_index;
+	uint32_t index_count;
+};
+
+// The constants of the upscaling of a view (b2 in the shaders), see UpscalePShader
+struct upscale_constants_t {
+	float jitter[4]; // Jitter in pixels of the internal resolution (x, y), the blend (z), and 1 if there is history (w)
+	uint32_t size[4]; // Internal width and height, width and height of the swapchain
+	float reject[4]; // How quickly history that had to be clamped is forgotten (x, see temporal_reject)
+};
+
+// The targets of a view with temporal upscaling. The view is rendered into color, motion and depth at the internal
+// resolution, and then blended into the history, which has the resolution of the swapchain
+struct d3d_upscale_view_t {
+	uint32_t width; // The internal resolution
+	uint32_t height;
+	uint32_t output_width;
+	uint32_t output_height;
+	ID3D11RenderTargetView* color_target;
+	ID3D11ShaderResourceView* color_view;
+	ID3D11RenderTargetView* motion_target;
+	ID3D11ShaderResourceView* motion_view;
+	ID3D11DepthStencilView* depth_buffer;
+	ID3D11RenderTargetView* history_targets[2]; // The output of the last frame, and the one being written
+	ID3D11ShaderResourceView* history_views[2];
+	uint32_t current; // Which history holds the output of the last frame
+	bool history_valid; // False until the first frame was upscaled into the targets
+	xr_mat4_t previous_view_projection; // Of the last frame, without the jitter
 };
 
 //###################################################################################################################
@@ -67,27 +161,64 @@ struct const_buffer_t {
 //------------------------------------------------------------------------------------------------------
 bool InitXr();
 bool InitXrActions();
+bool InitXrQuadLayers();
+bool CreateXrSwapchain(int32_t width, int32_t height, uint32_t sample_count, uint32_t array_size, const char* owner, swapchain_t& swapchain);
+void DestroyXrSwapchain(swapchain_t& swapchain);
+bool CreateXrAction(XrAction& action, XrActionType action_type, const char* name, const char* localized_name);
+bool SuggestXrBindings(const char* interaction_profile, const std::vector<std::pair<XrAction, const char*>>& bindings);
+void ShutdownXr();
 void PollOpenXrEvents(bool& running, bool& xr_running);
 void PollOpenXrActions();
+void LocateOpenXrControllers(XrTime predicted_time);
+bool WaitOpenXrFrame(void* user, frame_wait_result_t& result);
 void RenderOpenXrFrame();
 void RenderOpenXrLayer(XrTime predicted_time, std::vector<XrCompositionLayerProjectionView>& views, XrCompositionLayerProjection& layer_projection);
+uint32_t LocateOpenXrViews(XrTime predicted_time);
+void RenderOpenXrQuadLayers(std::vector<XrCompositionLayerQuad>& quad_layers);
 
 //------------------------------------------------------------------------------------------------------
 // DirectX Methods
 //------------------------------------------------------------------------------------------------------
 bool InitD3DDevice(LUID& adapter_luid);
-swapchain_data_t CreateSwapchainRenderTargets(XrSwapchainImageD3D11KHR& swapchain_image);
+swapchain_data_t CreateSwapchainRenderTargets(XrSwapchainImageD3D11KHR& swapchain_image, uint32_t array_index, const char* owner);
 bool InitD3DPipeline();
 bool InitD3DGraphics();
 void ShutdownD3D();
-void RenderD3DLayer(XrCompositionLayerProjectionView& view, swapchain_data_t& swapchain_data);
-DirectX::XMMATRIX CreateViewProjectionMatrix(XrCompositionLayerProjectionView& view);
+bool CreateD3DStructuredBuffer(uint32_t element_size, uint32_t element_count, const char* owner, ID3D11Buffer*& buffer, ID3D11ShaderResourceView*& view);
+void UploadD3DStructuredBuffer(ID3D11Buffer* buffer, const void* data, size_t size);
+void UploadD3DLights();
+bool InitD3DParticles();
+void UploadD3DParticles();
+void DrawD3DParticles();
+bool InitD3DUpscale();
+bool CreateD3DRenderTexture(uint32_t width, uint32_t height, DXGI_FORMAT format, uint32_t bytes_per_pixel, const char* owner, ID3D11RenderTargetView*& target, ID3D11ShaderResourceView*& view);
+bool CreateD3DUpscaleTargets(d3d_upscale_view_t& upscale, uint32_t output_width, uint32_t output_height);
+void ReleaseD3DUpscaleTargets(d3d_upscale_view_t& upscale);
+void RenderD3DLayer(uint32_t view_index, XrCompositionLayerProjectionView& view, swapchain_data_t& swapchain_data);
+void RenderD3DUpscale(d3d_upscale_view_t& upscale, swapchain_data_t& swapchain_data, const temporal_jitter_t& jitter);
+xr_mat4_t CreateViewProjectionMatrix(XrCompositionLayerProjectionView& view, const temporal_jitter_t& jitter);
+void RenderD3DQuadPanel(uint32_t panel_index, XrCompositionLayerProjectionView& view, swapchain_data_t& swapchain_data);
+bool CreateD3DGpuTimer(gpu_timer_t& timer);
+void ReleaseD3DGpuTimer(gpu_timer_t& timer);
+uint32_t BeginD3DGpuTimer(gpu_timer_t& timer);
+void EndD3DGpuTimer(gpu_timer_t& timer, uint32_t slot);
+bool ReadD3DGpuTimer(gpu_timer_t& timer, double& gpu_ms);
+bool CopyD3DReadback(void* user, uint32_t slot, const void* source, uint32_t width, uint32_t height);
+bool MapD3DReadback(void* user, uint32_t slot, const uint8_t*& pixels, uint32_t& row_pitch);
+void UnmapD3DReadback(void* user, uint32_t slot);
+template <typename T> void ReleaseD3DObject(T*& object);
 
 //------------------------------------------------------------------------------------------------------
 // App Methods
 //------------------------------------------------------------------------------------------------------
-void UpdateSimulation(XrTime predicted_time);
-void Draw(XrCompositionLayerProjectionView& view);
+void InitScene();
+void UpdateSimulation(const frame_plan_t& frame_plan);
+void PrepareDraw(uint32_t view_count);
+void CullScene(uint32_t view_count);
+void CullMeshlets(const view_frustum_t* frustums, uint32_t view_count);
+void Draw(XrCompositionLayerProjectionView& view, const std::vector<uint32_t>& objects, const temporal_jitter_t& jitter);
+void DrawD3DObject(uint32_t object, bool cull_meshlets);
+XrCompositionLayerProjectionView CreateQuadPanelView(const quad_panel_t& panel);
 
 
 //###################################################################################################################
@@ -100,6 +231,49 @@ void Draw(XrCompositionLayerProjectionView& view);
 const char* app_config_name = "BasicXRCube";
 XrFormFactor app_config_form_factor = XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY;	// We'll use a head mounted display
 XrViewConfigurationType app_config_view = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO; // And the HMD has two screens, one for each eye
+bool app_config_quad_views = true; // Render four views instead (XR_VARJO_quad_views), if the headset has them
+view_resolution_policy_t app_config_view_resolution = view_resolution_foveated; // How the resolution of each view is chosen, see view_layout.h
+float app_config_view_scale = 0.6f; // Scale of all views with view_resolution_scaled, of the outer ones with view_resolution_foveated
+bool app_config_view_arrays = true; // Views of the same size share one swapchain, as the slices of a texture array
+bool app_config_late_latch = true; // Locate the views a second time right before submitting the draw calls
+bool app_config_occlusion_culling = true; // Skip the objects that are hidden behind others
+const char* app_config_capture_file = nullptr; // If set, the inputs of every frame are recorded to this file, see frame_capture.h
+uint64_t app_config_resource_budget_mb = 512; // Memory our swapchains, depth buffers etc. should fit in, see resource_registry.h
+bool app_config_light_clusters = true; // Light the scene with all its lights, not only the sun
+bool app_config_frame_pacing = true; // Wait for the frames on their own thread and start the work just in time, see frame_pacer.h
+bool app_config_particles = true; // Draw the sparks and the dust of the simulation, see particles.h
+const char* app_config_image_directory = nullptr; // If set, the rendered views are written to this directory as QOI images, see image_recorder.h
+uint32_t app_config_image_interval = 90; // Every how many frames the views are written to app_config_image_directory
+// Render the views at a lower resolution and upscale them over time, see temporal_upscale.h. The scale comes on top
+// of app_config_view_scale (0.45 for the outer views with view_resolution_foveated)
+bool app_config_temporal_upscale = true;
+float app_config_temporal_scale = 0.75f; // The internal resolution of the views per axis with app_config_temporal_upscale
+bool app_config_meshlet_culling = true; // Leave out the parts of the meshes that face away from all views, see meshlet.h
+
+// The grid of the light clusters of each view, see light_clusters.h. The GPU buffers are created for these sizes
+const uint32_t app_light_tiles_x = 16;
+const uint32_t app_light_tiles_y = 16;
+const uint32_t app_light_slices = 24;
+const uint32_t app_max_views = 4;
+const uint32_t app_max_lights = 1024;
+const uint32_t app_max_light_indices = 256 * 1024;
+
+// How often the quad panels report how much GPU time reusing their images saved, in frames (10s at 90Hz)
+const uint64_t app_panel_report_frames = 900;
+
+// Size of the instance buffer of the particles, the sparks and the dust together
+const uint32_t app_max_particles = 32 * 1024;
+
+// The spaces of xr_pose_cache: the hands first, then the views. Poses further than this after the newest
+// sample aren't extrapolated any further, see pose_cache.h
+const uint32_t app_pose_space_views = input_max_hands;
+const uint32_t app_pose_space_count = input_max_hands + app_max_views;
+const XrDuration app_pose_max_extrapolation = 50000000; // 50ms
+
+// The meshlets of the cube mesh can have up to this many triangles. The cube only has 2 per side, and the sides
+// face different ways, so each side becomes a meshlet of its own. Size of the index buffer of the meshlet stream
+const uint32_t app_meshlet_max_triangles = 64;
+const uint32_t app_max_meshlet_indices = 256 * 1024;
 
 //------------------------------------------------------------------------------------------------------
 // OpenXR globals
@@ -113,7 +287,45 @@ XrSpace xr_app_space = {};
 
 std::vector<XrView> xr_views;
 std::vector<XrViewConfigurationView> xr_view_configurations;
-std::vector<swapchain_t> xr_swapchains;
+view_layout_t xr_view_layout; // The resolution of each view, and the swapchain and array slice it's rendered to
+std::vector<swapchain_t> xr_swapchains; // The swapchains of xr_view_layout
+
+std::vector<view_latch_t> xr_view_latches; // The poses of xr_views, together with the time we located them
+pose_age_stats_t xr_pose_age_stats; // How old the poses were when we handed the images to the runtime
+frame_schedule_t xr_frame_schedule; // Decides what each frame does, and measures the CPU time of the frames
+frame_pacer_t xr_frame_pacer; // Calls xrWaitFrame on its own thread while the session runs
+int64_t xr_counter_frequency; // Ticks per second of the performance counter, to convert XrTime to the CPU clock
+int64_t xr_wake_offset_ns = INT64_MAX; // Without XR_KHR_win32_convert_performance_counter_time, see WaitOpenXrFrame
+
+//------------------------------------------------------------------------------------------------------
+// OpenXR quad layer globals
+//------------------------------------------------------------------------------------------------------
+// The panels we show as quad layers, indexed by app_panel_t. For now, that's a single panel which shows
+// the cube as it was when its spinning was last toggled
+enum app_panel_t {
+	app_panel_status,
+	app_panel_count
+};
+
+std::vector<quad_layer_t> xr_quad_layers;
+
+//------------------------------------------------------------------------------------------------------
+// OpenXR input globals
+//------------------------------------------------------------------------------------------------------
+XrActionSet xr_action_set = {}; // The action set containing all our actions
+XrAction xr_action_hand_pose = {}; // Pose action of the controllers
+XrAction xr_actions[app_action_count] = {}; // The button actions, indexed by app_action_t
+XrActionType xr_action_types[app_action_count] = { XR_ACTION_TYPE_BOOLEAN_INPUT, XR_ACTION_TYPE_FLOAT_INPUT, XR_ACTION_TYPE_BOOLEAN_INPUT };
+XrPath xr_hand_paths[input_max_hands] = {}; // The subaction paths for the left and the right hand
+XrSpace xr_hand_spaces[input_max_hands] = {}; // The spaces of the controller poses
+
+input_snapshot_buffer_t xr_input_snapshots; // The latest published input, can be read from any thread
+input_snapshot_t xr_input_pending = {}; // The input of the current frame, before it's published
+
+// The poses of the hands and the views of the last frames, located once per frame. Code on the render thread
+// that needs a pose at another time than the display time of the frame asks this, instead of the runtime: the
+// simulation steps that catch up after a missed frame get the hands from here, see UpdateSimulation
+pose_cache_t xr_pose_cache;
 
 //------------------------------------------------------------------------------------------------------
 // D3D globals
@@ -125,18 +337,56 @@ ID3D11VertexShader* d3d_vertex_shader;
 ID3D11PixelShader* d3d_pixel_shader;
 ID3D11InputLayout* d3d_input_layout;
 ID3D11Buffer* d3d_const_buffer;
+// One constant buffer per object of the scene, with its draw item. It's only updated when the item changed,
+// which for most objects is never, so we keep the version of the item each buffer has (see scene_draw_cache_t)
+std::vector<ID3D11Buffer*> d3d_object_buffers;
+std::vector<uint32_t> d3d_object_versions;
 ID3D11Buffer* d3d_vertex_buffer;
 ID3D11Buffer* d3d_index_buffer;
+ID3D11Buffer* d3d_meshlet_index_buffer; // meshlet_stream, rewritten every frame
+ID3D11Buffer* d3d_light_buffer; // The lights, the cells of the light clusters and their light indices
+ID3D11Buffer* d3d_light_cell_buffer;
+ID3D11Buffer* d3d_light_index_buffer;
+ID3D11ShaderResourceView* d3d_light_views[3]; // The three buffers above, in the order the pixel shader wants them
+ID3D11VertexShader* d3d_particle_vertex_shader;
+ID3D11PixelShader* d3d_particle_pixel_shader;
+ID3D11InputLayout* d3d_particle_input_layout;
+ID3D11Buffer* d3d_particle_buffer; // One particle_instance_t per particle, rewritten every frame
+ID3D11BlendState* d3d_particle_blend_state; // The particles are added onto what's behind them
+ID3D11DepthStencilState* d3d_particle_depth_state; // Hidden behind the scene, but they don't hide each other
+uint32_t d3d_particle_count; // Number of instances in d3d_particle_buffer
+xr_projection_cache_t d3d_projection_cache = {}; // The projection matrices of the views, rebuilt only when a fov changes
+
+// Temporal upscaling, see RenderD3DUpscale. The targets of each view are created when the view is first rendered
+ID3D11VertexShader* d3d_upscale_vertex_shader;
+ID3D11PixelShader* d3d_upscale_pixel_shader;
+ID3D11Buffer* d3d_upscale_buffer; // The upscale_constants_t of the view that is upscaled
+d3d_upscale_view_t d3d_upscale_views[app_max_views];
+
+// The staging textures the image recorder copies the views into, one per slot of its pool. Multisampled
+// swapchain images are resolved into the resolve texture of the slot first, as they can't be mapped
+struct d3d_readback_t {
+	std::vector<ID3D11Texture2D*> staging;
+	std::vector<ID3D11Texture2D*> resolve;
+};
+d3d_readback_t d3d_readback;
 
 //------------------------------------------------------------------------------------------------------
 // Constants to use
 //------------------------------------------------------------------------------------------------------
 const XrPosef xr_pose_identity = { {0, 0, 0, 1}, {0, 0, 0} }; // Struct consisting of a quaternion which describes the orientation, and a vector3f which describes the position
 
+// The near and the far plane. A value often used for the near clipping in desktop applications is 1.0f,
+// however that seems to be too high for XR applications, as objects "relatively" close to the user already
+// vanish from the view, even when you would expect them not to
+const float app_near_clipping = 0.05f;
+const float app_far_clipping = 100.0f;
+
 //------------------------------------------------------------------------------------------------------
-// Pointer to a function that we need to load
+// Pointers to functions that we need to load
 //------------------------------------------------------------------------------------------------------
 PFN_xrGetD3D11GraphicsRequirementsKHR ext_xrGetD3D11GraphicsRequirementsKHR;
+PFN_xrConvertTimeToWin32PerformanceCounterKHR ext_xrConvertTimeToWin32PerformanceCounterKHR = nullptr; // Stays null if the runtime doesn't have the extension
 
 //------------------------------------------------------------------------------------------------------
 // The data to draw
@@ -173,7 +423,7 @@ vertex_t vertices[] = {
 		{-1.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f},
 };
 
-uint16_t indices[] = {
+app_index_t indices[] = {
 	2, 1, 0,    // side 1
 	3, 1, 2,
 	6, 5, 4,    // side 2
@@ -188,7 +438,49 @@ uint16_t indices[] = {
 	23, 21, 22
 };
 
-DirectX::XMFLOAT3 cube_rotation_angles = { 0.0f, 0.0f, 0.0f };
+// Everything we draw (the spinning cube, surrounded by a few city blocks) and its state. Each object is
+// drawn with the cube mesh above, scaled to the size of the object
+simulation_t simulation;
+
+// Worker threads for the work of a frame that splits into many independent parts, like updating the particles
+job_system_t job_system;
+
+// The depth buffer the occluders are rasterized into on the CPU, to find out which objects are hidden
+occlusion_buffer_t occlusion_buffer;
+
+// The per-object constants of all objects, only updated for the objects that moved (see scene.h)
+scene_draw_cache_t draw_cache;
+
+// The objects that survived the culling. Built once per frame, used for all views
+std::vector<uint32_t> draw_list;
+
+// The part of the draw list that's in the frustum of each view, see view_layout.h
+std::vector<uint32_t> view_draw_lists[app_max_views];
+
+// The cube mesh split into meshlets, and the indices of the meshlets that may be visible in one of the views
+// this frame, for all objects of the draw list (see CullMeshlets). The stream starts with the whole mesh
+meshlet_mesh_t cube_meshlets;
+std::vector<app_index_t> meshlet_stream;
+std::vector<meshlet_draw_t> meshlet_draws; // Per object
+meshlet_cull_stats_t meshlet_stats; // Of the last frame
+
+// The lights of each cell of the views, built once per frame by PrepareDraw
+light_cluster_grid_t light_clusters;
+
+// Records the inputs of every frame if app_config_capture_file is set, such that the session can be
+// replayed later without a headset
+capture_writer_t frame_capture;
+
+// The constant buffer of the views. The light clusters and the view-projection matrix are filled once per view
+const_buffer_t draw_constants;
+
+// Writes the rendered views to disk if app_config_image_directory is set, without ever waiting for the GPU
+image_recorder_t image_recorder;
+bool image_recording = false;
+
+// Every resource we create is tracked in here, together with its size and owner, such that we know how
+// much memory we use and what we forgot to release
+resource_registry_t resource_registry;
 
 
 //###################################################################################################################
@@ -196,6 +488,12 @@ DirectX::XMFLOAT3 cube_rotation_angles = { 0.0f, 0.0f, 0.0f };
 //###################################################################################################################
 int __stdcall wWinMain(HINSTANCE, HINSTANCE, LPWSTR, int) {
 
+	// Needs to be ready before the first resource is created
+	ResourceRegistryInit(resource_registry, app_config_resource_budget_mb * 1024 * 1024);
+
+	// Half a millisecond of safety margin on top of the expected CPU time of a frame
+	FramePacerInit(xr_frame_pacer, 500000);
+
 	//------------------------------------------------------------------------------------------------------
 	// Initialize OpenXR
 	//------------------------------------------------------------------------------------------------------
@@ -224,6 +522,40 @@ int __stdcall wWinMain(HINSTANCE, HINSTANCE, LPWSTR, int) {
 		return -1;
 	}
 
+	//------------------------------------------------------------------------------------------------------
+	// Initialize the quad layers
+	//------------------------------------------------------------------------------------------------------
+	if (!InitXrQuadLayers()) {
+		return -1;
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Initialize the scene
+	//------------------------------------------------------------------------------------------------------
+	InitScene();
+
+	//------------------------------------------------------------------------------------------------------
+	// Start recording the frames, if we should
+	//------------------------------------------------------------------------------------------------------
+	// InitScene already started the workers of the job system, which have to be joined before we return
+	if (app_config_capture_file && !CaptureOpen(frame_capture, app_config_capture_file)) {
+		MessageBox(NULL, "Couldn't open the capture file.", "Error", MB_OK);
+		JobSystemShutdown(job_system);
+		return -1;
+	}
+
+	// The images are mapped two frames after their copy was queued, by then the GPU is usually done with them.
+	// The pool has room for the views of four recorded frames, and half of the workers of the job system
+	// would be idle most of the time anyway, so the encoders get their own threads
+	if (app_config_image_directory) {
+		image_readback_t readback = { CopyD3DReadback, MapD3DReadback, UnmapD3DReadback, &d3d_readback, false };
+		uint32_t slot_count = (uint32_t)xr_view_layout.views.size() * 4;
+		d3d_readback.staging.assign(slot_count, nullptr);
+		d3d_readback.resolve.assign(slot_count, nullptr);
+		ImageRecorderInit(image_recorder, readback, slot_count, std::max(1u, JobSystemDefaultWorkers() / 2), app_config_image_directory, app_config_image_interval, 2);
+		image_recording = true;
+	}
+
 	//------------------------------------------------------------------------------------------------------
 	// Main Loop
 	//------------------------------------------------------------------------------------------------------
@@ -235,14 +567,11 @@ int __stdcall wWinMain(HINSTANCE, HINSTANCE, LPWSTR, int) {
 		PollOpenXrEvents(loop_running, xr_running);
 
 		if (xr_running) {
-			// TODO: If OpenXR is still running
-			// 1) Poll actions
-			PollOpenXrActions();
-
-			// 2) Render frame. We'll also call the method that updates the simulation in
-			//    that method, as we need to pass the predicted time (when the frame will
-			//	  be rendered) to the simulation, such that we're able to use the time
-			//	  to update the simulation accurately
+			// Render frame. We'll also poll the actions and update the simulation in that
+			// method: the actions are synced once we waited for the frame, such that the input
+			// is as new as possible, and we need to pass the predicted time (when the frame will
+			// be rendered) to the simulation, such that we're able to use the time
+			// to update the simulation accurately
 			RenderOpenXrFrame();
 		}
 
@@ -251,9 +580,32 @@ int __stdcall wWinMain(HINSTANCE, HINSTANCE, LPWSTR, int) {
 	}
 
 	//------------------------------------------------------------------------------------------------------
-	// Shutdown D3D
+	// Write out the rest of the recording
+	//------------------------------------------------------------------------------------------------------
+	CaptureClose(frame_capture);
+
+	// The images still in flight are written before the D3D device goes away. Their copies may not even be
+	// submitted to the GPU yet, so we do that first
+	if (image_recording) {
+		d3d_device_context->Flush();
+		ImageRecorderShutdown(image_recorder, 1000);
+		image_recording = false;
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Shutdown OpenXR and D3D
 	//------------------------------------------------------------------------------------------------------
+	// OpenXR goes first, as the swapchains hold render targets that need to be released while the device
+	// is still alive
+	ShutdownXr();
 	ShutdownD3D();
+	JobSystemShutdown(job_system);
+
+	// Everything should be released by now, so whatever is left in the registry was leaked
+	std::string leak_report = ResourceLeakReport(resource_registry);
+	if (!leak_report.empty()) {
+		OutputDebugStringA(leak_report.c_str());
+	}
 
 
 	//------------------------------------------------------------------------------------------------------
@@ -270,13 +622,32 @@ bool InitXr() {
 	XrResult result;
 
 	//------------------------------------------------------------------------------------------------------
-	// Setup the OpenXR instance. At the moment, we're only using the D3D11 extension
+	// Setup the OpenXR instance. We need the D3D11 extension, and the quad views extension if we want to
+	// render quad views and the runtime has it. The frame pacer wants to know the predicted display times
+	// on the CPU clock, which the performance counter extension tells us, if the runtime has it
 	//------------------------------------------------------------------------------------------------------
-	const char* enabled_extensions[] = { XR_KHR_D3D11_ENABLE_EXTENSION_NAME };
+	std::vector<const char*> enabled_extensions = { XR_KHR_D3D11_ENABLE_EXTENSION_NAME };
+	bool quad_views_enabled = false;
+	bool counter_time_enabled = false;
+	uint32_t extension_count = 0;
+	xrEnumerateInstanceExtensionProperties(nullptr, 0, &extension_count, nullptr);
+	std::vector<XrExtensionProperties> extensions(extension_count, { XR_TYPE_EXTENSION_PROPERTIES });
+	xrEnumerateInstanceExtensionProperties(nullptr, extension_count, &extension_count, extensions.data());
+	for (const XrExtensionProperties& extension : extensions) {
+		if (app_config_quad_views && strcmp(extension.extensionName, XR_VARJO_QUAD_VIEWS_EXTENSION_NAME) == 0) {
+			enabled_extensions.push_back(XR_VARJO_QUAD_VIEWS_EXTENSION_NAME);
+			quad_views_enabled = true;
+		}
+		if (strcmp(extension.extensionName, XR_KHR_WIN32_CONVERT_PERFORMANCE_COUNTER_TIME_EXTENSION_NAME) == 0) {
+			enabled_extensions.push_back(XR_KHR_WIN32_CONVERT_PERFORMANCE_COUNTER_TIME_EXTENSION_NAME);
+			counter_time_enabled = true;
+		}
+	}
+
 	XrInstanceCreateInfo create_info = {};
 	create_info.type = XR_TYPE_INSTANCE_CREATE_INFO;
-	create_info.enabledExtensionCount = 1;
-	create_info.enabledExtensionNames = enabled_extensions;
+	create_info.enabledExtensionCount = (uint32_t)enabled_extensions.size();
+	create_info.enabledExtensionNames = enabled_extensions.data();
 	create_info.applicationInfo.apiVersion = XR_CURRENT_API_VERSION;
 	strcpy_s(create_info.applicationInfo.applicationName, 128, app_config_name); // Copy the application name from the global
 
@@ -298,6 +669,20 @@ bool InitXr() {
 		return false;
 	}
 
+	// Having the quad views extension doesn't mean the headset has quad views, so we check the view
+	// configurations of the system. If it doesn't have them, we stay with stereo
+	if (quad_views_enabled) {
+		uint32_t configuration_count = 0;
+		xrEnumerateViewConfigurations(xr_instance, xr_system_id, 0, &configuration_count, nullptr);
+		std::vector<XrViewConfigurationType> configurations(configuration_count);
+		xrEnumerateViewConfigurations(xr_instance, xr_system_id, configuration_count, &configuration_count, configurations.data());
+		for (XrViewConfigurationType configuration : configurations) {
+			if (configuration == XR_VIEW_CONFIGURATION_TYPE_PRIMARY_QUAD_VARJO) {
+				app_config_view = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_QUAD_VARJO;
+			}
+		}
+	}
+
 	//------------------------------------------------------------------------------------------------------
 	// Setup the OpenXR session
 	//------------------------------------------------------------------------------------------------------
@@ -313,6 +698,12 @@ bool InitXr() {
 	// Get the address of the "xrGetD3D11GraphicsRequirementsKHR" function and store it, such that we can
 	// call the function. As of now, it seems it's not yet possible to directly call the function
 	xrGetInstanceProcAddr(xr_instance, "xrGetD3D11GraphicsRequirementsKHR", (PFN_xrVoidFunction*)(&ext_xrGetD3D11GraphicsRequirementsKHR));
+	if (counter_time_enabled) {
+		xrGetInstanceProcAddr(xr_instance, "xrConvertTimeToWin32PerformanceCounterKHR", (PFN_xrVoidFunction*)(&ext_xrConvertTimeToWin32PerformanceCounterKHR));
+	}
+	LARGE_INTEGER counter_frequency;
+	QueryPerformanceFrequency(&counter_frequency);
+	xr_counter_frequency = counter_frequency.QuadPart;
 
 	XrGraphicsRequirementsD3D11KHR graphics_requirements = {};
 	graphics_requirements.type = XR_TYPE_GRAPHICS_REQUIREMENTS_D3D11_KHR;
@@ -387,6 +778,7 @@ bool InitXr() {
 	// the fov of the view. Basically, a XrView is a view matrix in "traditional" rendering).
 	xr_view_configurations.resize(viewport_count, { XR_TYPE_VIEW_CONFIGURATION_VIEW });
 	xr_views.resize(viewport_count, { XR_TYPE_VIEW });
+	xr_view_latches.resize(viewport_count);
 
 	// Now we again call xrEnumerateViewConfigurationViews, this time we set the 4th param
 	// to the number of our viewports, such that the method fills the xr_view_configurations
@@ -396,83 +788,344 @@ bool InitXr() {
 		return false;
 	}
 
+	// Decide the resolution of each view, and which views can share a swapchain
+	std::vector<view_config_t> view_configs(viewport_count);
+	for (uint32_t i = 0; i < viewport_count; i++) {
+		const XrViewConfigurationView& configuration = xr_view_configurations[i];
+		view_configs[i] = {
+			configuration.recommendedImageRectWidth,
+			configuration.recommendedImageRectHeight,
+			configuration.maxImageRectWidth,
+			configuration.maxImageRectHeight,
+			configuration.recommendedSwapchainSampleCount,
+		};
+	}
+	ViewLayoutBuild(view_configs.data(), viewport_count, app_config_view_resolution, app_config_view_scale, app_config_view_arrays, xr_view_layout);
+
 	//------------------------------------------------------------------------------------------------------
 	// Setup the swapchains
 	//------------------------------------------------------------------------------------------------------
 
-	// For each viewport, we need to setup a swapchain. A swapchain consists of multiple buffers, where one
+	// For the views, we need to setup swapchains. A swapchain consists of multiple buffers, where one
 	// is used to draw the data to the screen, and another is used to render the deta from the simulation
 	// to. With this approach, tearing (that might occur because the scene is updated while it's drawn
-	// to the screen) should not occur
+	// to the screen) should not occur.
+	// Views of the same size share a swapchain, each view renders into its own slice of the texture array,
+	// so a stereo headset usually has a single swapchain with two slices
 
-	for (uint32_t i = 0; i < viewport_count; i++) {
-		// Get the current view configuration we're interested in
-		XrViewConfigurationView& current_view_configuration = xr_view_configurations[i];
-
-		// Create a create info struct to create the swapchain
-		XrSwapchainCreateInfo swapchain_create_info = {};
-		swapchain_create_info.type = { XR_TYPE_SWAPCHAIN_CREATE_INFO };
-		swapchain_create_info.arraySize = 1; // Number of array layers
-		swapchain_create_info.mipCount = 1; // Only use one mipmap level, bigger numbers would only be useful for textures
-		swapchain_create_info.faceCount = 1; // Number of faces to render, 1 should be used, other option would be 6 for cubemaps
-		swapchain_create_info.format = d3d_swapchain_format; // Use the globally set swapchain format
-		swapchain_create_info.width = current_view_configuration.recommendedImageRectWidth; // Just use the recommended width that the runtime gave us
-		swapchain_create_info.height = current_view_configuration.recommendedImageRectHeight; // Just use the recommended height that the runtime gave us
-		swapchain_create_info.sampleCount = current_view_configuration.recommendedSwapchainSampleCount; // Just use the recommended sample count that the runtime gave us
-		swapchain_create_info.usageFlags = XR_SWAPCHAIN_USAGE_SAMPLED_BIT | XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
-
-		// Create the OpenXR swapchain
-		XrSwapchain swapchain_handle;
-		result = xrCreateSwapchain(xr_session, &swapchain_create_info, &swapchain_handle);
-		if (XR_FAILED(result)) {
+	for (uint32_t i = 0; i < (uint32_t)xr_view_layout.swapchains.size(); i++) {
+		const view_layout_swapchain_t& layout_swapchain = xr_view_layout.swapchains[i];
+
+		// Create the swapchain with the size the layout decided on for its views
+		swapchain_t swapchain = {};
+		std::string owner = "views " + std::to_string(i);
+		bool swapchain_created = CreateXrSwapchain(
+			layout_swapchain.width,
+			layout_swapchain.height,
+			layout_swapchain.sample_count,
+			layout_swapchain.array_size,
+			owner.c_str(),
+			swapchain
+		);
+		if (!swapchain_created) {
 			return false;
 		}
 
-		// OpenXR can create an arbitrary number of swapchain images (from which we'll create our buffers),
-		// so we need to find out how many were created by the runtime
-		// If we pass zero as the 2nd param, we request the number of swapchain images and store it
-		// in the 3rd param
-		uint32_t swapchain_image_count = 0;
-		result = xrEnumerateSwapchainImages(swapchain_handle, 0, &swapchain_image_count, NULL);
-		if (XR_FAILED(result)) {
-			return false;
+		// We're done creating that swapchain, we can now add it to the vector of our swapchains
+		xr_swapchains.push_back(swapchain);
+	}
+
+	return true;
+}
+
+// Creates an OpenXR swapchain with the given size, together with a render target for each array slice of each of
+// its images
+bool CreateXrSwapchain(int32_t width, int32_t height, uint32_t sample_count, uint32_t array_size, const char* owner, swapchain_t& swapchain) {
+	XrResult result;
+
+	// Create a create info struct to create the swapchain
+	XrSwapchainCreateInfo swapchain_create_info = {};
+	swapchain_create_info.type = { XR_TYPE_SWAPCHAIN_CREATE_INFO };
+	swapchain_create_info.arraySize = array_size; // Number of array layers, one per view
+	swapchain_create_info.mipCount = 1; // Only use one mipmap level, bigger numbers would only be useful for textures
+	swapchain_create_info.faceCount = 1; // Number of faces to render, 1 should be used, other option would be 6 for cubemaps
+	swapchain_create_info.format = d3d_swapchain_format; // Use the globally set swapchain format
+	swapchain_create_info.width = width;
+	swapchain_create_info.height = height;
+	swapchain_create_info.sampleCount = sample_count;
+	swapchain_create_info.usageFlags = XR_SWAPCHAIN_USAGE_SAMPLED_BIT | XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
+
+	// Create the OpenXR swapchain
+	XrSwapchain swapchain_handle;
+	result = xrCreateSwapchain(xr_session, &swapchain_create_info, &swapchain_handle);
+	if (XR_FAILED(result)) {
+		return false;
+	}
+
+	// OpenXR can create an arbitrary number of swapchain images (from which we'll create our buffers),
+	// so we need to find out how many were created by the runtime
+	// If we pass zero as the 2nd param, we request the number of swapchain images and store it
+	// in the 3rd param
+	uint32_t swapchain_image_count = 0;
+	result = xrEnumerateSwapchainImages(swapchain_handle, 0, &swapchain_image_count, NULL);
+	if (XR_FAILED(result)) {
+		xrDestroySwapchain(swapchain_handle);
+		return false;
+	}
+
+	// The images are allocated by the runtime, but they still count towards the memory we use. The format
+	// has 4 bytes per pixel
+	uint64_t swapchain_bytes = ResourceTextureBytes(width, height, 4, sample_count, array_size, 1) * swapchain_image_count;
+	ResourceTrack(resource_registry, (uint64_t)swapchain_handle, resource_swapchain, swapchain_bytes, owner);
+
+	// Now we can create the swapchain
+	swapchain = {};
+	swapchain.width = swapchain_create_info.width;
+	swapchain.height = swapchain_create_info.height;
+	swapchain.array_size = array_size;
+	swapchain.handle = swapchain_handle;
+	swapchain.swapchain_images.resize(swapchain_image_count, { XR_TYPE_SWAPCHAIN_IMAGE_D3D11_KHR });
+	swapchain.swapchain_data.resize(swapchain_image_count * array_size);
+
+	// Now call the xrEnumerateSwapchainImages function again, this time with the 2nd param set to the number
+	// of swapchain images that got created by OpenXR. That way, we can store the swapchain images into our
+	// swwapchain
+	result = xrEnumerateSwapchainImages(swapchain_handle, swapchain_image_count, &swapchain_image_count, (XrSwapchainImageBaseHeader*)swapchain.swapchain_images.data());
+	if (XR_FAILED(result)) {
+		ResourceRelease(resource_registry, (uint64_t)swapchain_handle);
+		xrDestroySwapchain(swapchain_handle);
+		swapchain = {};
+		return false;
+	}
+
+	// For each swapchain image, call the function to create a render target for each of its slices
+	for (uint32_t i = 0; i < swapchain_image_count; i++) {
+		for (uint32_t slice = 0; slice < array_size; slice++) {
+			swapchain.swapchain_data[i * array_size + slice] = CreateSwapchainRenderTargets(swapchain.swapchain_images[i], slice, owner);
 		}
+	}
 
-		// Now we can create the swapchain
-		swapchain_t swapchain = {};
-		swapchain.width = swapchain_create_info.width;
-		swapchain.height = swapchain_create_info.height;
-		swapchain.handle = swapchain_handle;
-		swapchain.swapchain_images.resize(swapchain_image_count, { XR_TYPE_SWAPCHAIN_IMAGE_D3D11_KHR });
-		swapchain.swapchain_data.resize(swapchain_image_count);
-
-		// Now call the xrEnumerateSwapchainImages function again, this time with the 2nd param set to the number
-		// of swapchain images that got created by OpenXR. That way, we can store the swapchain images into our
-		// swwapchain
-		result = xrEnumerateSwapchainImages(swapchain_handle, swapchain_image_count, &swapchain_image_count, (XrSwapchainImageBaseHeader*)swapchain.swapchain_images.data());
-		if (XR_FAILED(result)) {
+	return true;
+}
+
+// Releases the render targets of a swapchain, and the swapchain itself
+void DestroyXrSwapchain(swapchain_t& swapchain) {
+	for (swapchain_data_t& swapchain_data : swapchain.swapchain_data) {
+		ReleaseD3DObject(swapchain_data.back_buffer);
+		ReleaseD3DObject(swapchain_data.depth_buffer);
+	}
+	swapchain.swapchain_data.clear();
+	swapchain.swapchain_images.clear();
+
+	if (swapchain.handle) {
+		ResourceRelease(resource_registry, (uint64_t)swapchain.handle);
+		xrDestroySwapchain(swapchain.handle);
+		swapchain.handle = {};
+	}
+}
+
+bool InitXrQuadLayers() {
+	//------------------------------------------------------------------------------------------------------
+	// Setup the panels
+	//------------------------------------------------------------------------------------------------------
+	// A quad layer is a flat rectangle placed somewhere in the world, which shows the image of its own
+	// swapchain. The compositor draws it on top of the projection layer, and it keeps showing the last
+	// image we released into that swapchain. So as long as the content of a panel doesn't change, we don't
+	// need to render anything for it at all.
+	// The status panel floats a bit to the left of the cube, and faces the user
+	XrPosef status_pose = xr_pose_identity;
+	status_pose.position = { -0.45f, 0.1f, -0.6f };
+	xr_quad_layers.resize(app_panel_count);
+	xr_quad_layers[app_panel_status].panel = QuadPanelCreate("status", status_pose, { 0.25f, 0.25f }, 512, 512);
+
+	//------------------------------------------------------------------------------------------------------
+	// Create a swapchain and a GPU timer for each panel
+	//------------------------------------------------------------------------------------------------------
+	// Each panel needs its own swapchain, as the compositor reads from it every frame, also in the frames
+	// we don't render into it. Quad layers are sampled by the compositor anyway, so we don't need any
+	// multisampling
+	for (quad_layer_t& quad_layer : xr_quad_layers) {
+		if (!CreateXrSwapchain(quad_layer.panel.width, quad_layer.panel.height, 1, 1, quad_layer.panel.name, quad_layer.swapchain)) {
 			return false;
 		}
 
-		// For each swapchain image, call the function to create a render target using that swapchain image
-		for (uint32_t i = 0; i < swapchain_image_count; i++) {
-			swapchain.swapchain_data[i] = CreateSwapchainRenderTargets(swapchain.swapchain_images[i]);
+		// The GPU timer tells us how expensive rendering the panel is, which is the time we save in every
+		// frame we don't need to render it
+		if (!CreateD3DGpuTimer(quad_layer.gpu_timer)) {
+			return false;
 		}
-
-		// We're done creating that swapchain, we can now add it to the vector of our swapchains (as we have multiple,
-		// as mentioned before one for each view
-		xr_swapchains.push_back(swapchain);
-
 	}
 
 	return true;
 }
 
 bool InitXrActions() {
-	// IMPLEMENT ME
+	XrResult result;
+
+	// The snapshots are read by the simulation, so they need to be ready before the first frame
+	InputSnapshotInit(xr_input_snapshots);
+	PoseCacheInit(xr_pose_cache, app_pose_space_count, app_pose_max_extrapolation);
+
+	//------------------------------------------------------------------------------------------------------
+	// Create the action set
+	//------------------------------------------------------------------------------------------------------
+	// Actions are always grouped into action sets. An application could for example have one action set
+	// for a menu and another one for the gameplay, and only activate the one it currently needs. We
+	// only need one action set for now
+	XrActionSetCreateInfo action_set_create_info = {};
+	action_set_create_info.type = XR_TYPE_ACTION_SET_CREATE_INFO;
+	strcpy_s(action_set_create_info.actionSetName, XR_MAX_ACTION_SET_NAME_SIZE, "gameplay");
+	strcpy_s(action_set_create_info.localizedActionSetName, XR_MAX_LOCALIZED_ACTION_SET_NAME_SIZE, "Gameplay");
+	result = xrCreateActionSet(xr_instance, &action_set_create_info, &xr_action_set);
+	if (XR_FAILED(result)) {
+		return false;
+	}
+
+	// Each action exists once for both hands. To find out which hand an action state belongs to, we
+	// use the paths of the hands as "subaction paths"
+	xrStringToPath(xr_instance, "/user/hand/left", &xr_hand_paths[0]);
+	xrStringToPath(xr_instance, "/user/hand/right", &xr_hand_paths[1]);
+
+	//------------------------------------------------------------------------------------------------------
+	// Create the actions
+	//------------------------------------------------------------------------------------------------------
+	bool actions_created = CreateXrAction(xr_action_hand_pose, XR_ACTION_TYPE_POSE_INPUT, "hand_pose", "Hand Pose")
+		&& CreateXrAction(xr_actions[app_action_select], xr_action_types[app_action_select], "select", "Select")
+		&& CreateXrAction(xr_actions[app_action_grab], xr_action_types[app_action_grab], "grab", "Grab")
+		&& CreateXrAction(xr_actions[app_action_menu], xr_action_types[app_action_menu], "menu", "Menu");
+	if (!actions_created) {
+		return false;
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Suggest bindings
+	//------------------------------------------------------------------------------------------------------
+	// We don't bind the actions to the buttons ourselves, we only suggest bindings for the controllers
+	// ("interaction profiles") we know about. The runtime then picks the bindings for the controller the
+	// user actually has, and can remap them if needed. The suggestions for a profile are only used if all
+	// of them are valid, so an unknown profile doesn't break anything, and we don't need all of them to work.
+	// The simple controller is supported by all runtimes, so we need that one at least
+	bool simple_bindings_suggested = SuggestXrBindings("/interaction_profiles/khr/simple_controller", {
+		{ xr_action_hand_pose, "/user/hand/left/input/grip/pose" },
+		{ xr_action_hand_pose, "/user/hand/right/input/grip/pose" },
+		{ xr_actions[app_action_select], "/user/hand/left/input/select/click" },
+		{ xr_actions[app_action_select], "/user/hand/right/input/select/click" },
+		{ xr_actions[app_action_menu], "/user/hand/left/input/menu/click" },
+		{ xr_actions[app_action_menu], "/user/hand/right/input/menu/click" },
+	});
+	if (!simple_bindings_suggested) {
+		return false;
+	}
+
+	SuggestXrBindings("/interaction_profiles/oculus/touch_controller", {
+		{ xr_action_hand_pose, "/user/hand/left/input/grip/pose" },
+		{ xr_action_hand_pose, "/user/hand/right/input/grip/pose" },
+		{ xr_actions[app_action_select], "/user/hand/left/input/trigger/value" },
+		{ xr_actions[app_action_select], "/user/hand/right/input/trigger/value" },
+		{ xr_actions[app_action_grab], "/user/hand/left/input/squeeze/value" },
+		{ xr_actions[app_action_grab], "/user/hand/right/input/squeeze/value" },
+		{ xr_actions[app_action_menu], "/user/hand/left/input/menu/click" },
+	});
+
+	//------------------------------------------------------------------------------------------------------
+	// Create a space for each controller
+	//------------------------------------------------------------------------------------------------------
+	// To find out where the controllers are, we create a space for the pose action of each hand. We can
+	// then locate these spaces in our app space, the same way we locate anything else
+	for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+		XrActionSpaceCreateInfo action_space_create_info = {};
+		action_space_create_info.type = XR_TYPE_ACTION_SPACE_CREATE_INFO;
+		action_space_create_info.action = xr_action_hand_pose;
+		action_space_create_info.subactionPath = xr_hand_paths[hand];
+		action_space_create_info.poseInActionSpace = xr_pose_identity;
+		result = xrCreateActionSpace(xr_session, &action_space_create_info, &xr_hand_spaces[hand]);
+		if (XR_FAILED(result)) {
+			return false;
+		}
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Attach the action set to the session
+	//------------------------------------------------------------------------------------------------------
+	// After this call, the action set and the bindings can't be changed anymore
+	XrSessionActionSetsAttachInfo attach_info = {};
+	attach_info.type = XR_TYPE_SESSION_ACTION_SETS_ATTACH_INFO;
+	attach_info.countActionSets = 1;
+	attach_info.actionSets = &xr_action_set;
+	result = xrAttachSessionActionSets(xr_session, &attach_info);
+	if (XR_FAILED(result)) {
+		return false;
+	}
+
 	return true;
 }
 
+// Creates an action in our action set, which exists once for each hand
+bool CreateXrAction(XrAction& action, XrActionType action_type, const char* name, const char* localized_name) {
+	XrActionCreateInfo action_create_info = {};
+	action_create_info.type = XR_TYPE_ACTION_CREATE_INFO;
+	action_create_info.actionType = action_type;
+	action_create_info.countSubactionPaths = input_max_hands;
+	action_create_info.subactionPaths = xr_hand_paths;
+	strcpy_s(action_create_info.actionName, XR_MAX_ACTION_NAME_SIZE, name);
+	strcpy_s(action_create_info.localizedActionName, XR_MAX_LOCALIZED_ACTION_NAME_SIZE, localized_name);
+
+	XrResult result = xrCreateAction(xr_action_set, &action_create_info, &action);
+	return XR_SUCCEEDED(result);
+}
+
+// Suggests the given (action, input path) bindings for an interaction profile
+bool SuggestXrBindings(const char* interaction_profile, const std::vector<std::pair<XrAction, const char*>>& bindings) {
+	std::vector<XrActionSuggestedBinding> suggested_bindings(bindings.size());
+	for (size_t i = 0; i < bindings.size(); i++) {
+		suggested_bindings[i].action = bindings[i].first;
+		xrStringToPath(xr_instance, bindings[i].second, &suggested_bindings[i].binding);
+	}
+
+	XrInteractionProfileSuggestedBinding profile_bindings = {};
+	profile_bindings.type = XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING;
+	xrStringToPath(xr_instance, interaction_profile, &profile_bindings.interactionProfile);
+	profile_bindings.countSuggestedBindings = (uint32_t)suggested_bindings.size();
+	profile_bindings.suggestedBindings = suggested_bindings.data();
+
+	XrResult result = xrSuggestInteractionProfileBindings(xr_instance, &profile_bindings);
+	return XR_SUCCEEDED(result);
+}
+
+// Destroys everything we created with OpenXR, in the reverse order of creation
+void ShutdownXr() {
+	// The wait thread must not call xrWaitFrame anymore once the session is gone
+	FramePacerStop(xr_frame_pacer);
+
+	for (quad_layer_t& quad_layer : xr_quad_layers) {
+		DestroyXrSwapchain(quad_layer.swapchain);
+	}
+	for (swapchain_t& swapchain : xr_swapchains) {
+		DestroyXrSwapchain(swapchain);
+	}
+	xr_swapchains.clear();
+
+	// Destroying the action set also destroys all actions in it
+	for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+		if (xr_hand_spaces[hand]) {
+			xrDestroySpace(xr_hand_spaces[hand]);
+		}
+	}
+	if (xr_action_set) {
+		xrDestroyActionSet(xr_action_set);
+	}
+
+	if (xr_app_space) {
+		xrDestroySpace(xr_app_space);
+	}
+	if (xr_session) {
+		xrDestroySession(xr_session);
+	}
+	if (xr_instance) {
+		xrDestroyInstance(xr_instance);
+	}
+}
+
 void PollOpenXrEvents(bool& loop_running, bool& xr_running) {
 	XrResult result;
 
@@ -499,6 +1152,8 @@ void PollOpenXrEvents(bool& loop_running, bool& xr_running) {
 			// Set the global state of the xr session to the state we just got from the call
 			// to xrPollEvent
 			xr_session_state = state_change->state;
+			CaptureEvent(frame_capture, capture_event_session_state, (int64_t)xr_session_state);
+			FrameScheduleSessionState(xr_frame_schedule, (uint32_t)xr_session_state);
 
 			switch (xr_session_state) {
 				// Session is in the READY state, which means we can call xrBeginSession to
@@ -523,13 +1178,25 @@ void PollOpenXrEvents(bool& loop_running, bool& xr_running) {
 						return;
 					}
 					xr_running = true;
+
+					// From now on, xrWaitFrame can be called. With frame pacing, that's done by the wait thread
+					if (app_config_frame_pacing) {
+						FramePacerStart(xr_frame_pacer, WaitOpenXrFrame, nullptr);
+					}
 					break;
 				}
 				case XR_SESSION_STATE_STOPPING: {
 					// Session is in the STOPPING state, where we need to call xrEndSession
 					// to enter the IDLE state
 					xr_running = false;
+
+					// The wait thread may be inside xrWaitFrame right now, and a stopping session doesn't
+					// have to let that wait return. So we only tell the wait thread not to wait again, and
+					// end the session: xrWaitFrame returns once the session isn't running anymore (with
+					// XR_ERROR_SESSION_NOT_RUNNING), and only then we join the thread
+					FramePacerRequestStop(xr_frame_pacer);
 					result = xrEndSession(xr_session);
+					FramePacerStop(xr_frame_pacer);
 					if (XR_FAILED(result)) {
 						MessageBox(NULL, "Couldn't end the XR session.", "Error", MB_OK);
 						return;
@@ -553,6 +1220,8 @@ void PollOpenXrEvents(bool& loop_running, bool& xr_running) {
 		// Instance seems to be shutting down, need to break out from the main loop
 		// and quit the aplication
 		else if (event_data_buffer.type == XR_TYPE_EVENT_DATA_INSTANCE_LOSS_PENDING) {
+			XrEventDataInstanceLossPending* loss_pending = (XrEventDataInstanceLossPending*)&event_data_buffer;
+			CaptureEvent(frame_capture, capture_event_instance_loss, (int64_t)loss_pending->lossTime);
 			loop_running = false;
 			return;
 		}
@@ -564,9 +1233,115 @@ void PollOpenXrEvents(bool& loop_running, bool& xr_running) {
 }
 
 void PollOpenXrActions() {
-	// IMPLEMENT ME => First need to setup actions, but let's skip that for now
+	//------------------------------------------------------------------------------------------------------
+	// Sync the actions
+	//------------------------------------------------------------------------------------------------------
+	// xrSyncActions updates the state of all actions of the active action sets at once, and the
+	// xrGetActionState* calls afterwards only return that state. So we only sync once per frame,
+	// with all action sets we need, instead of once per action
+	XrActiveActionSet active_action_set = {};
+	active_action_set.actionSet = xr_action_set;
+	active_action_set.subactionPath = XR_NULL_PATH;
+
+	XrActionsSyncInfo sync_info = {};
+	sync_info.type = XR_TYPE_ACTIONS_SYNC_INFO;
+	sync_info.countActiveActionSets = 1;
+	sync_info.activeActionSets = &active_action_set;
+
+	// If the session isn't focused (e.g. a system menu is open), we don't get any input. We just keep
+	// the last values in that case
+	XrResult result = xrSyncActions(xr_session, &sync_info);
+	if (XR_FAILED(result) || result == XR_SESSION_NOT_FOCUSED) {
+		return;
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Read the button states into the pending snapshot
+	//------------------------------------------------------------------------------------------------------
+	// The snapshot is only published once the controllers are located in RenderOpenXrFrame, as we need
+	// the predicted display time for that
+	xr_input_pending.action_count = app_action_count * input_max_hands;
+	xr_input_pending.action_changed = 0;
+
+	for (uint32_t action = 0; action < app_action_count; action++) {
+		for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+			XrActionStateGetInfo get_info = {};
+			get_info.type = XR_TYPE_ACTION_STATE_GET_INFO;
+			get_info.action = xr_actions[action];
+			get_info.subactionPath = xr_hand_paths[hand];
+
+			// Boolean and float actions have to be read with their own function
+			float value = 0.0f;
+			if (xr_action_types[action] == XR_ACTION_TYPE_BOOLEAN_INPUT) {
+				XrActionStateBoolean state = {};
+				state.type = XR_TYPE_ACTION_STATE_BOOLEAN;
+				xrGetActionStateBoolean(xr_session, &get_info, &state);
+				value = (state.isActive && state.currentState) ? 1.0f : 0.0f;
+			}
+			else {
+				XrActionStateFloat state = {};
+				state.type = XR_TYPE_ACTION_STATE_FLOAT;
+				xrGetActionStateFloat(xr_session, &get_info, &state);
+				value = state.isActive ? state.currentState : 0.0f;
+			}
+
+			uint32_t index = action * input_max_hands + hand;
+			if (value != xr_input_pending.action_values[index]) {
+				xr_input_pending.action_changed |= (1ull << index);
+			}
+			xr_input_pending.action_values[index] = value;
+		}
+	}
 };
 
+// Locates the controllers for the predicted display time, and publishes the input of this frame, such that
+// the simulation (and any other thread) can read it
+void LocateOpenXrControllers(XrTime predicted_time) {
+	xr_input_pending.display_time = predicted_time;
+	xr_input_pending.hand_pose_valid = 0;
+
+	for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+		// If the controller of that hand isn't there (or not tracked), the pose action is inactive
+		XrActionStateGetInfo get_info = {};
+		get_info.type = XR_TYPE_ACTION_STATE_GET_INFO;
+		get_info.action = xr_action_hand_pose;
+		get_info.subactionPath = xr_hand_paths[hand];
+
+		XrActionStatePose pose_state = {};
+		pose_state.type = XR_TYPE_ACTION_STATE_POSE;
+		xrGetActionStatePose(xr_session, &get_info, &pose_state);
+		if (!pose_state.isActive) {
+			PoseCacheClear(xr_pose_cache, hand);
+			continue;
+		}
+
+		// Locate the controller at the time the frame will be displayed, same as the views
+		XrSpaceLocation location = {};
+		location.type = XR_TYPE_SPACE_LOCATION;
+		XrResult result = xrLocateSpace(xr_hand_spaces[hand], xr_app_space, predicted_time, &location);
+		if (XR_FAILED(result)) {
+			PoseCacheClear(xr_pose_cache, hand);
+			continue;
+		}
+
+		// A hand that lost tracking starts a new history, we don't want to interpolate over the gap
+		const XrSpaceLocationFlags valid_flags = XR_SPACE_LOCATION_ORIENTATION_VALID_BIT | XR_SPACE_LOCATION_POSITION_VALID_BIT;
+		if ((location.locationFlags & valid_flags) == valid_flags) {
+			xr_input_pending.hand_poses[hand] = location.pose;
+			xr_input_pending.hand_pose_valid |= (1u << hand);
+			PoseCachePush(xr_pose_cache, hand, predicted_time, location.pose);
+		} else {
+			PoseCacheClear(xr_pose_cache, hand);
+		}
+	}
+
+	InputSnapshotPublish(xr_input_snapshots, xr_input_pending);
+	CaptureInput(frame_capture, xr_input_pending);
+
+	// The changed flags are relative to the previously published snapshot
+	xr_input_pending.action_changed = 0;
+}
+
 void RenderOpenXrFrame() {
 	XrResult result;
 
@@ -577,46 +1352,80 @@ void RenderOpenXrFrame() {
 	// be interested in is the predictedDisplayTime field.
 	// That field stores a prediction when the next frame will be displayed. This can be used to
 	// place objects, viewpoints, controllers etc. in the view
+	// With frame pacing, the wait thread already called xrWaitFrame for us (while we were still busy with
+	// the last frame), so we just take its result. Then we wait until the work of the frame has to start,
+	// such that it's done just in time and renders with poses that are as new as possible
 	XrFrameState frame_state = {};
 	frame_state.type = XR_TYPE_FRAME_STATE;
-	result = xrWaitFrame(xr_session, NULL, &frame_state);
-	if (XR_FAILED(result)) {
-		return;
+	if (FramePacerRunning(xr_frame_pacer)) {
+		frame_wait_result_t wait_result;
+		if (!FramePacerTakeFrame(xr_frame_pacer, wait_result)) {
+			return;
+		}
+		FramePacerWaitToStart(xr_frame_pacer, wait_result);
+		frame_state.predictedDisplayTime = wait_result.predicted_display_time;
+		frame_state.predictedDisplayPeriod = wait_result.predicted_display_period;
+		frame_state.shouldRender = wait_result.should_render ? XR_TRUE : XR_FALSE;
+	} else {
+		result = xrWaitFrame(xr_session, NULL, &frame_state);
+		if (XR_FAILED(result)) {
+			return;
+		}
 	}
 
+	// Only now we sync the actions, after all the waiting, such that the buttons are as new as the poses
+	PollOpenXrActions();
+	CaptureFrameState(frame_capture, frame_state.predictedDisplayTime, frame_state.predictedDisplayPeriod, frame_state.shouldRender == XR_TRUE);
+
+	// Decide what this frame has to do, see frame_schedule.h
+	frame_plan_t frame_plan = FrameScheduleBegin(xr_frame_schedule, frame_state.predictedDisplayTime, frame_state.predictedDisplayPeriod, frame_state.shouldRender == XR_TRUE);
+
 	//------------------------------------------------------------------------------------------------------
 	// Begin the frame 
 	//------------------------------------------------------------------------------------------------------
+	// As soon as the frame is begun, the wait thread may wait for the next one
 	result = xrBeginFrame(xr_session, NULL);
+	FramePacerBegun(xr_frame_pacer);
 	if (XR_FAILED(result)) {
 		return;
 	}
 
 	//------------------------------------------------------------------------------------------------------
-	// Call to UpdateSimulation which will update the simulation for the predicted rendering time
+	// Locate the controllers for the predicted rendering time and publish the input of this frame
 	//------------------------------------------------------------------------------------------------------
-	UpdateSimulation(frame_state.predictedDisplayTime);
+	LocateOpenXrControllers(frame_state.predictedDisplayTime);
+
+	//------------------------------------------------------------------------------------------------------
+	// Call to UpdateSimulation which will update the simulation with the input of this frame
+	//------------------------------------------------------------------------------------------------------
+	UpdateSimulation(frame_plan);
 
 	//------------------------------------------------------------------------------------------------------
 	// Render the layer
 	//------------------------------------------------------------------------------------------------------
-	XrCompositionLayerBaseHeader* layer = nullptr;
+	// We submit the projection layer, followed by the quad layers of the panels. The compositor draws the
+	// layers in this order, so the panels end up on top of the projection layer
+	std::vector<XrCompositionLayerBaseHeader*> layers;
 	XrCompositionLayerProjection layer_projection = {};
 	layer_projection.type = XR_TYPE_COMPOSITION_LAYER_PROJECTION;
 	std::vector<XrCompositionLayerProjectionView> views;
-
-	// Check if the xrSession is in a state that we actually need to render. If the session isn't in the
-	// VISIBLE or in the FOCUSED state, we don't need to render the layer (e.g. when the user of the
-	// application takes off the vr headset while the application still is running. In that case,
-	// we need to keep the application (and the simulation) running, but there is no point in rendering
-	// anything.
-	bool session_active = xr_session_state == XR_SESSION_STATE_VISIBLE || xr_session_state == XR_SESSION_STATE_FOCUSED;
-	uint32_t layer_count = 0;
-
-	if (session_active) {
+	std::vector<XrCompositionLayerQuad> quad_layers;
+
+	// Check if we actually need to render. If the session isn't in the VISIBLE or in the FOCUSED state,
+	// or the runtime tells us that it won't display the frame, we don't need to render the layer (e.g.
+	// when the user of the application takes off the vr headset while the application still is running.
+	// In that case, we need to keep the application (and the simulation) running, but there is no point
+	// in rendering anything.
+	if (frame_plan.render) {
 		RenderOpenXrLayer(frame_state.predictedDisplayTime, views, layer_projection);
-		layer = (XrCompositionLayerBaseHeader*)&layer_projection;
-		layer_count = 1;
+		layers.push_back((XrCompositionLayerBaseHeader*)&layer_projection);
+
+		// The panels are only rendered if their content changed, otherwise the compositor just reuses the
+		// image from the last time
+		RenderOpenXrQuadLayers(quad_layers);
+		for (XrCompositionLayerQuad& quad_layer : quad_layers) {
+			layers.push_back((XrCompositionLayerBaseHeader*)&quad_layer);
+		}
 	}
 
 	//------------------------------------------------------------------------------------------------------
@@ -626,52 +1435,86 @@ void RenderOpenXrFrame() {
 	frame_end_info.type = XR_TYPE_FRAME_END_INFO;
 	frame_end_info.displayTime = frame_state.predictedDisplayTime;
 	frame_end_info.environmentBlendMode = xr_blend_mode;
-	frame_end_info.layerCount = layer_count;
-	frame_end_info.layers = &layer;
+	frame_end_info.layerCount = (uint32_t)layers.size();
+	frame_end_info.layers = layers.data();
 	xrEndFrame(xr_session, &frame_end_info);
+
+	// Everything the frame depends on is recorded now
+	CaptureEndFrame(frame_capture);
+	FrameScheduleEnd(xr_frame_schedule);
+	if (FramePacerRunning(xr_frame_pacer)) {
+		FramePacerFrameDone(xr_frame_pacer);
+	}
+
+	// Compare the memory of our resources against the budget. We only complain the first time, the
+	// registry keeps counting the frames over budget
+	const resource_totals_t& resource_totals = ResourceFrame(resource_registry);
+	if (resource_totals.over_budget && resource_registry.frames_over_budget == 1) {
+		std::string message = "Resources use " + std::to_string(resource_totals.bytes / (1024 * 1024)) + " MB, more than the budget of "
+			+ std::to_string(app_config_resource_budget_mb) + " MB\n";
+		OutputDebugStringA(message.c_str());
+	}
 };
 
-void RenderOpenXrLayer(XrTime predicted_time, std::vector<XrCompositionLayerProjectionView>& views, XrCompositionLayerProjection& layer_projection) {
-	uint32_t view_count = 0;
+// Runs on the wait thread of the frame pacer. xrWaitFrame is one of the few OpenXR functions that may be
+// called from another thread than the rest of the frame
+bool WaitOpenXrFrame(void*, frame_wait_result_t& result) {
+	XrFrameState frame_state = {};
+	frame_state.type = XR_TYPE_FRAME_STATE;
+	if (XR_FAILED(xrWaitFrame(xr_session, NULL, &frame_state))) {
+		return false;
+	}
+	int64_t woke_ns = CoreTimeNowNs();
+	result.predicted_display_time = frame_state.predictedDisplayTime;
+	result.predicted_display_period = frame_state.predictedDisplayPeriod;
+	result.should_render = frame_state.shouldRender == XR_TRUE;
+
+	// The pacer wants the display time on the clock of CoreTimeNowNs. steady_clock counts with the performance
+	// counter, and converts the ticks to nanoseconds like this (in two parts, as the product would overflow)
+	LARGE_INTEGER counter;
+	if (ext_xrConvertTimeToWin32PerformanceCounterKHR && XR_SUCCEEDED(ext_xrConvertTimeToWin32PerformanceCounterKHR(xr_instance, frame_state.predictedDisplayTime, &counter))) {
+		int64_t whole_seconds = counter.QuadPart / xr_counter_frequency;
+		int64_t rest = counter.QuadPart % xr_counter_frequency;
+		result.display_ns = whole_seconds * 1000000000 + rest * 1000000000 / xr_counter_frequency;
+		return true;
+	}
+
+	// Without the extension, we guess: runtimes wake us about two display periods before the display time,
+	// and scheduling only ever makes the wait return later than that. So the smallest difference between a
+	// wake up and its display time we've seen so far is the closest to how the two clocks relate
+	xr_wake_offset_ns = std::min(xr_wake_offset_ns, woke_ns - (int64_t)frame_state.predictedDisplayTime);
+	result.display_ns = (int64_t)frame_state.predictedDisplayTime + xr_wake_offset_ns + 2 * (int64_t)frame_state.predictedDisplayPeriod;
+	return true;
+}
 
+void RenderOpenXrLayer(XrTime predicted_time, std::vector<XrCompositionLayerProjectionView>& views, XrCompositionLayerProjection& layer_projection) {
 	//------------------------------------------------------------------------------------------------------
 	// Setup the views for the predicted rendering time
 	//------------------------------------------------------------------------------------------------------
 	// We got the predicted time from the OpenXR runtime at which it will render the next frame (i.e. the
 	// frame we're preparing to render right now.
-	// We can use this predicted time to call the method xrLocateViews, which will return the view and
-	// projection info for a particular time.
-	XrViewState view_state = {};
-	view_state.type = XR_TYPE_VIEW_STATE;
-
-	// Setup an info struct which we'll pass into the xrLocateView call with informations about the
-	// predicted time, the type of view we have and the xr space we're in
-	XrViewLocateInfo view_locate_info = {};
-	view_locate_info.type = XR_TYPE_VIEW_LOCATE_INFO;
-	view_locate_info.viewConfigurationType = app_config_view;
-	view_locate_info.displayTime = predicted_time;
-	view_locate_info.space = xr_app_space;
-
-	// Call xrLocateViews, which will give us the number of views we have to render (stored in view_count), as
-	// well as fill in the xr_views vector with the predicted views (which is basically a struct containing
-	// the pose of the view, as well as the fov for that view. We'll use these two later to render with D3D11,
-	// as we need to modify the objects and the view before rendering.
-	xrLocateViews(xr_session, &view_locate_info, &view_state, (uint32_t)xr_views.size(), &view_count, xr_views.data());
+	// We locate the views here once, such that we know how many views we have to render. The poses we get
+	// here are only used if late latching is disabled, see below.
+	uint32_t view_count = LocateOpenXrViews(predicted_time);
+	CaptureViews(frame_capture, capture_locate_early, xr_view_latches.data(), view_count);
+	view_count = std::min(view_count, (uint32_t)xr_view_layout.views.size());
 	views.resize(view_count);
 
 	//------------------------------------------------------------------------------------------------------
-	// Render the layer for each view
+	// Acquire the swapchain images for the views
 	//------------------------------------------------------------------------------------------------------
-	for (uint32_t i = 0; i < view_count; i++) {
+	// Waiting for a swapchain image can block, so we do that for all swapchains before we do any of the
+	// work that depends on the poses. Views that share a swapchain render into the slices of the same image
+	std::vector<uint32_t> swapchain_image_ids(xr_swapchains.size());
+	for (uint32_t i = 0; i < (uint32_t)xr_swapchains.size(); i++) {
 		// First, we need to acquire a swapchain image, as we need a render target to render the data
 		// to. As a reminder (from the CreateSwapchainRenderTargets method), a swapchain image
 		// in the context of D3D11 is the buffer we want to render to.
 		// As we don't pass a swapchain_image_id into the xrAcquireSwapchainImage call, the runtime decides
 		// which swapchain image we'll get
-		uint32_t swapchain_image_id;
 		XrSwapchainImageAcquireInfo swapchain_acquire_info = {};
 		swapchain_acquire_info.type = XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO;
-		xrAcquireSwapchainImage(xr_swapchains[i].handle, &swapchain_acquire_info, &swapchain_image_id);
+		xrAcquireSwapchainImage(xr_swapchains[i].handle, &swapchain_acquire_info, &swapchain_image_ids[i]);
 
 		// We need to wait until the swapchain image is available for writing, as the compositor
 		// could still be reading from it (writing while the compositor is still reading could
@@ -682,33 +1525,112 @@ void RenderOpenXrLayer(XrTime predicted_time, std::vector<XrCompositionLayerProj
 		swapchain_wait_info.type = XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO;
 		swapchain_wait_info.timeout = XR_INFINITE_DURATION;
 		xrWaitSwapchainImage(xr_swapchains[i].handle, &swapchain_wait_info);
+	}
 
-		// Setup the info we need to render the layer for the current view. The XrCompositionLayerProjectionView
-		// is a projection layer element, which has the pose of the current view (pose = location and orientation),
-		// the fov of the current view, and the swapchain sub image, which holds the data for the composition
-		// layer.
+	//------------------------------------------------------------------------------------------------------
+	// Do all the CPU work that doesn't depend on the view poses
+	//------------------------------------------------------------------------------------------------------
+	PrepareDraw(view_count);
+
+	//------------------------------------------------------------------------------------------------------
+	// Find out which objects we need to draw
+	//------------------------------------------------------------------------------------------------------
+	// The culling uses the poses of the first locate, as the late latched poses aren't there yet. They only
+	// differ by the head motion of a few milliseconds, which CullScene accounts for
+	CullScene(view_count);
+
+	// The per-object constants don't depend on the view and are already in the draw cache, so the list of
+	// what to draw is built once for all views
+	SceneBuildDrawList(simulation.scene, draw_list);
+
+	// The narrow inner views of a quad view headset only see a small part of what survived the culling, so
+	// each view gets its own part of the draw list. That's one more pass over the visible objects, for all
+	// views at once. The frusta are widened like for the culling, to cover the late latched poses
+	view_frustum_t frustums[app_max_views];
+	uint32_t split_count = std::min(view_count, app_max_views);
+	for (uint32_t i = 0; i < split_count; i++) {
+		frustums[i] = ViewFrustum(xr_view_latches[i].pose, xr_view_latches[i].fov, app_near_clipping, app_far_clipping, simulation_cull_margin);
+	}
+	ViewSplitDrawList(simulation.scene, draw_list, frustums, split_count, view_draw_lists);
+
+	// The same frusta leave out the meshlets of the objects that face away from all views
+	if (app_config_meshlet_culling) {
+		CullMeshlets(frustums, split_count);
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Late latch the view poses
+	//------------------------------------------------------------------------------------------------------
+	// All time spent between locating the views and submitting the draw calls makes the poses older,
+	// and with that the prediction of the runtime less accurate. So we ask the runtime again for the
+	// poses, as late as possible. The predicted time stays the same, but the runtime can now use newer
+	// tracking data for the prediction.
+	// The number of views stays the one of the first locate, as xrEndFrame wants a projection view for every
+	// view of the configuration. If the second locate fails or returns fewer views, the views it didn't return
+	// keep the poses of the first locate, which are still in xr_view_latches
+	if (app_config_late_latch) {
+		uint32_t late_view_count = LocateOpenXrViews(predicted_time);
+		CaptureViews(frame_capture, capture_locate_late, xr_view_latches.data(), late_view_count);
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Hand the recorded images of earlier frames to the encoders
+	//------------------------------------------------------------------------------------------------------
+	// This also decides whether the views of this frame are recorded (see image_recorder.h)
+	if (image_recording) {
+		ImageRecorderBeginFrame(image_recorder, xr_frame_schedule.frames);
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Render the layer for each view
+	//------------------------------------------------------------------------------------------------------
+	for (uint32_t i = 0; i < (uint32_t)views.size(); i++) {
+		// Setup the info we need to render the layer for the current view. The XrCompositionLayerProjectionView
+		// is a projection layer element, which has the pose of the current view (pose = location and orientation),
+		// the fov of the current view, and the swapchain sub image, which holds the data for the composition
+		// layer.
 		// The subimage is of type XrSwapchainSubImage, which has a field to the swapchain to display and an
 		// imageRect, which represents the valid portion of the image to use (in pixels)
+		// It's important that we submit exactly the pose we rendered with, otherwise the compositor would
+		// reproject the image to the wrong pose
+		// The view renders into its slice of the swapchain the layout put it in
+		const view_layout_view_t& placement = xr_view_layout.views[i];
+		swapchain_t& swapchain = xr_swapchains[placement.swapchain];
 		views[i] = {};
 		views[i].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
-		views[i].pose = xr_views[i].pose;
-		views[i].fov = xr_views[i].fov;
-		views[i].subImage.swapchain = xr_swapchains[i].handle;
+		views[i].pose = xr_view_latches[i].pose;
+		views[i].fov = xr_view_latches[i].fov;
+		views[i].subImage.swapchain = swapchain.handle;
+		views[i].subImage.imageArrayIndex = placement.array_index;
 		views[i].subImage.imageRect.offset = { 0, 0 };
-		views[i].subImage.imageRect.extent = { xr_swapchains[i].width, xr_swapchains[i].height };
+		views[i].subImage.imageRect.extent = { (int32_t)placement.width, (int32_t)placement.height };
 
 		// Call the RenderD3D method, which will call the Draw method which will eventually render the
 		// content to the swapchain. With this call hierarchy, it should be possible to simply adapt the
-		// Draw method if other content is to be rendered
-		RenderD3DLayer(views[i], xr_swapchains[i].swapchain_data[swapchain_image_id]);
+		// Draw method if other content is to be rendered.
+		swapchain_data_t& swapchain_data = swapchain.swapchain_data[swapchain_image_ids[placement.swapchain] * swapchain.array_size + placement.array_index];
+		RenderD3DLayer(i, views[i], swapchain_data);
+
+		// Only queues a copy of the image on the GPU, if this frame is recorded
+		if (image_recording) {
+			ImageRecorderCaptureView(image_recorder, i, swapchain_data.back_buffer, placement.width, placement.height);
+		}
+	}
 
-		// We're done rendering for the current view, so we can release the swapchain image (i.e. tell
-		// the OpenXR runtime that we're done with this swapchain image.
-		// We have to pass in a XrSwapchainImageReleaseInfo, but at the moment, this struct doesn't
-		// do anything special.
+	// We're done rendering all views, so we can release the swapchain images (i.e. tell the OpenXR runtime
+	// that we're done with these swapchain images.
+	// We have to pass in a XrSwapchainImageReleaseInfo, but at the moment, this struct doesn't
+	// do anything special.
+	for (swapchain_t& swapchain : xr_swapchains) {
 		XrSwapchainImageReleaseInfo swapchain_release_info = {};
 		swapchain_release_info.type = XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO;
-		xrReleaseSwapchainImage(xr_swapchains[i].handle, &swapchain_release_info);
+		xrReleaseSwapchainImage(swapchain.handle, &swapchain_release_info);
+	}
+
+	// Keep track of how old the poses were at the time we handed the images to the runtime
+	int64_t released_at = CoreTimeNowNs();
+	for (uint32_t i = 0; i < view_count; i++) {
+		PoseAgeRecord(xr_pose_age_stats, xr_view_latches[i], released_at);
 	}
 
 	//------------------------------------------------------------------------------------------------------
@@ -721,6 +1643,118 @@ void RenderOpenXrLayer(XrTime predicted_time, std::vector<XrCompositionLayerProj
 	layer_projection.views = views.data();
 };
 
+// Locates the views for the predicted display time and stores them in xr_views and xr_view_latches.
+// Returns the number of views the runtime located.
+uint32_t LocateOpenXrViews(XrTime predicted_time) {
+	uint32_t view_count = 0;
+
+	// The XrViewState will tell us which parts of the poses are valid
+	XrViewState view_state = {};
+	view_state.type = XR_TYPE_VIEW_STATE;
+
+	// Setup an info struct which we'll pass into the xrLocateView call with informations about the
+	// predicted time, the type of view we have and the xr space we're in
+	XrViewLocateInfo view_locate_info = {};
+	view_locate_info.type = XR_TYPE_VIEW_LOCATE_INFO;
+	view_locate_info.viewConfigurationType = app_config_view;
+	view_locate_info.displayTime = predicted_time;
+	view_locate_info.space = xr_app_space;
+
+	// Call xrLocateViews, which will give us the number of views we have to render (stored in view_count), as
+	// well as fill in the xr_views vector with the predicted views (which is basically a struct containing
+	// the pose of the view, as well as the fov for that view. We'll use these two later to render with D3D11,
+	// as we need to modify the objects and the view before rendering.
+	XrResult result = xrLocateViews(xr_session, &view_locate_info, &view_state, (uint32_t)xr_views.size(), &view_count, xr_views.data());
+	if (XR_FAILED(result)) {
+		return 0;
+	}
+
+	// Remember when we got the poses, such that we know how old they are when we submit them
+	int64_t latched_at = CoreTimeNowNs();
+	for (uint32_t i = 0; i < view_count; i++) {
+		xr_view_latches[i].pose = xr_views[i].pose;
+		xr_view_latches[i].fov = xr_views[i].fov;
+		xr_view_latches[i].display_time = predicted_time;
+		xr_view_latches[i].latched_at_ns = latched_at;
+	}
+
+	// The late latch locates the views for the same time again, which replaces the samples of the first locate
+	for (uint32_t i = 0; i < view_count && i < app_max_views; i++) {
+		PoseCachePush(xr_pose_cache, app_pose_space_views + i, predicted_time, xr_views[i].pose);
+	}
+
+	return view_count;
+}
+
+// Renders the panels whose content changed into their swapchains, and sets up a quad layer for each panel
+// that has an image to show
+void RenderOpenXrQuadLayers(std::vector<XrCompositionLayerQuad>& quad_layers) {
+	for (uint32_t i = 0; i < (uint32_t)xr_quad_layers.size(); i++) {
+		quad_layer_t& quad_layer = xr_quad_layers[i];
+		quad_panel_t& panel = quad_layer.panel;
+
+		// Pick up the GPU times of earlier renders that are done by now
+		double gpu_ms = 0.0;
+		while (ReadD3DGpuTimer(quad_layer.gpu_timer, gpu_ms)) {
+			QuadPanelRecordGpuTime(panel, gpu_ms);
+		}
+
+		//------------------------------------------------------------------------------------------------------
+		// Render the panel if its content changed
+		//------------------------------------------------------------------------------------------------------
+		// This works the same way as for the views in RenderOpenXrLayer, except that we skip the whole thing
+		// (including acquiring a swapchain image) if the swapchain already contains the current content
+		bool rendered = false;
+		if (QuadPanelNeedsRender(panel)) {
+			uint32_t swapchain_image_id = 0;
+			XrSwapchainImageAcquireInfo swapchain_acquire_info = {};
+			swapchain_acquire_info.type = XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO;
+			xrAcquireSwapchainImage(quad_layer.swapchain.handle, &swapchain_acquire_info, &swapchain_image_id);
+
+			XrSwapchainImageWaitInfo swapchain_wait_info = {};
+			swapchain_wait_info.type = XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO;
+			swapchain_wait_info.timeout = XR_INFINITE_DURATION;
+			xrWaitSwapchainImage(quad_layer.swapchain.handle, &swapchain_wait_info);
+
+			XrCompositionLayerProjectionView panel_view = CreateQuadPanelView(panel);
+			uint32_t timer_slot = BeginD3DGpuTimer(quad_layer.gpu_timer);
+			RenderD3DQuadPanel(i, panel_view, quad_layer.swapchain.swapchain_data[swapchain_image_id]);
+			EndD3DGpuTimer(quad_layer.gpu_timer, timer_slot);
+
+			XrSwapchainImageReleaseInfo swapchain_release_info = {};
+			swapchain_release_info.type = XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO;
+			xrReleaseSwapchainImage(quad_layer.swapchain.handle, &swapchain_release_info);
+			rendered = true;
+		}
+		QuadPanelSubmitted(panel, rendered);
+
+		// Every now and then, tell how much the caching of the panel saved so far. The saved time is an estimate
+		// from the mean GPU time of the renders, so it's only there once a render was measured
+		if (panel.stats.frames % app_panel_report_frames == 0) {
+			std::string message = std::string("Panel ") + panel.name + ": rendered in " + std::to_string(panel.stats.renders) + " of "
+				+ std::to_string(panel.stats.frames) + " frames, " + std::to_string(QuadPanelMeanGpuMs(panel.stats)) + " ms GPU per render, "
+				+ std::to_string(QuadPanelSavedGpuMs(panel.stats)) + " ms GPU saved\n";
+			OutputDebugStringA(message.c_str());
+		}
+
+		//------------------------------------------------------------------------------------------------------
+		// Setup the quad layer
+		//------------------------------------------------------------------------------------------------------
+		// The quad layer always shows the whole swapchain image. The pose is the center of the quad, and
+		// the size is given in meters
+		XrCompositionLayerQuad layer_quad = {};
+		layer_quad.type = XR_TYPE_COMPOSITION_LAYER_QUAD;
+		layer_quad.space = xr_app_space;
+		layer_quad.eyeVisibility = XR_EYE_VISIBILITY_BOTH;
+		layer_quad.subImage.swapchain = quad_layer.swapchain.handle;
+		layer_quad.subImage.imageRect.offset = { 0, 0 };
+		layer_quad.subImage.imageRect.extent = { quad_layer.swapchain.width, quad_layer.swapchain.height };
+		layer_quad.pose = panel.pose;
+		layer_quad.size = panel.size;
+		quad_layers.push_back(layer_quad);
+	}
+}
+
 //###################################################################################################################
 // D3D Methods
 //###################################################################################################################
@@ -778,9 +1812,13 @@ bool InitD3DDevice(LUID& adapter_luid) {
 // This method takes a XrSwapchainImageD3D11KHR (which has a ID3D11Texture2D field, which normally
 // needs to be created manually when using D3D11), and creates a render target (backbuffer) as well
 // as a matching depth buffer
-swapchain_data_t CreateSwapchainRenderTargets(XrSwapchainImageD3D11KHR& swapchain_image) {
+swapchain_data_t CreateSwapchainRenderTargets(XrSwapchainImageD3D11KHR& swapchain_image, uint32_t array_index, const char* owner) {
 	swapchain_data_t resulting_target = {};
 
+	// If views share the swapchain, the image is a texture array, and each view renders into its own slice
+	D3D11_TEXTURE2D_DESC image_desc = {};
+	swapchain_image.texture->GetDesc(&image_desc);
+
 	//----------------------------------------------------------------------------------
 	// Create the backbuffer
 	//----------------------------------------------------------------------------------
@@ -795,17 +1833,23 @@ swapchain_data_t CreateSwapchainRenderTargets(XrSwapchainImageD3D11KHR& swapchai
 	D3D11_RENDER_TARGET_VIEW_DESC render_target_desc = {};
 	render_target_desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
 	render_target_desc.Format = d3d_swapchain_format;
+	if (image_desc.ArraySize > 1) {
+		render_target_desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2DARRAY;
+		render_target_desc.Texture2DArray.FirstArraySlice = array_index;
+		render_target_desc.Texture2DArray.ArraySize = 1;
+	}
 	d3d_device->CreateRenderTargetView(swapchain_image.texture, &render_target_desc, &resulting_target.back_buffer);
 
+	// The memory of the image is counted with the swapchain, the view itself is tiny
+	ResourceTrack(resource_registry, ResourceHandle(resulting_target.back_buffer), resource_render_target_view, 0, owner);
+
 	//----------------------------------------------------------------------------------
 	// Create a matching depth buffer (z-buffer)
 	//----------------------------------------------------------------------------------
 
 	// As we can't directly use the .texture field of the swapchain image as for the backbuffer,
-	// we first need to fetch information about the swapchain image (ID3D11Texture2D) that OpenXR
-	// created and then we can use that to information to manually construct a texture object
-	D3D11_TEXTURE2D_DESC image_desc = {};
-	swapchain_image.texture->GetDesc(&image_desc);
+	// we use the information about the swapchain image (ID3D11Texture2D) that OpenXR created
+	// to manually construct a texture object. Each slice gets a depth buffer of its own
 
 	// Create the depth buffer description
 	D3D11_TEXTURE2D_DESC depth_buffer_desc = {};
@@ -813,7 +1857,7 @@ swapchain_data_t CreateSwapchainRenderTargets(XrSwapchainImageD3D11KHR& swapchai
 	depth_buffer_desc.MipLevels = 1; // Multiple mipmap levels are only useful for textures, for backbuffer only need one level
 	depth_buffer_desc.Width = image_desc.Width;	// Use same width as the swapchain image that OpenXR created
 	depth_buffer_desc.Height = image_desc.Height; // Use same height as the swapchain image that OpenXR created
-	depth_buffer_desc.ArraySize = image_desc.ArraySize;
+	depth_buffer_desc.ArraySize = 1;
 	depth_buffer_desc.Format = DXGI_FORMAT_R32_TYPELESS; // Use TYPELESS format, such that we have the same as for the image that OpenXR created
 	depth_buffer_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_DEPTH_STENCIL;
 
@@ -828,12 +1872,59 @@ swapchain_data_t CreateSwapchainRenderTargets(XrSwapchainImageD3D11KHR& swapchai
 	d3d_device->CreateDepthStencilView(depth_buffer, &depth_stencil_view_desc, &resulting_target.depth_buffer);
 
 	// We don't need the ID3D11Texture2D object anymore. As it's a COM object, it should be freed by calling
-	// Release() on it
+	// Release() on it. The view still holds a reference to it, so its memory is counted with the view
 	depth_buffer->Release();
+	uint64_t depth_bytes = ResourceTextureBytes(depth_buffer_desc.Width, depth_buffer_desc.Height, 4, depth_buffer_desc.SampleDesc.Count, depth_buffer_desc.ArraySize, 1);
+	ResourceTrack(resource_registry, ResourceHandle(resulting_target.depth_buffer), resource_depth_target, depth_bytes, owner);
 
 	return resulting_target;
 };
 
+//------------------------------------------------------------------------------------------------------
+// Vertex formats in D3D
+//------------------------------------------------------------------------------------------------------
+constexpr DXGI_FORMAT D3DVertexComponentFormat(vertex_component_t component) {
+	switch (component) {
+	case vertex_component_float2: return DXGI_FORMAT_R32G32_FLOAT;
+	case vertex_component_float3: return DXGI_FORMAT_R32G32B32_FLOAT;
+	case vertex_component_float4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	case vertex_component_half2: return DXGI_FORMAT_R16G16_FLOAT;
+	case vertex_component_half4: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	case vertex_component_snorm8x4: return DXGI_FORMAT_R8G8B8A8_SNORM;
+	case vertex_component_unorm8x4: return DXGI_FORMAT_R8G8B8A8_UNORM;
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+// The names the vertex shader uses for its inputs (see vsIn in shaders.shader)
+constexpr const char* D3DVertexSemanticName(vertex_semantic_t semantic) {
+	switch (semantic) {
+	case vertex_semantic_position: return "SV_POSITION";
+	case vertex_semantic_normal: return "NORMAL";
+	case vertex_semantic_color: return "COLOR";
+	case vertex_semantic_texcoord: return "TEXCOORD";
+	}
+	return "";
+}
+
+// The input layout of a vertex format, built at compile time. With D3D11_INPUT_PER_INSTANCE_DATA, the format
+// describes one instance instead of one vertex
+template <typename Format>
+constexpr std::array<D3D11_INPUT_ELEMENT_DESC, Format::attribute_count> D3DInputLayout(D3D11_INPUT_CLASSIFICATION classification = D3D11_INPUT_PER_VERTEX_DATA) {
+	std::array<D3D11_INPUT_ELEMENT_DESC, Format::attribute_count> elements = {};
+	UINT step_rate = classification == D3D11_INPUT_PER_INSTANCE_DATA ? 1 : 0;
+	for (uint32_t i = 0; i < Format::attribute_count; i++) {
+		const vertex_attribute_t& attribute = Format::attributes[i];
+		elements[i] = { D3DVertexSemanticName(attribute.semantic), 0, D3DVertexComponentFormat(attribute.component), 0, attribute.offset, classification, step_rate };
+	}
+	return elements;
+}
+
+template <typename Index>
+constexpr DXGI_FORMAT D3DIndexFormat() {
+	return VertexIndexType<Index>() == vertex_index_uint16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
+
 bool InitD3DPipeline() {
 	HRESULT result;
 	//----------------------------------------------------------------------------------
@@ -866,6 +1957,8 @@ bool InitD3DPipeline() {
 	if (FAILED(result)) {
 		return false;
 	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_vertex_shader), resource_shader, vert_shader_blob->GetBufferSize(), "pipeline");
+	ResourceTrack(resource_registry, ResourceHandle(d3d_pixel_shader), resource_shader, pixel_shader_blob->GetBufferSize(), "pipeline");
 
 	// Set the shader objects
 	d3d_device_context->VSSetShader(d3d_vertex_shader, 0, 0);
@@ -875,17 +1968,20 @@ bool InitD3DPipeline() {
 	// Create the input layout. This describes to the GPU how the data is arranged
 	//----------------------------------------------------------------------------------
 
-	// For now, we'll only be using the position and the normal of the vertices
-	D3D11_INPUT_ELEMENT_DESC input_desc[] = {
-		{"SV_POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}
-	};
+	// For now, we'll only be using the position and the normal of the vertices. The elements come from
+	// app_vertex_format, so they always match vertex_t
+	constexpr std::array<D3D11_INPUT_ELEMENT_DESC, app_vertex_format::attribute_count> input_desc = D3DInputLayout<app_vertex_format>();
 
 	// Create the input layout
-	result = d3d_device->CreateInputLayout(input_desc, _countof(input_desc), vert_shader_blob->GetBufferPointer(), vert_shader_blob->GetBufferSize(), &d3d_input_layout);
+	result = d3d_device->CreateInputLayout(input_desc.data(), (UINT)input_desc.size(), vert_shader_blob->GetBufferPointer(), vert_shader_blob->GetBufferSize(), &d3d_input_layout);
 	if (FAILED(result)) {
 		return false;
 	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_input_layout), resource_input_layout, sizeof(input_desc), "pipeline");
+
+	// The compiled shaders are copied into the shader objects, so we don't need them anymore
+	vert_shader_blob->Release();
+	pixel_shader_blob->Release();
 
 	// Tell the GPU to use that input layout
 	d3d_device_context->IASetInputLayout(d3d_input_layout);
@@ -902,13 +1998,293 @@ bool InitD3DPipeline() {
 	if (FAILED(result)) {
 		return false;
 	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_const_buffer), resource_buffer, const_buffer_desc.ByteWidth, "pipeline");
 
-	// And now set the constant buffer
+	// And now set the constant buffer. The pixel shader needs it as well, for the light clusters. The
+	// constant buffer of each object is set when it's drawn
 	d3d_device_context->VSSetConstantBuffers(0, 1, &d3d_const_buffer);
+	d3d_device_context->PSSetConstantBuffers(0, 1, &d3d_const_buffer);
 
-	return true;
+	//----------------------------------------------------------------------------------
+	// Create the buffers for the light clusters
+	//----------------------------------------------------------------------------------
+	// These are rewritten every frame, see UploadD3DLights
+	uint32_t cell_count = app_light_tiles_x * app_light_tiles_y * app_light_slices * app_max_views;
+	if (!CreateD3DStructuredBuffer(sizeof(light_t), app_max_lights, "lights", d3d_light_buffer, d3d_light_views[0]) ||
+		!CreateD3DStructuredBuffer(sizeof(light_cluster_t), cell_count, "lights", d3d_light_cell_buffer, d3d_light_views[1]) ||
+		!CreateD3DStructuredBuffer(sizeof(uint32_t), app_max_light_indices, "lights", d3d_light_index_buffer, d3d_light_views[2])) {
+		return false;
+	}
+	d3d_device_context->PSSetShaderResources(0, 3, d3d_light_views);
+
+	if (!InitD3DParticles()) {
+		return false;
+	}
+	return InitD3DUpscale();
 };
 
+// Creates what the particles are drawn with: their own shaders, the instance buffer they are uploaded to every
+// frame, and the blend and depth states. The particles are drawn after the scene, see DrawD3DParticles
+bool InitD3DParticles() {
+	ID3D10Blob* vert_shader_blob;
+	ID3D10Blob* pixel_shader_blob;
+	ID3D10Blob* errors;
+
+	D3DCompileFromFile(L"shaders.shader", 0, 0, "PartVShader", "vs_5_0", D3D10_SHADER_OPTIMIZATION_LEVEL3, 0, &vert_shader_blob, &errors);
+	if (errors) {
+		MessageBox(NULL, "The particle vertex shader failed to compile.", "Error", MB_OK);
+		return false;
+	}
+	D3DCompileFromFile(L"shaders.shader", 0, 0, "PartPShader", "ps_5_0", D3D10_SHADER_OPTIMIZATION_LEVEL3, 0, &pixel_shader_blob, &errors);
+	if (errors) {
+		MessageBox(NULL, "The particle pixel shader failed to compile.", "Error", MB_OK);
+		return false;
+	}
+
+	HRESULT result = d3d_device->CreateVertexShader(vert_shader_blob->GetBufferPointer(), vert_shader_blob->GetBufferSize(), NULL, &d3d_particle_vertex_shader);
+	if (FAILED(result)) {
+		return false;
+	}
+	result = d3d_device->CreatePixelShader(pixel_shader_blob->GetBufferPointer(), pixel_shader_blob->GetBufferSize(), NULL, &d3d_particle_pixel_shader);
+	if (FAILED(result)) {
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_particle_vertex_shader), resource_shader, vert_shader_blob->GetBufferSize(), "particles");
+	ResourceTrack(resource_registry, ResourceHandle(d3d_particle_pixel_shader), resource_shader, pixel_shader_blob->GetBufferSize(), "particles");
+
+	// There is no vertex buffer, the corners of the quads come from SV_VertexID. The only input is the
+	// instance buffer, with one particle per instance
+	constexpr std::array<D3D11_INPUT_ELEMENT_DESC, particle_instance_format::attribute_count> input_desc = D3DInputLayout<particle_instance_format>(D3D11_INPUT_PER_INSTANCE_DATA);
+	result = d3d_device->CreateInputLayout(input_desc.data(), (UINT)input_desc.size(), vert_shader_blob->GetBufferPointer(), vert_shader_blob->GetBufferSize(), &d3d_particle_input_layout);
+	if (FAILED(result)) {
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_particle_input_layout), resource_input_layout, sizeof(input_desc), "particles");
+	vert_shader_blob->Release();
+	pixel_shader_blob->Release();
+
+	D3D11_BUFFER_DESC buffer_desc = {};
+	buffer_desc.ByteWidth = app_max_particles * sizeof(particle_instance_t);
+	buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+	buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	result = d3d_device->CreateBuffer(&buffer_desc, NULL, &d3d_particle_buffer);
+	if (FAILED(result)) {
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_particle_buffer), resource_buffer, buffer_desc.ByteWidth, "particles");
+
+	// Sparks and dust glow, so they are added onto the scene, weighted with their alpha. That doesn't
+	// depend on the order they are drawn in, so they don't need to be sorted
+	D3D11_BLEND_DESC blend_desc = {};
+	blend_desc.RenderTarget[0].BlendEnable = TRUE;
+	blend_desc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	blend_desc.RenderTarget[0].DestBlend = D3D11_BLEND_ONE;
+	blend_desc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blend_desc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ZERO;
+	blend_desc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
+	blend_desc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blend_desc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+	// With temporal upscaling, the motion vectors are the second render target. The particles don't write any,
+	// so they keep the ones of the scene behind them
+	blend_desc.IndependentBlendEnable = TRUE;
+	blend_desc.RenderTarget[1].RenderTargetWriteMask = 0;
+	result = d3d_device->CreateBlendState(&blend_desc, &d3d_particle_blend_state);
+	if (FAILED(result)) {
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_particle_blend_state), resource_state, sizeof(blend_desc), "particles");
+
+	D3D11_DEPTH_STENCIL_DESC depth_desc = {};
+	depth_desc.DepthEnable = TRUE;
+	depth_desc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	depth_desc.DepthFunc = D3D11_COMPARISON_LESS;
+	result = d3d_device->CreateDepthStencilState(&depth_desc, &d3d_particle_depth_state);
+	if (FAILED(result)) {
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_particle_depth_state), resource_state, sizeof(depth_desc), "particles");
+
+	return true;
+}
+
+// Creates what the temporal upscaling is done with: the shaders of the resolve and its constant buffer. The
+// targets of the views are created when a view is rendered, see CreateD3DUpscaleTargets
+bool InitD3DUpscale() {
+	ID3D10Blob* vert_shader_blob;
+	ID3D10Blob* pixel_shader_blob;
+	ID3D10Blob* errors;
+
+	D3DCompileFromFile(L"shaders.shader", 0, 0, "UpscaleVShader", "vs_5_0", D3D10_SHADER_OPTIMIZATION_LEVEL3, 0, &vert_shader_blob, &errors);
+	if (errors) {
+		MessageBox(NULL, "The upscale vertex shader failed to compile.", "Error", MB_OK);
+		return false;
+	}
+	D3DCompileFromFile(L"shaders.shader", 0, 0, "UpscalePShader", "ps_5_0", D3D10_SHADER_OPTIMIZATION_LEVEL3, 0, &pixel_shader_blob, &errors);
+	if (errors) {
+		MessageBox(NULL, "The upscale pixel shader failed to compile.", "Error", MB_OK);
+		return false;
+	}
+
+	HRESULT result = d3d_device->CreateVertexShader(vert_shader_blob->GetBufferPointer(), vert_shader_blob->GetBufferSize(), NULL, &d3d_upscale_vertex_shader);
+	if (FAILED(result)) {
+		return false;
+	}
+	result = d3d_device->CreatePixelShader(pixel_shader_blob->GetBufferPointer(), pixel_shader_blob->GetBufferSize(), NULL, &d3d_upscale_pixel_shader);
+	if (FAILED(result)) {
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_upscale_vertex_shader), resource_shader, vert_shader_blob->GetBufferSize(), "upscale");
+	ResourceTrack(resource_registry, ResourceHandle(d3d_upscale_pixel_shader), resource_shader, pixel_shader_blob->GetBufferSize(), "upscale");
+	vert_shader_blob->Release();
+	pixel_shader_blob->Release();
+
+	D3D11_BUFFER_DESC buffer_desc = {};
+	buffer_desc.ByteWidth = sizeof(upscale_constants_t);
+	buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	result = d3d_device->CreateBuffer(&buffer_desc, NULL, &d3d_upscale_buffer);
+	if (FAILED(result)) {
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_upscale_buffer), resource_buffer, buffer_desc.ByteWidth, "upscale");
+	return true;
+}
+
+// Creates a texture that can be rendered into and read by the shaders, with a view for each. The views keep the
+// texture alive, so its memory is counted with the render target view
+bool CreateD3DRenderTexture(uint32_t width, uint32_t height, DXGI_FORMAT format, uint32_t bytes_per_pixel, const char* owner, ID3D11RenderTargetView*& target, ID3D11ShaderResourceView*& view) {
+	D3D11_TEXTURE2D_DESC texture_desc = {};
+	texture_desc.Width = width;
+	texture_desc.Height = height;
+	texture_desc.MipLevels = 1;
+	texture_desc.ArraySize = 1;
+	texture_desc.Format = format;
+	texture_desc.SampleDesc.Count = 1;
+	texture_desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+	ID3D11Texture2D* texture;
+	if (FAILED(d3d_device->CreateTexture2D(&texture_desc, NULL, &texture))) {
+		return false;
+	}
+	target = nullptr;
+	view = nullptr;
+	bool created = SUCCEEDED(d3d_device->CreateRenderTargetView(texture, NULL, &target)) && SUCCEEDED(d3d_device->CreateShaderResourceView(texture, NULL, &view));
+	texture->Release();
+	if (!created) {
+		// The render target view may already exist. It isn't tracked yet, so it's released directly
+		if (target) {
+			target->Release();
+			target = nullptr;
+		}
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(target), resource_render_target_view, ResourceTextureBytes(width, height, bytes_per_pixel, 1, 1, 1), owner);
+	ResourceTrack(resource_registry, ResourceHandle(view), resource_render_target_view, 0, owner);
+	return true;
+}
+
+// Makes sure the targets of a view fit the size of its swapchain. They're only created again if the size or
+// app_config_temporal_scale changed, which also throws away the history
+bool CreateD3DUpscaleTargets(d3d_upscale_view_t& upscale, uint32_t output_width, uint32_t output_height) {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	TemporalInternalSize(output_width, output_height, app_config_temporal_scale, width, height);
+	if (upscale.color_target && upscale.width == width && upscale.height == height && upscale.output_width == output_width && upscale.output_height == output_height) {
+		return true;
+	}
+	ReleaseD3DUpscaleTargets(upscale);
+
+	// The scene is rendered in floats, so the history doesn't lose precision when it's blended over and over
+	bool created = CreateD3DRenderTexture(width, height, DXGI_FORMAT_R16G16B16A16_FLOAT, 8, "upscale", upscale.color_target, upscale.color_view)
+		&& CreateD3DRenderTexture(width, height, DXGI_FORMAT_R16G16_FLOAT, 4, "upscale", upscale.motion_target, upscale.motion_view)
+		&& CreateD3DRenderTexture(output_width, output_height, DXGI_FORMAT_R16G16B16A16_FLOAT, 8, "upscale", upscale.history_targets[0], upscale.history_views[0])
+		&& CreateD3DRenderTexture(output_width, output_height, DXGI_FORMAT_R16G16B16A16_FLOAT, 8, "upscale", upscale.history_targets[1], upscale.history_views[1]);
+
+	// The depth buffer at the internal resolution, like the ones of the swapchains (see CreateSwapchainRenderTargets)
+	if (created) {
+		D3D11_TEXTURE2D_DESC depth_buffer_desc = {};
+		depth_buffer_desc.SampleDesc.Count = 1;
+		depth_buffer_desc.MipLevels = 1;
+		depth_buffer_desc.Width = width;
+		depth_buffer_desc.Height = height;
+		depth_buffer_desc.ArraySize = 1;
+		depth_buffer_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+		depth_buffer_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_DEPTH_STENCIL;
+
+		ID3D11Texture2D* depth_buffer;
+		created = SUCCEEDED(d3d_device->CreateTexture2D(&depth_buffer_desc, NULL, &depth_buffer));
+		if (created) {
+			D3D11_DEPTH_STENCIL_VIEW_DESC depth_stencil_view_desc = {};
+			depth_stencil_view_desc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+			depth_stencil_view_desc.Format = DXGI_FORMAT_D32_FLOAT;
+			created = SUCCEEDED(d3d_device->CreateDepthStencilView(depth_buffer, &depth_stencil_view_desc, &upscale.depth_buffer));
+			depth_buffer->Release();
+		}
+		if (created) {
+			ResourceTrack(resource_registry, ResourceHandle(upscale.depth_buffer), resource_depth_target, ResourceTextureBytes(width, height, 4, 1, 1, 1), "upscale");
+		}
+	}
+
+	if (!created) {
+		ReleaseD3DUpscaleTargets(upscale);
+		return false;
+	}
+	upscale.width = width;
+	upscale.height = height;
+	upscale.output_width = output_width;
+	upscale.output_height = output_height;
+	upscale.current = 0;
+	upscale.history_valid = false;
+	return true;
+}
+
+void ReleaseD3DUpscaleTargets(d3d_upscale_view_t& upscale) {
+	ReleaseD3DObject(upscale.color_target);
+	ReleaseD3DObject(upscale.color_view);
+	ReleaseD3DObject(upscale.motion_target);
+	ReleaseD3DObject(upscale.motion_view);
+	ReleaseD3DObject(upscale.depth_buffer);
+	for (uint32_t i = 0; i < 2; i++) {
+		ReleaseD3DObject(upscale.history_targets[i]);
+		ReleaseD3DObject(upscale.history_views[i]);
+	}
+	upscale.history_valid = false;
+}
+
+// Creates a buffer of element_count structs that the CPU rewrites every frame, and a view such that the shaders
+// can read it as a StructuredBuffer
+bool CreateD3DStructuredBuffer(uint32_t element_size, uint32_t element_count, const char* owner, ID3D11Buffer*& buffer, ID3D11ShaderResourceView*& view) {
+	D3D11_BUFFER_DESC buffer_desc;
+	ZeroMemory(&buffer_desc, sizeof(buffer_desc));
+	buffer_desc.ByteWidth = element_size * element_count;
+	buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+	buffer_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	buffer_desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	buffer_desc.StructureByteStride = element_size;
+
+	HRESULT result = d3d_device->CreateBuffer(&buffer_desc, NULL, &buffer);
+	if (FAILED(result)) {
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(buffer), resource_buffer, buffer_desc.ByteWidth, owner);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC view_desc = {};
+	view_desc.Format = DXGI_FORMAT_UNKNOWN;
+	view_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	view_desc.Buffer.FirstElement = 0;
+	view_desc.Buffer.NumElements = element_count;
+
+	result = d3d_device->CreateShaderResourceView(buffer, &view_desc, &view);
+	if (FAILED(result)) {
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(view), resource_buffer, 0, owner);
+
+	return true;
+}
+
 bool InitD3DGraphics() {
 	HRESULT result;
 
@@ -928,6 +2304,7 @@ bool InitD3DGraphics() {
 	if (FAILED(result)) {
 		return false;
 	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_vertex_buffer), resource_buffer, vert_buffer_desc.ByteWidth, "cube mesh");
 
 	//----------------------------------------------------------------------------------
 	// Index buffer 
@@ -943,21 +2320,124 @@ bool InitD3DGraphics() {
 	if (FAILED(result)) {
 		return false;
 	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_index_buffer), resource_buffer, index_buffer_desc.ByteWidth, "cube mesh");
+
+	//----------------------------------------------------------------------------------
+	// Meshlets
+	//----------------------------------------------------------------------------------
+	// The cube mesh is split into meshlets once, and every frame, the meshlets that may be visible are
+	// written into an index buffer of their own (see CullMeshlets). Until then, it only has the whole mesh
+	std::vector<XrVector3f> positions(_countof(vertices));
+	for (size_t i = 0; i < positions.size(); i++) {
+		positions[i] = VertexFetch3<app_vertex_format, vertex_semantic_position>((const uint8_t*)&vertices[i]);
+	}
+	MeshletBuild(cube_meshlets, positions.data(), (uint32_t)positions.size(), indices, (uint32_t)_countof(indices), app_meshlet_max_triangles);
+
+	std::vector<app_index_t> meshlet_indices(app_max_meshlet_indices, 0);
+	std::copy(indices, indices + _countof(indices), meshlet_indices.begin());
+	D3D11_BUFFER_DESC meshlet_buffer_desc = {};
+	meshlet_buffer_desc.ByteWidth = app_max_meshlet_indices * sizeof(app_index_t);
+	meshlet_buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+	meshlet_buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	meshlet_buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	D3D11_SUBRESOURCE_DATA meshlet_buffer_data = { meshlet_indices.data() };
+	result = d3d_device->CreateBuffer(&meshlet_buffer_desc, &meshlet_buffer_data, &d3d_meshlet_index_buffer);
+	if (FAILED(result)) {
+		return false;
+	}
+	ResourceTrack(resource_registry, ResourceHandle(d3d_meshlet_index_buffer), resource_buffer, meshlet_buffer_desc.ByteWidth, "meshlets");
+
+	//----------------------------------------------------------------------------------
+	// Set buffers and primitive topology
+	//----------------------------------------------------------------------------------
+	// All objects are drawn with the same mesh, so we only need to set these once
+	UINT stride = app_vertex_format::stride;
+	UINT offset = 0;
+	// Set vertex buffer to use
+	d3d_device_context->IASetVertexBuffers(0, 1, &d3d_vertex_buffer, &stride, &offset);
+
+	// We'll also need to set the index buffer to be able to draw the triangles.
+	// The format follows the type of an index (DXGI_FORMAT_R16_UINT for uint16_t)
+	// With the meshlet culling, the meshlet stream is used instead. It starts with the whole mesh, for
+	// everything that isn't culled
+	d3d_device_context->IASetIndexBuffer(app_config_meshlet_culling ? d3d_meshlet_index_buffer : d3d_index_buffer, D3DIndexFormat<app_index_t>(), 0);
+
+	// And finally we'll tell the renderer that we want to render a trianglelist
+	d3d_device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	return true;
 };
 
 void ShutdownD3D() {
+	// Unbind everything first, such that the context doesn't keep any of the objects alive
+	if (d3d_device_context) {
+		d3d_device_context->ClearState();
+	}
+
+	for (quad_layer_t& quad_layer : xr_quad_layers) {
+		ReleaseD3DGpuTimer(quad_layer.gpu_timer);
+	}
+
+	for (ID3D11ShaderResourceView*& light_view : d3d_light_views) {
+		ReleaseD3DObject(light_view);
+	}
+	for (d3d_upscale_view_t& upscale : d3d_upscale_views) {
+		ReleaseD3DUpscaleTargets(upscale);
+	}
+	ReleaseD3DObject(d3d_upscale_buffer);
+	ReleaseD3DObject(d3d_upscale_pixel_shader);
+	ReleaseD3DObject(d3d_upscale_vertex_shader);
+	for (ID3D11Texture2D*& texture : d3d_readback.staging) {
+		ReleaseD3DObject(texture);
+	}
+	for (ID3D11Texture2D*& texture : d3d_readback.resolve) {
+		ReleaseD3DObject(texture);
+	}
+	ReleaseD3DObject(d3d_particle_depth_state);
+	ReleaseD3DObject(d3d_particle_blend_state);
+	ReleaseD3DObject(d3d_particle_buffer);
+	ReleaseD3DObject(d3d_particle_input_layout);
+	ReleaseD3DObject(d3d_particle_pixel_shader);
+	ReleaseD3DObject(d3d_particle_vertex_shader);
+	ReleaseD3DObject(d3d_light_index_buffer);
+	ReleaseD3DObject(d3d_light_cell_buffer);
+	ReleaseD3DObject(d3d_light_buffer);
+	ReleaseD3DObject(d3d_index_buffer);
+	ReleaseD3DObject(d3d_meshlet_index_buffer);
+	ReleaseD3DObject(d3d_vertex_buffer);
+	for (ID3D11Buffer*& buffer : d3d_object_buffers) {
+		ReleaseD3DObject(buffer);
+	}
+	d3d_object_buffers.clear();
+	d3d_object_versions.clear();
+	ReleaseD3DObject(d3d_const_buffer);
+	ReleaseD3DObject(d3d_input_layout);
+	ReleaseD3DObject(d3d_pixel_shader);
+	ReleaseD3DObject(d3d_vertex_shader);
+
+	// The device and the context aren't in the resource registry, they're what the resources are created with
 	if (d3d_device_context) {
 		d3d_device_context->Release();
+		d3d_device_context = nullptr;
 	}
 
 	if (d3d_device) {
 		d3d_device->Release();
+		d3d_device = nullptr;
+	}
+}
+
+// Releases a D3D object and removes it from the resource registry
+template <typename T>
+void ReleaseD3DObject(T*& object) {
+	if (object) {
+		ResourceRelease(resource_registry, ResourceHandle(object));
+		object->Release();
+		object = nullptr;
 	}
 }
 
-void RenderD3DLayer(XrCompositionLayerProjectionView& view, swapchain_data_t& swapchain_data) {
+void RenderD3DLayer(uint32_t view_index, XrCompositionLayerProjectionView& view, swapchain_data_t& swapchain_data) {
 	//----------------------------------------------------------------------------------
 	// Setup viewport
 	//----------------------------------------------------------------------------------
@@ -967,11 +2447,19 @@ void RenderD3DLayer(XrCompositionLayerProjectionView& view, swapchain_data_t& sw
 	// As this should match the size of the swapchain, we just use the size of the
 	// subimage we set previously
 	XrRect2Di& image_rect = view.subImage.imageRect;
+
+	// With temporal upscaling, the view is first rendered into targets of its own at the lower internal
+	// resolution, and only RenderD3DUpscale writes into the swapchain
+	d3d_upscale_view_t* upscale = nullptr;
+	if (app_config_temporal_upscale && view_index < app_max_views && CreateD3DUpscaleTargets(d3d_upscale_views[view_index], image_rect.extent.width, image_rect.extent.height)) {
+		upscale = &d3d_upscale_views[view_index];
+	}
+
 	D3D11_VIEWPORT viewport = {};
-	viewport.TopLeftX = (float)image_rect.offset.x;
-	viewport.TopLeftY = (float)image_rect.offset.y;
-	viewport.Width = (float)image_rect.extent.width;
-	viewport.Height = (float)image_rect.extent.height;
+	viewport.TopLeftX = upscale ? 0.0f : (float)image_rect.offset.x;
+	viewport.TopLeftY = upscale ? 0.0f : (float)image_rect.offset.y;
+	viewport.Width = upscale ? (float)upscale->width : (float)image_rect.extent.width;
+	viewport.Height = upscale ? (float)upscale->height : (float)image_rect.extent.height;
 
 	// Now we can set the viewport of the device context
 	d3d_device_context->RSSetViewports(1, &viewport);
@@ -983,10 +2471,18 @@ void RenderD3DLayer(XrCompositionLayerProjectionView& view, swapchain_data_t& sw
 	// data from the previous frame). This is usually done by setting all the data
 	// (pixels) to a single color.
 	float clear_color[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-	d3d_device_context->ClearRenderTargetView(swapchain_data.back_buffer, clear_color);
-
-	// Also clear the depth buffer, such that it's ready for rendering
-	d3d_device_context->ClearDepthStencilView(swapchain_data.depth_buffer, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	if (upscale) {
+		// Where nothing is drawn, the background doesn't move
+		float no_motion[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		d3d_device_context->ClearRenderTargetView(upscale->color_target, clear_color);
+		d3d_device_context->ClearRenderTargetView(upscale->motion_target, no_motion);
+		d3d_device_context->ClearDepthStencilView(upscale->depth_buffer, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	} else {
+		d3d_device_context->ClearRenderTargetView(swapchain_data.back_buffer, clear_color);
+
+		// Also clear the depth buffer, such that it's ready for rendering
+		d3d_device_context->ClearDepthStencilView(swapchain_data.depth_buffer, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	}
 
 	//----------------------------------------------------------------------------------
 	// Set the render target
@@ -994,141 +2490,597 @@ void RenderD3DLayer(XrCompositionLayerProjectionView& view, swapchain_data_t& sw
 	// Now we can set the target of all render operations to the backbuffer of the
 	// swapchain we're using.
 	// This will render all our content to that backbuffer.
-	d3d_device_context->OMSetRenderTargets(1, &swapchain_data.back_buffer, swapchain_data.depth_buffer);
+	// With temporal upscaling, the color and the motion vectors go to the targets of the view
+	if (upscale) {
+		ID3D11RenderTargetView* targets[2] = { upscale->color_target, upscale->motion_target };
+		d3d_device_context->OMSetRenderTargets(2, targets, upscale->depth_buffer);
+	} else {
+		d3d_device_context->OMSetRenderTargets(1, &swapchain_data.back_buffer, swapchain_data.depth_buffer);
+	}
+
+	//----------------------------------------------------------------------------------
+	// Select the light clusters of the view
+	//----------------------------------------------------------------------------------
+	// The pixel shader finds the cell of a pixel from its position in the viewport and its depth.
+	// The cells of all views are in the same buffer, so it also needs to know where the cells of
+	// this view start
+	draw_constants.cluster_scale = DirectX::XMFLOAT4((float)app_light_tiles_x / viewport.Width, (float)app_light_tiles_y / viewport.Height, light_clusters.slice_scale, light_clusters.slice_bias);
+	draw_constants.cluster_viewport = DirectX::XMFLOAT4(viewport.TopLeftX, viewport.TopLeftY, 0.0f, 0.0f);
+	draw_constants.cluster_grid[0] = app_light_tiles_x;
+	draw_constants.cluster_grid[1] = app_light_tiles_y;
+	draw_constants.cluster_grid[2] = view_index < light_clusters.view_count ? app_light_slices : 0;
+	draw_constants.cluster_grid[3] = view_index * light_clusters.cells_per_view;
+
+	//----------------------------------------------------------------------------------
+	// Jitter and motion vectors
+	//----------------------------------------------------------------------------------
+	// Every frame samples a different point of the pixels (see temporal_upscale.h). The motion vectors
+	// come from the view-projection of this frame and of the last one, both without the jitter
+	temporal_jitter_t jitter = {};
+	if (upscale) {
+		jitter = TemporalJitter(xr_frame_schedule.frames, upscale->width, upscale->height);
+		draw_constants.motion_view_projection = CreateViewProjectionMatrix(view, temporal_jitter_t{});
+		draw_constants.previous_view_projection = upscale->history_valid ? upscale->previous_view_projection : draw_constants.motion_view_projection;
+		upscale->previous_view_projection = draw_constants.motion_view_projection;
+	}
 
-	Draw(view);
+	Draw(view, view_index < app_max_views ? view_draw_lists[view_index] : draw_list, jitter);
+
+	if (upscale) {
+		RenderD3DUpscale(*upscale, swapchain_data, jitter);
+	}
 };
 
+// Blends the view that was rendered at the internal resolution into its history, and writes the result to the
+// swapchain as well. UpscalePShader does the same as TemporalUpscaleResolve, per pixel of the swapchain
+void RenderD3DUpscale(d3d_upscale_view_t& upscale, swapchain_data_t& swapchain_data, const temporal_jitter_t& jitter) {
+	upscale_constants_t constants = {};
+	constants.jitter[0] = jitter.pixels.x;
+	constants.jitter[1] = jitter.pixels.y;
+	constants.jitter[2] = temporal_blend;
+	constants.jitter[3] = upscale.history_valid ? 1.0f : 0.0f;
+	constants.size[0] = upscale.width;
+	constants.size[1] = upscale.height;
+	constants.size[2] = upscale.output_width;
+	constants.size[3] = upscale.output_height;
+	constants.reject[0] = temporal_reject;
+	d3d_device_context->UpdateSubresource(d3d_upscale_buffer, 0, NULL, &constants, 0, 0);
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)upscale.output_width;
+	viewport.Height = (float)upscale.output_height;
+	d3d_device_context->RSSetViewports(1, &viewport);
+
+	// The history of the last frame is read, the other one is written, and becomes the history of the next frame
+	ID3D11RenderTargetView* targets[2] = { swapchain_data.back_buffer, upscale.history_targets[upscale.current ^ 1] };
+	d3d_device_context->OMSetRenderTargets(2, targets, NULL);
+	ID3D11ShaderResourceView* inputs[3] = { upscale.color_view, upscale.motion_view, upscale.history_views[upscale.current] };
+	d3d_device_context->PSSetShaderResources(3, 3, inputs);
+	d3d_device_context->PSSetConstantBuffers(2, 1, &d3d_upscale_buffer);
+
+	// One triangle that covers the whole viewport. The vertex shader makes it from the vertex ids alone, so
+	// there's no vertex buffer and no input layout
+	d3d_device_context->IASetInputLayout(NULL);
+	d3d_device_context->VSSetShader(d3d_upscale_vertex_shader, 0, 0);
+	d3d_device_context->PSSetShader(d3d_upscale_pixel_shader, 0, 0);
+	d3d_device_context->Draw(3, 0);
+
+	// Back to what the scene is drawn with. The targets are unbound, as they're read by the shaders next frame
+	ID3D11ShaderResourceView* no_inputs[3] = {};
+	d3d_device_context->PSSetShaderResources(3, 3, no_inputs);
+	d3d_device_context->OMSetRenderTargets(0, NULL, NULL);
+	d3d_device_context->IASetInputLayout(d3d_input_layout);
+	d3d_device_context->VSSetShader(d3d_vertex_shader, 0, 0);
+	d3d_device_context->PSSetShader(d3d_pixel_shader, 0, 0);
+
+	upscale.current ^= 1;
+	upscale.history_valid = true;
+}
+
 // Helper method that takes a XrCompositionLayerProjectionView and calculates the
 // ViewProjection matrix from it, such that we can pass that matrix to the constant buffer
 // and finally to the shader to correctly transform the objects.
-DirectX::XMMATRIX CreateViewProjectionMatrix(XrCompositionLayerProjectionView& view) {
+xr_mat4_t CreateViewProjectionMatrix(XrCompositionLayerProjectionView& view, const temporal_jitter_t& jitter) {
 	//----------------------------------------------------------------------------------
-	// Build projection matrix
+	// Get the projection matrix
 	//----------------------------------------------------------------------------------
-	// Define the far plane and the near plane. A value often used for the near
-	// clipping in desktop applications is 1.0f, however that seems to be too high
-	// for XR applications, as objects "relatively" close to the user already vanish
-	// from the view, even when you would expect them not to
-	const float near_clipping = 0.05f;
-	const float far_clipping = 100.0f;
-
-	// Construct the left, right, top and bottom values to pass into the
-	// XMMatrixPerspectiveOffCenterRH call. These 4 values represent the x and y
-	// coordinates respectively of the view frustum at the near plane.
-	const float left = near_clipping * tanf(view.fov.angleLeft);
-	const float right = near_clipping * tanf(view.fov.angleRight);
-	const float top = near_clipping * tanf(view.fov.angleUp);
-	const float bottom = near_clipping * tanf(view.fov.angleDown);
-
-	// Construct the projection matrix from the values we just calculated
-	DirectX::XMMATRIX projection_matrix = DirectX::XMMatrixPerspectiveOffCenterRH(left, right, bottom, top, near_clipping, far_clipping);
+	// The projection only depends on the fov of the view (and the clipping planes), which
+	// usually doesn't change during the whole session. So instead of calling tanf four times
+	// per view and frame, we only build the projection matrix when we see a new fov and
+	// otherwise take it from the cache
+	// With temporal upscaling, the projection is moved by the jitter of the frame afterwards
+	const xr_mat4_t& cached_projection = XrMathProjectionCached(d3d_projection_cache, view.fov, app_near_clipping, app_far_clipping);
+	xr_mat4_t projection_matrix = TemporalJitterProjection(cached_projection, jitter);
 
 	//----------------------------------------------------------------------------------
 	// Build view matrix
 	//----------------------------------------------------------------------------------
-	// Load the orientation quaternion into a vector, such that we can use it to construct
-	// an affine transformation
-	DirectX::XMVECTOR view_rotation = DirectX::XMLoadFloat4((DirectX::XMFLOAT4*) & view.pose.orientation);
-
-	// Also load the position vector into a 3-component vector
-	DirectX::GXMVECTOR view_translation = DirectX::XMLoadFloat3((DirectX::XMFLOAT3*) & view.pose.position);
-
-	// Build an affine transformation, represented as a matrix, of the view transformation
-	// The first argument is the scaling factor. As we don't want to scale anything right now,
-	// we pass in a vector with all ones.
-	// The second argument is the point identifying the origin of the rotation, which we set
-	// to (0, 0, 0), such that we rotate about the origin
-	// As third argument we pass the rotation we loaded before, and as fourth argument
-	// the translation we loaded before. 
-	DirectX::XMMATRIX view_transformation_matrix = DirectX::XMMatrixAffineTransformation(DirectX::g_XMOne, DirectX::g_XMZero, view_rotation, view_translation);
-
-	// We then need to inverse the matrix. The first argument could be a pointer to a
-	// XMVECTOR which would store the determinant. As we don't care about the
-	// determinant, we just pass in NULL
-	DirectX::XMMATRIX view_matrix = DirectX::XMMatrixInverse(NULL, view_transformation_matrix);
+	// The view matrix is the inverse of the pose of the view. As a pose only consists of a
+	// rotation and a translation (a "rigid" transformation), we don't need a general matrix
+	// inverse for that: The inverse of a rotation is its transpose, and the inverse translation
+	// is just the negated position, rotated with the inverse rotation
+	xr_mat4_t view_matrix = XrMathRigidInverse(view.pose);
 
 	// Finally, return the Transpose of the product of the view matrix and the projection
 	// matrix
-	return DirectX::XMMatrixTranspose(view_matrix * projection_matrix);
+	return XrMathTranspose(XrMathMultiply(view_matrix, projection_matrix));
+}
+
+// Same as RenderD3DLayer, but for the swapchain of a panel. The panels don't share the clear color
+// of the projection layer, so the background shows the state of the panel
+void RenderD3DQuadPanel(uint32_t panel_index, XrCompositionLayerProjectionView& view, swapchain_data_t& swapchain_data) {
+	XrRect2Di& image_rect = view.subImage.imageRect;
+	D3D11_VIEWPORT viewport = {};
+	viewport.TopLeftX = (float)image_rect.offset.x;
+	viewport.TopLeftY = (float)image_rect.offset.y;
+	viewport.Width = (float)image_rect.extent.width;
+	viewport.Height = (float)image_rect.extent.height;
+	d3d_device_context->RSSetViewports(1, &viewport);
+
+	// The status panel is green while the cube spins, and red while it's paused
+	float clear_color[] = { 0.1f, 0.1f, 0.1f, 1.0f };
+	if (panel_index == app_panel_status) {
+		clear_color[0] = simulation.cube_spinning ? 0.1f : 0.6f;
+		clear_color[1] = simulation.cube_spinning ? 0.5f : 0.1f;
+	}
+	d3d_device_context->ClearRenderTargetView(swapchain_data.back_buffer, clear_color);
+	d3d_device_context->ClearDepthStencilView(swapchain_data.depth_buffer, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	d3d_device_context->OMSetRenderTargets(1, &swapchain_data.back_buffer, swapchain_data.depth_buffer);
+
+	// The panel only shows the cube, not the rest of the scene. There are no light clusters for the panel, so
+	// it's only lit by the sun
+	draw_constants.cluster_grid[2] = 0;
+	draw_constants.view_projection = CreateViewProjectionMatrix(view, temporal_jitter_t{});
+	d3d_device_context->UpdateSubresource(d3d_const_buffer, 0, NULL, &draw_constants, 0, 0);
+	// The meshlets were culled for the views, not for the camera of the panel, so it draws the whole cube
+	DrawD3DObject(simulation.cube_object, false);
+}
+
+// Copies the lights and the light clusters of this frame to the GPU
+void UploadD3DLights() {
+	uint32_t light_count = std::min((uint32_t)simulation.scene.lights.size(), app_max_lights);
+	UploadD3DStructuredBuffer(d3d_light_buffer, simulation.scene.lights.data(), light_count * sizeof(light_t));
+	UploadD3DStructuredBuffer(d3d_light_cell_buffer, light_clusters.cells.data(), light_clusters.cells.size() * sizeof(light_cluster_t));
+	UploadD3DStructuredBuffer(d3d_light_index_buffer, light_clusters.light_indices.data(), light_clusters.light_indices.size() * sizeof(uint32_t));
+}
+
+// Replaces the content of a buffer created with CreateD3DStructuredBuffer. With WRITE_DISCARD, the driver gives
+// us new memory if the GPU still reads the old content, so this doesn't wait for the GPU
+void UploadD3DStructuredBuffer(ID3D11Buffer* buffer, const void* data, size_t size) {
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (size == 0 || FAILED(d3d_device_context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+		return;
+	}
+	memcpy(mapped.pData, data, size);
+	d3d_device_context->Unmap(buffer, 0);
+}
+
+// Writes the instances of the sparks and the dust straight into the instance buffer. The jobs write their
+// chunks of particles in parallel, the sparks first and the dust behind them
+void UploadD3DParticles() {
+	d3d_particle_count = 0;
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (!app_config_particles || FAILED(d3d_device_context->Map(d3d_particle_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+		return;
+	}
+	particle_instance_t* instances = (particle_instance_t*)mapped.pData;
+	d3d_particle_count = ParticleWriteInstances(simulation.sparks, instances, app_max_particles, &job_system);
+	d3d_particle_count += ParticleWriteInstances(simulation.dust, instances + d3d_particle_count, app_max_particles - d3d_particle_count, &job_system);
+	d3d_device_context->Unmap(d3d_particle_buffer, 0);
+}
+
+// Draws all particles with one instanced draw call: 4 vertices (a triangle strip) per particle. Afterwards,
+// the pipeline of the scene is set again, as that's only set once at the start
+void DrawD3DParticles() {
+	// The constants of the view were already uploaded by Draw
+	if (d3d_particle_count == 0) {
+		return;
+	}
+
+	UINT stride = particle_instance_format::stride;
+	UINT offset = 0;
+	d3d_device_context->IASetInputLayout(d3d_particle_input_layout);
+	d3d_device_context->IASetVertexBuffers(0, 1, &d3d_particle_buffer, &stride, &offset);
+	d3d_device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	d3d_device_context->VSSetShader(d3d_particle_vertex_shader, 0, 0);
+	d3d_device_context->PSSetShader(d3d_particle_pixel_shader, 0, 0);
+	d3d_device_context->OMSetBlendState(d3d_particle_blend_state, NULL, 0xFFFFFFFF);
+	d3d_device_context->OMSetDepthStencilState(d3d_particle_depth_state, 0);
+
+	d3d_device_context->DrawInstanced(4, d3d_particle_count, 0, 0);
+
+	stride = app_vertex_format::stride;
+	d3d_device_context->IASetInputLayout(d3d_input_layout);
+	d3d_device_context->IASetVertexBuffers(0, 1, &d3d_vertex_buffer, &stride, &offset);
+	d3d_device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	d3d_device_context->VSSetShader(d3d_vertex_shader, 0, 0);
+	d3d_device_context->PSSetShader(d3d_pixel_shader, 0, 0);
+	d3d_device_context->OMSetBlendState(NULL, NULL, 0xFFFFFFFF);
+	d3d_device_context->OMSetDepthStencilState(NULL, 0);
+}
+
+// Creates the queries of a GPU timer
+bool CreateD3DGpuTimer(gpu_timer_t& timer) {
+	timer = {};
+
+	D3D11_QUERY_DESC disjoint_desc = {};
+	disjoint_desc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+	D3D11_QUERY_DESC timestamp_desc = {};
+	timestamp_desc.Query = D3D11_QUERY_TIMESTAMP;
+
+	for (uint32_t i = 0; i < gpu_timer_slots; i++) {
+		bool created = SUCCEEDED(d3d_device->CreateQuery(&disjoint_desc, &timer.disjoint[i]))
+			&& SUCCEEDED(d3d_device->CreateQuery(&timestamp_desc, &timer.begin[i]))
+			&& SUCCEEDED(d3d_device->CreateQuery(&timestamp_desc, &timer.end[i]));
+		if (!created) {
+			return false;
+		}
+		ResourceTrack(resource_registry, ResourceHandle(timer.disjoint[i]), resource_query, sizeof(D3D11_QUERY_DATA_TIMESTAMP_DISJOINT), "gpu timer");
+		ResourceTrack(resource_registry, ResourceHandle(timer.begin[i]), resource_query, sizeof(UINT64), "gpu timer");
+		ResourceTrack(resource_registry, ResourceHandle(timer.end[i]), resource_query, sizeof(UINT64), "gpu timer");
+	}
+
+	return true;
+}
+
+void ReleaseD3DGpuTimer(gpu_timer_t& timer) {
+	for (uint32_t i = 0; i < gpu_timer_slots; i++) {
+		ReleaseD3DObject(timer.disjoint[i]);
+		ReleaseD3DObject(timer.begin[i]);
+		ReleaseD3DObject(timer.end[i]);
+	}
+}
+
+// Starts measuring the GPU time of the commands that follow, and returns the slot to pass to EndD3DGpuTimer.
+// If all slots are still waiting for their results, the oldest measurement is dropped
+uint32_t BeginD3DGpuTimer(gpu_timer_t& timer) {
+	uint32_t slot = timer.next;
+	timer.next = (timer.next + 1) % gpu_timer_slots;
+
+	// A timestamp query only has an End, which records the time at which the GPU got to that point
+	d3d_device_context->Begin(timer.disjoint[slot]);
+	d3d_device_context->End(timer.begin[slot]);
+	timer.pending[slot] = false;
+	return slot;
+}
+
+void EndD3DGpuTimer(gpu_timer_t& timer, uint32_t slot) {
+	d3d_device_context->End(timer.end[slot]);
+	d3d_device_context->End(timer.disjoint[slot]);
+	timer.pending[slot] = true;
+}
+
+// Returns the result of one finished measurement, if there is one. Never waits for the GPU
+bool ReadD3DGpuTimer(gpu_timer_t& timer, double& gpu_ms) {
+	for (uint32_t i = 0; i < gpu_timer_slots; i++) {
+		if (!timer.pending[i]) {
+			continue;
+		}
+
+		// With D3D11_ASYNC_GETDATA_DONOTFLUSH, GetData just returns S_FALSE if the GPU isn't done yet
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = {};
+		if (d3d_device_context->GetData(timer.disjoint[i], &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) {
+			continue;
+		}
+
+		UINT64 begin_ticks = 0;
+		UINT64 end_ticks = 0;
+		d3d_device_context->GetData(timer.begin[i], &begin_ticks, sizeof(begin_ticks), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+		d3d_device_context->GetData(timer.end[i], &end_ticks, sizeof(end_ticks), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+		timer.pending[i] = false;
+
+		// If the GPU changed its clock in the meantime (e.g. because of power saving), the timestamps
+		// can't be compared, so we throw that measurement away
+		if (disjoint.Disjoint || disjoint.Frequency == 0) {
+			continue;
+		}
+
+		gpu_ms = (double)(end_ticks - begin_ticks) * 1000.0 / (double)disjoint.Frequency;
+		return true;
+	}
+
+	return false;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Readback of the recorded images
+//------------------------------------------------------------------------------------------------------
+// The readback of the image recorder (see image_readback_t), with staging textures. source is the back buffer
+// (render target view) of a swapchain image. The staging texture of a slot is created when it's first used,
+// and created again if the size of the image changed
+bool CopyD3DReadback(void* user, uint32_t slot, const void* source, uint32_t width, uint32_t height) {
+	d3d_readback_t& readback = *(d3d_readback_t*)user;
+
+	ID3D11Resource* resource = nullptr;
+	((ID3D11RenderTargetView*)source)->GetResource(&resource);
+	if (!resource) {
+		return false;
+	}
+
+	// Views that share a swapchain are slices of a texture array, the render target view tells us which one.
+	// With a single mip level, the subresource of a slice is its index
+	D3D11_RENDER_TARGET_VIEW_DESC view_desc = {};
+	((ID3D11RenderTargetView*)source)->GetDesc(&view_desc);
+	UINT subresource = view_desc.ViewDimension == D3D11_RTV_DIMENSION_TEXTURE2DARRAY ? view_desc.Texture2DArray.FirstArraySlice : 0;
+	D3D11_TEXTURE2D_DESC image_desc = {};
+	((ID3D11Texture2D*)resource)->GetDesc(&image_desc);
+	bool multisampled = image_desc.SampleDesc.Count > 1;
+
+	D3D11_TEXTURE2D_DESC staging_desc = {};
+	if (readback.staging[slot]) {
+		readback.staging[slot]->GetDesc(&staging_desc);
+	}
+	if (!readback.staging[slot] || staging_desc.Width != width || staging_desc.Height != height) {
+		ReleaseD3DObject(readback.staging[slot]);
+		ReleaseD3DObject(readback.resolve[slot]);
+
+		// Same format as the swapchain image (which is TYPELESS), such that it can be copied
+		staging_desc = {};
+		staging_desc.Width = width;
+		staging_desc.Height = height;
+		staging_desc.MipLevels = 1;
+		staging_desc.ArraySize = 1;
+		staging_desc.Format = image_desc.Format;
+		staging_desc.SampleDesc.Count = 1;
+		staging_desc.Usage = D3D11_USAGE_STAGING;
+		staging_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		bool created = SUCCEEDED(d3d_device->CreateTexture2D(&staging_desc, nullptr, &readback.staging[slot]));
+		if (created) {
+			ResourceTrack(resource_registry, ResourceHandle(readback.staging[slot]), resource_staging, ResourceTextureBytes(width, height, 4, 1, 1, 1), "image recorder");
+		}
+
+		if (created && multisampled) {
+			D3D11_TEXTURE2D_DESC resolve_desc = staging_desc;
+			resolve_desc.Usage = D3D11_USAGE_DEFAULT;
+			resolve_desc.CPUAccessFlags = 0;
+			created = SUCCEEDED(d3d_device->CreateTexture2D(&resolve_desc, nullptr, &readback.resolve[slot]));
+			if (created) {
+				ResourceTrack(resource_registry, ResourceHandle(readback.resolve[slot]), resource_staging, ResourceTextureBytes(width, height, 4, 1, 1, 1), "image recorder");
+			}
+		}
+		if (!created) {
+			resource->Release();
+			return false;
+		}
+	}
+
+	// Both only queue the work on the GPU
+	if (multisampled) {
+		d3d_device_context->ResolveSubresource(readback.resolve[slot], 0, resource, subresource, d3d_swapchain_format);
+		d3d_device_context->CopyResource(readback.staging[slot], readback.resolve[slot]);
+	} else {
+		d3d_device_context->CopySubresourceRegion(readback.staging[slot], 0, 0, 0, 0, resource, subresource, nullptr);
+	}
+	resource->Release();
+	return true;
+}
+
+bool MapD3DReadback(void* user, uint32_t slot, const uint8_t*& pixels, uint32_t& row_pitch) {
+	d3d_readback_t& readback = *(d3d_readback_t*)user;
+
+	// With D3D11_MAP_FLAG_DO_NOT_WAIT, Map returns DXGI_ERROR_WAS_STILL_DRAWING instead of waiting for the copy
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (d3d_device_context->Map(readback.staging[slot], 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped) != S_OK) {
+		return false;
+	}
+	pixels = (const uint8_t*)mapped.pData;
+	row_pitch = mapped.RowPitch;
+	return true;
+}
+
+void UnmapD3DReadback(void* user, uint32_t slot) {
+	d3d_readback_t& readback = *(d3d_readback_t*)user;
+	d3d_device_context->Unmap(readback.staging[slot], 0);
 }
 
 //###################################################################################################################
 // App Methods
 //###################################################################################################################
-void UpdateSimulation(XrTime predicted_time) {
-	cube_rotation_angles.x += 0.02f;
-	cube_rotation_angles.y += 0.04f;
+void InitScene() {
+	// One worker less than there are cores, the render thread works on the jobs as well
+	JobSystemInit(job_system, JobSystemDefaultWorkers());
+
+	// The cube and the city blocks around it, see simulation.h. The particles are updated on the workers
+	SimulationInit(simulation);
+	simulation.jobs = &job_system;
+
+	// A low resolution is enough for the occlusion buffer, as only large occluders are rasterized. It's
+	// twice as wide as high, as the combined view covers both eyes
+	OcclusionInit(occlusion_buffer, 256, 128);
+
+	// The depth slices of the light clusters go from the near to the far plane
+	LightClusterInit(light_clusters, app_light_tiles_x, app_light_tiles_y, app_light_slices, app_near_clipping, app_far_clipping, app_max_light_indices);
+}
+
+void UpdateSimulation(const frame_plan_t& frame_plan) {
+	// Read the newest input. This doesn't take a lock, so it works exactly the same if the simulation
+	// runs on its own thread (which would then keep a pose cache of its own, filled from the snapshots)
+	input_snapshot_t input;
+	bool has_input = InputSnapshotRead(xr_input_snapshots, input);
+
+	// The simulation itself doesn't know about OpenXR, such that a recorded session can be replayed
+	// without a headset. If display periods were missed since the last frame, it runs a step for each of
+	// them, with the hands where they were at the time of the step
+	if (SimulationUpdateFrame(simulation, has_input ? &input : nullptr, xr_pose_cache, frame_plan.display_time, frame_plan.display_period, frame_plan.missed_periods)) {
+		// The status panel shows whether the cube spins, so it needs to be rendered again
+		QuadPanelMarkDirty(xr_quad_layers[app_panel_status].panel);
+	}
 }
 
-void Draw(XrCompositionLayerProjectionView& view) {
+// Does the per-frame work of drawing that's the same for each view, such that only the view
+// dependent part is left for Draw. This is called before the views get late latched, so we can
+// do as much work as we like in here without making the poses older.
+void PrepareDraw(uint32_t view_count) {
 	//----------------------------------------------------------------------------------
-	// Setup
+	// Update the per-object constants of the objects that moved
 	//----------------------------------------------------------------------------------
-	// Use the helper method to create the view-projection matrix
-	DirectX::XMMATRIX view_projection_matrix = CreateViewProjectionMatrix(view);
-
-	// Create the transform buffer struct, which stores the data we want to pass
-	// to the shaders
-	const_buffer_t transform_buffer;
+	// This also lights up their faces with the sun. Objects that didn't move (most of the city) keep the
+	// constants they already have, on the CPU and on the GPU
+	SceneUpdateDrawCache(simulation.scene, draw_cache, simulation_sun);
 
-	// Store the view-projection matrix in the transform buffer struct
-	DirectX::XMStoreFloat4x4(&transform_buffer.view_projection, view_projection_matrix);
+	//----------------------------------------------------------------------------------
+	// Find the lights of each cell of the views
+	//----------------------------------------------------------------------------------
+	// Like the culling, this uses the poses of the first locate. The lights are made bigger by
+	// the same margin that the culling widens the fovs with, to cover the late latched poses
+	uint32_t light_count = app_config_light_clusters ? std::min((uint32_t)simulation.scene.lights.size(), app_max_lights) : 0;
+	view_count = std::min(view_count, app_max_views);
+	std::vector<XrPosef> poses(view_count);
+	std::vector<XrFovf> fovs(view_count);
+	for (uint32_t i = 0; i < view_count; i++) {
+		poses[i] = xr_view_latches[i].pose;
+		fovs[i] = xr_view_latches[i].fov;
+	}
+	LightClusterBuild(light_clusters, simulation.scene.lights.data(), light_count, poses.data(), fovs.data(), view_count, 0.02f);
+	UploadD3DLights();
 
 	//----------------------------------------------------------------------------------
-	// Set buffers and primitive topology
+	// Upload the particles
 	//----------------------------------------------------------------------------------
-	UINT stride = sizeof(vertex_t);
-	UINT offset = 0;
-	// Set vertex buffer to use
-	d3d_device_context->IASetVertexBuffers(0, 1, &d3d_vertex_buffer, &stride, &offset);
+	UploadD3DParticles();
+}
+// Decides for each object of the scene if it needs to be drawn this frame. All views are handled at once,
+// with a combined view that covers all of them (see occlusion.h)
+void CullScene(uint32_t view_count) {
+	if (!app_config_occlusion_culling) {
+		for (scene_object_t& object : simulation.scene.objects) {
+			object.visible = true;
+		}
+		return;
+	}
 
-	// We'll also need to set the index buffer to be able to draw the triangles.
-	// As the type of an index is uint16_t, we'll use the DXGI_FORMAT_R16_UINT
-	// format
-	d3d_device_context->IASetIndexBuffer(d3d_index_buffer, DXGI_FORMAT_R16_UINT, 0);
+	// The replay (see frame_capture.h) culls with the same function, from the recorded poses. Without any views,
+	// it leaves everything visible
+	std::vector<XrPosef> poses(view_count);
+	std::vector<XrFovf> fovs(view_count);
+	for (uint32_t i = 0; i < view_count; i++) {
+		poses[i] = xr_view_latches[i].pose;
+		fovs[i] = xr_view_latches[i].fov;
+	}
+	SimulationCull(simulation, occlusion_buffer, poses.data(), fovs.data(), view_count, app_near_clipping, app_far_clipping);
+}
 
-	// And finally we'll tell the renderer that we want to render a trianglelist
-	d3d_device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+// Writes the meshlets of the objects of the draw list that may be visible in one of the views to the meshlet
+// stream, and uploads it. Like the frusta, this uses the poses of the first locate. The late latched eyes are
+// only a few millimeters away, and a side of a box that turns towards them in that time is seen from the edge,
+// so it covers next to no pixels
+void CullMeshlets(const view_frustum_t* frustums, uint32_t view_count) {
+	XrVector3f positions[app_max_views];
+	for (uint32_t i = 0; i < view_count; i++) {
+		positions[i] = xr_view_latches[i].pose.position;
+	}
 
-	//----------------------------------------------------------------------------------
-	// Setup lighting
-	//----------------------------------------------------------------------------------
-	transform_buffer.light_vector = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 0.0f);
-	transform_buffer.light_color = { 0.5f, 0.5f, 0.5f, 1.0f };
-	transform_buffer.ambient_color = { 0.2f, 0.2f, 0.2f, 1.0f };
+	meshlet_stream.assign(indices, indices + _countof(indices));
+	meshlet_draws.resize(simulation.scene.objects.size());
+	meshlet_stats = {};
+	for (uint32_t object : draw_list) {
+		// If the stream is full, the object draws the whole mesh at the start
+		uint32_t first_index = (uint32_t)meshlet_stream.size();
+		if (first_index + _countof(indices) > app_max_meshlet_indices) {
+			meshlet_draws[object] = { 0, (uint32_t)_countof(indices) };
+			continue;
+		}
+		uint32_t index_count = MeshletCull(cube_meshlets, SceneObjectMatrix(simulation.scene.objects[object]), positions, frustums, view_count, meshlet_stream, meshlet_stats);
+		meshlet_draws[object] = { first_index, index_count };
+	}
+
+	// WRITE_DISCARD gives us new memory if the GPU still reads the stream of the last frame
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (SUCCEEDED(d3d_device_context->Map(d3d_meshlet_index_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+		memcpy(mapped.pData, meshlet_stream.data(), meshlet_stream.size() * sizeof(app_index_t));
+		d3d_device_context->Unmap(d3d_meshlet_index_buffer, 0);
+	}
+}
 
+void Draw(XrCompositionLayerProjectionView& view, const std::vector<uint32_t>& objects, const temporal_jitter_t& jitter) {
 	//----------------------------------------------------------------------------------
-	// Draw a single cube
+	// Setup
 	//----------------------------------------------------------------------------------
-	// Load the rotation angles (roll, pitch, yaw) into a XMVECTOR
-	DirectX::XMVECTOR rotation_angles = DirectX::XMLoadFloat3(&cube_rotation_angles);
+	// Use the helper method to create the view-projection matrix. The pose of the view was
+	// late latched right before we got here, so this is the freshest pose we can get
+	// Store the view-projection matrix in the constant buffer struct, which already
+	// contains the light clusters of the view
+	draw_constants.view_projection = CreateViewProjectionMatrix(view, jitter);
+
+	// The particles face the view, so they need to know its right and up direction
+	xr_mat4_t view_rotation = XrMathQuatToMatrix(view.pose.orientation);
+	draw_constants.camera_right = DirectX::XMFLOAT4(view_rotation.m[0][0], view_rotation.m[0][1], view_rotation.m[0][2], 0.0f);
+	draw_constants.camera_up = DirectX::XMFLOAT4(view_rotation.m[1][0], view_rotation.m[1][1], view_rotation.m[1][2], 0.0f);
 
-	// Get the rotation we'll apply to the cube. Here, we need a quaternion
-	DirectX::XMVECTOR model_rotation = DirectX::XMQuaternionRotationRollPitchYawFromVector(rotation_angles);
+	// Send the constant buffer to the GPU, once for the whole view
+	d3d_device_context->UpdateSubresource(d3d_const_buffer, 0, NULL, &draw_constants, 0, 0);
 
-	// Get the translation which we'll apply to the cube. We'll also use the xr_pose_identity,
-	// which means the cube is positioned at (0, 0, 0), i.e. the origin.
-	DirectX::GXMVECTOR model_translation = DirectX::XMLoadFloat3((DirectX::XMFLOAT3*) &xr_pose_identity.position);
+	//----------------------------------------------------------------------------------
+	// Draw the objects that survived the culling and are in the frustum of the view
+	//----------------------------------------------------------------------------------
+	for (uint32_t object : objects) {
+		DrawD3DObject(object, true);
+	}
 
-	// Set the scaling factor of the cube. We'll scale it down by a factor of 10, i.e.
-	// we'll multiply the unit-vector by 0.1 in the affine translation
-	float scaling_factor = 0.1f;
+	//----------------------------------------------------------------------------------
+	// Draw the particles on top, all of them at once
+	//----------------------------------------------------------------------------------
+	DrawD3DParticles();
+}
 
-	// Setup the affine translation which we'll use for our cube
-	DirectX::XMMATRIX model_matrix = DirectX::XMMatrixAffineTransformation(DirectX::g_XMOne * scaling_factor, DirectX::g_XMZero, model_rotation, model_translation);
+// Draws a single object of the scene. The constants of the view need to be uploaded already. The constants of
+// the object are only uploaded if its draw item changed since they were last uploaded, which means once per
+// frame for the objects that move, and only once for all others. With cull_meshlets, only the meshlets of
+// the object that survived CullMeshlets are drawn
+void DrawD3DObject(uint32_t object, bool cull_meshlets) {
+	if (object >= draw_cache.items.size()) {
+		return;
+	}
 
-	// Store the model matrix for our cube in the constant buffer for the shader
-	DirectX::XMStoreFloat4x4(&transform_buffer.world, DirectX::XMMatrixTranspose(model_matrix));
+	// All meshlets of the object face away from the views
+	cull_meshlets = cull_meshlets && app_config_meshlet_culling && object < meshlet_draws.size();
+	if (cull_meshlets && meshlet_draws[object].index_count == 0) {
+		return;
+	}
+	if (d3d_object_buffers.size() < draw_cache.items.size()) {
+		d3d_object_buffers.resize(draw_cache.items.size(), nullptr);
+		d3d_object_versions.resize(draw_cache.items.size(), 0);
+	}
 
-	// We also need to store the rotation matrix (of the cube), as we need it to correctly
-	// light up the cube. Here, we need a vector instead of a quaternion
-	DirectX::XMMATRIX object_rotation = DirectX::XMMatrixRotationRollPitchYawFromVector(rotation_angles);
-	DirectX::XMStoreFloat4x4(&transform_buffer.rotation, object_rotation);
+	ID3D11Buffer*& buffer = d3d_object_buffers[object];
+	const scene_draw_item_t& item = draw_cache.items[object];
+	if (!buffer) {
+		D3D11_BUFFER_DESC buffer_desc = {};
+		buffer_desc.ByteWidth = sizeof(scene_draw_item_t);
+		buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		D3D11_SUBRESOURCE_DATA buffer_data = { &item };
+		if (FAILED(d3d_device->CreateBuffer(&buffer_desc, &buffer_data, &buffer))) {
+			buffer = nullptr;
+			return;
+		}
+		ResourceTrack(resource_registry, ResourceHandle(buffer), resource_buffer, buffer_desc.ByteWidth, "object constants");
+		d3d_object_versions[object] = draw_cache.versions[object];
+	}
+	else if (d3d_object_versions[object] != draw_cache.versions[object]) {
+		d3d_device_context->UpdateSubresource(buffer, 0, NULL, &item, 0, 0);
+		d3d_object_versions[object] = draw_cache.versions[object];
+	}
 
-	// Send the constant buffer to the GPU, such that the shader can use it
-	d3d_device_context->UpdateSubresource(d3d_const_buffer, 0, NULL, &transform_buffer, 0, 0);
+	// Only the vertex shader needs the constants of the object, it passes the light of the face on
+	d3d_device_context->VSSetConstantBuffers(1, 1, &buffer);
 
 	// And now we tell the GPU to draw our vertices
-	d3d_device_context->DrawIndexed((UINT)_countof(indices), 0, 0);
+	if (cull_meshlets) {
+		d3d_device_context->DrawIndexed(meshlet_draws[object].index_count, meshlet_draws[object].first_index, 0);
+	} else {
+		d3d_device_context->DrawIndexed((UINT)_countof(indices), 0, 0);
+	}
+}
+
+// The panels are rendered with the same Draw method as the views, from a fixed camera in front of the
+// cube. Only the parts of the view that Draw and RenderD3DQuadPanel use are filled in
+XrCompositionLayerProjectionView CreateQuadPanelView(const quad_panel_t& panel) {
+	XrCompositionLayerProjectionView view = {};
+	view.type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
+	view.pose = xr_pose_identity;
+	view.pose.position = { 0.0f, 0.0f, 0.4f };
+	view.fov = { -0.35f, 0.35f, 0.35f, -0.35f };
+	view.subImage.imageRect.offset = { 0, 0 };
+	view.subImage.imageRect.extent = { panel.width, panel.height };
+	return view;
 }
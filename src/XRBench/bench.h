@@ -0,0 +1,64 @@
+#pragma once
+//###################################################################################################################
+// Minimal benchmark harness
+//###################################################################################################################
+// Each benchmark is a function that gets registered with the XR_BENCH macro and reports any number of
+// named metrics. bench_main.cpp runs all registered benchmarks (or the ones whose name contains the
+// filter passed on the command line) and prints the metrics.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+struct bench_metric_t {
+	std::string name;
+	double value;
+	std::string unit;
+};
+
+struct bench_context_t {
+	std::string name;
+	std::vector<bench_metric_t> metrics;
+	bool quick; // Set when the benchmarks should only do a short run (e.g. for smoke testing)
+	uint32_t failed_checks; // See BenchCheck
+};
+
+typedef void (*bench_function_t)(bench_context_t& context);
+
+struct bench_case_t {
+	const char* name;
+	bench_function_t function;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+// Adds a benchmark to the global list. Use the XR_BENCH macro instead of calling this directly
+int BenchRegister(const char* name, bench_function_t function);
+std::vector<bench_case_t>& BenchCases();
+
+// Adds a metric to the results of the currently running benchmark
+void BenchReport(bench_context_t& context, const std::string& name, double value, const char* unit);
+
+// For results that have to be right, not only fast: if the condition is false, the check is reported as failed
+// and xrbench exits with an error once all benchmarks ran
+void BenchCheck(bench_context_t& context, const std::string& name, bool condition);
+
+// Busy waits for the given amount of nanoseconds. Used to simulate CPU work of a known cost
+void BenchSpinFor(int64_t duration_ns);
+
+// Prevents the compiler from optimizing away a computed value
+template <typename T>
+inline void BenchKeep(const T& value) {
+	volatile const char* sink = (volatile const char*)&value;
+	(void)*sink;
+}
+
+#define XR_BENCH(bench_name) \
+	static void bench_name(bench_context_t& context); \
+	static int bench_name##_registered = BenchRegister(#bench_name, bench_name); \
+	static void bench_name(bench_context_t& context)
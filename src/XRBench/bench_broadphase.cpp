@@ -0,0 +1,153 @@
+//###################################################################################################################
+// Broadphase benchmarks
+//###################################################################################################################
+// Moves more and more bodies around in a box (always about as densely packed, so each body has a similar
+// number of neighbours) and finds the overlapping pairs with both methods of broadphase.h, frame after frame.
+// The first frame builds everything from scratch, the following ones are incremental updates, which are
+// reported separately. Both methods have to find the same pairs, and for the smaller counts, the same ones as
+// testing every pair.
+#include "bench.h"
+#include "broadphase.h"
+#include "core_time.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+struct broadphase_bench_body_t {
+	XrVector3f position;
+	XrVector3f velocity; // Meters per frame
+	XrVector3f half_extents;
+};
+
+static float BroadphaseBenchRandom(uint32_t& state) {
+	state = state * 1664525u + 1013904223u;
+	return (float)(state >> 8) / (float)(1 << 24);
+}
+
+// Bodies from 0.2m to 1m in size, one per 4m³. One in a thousand is a lot larger than the rest
+static std::vector<broadphase_bench_body_t> BroadphaseBenchBodies(uint32_t count, float& half_world) {
+	half_world = 0.5f * std::cbrt(4.0f * (float)count);
+	uint32_t random = count;
+	std::vector<broadphase_bench_body_t> bodies(count);
+	for (uint32_t i = 0; i < count; i++) {
+		broadphase_bench_body_t& body = bodies[i];
+		float size = i % 1000 == 999 ? 2.5f : 0.1f + 0.4f * BroadphaseBenchRandom(random);
+		body.half_extents = { size, size, size };
+		body.position = {
+			(BroadphaseBenchRandom(random) * 2.0f - 1.0f) * half_world,
+			(BroadphaseBenchRandom(random) * 2.0f - 1.0f) * half_world,
+			(BroadphaseBenchRandom(random) * 2.0f - 1.0f) * half_world,
+		};
+		body.velocity = {
+			(BroadphaseBenchRandom(random) * 2.0f - 1.0f) * 0.03f,
+			(BroadphaseBenchRandom(random) * 2.0f - 1.0f) * 0.03f,
+			(BroadphaseBenchRandom(random) * 2.0f - 1.0f) * 0.03f,
+		};
+	}
+	return bodies;
+}
+
+// Moves the bodies, bouncing them off the walls, and makes their boxes
+static void BroadphaseBenchMove(std::vector<broadphase_bench_body_t>& bodies, float half_world, std::vector<broadphase_box_t>& boxes) {
+	boxes.resize(bodies.size());
+	for (size_t i = 0; i < bodies.size(); i++) {
+		broadphase_bench_body_t& body = bodies[i];
+		float* position = &body.position.x;
+		float* velocity = &body.velocity.x;
+		for (int axis = 0; axis < 3; axis++) {
+			position[axis] += velocity[axis];
+			if ((position[axis] > half_world && velocity[axis] > 0.0f) || (position[axis] < -half_world && velocity[axis] < 0.0f)) {
+				velocity[axis] = -velocity[axis];
+			}
+		}
+		const XrVector3f& p = body.position;
+		const XrVector3f& h = body.half_extents;
+		boxes[i] = { { p.x - h.x, p.y - h.y, p.z - h.z }, { p.x + h.x, p.y + h.y, p.z + h.z } };
+	}
+}
+
+static void BroadphaseBenchSort(std::vector<broadphase_pair_t>& pairs) {
+	std::sort(pairs.begin(), pairs.end(), [](const broadphase_pair_t& a, const broadphase_pair_t& b) {
+		return a.a != b.a ? a.a < b.a : a.b < b.b;
+	});
+}
+
+static uint32_t BroadphaseBenchMismatches(std::vector<broadphase_pair_t> a, std::vector<broadphase_pair_t> b) {
+	BroadphaseBenchSort(a);
+	BroadphaseBenchSort(b);
+	if (a.size() != b.size()) {
+		return 1;
+	}
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].a != b[i].a || a[i].b != b[i].b) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+XR_BENCH(broadphase) {
+	const uint32_t frame_count = context.quick ? 5 : 60;
+	std::vector<uint32_t> body_counts = { 1000, 10000, 50000, 200000 };
+	if (context.quick) {
+		body_counts = { 1000, 10000 };
+	}
+
+	const broadphase_method_t methods[] = { broadphase_sweep_and_prune, broadphase_spatial_hash };
+	const char* method_names[] = { "sap", "hash" };
+
+	for (uint32_t body_count : body_counts) {
+		float half_world = 0.0f;
+		std::vector<broadphase_bench_body_t> bodies = BroadphaseBenchBodies(body_count, half_world);
+		std::vector<broadphase_box_t> boxes;
+
+		broadphase_t broadphases[2];
+		std::vector<broadphase_pair_t> pairs[2];
+		int64_t build_ns[2] = {};
+		int64_t update_ns[2] = {};
+		uint64_t moved[2] = {};
+		uint64_t total_pairs = 0;
+		uint32_t mismatches = 0;
+		for (uint32_t m = 0; m < 2; m++) {
+			// The large bodies go into the oversized list, the cells fit all the others
+			BroadphaseInit(broadphases[m], methods[m], 1.0f);
+		}
+
+		for (uint32_t frame = 0; frame < frame_count; frame++) {
+			BroadphaseBenchMove(bodies, half_world, boxes);
+			for (uint32_t m = 0; m < 2; m++) {
+				int64_t start = CoreTimeNowNs();
+				BroadphaseUpdate(broadphases[m], boxes.data(), body_count, pairs[m]);
+				int64_t ns = CoreTimeNowNs() - start;
+				(frame == 0 ? build_ns[m] : update_ns[m]) += ns;
+				moved[m] += frame == 0 ? 0 : broadphases[m].stats.moved;
+			}
+			total_pairs += pairs[0].size();
+			mismatches += BroadphaseBenchMismatches(pairs[0], pairs[1]);
+		}
+
+		// Testing every pair is only done once, and only where it doesn't take too long
+		std::string prefix = std::to_string(body_count) + "_";
+		if (body_count <= 10000) {
+			std::vector<broadphase_pair_t> brute_pairs;
+			int64_t start = CoreTimeNowNs();
+			BroadphaseBruteForce(boxes.data(), body_count, brute_pairs);
+			BenchReport(context, prefix + "brute_force", CoreNsToMs(CoreTimeNowNs() - start), "ms");
+			mismatches += BroadphaseBenchMismatches(pairs[0], brute_pairs);
+		}
+
+		uint32_t updates = frame_count - 1;
+		BenchReport(context, prefix + "pairs", (double)total_pairs / frame_count, "");
+		for (uint32_t m = 0; m < 2; m++) {
+			std::string method_prefix = prefix + method_names[m] + "_";
+			BenchReport(context, method_prefix + "build", CoreNsToMs(build_ns[m]), "ms");
+			BenchReport(context, method_prefix + "update", CoreNsToMs(update_ns[m]) / updates, "ms");
+			BenchReport(context, method_prefix + "bodies_per_ms", (double)body_count * updates / CoreNsToMs(update_ns[m]), "");
+			BenchReport(context, method_prefix + "moved_per_update", (double)moved[m] / updates, "");
+		}
+		BenchReport(context, prefix + "mismatches", (double)mismatches, "");
+		BenchCheck(context, prefix + "mismatches", mismatches == 0);
+	}
+}
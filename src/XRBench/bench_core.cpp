@@ -0,0 +1,161 @@
+//###################################################################################################################
+// Core component benchmarks
+//###################################################################################################################
+// Microbenchmarks for the platform independent parts of a frame, each on its own: the simulation update, the
+// culling, building the draw list, the frame scheduling and recording / reading a frame capture. They use the
+// same scene the application shows, and the stand-in runtime for the view poses.
+#include "bench.h"
+#include "core_time.h"
+#include "frame_capture.h"
+#include "frame_schedule.h"
+#include "simulation.h"
+#include "standin_runtime.h"
+
+#include <vector>
+
+// Stereo views of the stand-in runtime for the given display time
+static uint32_t CoreBenchViews(standin_runtime_t& runtime, XrTime display_time, XrPosef* poses, XrFovf* fovs) {
+	return StandinLocateViews(runtime, display_time, poses, fovs, 2);
+}
+
+XR_BENCH(core_simulation_frame) {
+	const uint32_t frame_count = context.quick ? 100 : 2000;
+
+	standin_runtime_config_t config;
+	config.locate_cost_ns = 0;
+	standin_runtime_t runtime;
+	StandinInit(runtime, config);
+
+	static simulation_t simulation;
+	static occlusion_buffer_t occlusion_buffer;
+	SimulationInit(simulation);
+	OcclusionInit(occlusion_buffer, 256, 128);
+
+	input_snapshot_t input = {};
+	input.action_count = app_action_count * input_max_hands;
+
+	scene_draw_cache_t draw_cache;
+	SceneDrawCacheInit(draw_cache);
+	std::vector<uint32_t> draw_list;
+	int64_t update_ns = 0;
+	int64_t cull_ns = 0;
+	int64_t draw_list_ns = 0;
+	uint64_t drawn = 0;
+	for (uint32_t frame = 0; frame < frame_count; frame++) {
+		XrTime display_time = (XrTime)frame * config.display_period;
+		XrPosef poses[2];
+		XrFovf fovs[2];
+		uint32_t view_count = CoreBenchViews(runtime, display_time, poses, fovs);
+
+		// Press select every 50 frames
+		input.version++;
+		input.action_changed = (frame % 50 == 0) ? 1 : 0;
+		input.action_values[0] = (frame % 100 == 0) ? 1.0f : 0.0f;
+
+		int64_t start = CoreTimeNowNs();
+		SimulationUpdate(simulation, &input);
+		int64_t updated = CoreTimeNowNs();
+		SimulationCull(simulation, occlusion_buffer, poses, fovs, view_count, 0.05f, 100.0f);
+		int64_t culled = CoreTimeNowNs();
+		SceneUpdateDrawCache(simulation.scene, draw_cache, simulation_sun);
+		SceneBuildDrawList(simulation.scene, draw_list);
+		int64_t built = CoreTimeNowNs();
+
+		update_ns += updated - start;
+		cull_ns += culled - updated;
+		draw_list_ns += built - culled;
+		drawn += draw_list.size();
+	}
+
+	BenchReport(context, "objects", (double)simulation.scene.objects.size(), "");
+	BenchReport(context, "update", (double)update_ns / frame_count / 1000.0, "us");
+	BenchReport(context, "cull", (double)cull_ns / frame_count / 1000.0, "us");
+	BenchReport(context, "draw_list", (double)draw_list_ns / frame_count / 1000.0, "us");
+	BenchReport(context, "drawn_per_frame", (double)drawn / frame_count, "");
+}
+
+XR_BENCH(core_frame_schedule) {
+	const uint32_t frame_count = context.quick ? 10000 : 1000000;
+	const XrDuration period = 11111111;
+
+	frame_schedule_t schedule;
+	FrameScheduleInit(schedule);
+	FrameScheduleSessionState(schedule, 5); // FOCUSED
+
+	int64_t start = CoreTimeNowNs();
+	XrTime display_time = 0;
+	for (uint32_t frame = 0; frame < frame_count; frame++) {
+		// Every 100th frame misses one display period
+		display_time += (frame % 100 == 99) ? 2 * period : period;
+		frame_plan_t plan = FrameScheduleBegin(schedule, display_time, period, true);
+		BenchKeep(plan);
+		FrameScheduleEnd(schedule);
+	}
+	int64_t elapsed = CoreTimeNowNs() - start;
+
+	BenchReport(context, "per_frame", (double)elapsed / frame_count, "ns");
+	BenchReport(context, "missed_periods", (double)schedule.missed_periods, "");
+}
+
+XR_BENCH(core_frame_capture) {
+	const uint32_t frame_count = context.quick ? 1000 : 100000;
+
+	standin_runtime_config_t config;
+	config.locate_cost_ns = 0;
+	standin_runtime_t runtime;
+	StandinInit(runtime, config);
+
+	// Record the views and the input of each frame, like the application does with a capture file
+	capture_writer_t writer;
+	CaptureOpen(writer, nullptr);
+	CaptureEvent(writer, capture_event_session_state, capture_session_focused);
+
+	input_snapshot_t input = {};
+	input.action_count = app_action_count * input_max_hands;
+	input.hand_pose_valid = 3;
+
+	int64_t encode_ns = 0;
+	for (uint32_t frame = 0; frame < frame_count; frame++) {
+		XrTime display_time = (XrTime)frame * config.display_period;
+		view_latch_t latches[2] = {};
+		XrPosef poses[2];
+		XrFovf fovs[2];
+		uint32_t view_count = CoreBenchViews(runtime, display_time, poses, fovs);
+		for (uint32_t i = 0; i < view_count; i++) {
+			latches[i].pose = poses[i];
+			latches[i].fov = fovs[i];
+		}
+		input.version++;
+		input.display_time = display_time;
+		input.action_values[frame % input.action_count] = (float)(frame % 2);
+		input.hand_poses[0] = StandinLocateHand(runtime, 0, display_time);
+		input.hand_poses[1] = StandinLocateHand(runtime, 1, display_time);
+
+		int64_t start = CoreTimeNowNs();
+		CaptureFrameState(writer, display_time, config.display_period, true);
+		CaptureInput(writer, input);
+		CaptureViews(writer, capture_locate_early, latches, view_count);
+		CaptureViews(writer, capture_locate_late, latches, view_count);
+		CaptureEndFrame(writer);
+		encode_ns += CoreTimeNowNs() - start;
+	}
+	CaptureClose(writer);
+
+	// And read it again
+	capture_reader_t reader;
+	CaptureLoadMemory(reader, writer.buffer.data(), writer.buffer.size());
+	capture_frame_t frame;
+	uint32_t frames_read = 0;
+	int64_t decode_start = CoreTimeNowNs();
+	while (CaptureReadFrame(reader, frame)) {
+		frames_read++;
+	}
+	int64_t decode_ns = CoreTimeNowNs() - decode_start;
+
+	BenchReport(context, "encode_per_frame", (double)encode_ns / frame_count, "ns");
+	BenchReport(context, "decode_per_frame", (double)decode_ns / frame_count, "ns");
+	BenchReport(context, "bytes_per_frame", (double)writer.bytes / frame_count, "B");
+	bool frames_read_ok = frames_read == frame_count && !reader.failed;
+	BenchReport(context, "frames_read_ok", frames_read_ok ? 1.0 : 0.0, "");
+	BenchCheck(context, "frames_read_ok", frames_read_ok);
+}
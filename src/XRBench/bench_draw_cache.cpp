@@ -0,0 +1,191 @@
+//###################################################################################################################
+// Draw cache benchmark
+//###################################################################################################################
+// Draws a city where only some of the objects move, with two views, once the way the application used to (the
+// draw items of all visible objects built every frame, and all constants uploaded for every object of every
+// view) and once with the draw cache of scene.h (only the items of the objects that moved are made again, each
+// object keeps its own constants on the GPU, which are only uploaded when they changed, and the constants of
+// the view are uploaded once per view). The uploads go into memory here, like UpdateSubresource copies them
+// for the driver. How many bytes are uploaded and how many update calls that takes is what the GPU side
+// saves, the CPU time of both includes the copies. The lighting by the sun, which is now done once per face
+// instead of once per pixel, saves GPU time on top that can only be measured on a GPU.
+#include "bench.h"
+#include "core_time.h"
+#include "scene.h"
+#include "simulation.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const uint32_t draw_cache_bench_views = 2;
+
+// The constants the application uploaded for every object of every view before the draw cache
+struct draw_cache_bench_old_constants_t {
+	xr_mat4_t world;
+	xr_mat4_t view_projection;
+	xr_mat4_t rotation;
+	float light_vector[4];
+	float light_color[4];
+	float ambient_color[4];
+	float cluster_scale[4];
+	float cluster_viewport[4];
+	uint32_t cluster_grid[4];
+	float camera_right[4];
+	float camera_up[4];
+};
+
+// The constants of a view with the draw cache, the rest is in the draw items
+struct draw_cache_bench_view_constants_t {
+	xr_mat4_t view_projection;
+	float cluster_scale[4];
+	float cluster_viewport[4];
+	uint32_t cluster_grid[4];
+	float camera_right[4];
+	float camera_up[4];
+};
+
+// Stands in for the constant buffers on the GPU: UpdateSubresource copies what we upload, and counts the calls
+struct draw_cache_bench_uploads_t {
+	std::vector<uint8_t> memory;
+	size_t used;
+	uint64_t bytes;
+	uint64_t calls;
+};
+
+static void DrawCacheBenchUpload(draw_cache_bench_uploads_t& uploads, const void* data, size_t size) {
+	if (uploads.used + size > uploads.memory.size()) {
+		uploads.used = 0;
+	}
+	memcpy(&uploads.memory[uploads.used], data, size);
+	uploads.used += size;
+	uploads.bytes += size;
+	uploads.calls++;
+}
+
+// Turns the moving objects a little further. They're spread over the whole city, every stride-th object moves
+static void DrawCacheBenchMove(scene_t& scene, uint32_t stride, uint32_t frame) {
+	if (stride == 0) {
+		return;
+	}
+	for (size_t i = 0; i < scene.objects.size(); i += stride) {
+		scene.objects[i].orientation = XrMathQuatFromEuler(0.0f, 0.01f * (float)frame + (float)i, 0.0f);
+		scene.objects[i].moved = true;
+	}
+}
+
+XR_BENCH(draw_cache) {
+	const uint32_t frame_count = context.quick ? 20 : 300;
+	const uint32_t blocks = context.quick ? 6 : 16;
+
+	struct draw_cache_bench_case_t {
+		const char* name;
+		uint32_t stride; // Every stride-th object moves, 0 for none
+	};
+	const draw_cache_bench_case_t cases[] = {
+		{ "static", 0 },
+		{ "moving_1pct", 100 },
+		{ "moving_10pct", 10 },
+		{ "moving_all", 1 },
+	};
+
+	xr_mat4_t view_projection = XrMathIdentity();
+	for (const draw_cache_bench_case_t& bench_case : cases) {
+		// Both ways get their own copy of the same city. Every object is visible, like when nothing is culled
+		scene_t scenes[2];
+		for (scene_t& scene : scenes) {
+			SceneAddCityBlocks(scene, blocks, blocks, -1.5f, 5);
+		}
+
+		//------------------------------------------------------------------------------------------------------
+		// All items every frame, all constants for every object and view
+		//------------------------------------------------------------------------------------------------------
+		draw_cache_bench_uploads_t old_uploads = { std::vector<uint8_t>(1 << 20), 0, 0, 0 };
+		std::vector<scene_draw_item_t> items;
+		std::vector<xr_mat4_t> previous_worlds; // Of the frame before the last one, to check the cached items with
+		draw_cache_bench_old_constants_t old_constants = {};
+		int64_t old_ns = 0;
+		for (uint32_t frame = 0; frame < frame_count; frame++) {
+			if (frame == frame_count - 1) {
+				for (const scene_draw_item_t& item : items) {
+					previous_worlds.push_back(item.world);
+				}
+			}
+			DrawCacheBenchMove(scenes[0], bench_case.stride, frame);
+			int64_t start = CoreTimeNowNs();
+			items.clear();
+			for (const scene_object_t& object : scenes[0].objects) {
+				if (object.visible) {
+					items.push_back(SceneDrawItem(object, simulation_sun));
+				}
+			}
+			for (uint32_t view = 0; view < draw_cache_bench_views; view++) {
+				old_constants.view_projection = view_projection;
+				for (const scene_draw_item_t& item : items) {
+					old_constants.world = item.world;
+					old_constants.rotation = item.rotation;
+					DrawCacheBenchUpload(old_uploads, &old_constants, sizeof(old_constants));
+				}
+			}
+			old_ns += CoreTimeNowNs() - start;
+		}
+		BenchKeep(old_uploads.memory[old_uploads.used / 2]);
+
+		//------------------------------------------------------------------------------------------------------
+		// With the draw cache
+		//------------------------------------------------------------------------------------------------------
+		draw_cache_bench_uploads_t cached_uploads = { std::vector<uint8_t>(1 << 20), 0, 0, 0 };
+		scene_draw_cache_t cache;
+		SceneDrawCacheInit(cache);
+		std::vector<uint32_t> draw_list;
+		std::vector<uint32_t> uploaded_versions;
+		draw_cache_bench_view_constants_t view_constants = {};
+		int64_t cached_ns = 0;
+		uint64_t transforms = 0;
+		for (uint32_t frame = 0; frame < frame_count; frame++) {
+			DrawCacheBenchMove(scenes[1], bench_case.stride, frame);
+			int64_t start = CoreTimeNowNs();
+			SceneUpdateDrawCache(scenes[1], cache, simulation_sun);
+			SceneBuildDrawList(scenes[1], draw_list);
+			uploaded_versions.resize(cache.items.size(), 0);
+			for (uint32_t view = 0; view < draw_cache_bench_views; view++) {
+				view_constants.view_projection = view_projection;
+				DrawCacheBenchUpload(cached_uploads, &view_constants, sizeof(view_constants));
+				for (uint32_t object : draw_list) {
+					if (uploaded_versions[object] != cache.versions[object]) {
+						DrawCacheBenchUpload(cached_uploads, &cache.items[object], sizeof(scene_draw_item_t));
+						uploaded_versions[object] = cache.versions[object];
+					}
+				}
+			}
+			cached_ns += CoreTimeNowNs() - start;
+			// The first frame makes every item, like the first frame of the application
+			transforms += frame == 0 ? 0 : cache.stats.transforms;
+		}
+		BenchKeep(cached_uploads.memory[cached_uploads.used / 2]);
+
+		// The cached items have to be the ones the old way makes, with the world of the frame before as the
+		// previous world
+		uint32_t mismatches = 0;
+		for (size_t i = 0; i < items.size(); i++) {
+			scene_draw_item_t expected = items[i];
+			expected.previous_world = previous_worlds[i];
+			mismatches += memcmp(&expected, &cache.items[i], sizeof(scene_draw_item_t)) != 0 ? 1 : 0;
+		}
+
+		std::string prefix = std::string(bench_case.name) + "_";
+		if (bench_case.stride == 0) {
+			BenchReport(context, "objects", (double)scenes[0].objects.size(), "");
+		}
+		BenchReport(context, prefix + "old_cpu", (double)old_ns / frame_count / 1000.0, "us");
+		BenchReport(context, prefix + "cached_cpu", (double)cached_ns / frame_count / 1000.0, "us");
+		BenchReport(context, prefix + "speedup", cached_ns > 0 ? (double)old_ns / (double)cached_ns : 0.0, "x");
+		BenchReport(context, prefix + "old_upload", (double)old_uploads.bytes / frame_count / 1024.0, "KiB");
+		BenchReport(context, prefix + "cached_upload", (double)cached_uploads.bytes / frame_count / 1024.0, "KiB");
+		BenchReport(context, prefix + "old_update_calls", (double)old_uploads.calls / frame_count, "");
+		BenchReport(context, prefix + "cached_update_calls", (double)cached_uploads.calls / frame_count, "");
+		BenchReport(context, prefix + "transforms_per_frame", (double)transforms / (frame_count - 1), "");
+		BenchReport(context, prefix + "mismatches", (double)mismatches, "");
+		BenchCheck(context, prefix + "mismatches", mismatches == 0);
+	}
+}
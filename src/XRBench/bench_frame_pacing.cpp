@@ -0,0 +1,134 @@
+//###################################################################################################################
+// Frame pacing benchmarks
+//###################################################################################################################
+// Runs the frame loop against the stand-in runtime with a fixed CPU and GPU cost per frame, once the way
+// RenderOpenXrFrame used to do it (wait, work and end on one thread) and once with the frame pacer (see
+// frame_pacer.h). For each, we measure how many frames per second the stand-in display shows, and the
+// latency: how long it takes from locating the views until the frame is displayed.
+#include "bench.h"
+#include "core_time.h"
+#include "frame_pacer.h"
+#include "standin_runtime.h"
+
+#include <string>
+
+struct pacing_result_t {
+	double frames_per_second;
+	double latency_ms; // From locating the views to the display time the frame was shown at
+	uint64_t late_frames;
+	double delay_ms; // Mean time the work was delayed to start just in time
+	double expected_cost_ms; // What the pacer expected the work to cost at the end
+};
+
+// The work of a frame: locating the views, and then the CPU cost, with a bit of variation from frame to frame
+static XrTime PacingFrameWork(standin_runtime_t& runtime, XrTime display_time, uint32_t frame, int64_t cpu_cost_ns) {
+	XrPosef poses[2];
+	XrFovf fovs[2];
+	XrTime located_time = StandinNow(runtime);
+	StandinLocateViews(runtime, display_time, poses, fovs, 2);
+	BenchSpinFor(cpu_cost_ns + (int64_t)((frame * 7919u) % 11u) * cpu_cost_ns / 100 - cpu_cost_ns / 20);
+	return located_time;
+}
+
+static bool PacingWait(void* user, frame_wait_result_t& result) {
+	standin_frame_state_t frame_state = StandinWaitFrame(*(standin_runtime_t*)user);
+	result.predicted_display_time = frame_state.predicted_display_time;
+	result.predicted_display_period = frame_state.predicted_display_period;
+	result.should_render = frame_state.should_render;
+
+	// The stand-in runtime counts its time from start_ns on the CPU clock
+	result.display_ns = ((standin_runtime_t*)user)->start_ns + frame_state.predicted_display_time;
+	return true;
+}
+
+static pacing_result_t PacingRun(bool pipelined, uint32_t frame_count, int64_t cpu_cost_ns) {
+	standin_runtime_config_t config;
+	config.locate_cost_ns = 20000;
+	config.gpu_cost_ns = 5000000;
+	standin_runtime_t runtime;
+	StandinInit(runtime, config);
+
+	frame_pacer_t pacer;
+	FramePacerInit(pacer, 500000);
+	if (pipelined) {
+		FramePacerStart(pacer, PacingWait, &runtime);
+	}
+
+	XrTime first_shown = 0;
+	XrTime last_shown = 0;
+	int64_t latency_sum = 0;
+	for (uint32_t frame = 0; frame < frame_count; frame++) {
+		XrTime display_time;
+		if (pipelined) {
+			frame_wait_result_t frame_state;
+			FramePacerTakeFrame(pacer, frame_state);
+			FramePacerWaitToStart(pacer, frame_state);
+			FramePacerBegun(pacer);
+			display_time = frame_state.predicted_display_time;
+		} else {
+			display_time = StandinWaitFrame(runtime).predicted_display_time;
+		}
+
+		XrTime located_time = PacingFrameWork(runtime, display_time, frame, cpu_cost_ns);
+		XrTime shown_time = StandinEndFrame(runtime, display_time);
+		if (pipelined) {
+			FramePacerFrameDone(pacer);
+		}
+
+		latency_sum += shown_time - located_time;
+		first_shown = frame == 0 ? shown_time : first_shown;
+		last_shown = shown_time;
+	}
+	FramePacerStop(pacer);
+
+	pacing_result_t result = {};
+	result.frames_per_second = (double)(frame_count - runtime.frames_replaced - 1) / ((double)(last_shown - first_shown) / 1000000000.0);
+	result.latency_ms = CoreNsToMs(latency_sum) / frame_count;
+	result.late_frames = runtime.frames_late;
+	result.delay_ms = CoreNsToMs(pacer.stats.delayed_ns) / frame_count;
+	result.expected_cost_ms = CoreNsToMs(FrameCostExpected(pacer.cost));
+	return result;
+}
+
+XR_BENCH(frame_pacing) {
+	const uint32_t frame_count = context.quick ? 40 : 600;
+	const int64_t cpu_costs_ms[] = { 3, 8, 10, 14 };
+
+	for (int64_t cpu_cost_ms : cpu_costs_ms) {
+		pacing_result_t serial = PacingRun(false, frame_count, cpu_cost_ms * 1000000);
+		pacing_result_t pipelined = PacingRun(true, frame_count, cpu_cost_ms * 1000000);
+
+		std::string prefix = "cpu" + std::to_string(cpu_cost_ms) + "ms_";
+		BenchReport(context, prefix + "serial_fps", serial.frames_per_second, "");
+		BenchReport(context, prefix + "paced_fps", pipelined.frames_per_second, "");
+		BenchReport(context, prefix + "serial_latency", serial.latency_ms, "ms");
+		BenchReport(context, prefix + "paced_latency", pipelined.latency_ms, "ms");
+		BenchReport(context, prefix + "serial_late", (double)serial.late_frames, "");
+		BenchReport(context, prefix + "paced_late", (double)pipelined.late_frames, "");
+		BenchReport(context, prefix + "paced_delay", pipelined.delay_ms, "ms");
+		BenchReport(context, prefix + "paced_expected_cost", pipelined.expected_cost_ms, "ms");
+	}
+}
+
+XR_BENCH(frame_cost_estimator) {
+	const uint32_t sample_count = context.quick ? 100000 : 10000000;
+
+	// A cost of about 5ms that jumps to 8ms for a while. The estimate has to follow the jump within a few frames
+	frame_cost_estimator_t estimator;
+	FrameCostInit(estimator);
+	uint32_t frames_below = 0;
+	int64_t start = CoreTimeNowNs();
+	for (uint32_t i = 0; i < sample_count; i++) {
+		bool spike = (i / 1000) % 10 == 9;
+		int64_t cost = (spike ? 8000000 : 5000000) + (int64_t)((i * 7919u) % 200000u);
+		if (FrameCostExpected(estimator) < cost) {
+			frames_below++;
+		}
+		FrameCostAdd(estimator, cost);
+	}
+	int64_t elapsed = CoreTimeNowNs() - start;
+
+	BenchReport(context, "add", (double)elapsed / sample_count, "ns");
+	BenchReport(context, "underestimated", 100.0 * frames_below / sample_count, "%");
+	BenchReport(context, "expected", CoreNsToMs(FrameCostExpected(estimator)), "ms");
+}
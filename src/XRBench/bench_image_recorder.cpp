@@ -0,0 +1,149 @@
+//###################################################################################################################
+// Image recording benchmark
+//###################################################################################################################
+// Renders two views into images in memory (a gradient with a few moving boxes, about as easy to compress as the
+// city), and records them with the software readback of image_recorder.h, the same way the application records
+// its swapchain images. Compares the frame time without recording to recording every 10th frame and every
+// frame, once without and once with writing the files. The added frame time is what the render thread pays,
+// the encoding runs on the encoder thread. On a machine with a single core, the encoder shares it with the
+// render thread, so the added frame time includes the encoding. If the encoder can't keep up, images are
+// dropped instead of slowing down the frames. Also checks that the QOI files decode to the rendered images.
+#include "bench.h"
+#include "core_time.h"
+#include "image_recorder.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t image_bench_views = 2;
+static const uint32_t image_bench_latency = 2;
+
+// Fills the image of a view for the given frame
+static void ImageBenchRender(std::vector<uint8_t>& image, uint32_t size, uint32_t view, uint32_t frame) {
+	image.resize((size_t)size * size * 4);
+	for (uint32_t y = 0; y < size; y++) {
+		uint8_t* row = &image[(size_t)y * size * 4];
+		for (uint32_t x = 0; x < size; x++) {
+			row[x * 4 + 0] = (uint8_t)(40 + y * 120 / size);
+			row[x * 4 + 1] = (uint8_t)(60 + y * 100 / size + view * 4);
+			row[x * 4 + 2] = (uint8_t)(200 - x * 60 / size);
+			row[x * 4 + 3] = 255;
+		}
+	}
+
+	for (uint32_t box = 0; box < 8; box++) {
+		uint32_t box_size = size / 10 + box * size / 80;
+		uint32_t left = (box * size / 8 + frame * (box + 1) * 3 + view * 12) % (size - box_size);
+		uint32_t top = (box * 97 + frame * 2) % (size - box_size);
+		for (uint32_t y = top; y < top + box_size; y++) {
+			uint8_t* row = &image[(size_t)y * size * 4];
+			for (uint32_t x = left; x < left + box_size; x++) {
+				// Shaded a little from top to bottom, like a lit face
+				uint8_t shade = (uint8_t)(90 + (y - top) * 60 / box_size);
+				row[x * 4 + 0] = shade;
+				row[x * 4 + 1] = (uint8_t)(shade - box * 8);
+				row[x * 4 + 2] = (uint8_t)(shade / 2);
+			}
+		}
+	}
+}
+
+static double ImageBenchPercentile(std::vector<double> samples, double percentile) {
+	std::sort(samples.begin(), samples.end());
+	return samples[(size_t)(percentile / 100.0 * (double)(samples.size() - 1))];
+}
+
+XR_BENCH(image_recording) {
+	const uint32_t size = context.quick ? 512 : 1024;
+	const uint32_t frame_count = context.quick ? 30 : 180;
+	uint32_t encoders = std::max(1u, JobSystemDefaultWorkers() / 2);
+	BenchReport(context, "cores", (double)std::max(1u, std::thread::hardware_concurrency()), "");
+	BenchReport(context, "encoders", (double)encoders, "");
+
+	//------------------------------------------------------------------------------------------------------
+	// The files have to decode to the rendered images
+	//------------------------------------------------------------------------------------------------------
+	std::vector<uint8_t> image;
+	ImageBenchRender(image, size, 0, 7);
+	std::vector<uint8_t> encoded;
+	ImageEncodeQoi(image.data(), size, size, size * 4, false, encoded);
+	std::vector<uint8_t> decoded;
+	uint32_t decoded_width = 0;
+	uint32_t decoded_height = 0;
+	bool decodes = ImageDecodeQoi(encoded.data(), encoded.size(), decoded_width, decoded_height, decoded);
+	BenchReport(context, "roundtrip_ok", decodes && decoded_width == size && decoded_height == size && decoded == image ? 1.0 : 0.0, "");
+
+	//------------------------------------------------------------------------------------------------------
+	// Frames with and without recording
+	//------------------------------------------------------------------------------------------------------
+	struct image_bench_case_t {
+		const char* name;
+		uint32_t interval; // 0 doesn't record at all
+		bool write;
+	};
+	const image_bench_case_t cases[] = {
+		{ "off", 0, false },
+		{ "every_10th", 10, false },
+		{ "every_frame", 1, false },
+		{ "every_10th_write", 10, true },
+	};
+
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "xrbench_images";
+	double off_mean_ms = 0.0;
+	std::vector<std::vector<uint8_t>> views(image_bench_views);
+	for (const image_bench_case_t& bench_case : cases) {
+		if (bench_case.write) {
+			std::filesystem::create_directories(directory);
+		}
+		image_readback_software_t software;
+		image_recorder_t recorder;
+		std::string directory_name = directory.string();
+		ImageRecorderInit(recorder, ImageReadbackSoftware(software), image_bench_views * (image_bench_latency + 2), encoders, bench_case.write ? directory_name.c_str() : nullptr, bench_case.interval, image_bench_latency);
+
+		std::vector<double> frame_ms;
+		for (uint32_t frame = 0; frame < frame_count; frame++) {
+			int64_t start = CoreTimeNowNs();
+			if (bench_case.interval > 0) {
+				ImageRecorderBeginFrame(recorder, frame);
+			}
+			for (uint32_t view = 0; view < image_bench_views; view++) {
+				ImageBenchRender(views[view], size, view, frame);
+				if (bench_case.interval > 0) {
+					ImageRecorderCaptureView(recorder, view, views[view].data(), size, size);
+				}
+			}
+			frame_ms.push_back(CoreNsToMs(CoreTimeNowNs() - start));
+			BenchKeep(views[0][frame % views[0].size()]);
+		}
+		ImageRecorderShutdown(recorder, 1000);
+		image_recorder_stats_t stats = ImageRecorderStats(recorder);
+
+		double mean_ms = 0.0;
+		for (double ms : frame_ms) {
+			mean_ms += ms / frame_ms.size();
+		}
+		off_mean_ms = bench_case.interval == 0 ? mean_ms : off_mean_ms;
+
+		std::string prefix = std::string(bench_case.name) + "_";
+		BenchReport(context, prefix + "frame_mean", mean_ms, "ms");
+		BenchReport(context, prefix + "frame_p99", ImageBenchPercentile(frame_ms, 99.0), "ms");
+		if (bench_case.interval == 0) {
+			continue;
+		}
+		BenchReport(context, prefix + "added_per_frame", mean_ms - off_mean_ms, "ms");
+		BenchReport(context, prefix + "recorder_per_frame", CoreNsToMs(stats.render_thread_ns) / frame_count, "ms");
+		BenchReport(context, prefix + "requested", (double)stats.requested, "");
+		BenchReport(context, prefix + "written", (double)stats.written, "");
+		BenchReport(context, prefix + "dropped", (double)stats.dropped, "");
+		BenchReport(context, prefix + "failed_writes", (double)stats.failed_writes, "");
+		BenchReport(context, prefix + "encode_per_image", stats.written ? CoreNsToMs(stats.encode_ns) / stats.written : 0.0, "ms");
+		BenchReport(context, prefix + "compression", stats.encoded_bytes ? (double)stats.raw_bytes / stats.encoded_bytes : 0.0, "x");
+	}
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+}
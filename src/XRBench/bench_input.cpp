@@ -0,0 +1,104 @@
+//###################################################################################################################
+// Input pipeline benchmark
+//###################################################################################################################
+// Measures the per-frame cost of the input path of the application (one xrSyncActions, one state query per
+// action, locating both controllers, publishing the snapshot) for a growing number of actions, while reader
+// threads continuously read the latest snapshot like the simulation would.
+#include "bench.h"
+#include "core_time.h"
+#include "input_snapshot.h"
+#include "standin_runtime.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The same steps PollOpenXrActions and LocateOpenXrControllers do in the application
+static void PollInputFrame(standin_runtime_t& runtime, input_snapshot_buffer_t& buffer, input_snapshot_t& snapshot, uint32_t action_count, XrTime display_time) {
+	StandinSyncActions(runtime);
+
+	snapshot.action_count = action_count;
+	snapshot.action_changed = 0;
+	for (uint32_t i = 0; i < action_count; i++) {
+		float value = StandinGetActionState(runtime, i);
+		if (value != snapshot.action_values[i]) {
+			snapshot.action_changed |= (1ull << i);
+		}
+		snapshot.action_values[i] = value;
+	}
+
+	snapshot.display_time = display_time;
+	snapshot.hand_pose_valid = 0;
+	for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+		snapshot.hand_poses[hand] = StandinLocateHand(runtime, hand, display_time);
+		snapshot.hand_pose_valid |= (1u << hand);
+	}
+
+	InputSnapshotPublish(buffer, snapshot);
+}
+
+XR_BENCH(input_snapshot_per_frame_cost) {
+	const int frame_count = context.quick ? 200 : 5000;
+	const uint32_t reader_count = 2;
+	const uint32_t action_counts[] = { 4, 8, 16, 32, 64 };
+
+	standin_runtime_config_t config;
+	standin_runtime_t runtime;
+
+	for (uint32_t action_count : action_counts) {
+		StandinInit(runtime, config);
+		static input_snapshot_buffer_t buffer;
+		InputSnapshotInit(buffer);
+		input_snapshot_t snapshot = {};
+
+		// Simulation threads that read the latest snapshot as fast as they can
+		std::atomic<bool> readers_running(true);
+		std::atomic<uint64_t> reads(0);
+		std::atomic<uint64_t> retries(0);
+		std::vector<std::thread> readers;
+		for (uint32_t r = 0; r < reader_count; r++) {
+			readers.emplace_back([&]() {
+				input_snapshot_t local = {};
+				uint64_t local_reads = 0;
+				uint32_t local_retries = 0;
+				while (readers_running.load(std::memory_order_relaxed)) {
+					if (InputSnapshotRead(buffer, local, &local_retries)) {
+						local_reads++;
+					}
+					std::this_thread::yield();
+				}
+				reads += local_reads;
+				retries += local_retries;
+			});
+		}
+
+		// Time the input part of the frame only, we don't wait for the display period here
+		int64_t total_ns = 0;
+		int64_t publish_ns = 0;
+		for (int frame = 0; frame < frame_count; frame++) {
+			XrTime display_time = StandinNow(runtime) + 2 * config.display_period;
+
+			int64_t start = CoreTimeNowNs();
+			PollInputFrame(runtime, buffer, snapshot, action_count, display_time);
+			int64_t end = CoreTimeNowNs();
+			total_ns += end - start;
+
+			// Publishing alone, to show that the readers don't slow down the writer
+			start = CoreTimeNowNs();
+			InputSnapshotPublish(buffer, snapshot);
+			publish_ns += CoreTimeNowNs() - start;
+		}
+
+		readers_running = false;
+		for (std::thread& reader : readers) {
+			reader.join();
+		}
+
+		std::string prefix = "actions_" + std::to_string(action_count);
+		BenchReport(context, prefix + ".frame_input_cost", (double)total_ns / frame_count / 1000.0, "us");
+		BenchReport(context, prefix + ".publish_cost", (double)publish_ns / frame_count / 1000.0, "us");
+		BenchReport(context, prefix + ".sync_calls_per_frame", (double)runtime.sync_calls / frame_count, "calls");
+		BenchReport(context, prefix + ".reader_retry_ratio", reads ? (double)retries / (double)reads : 0.0, "");
+	}
+}
@@ -0,0 +1,92 @@
+//###################################################################################################################
+// Late latching latency harness
+//###################################################################################################################
+// Runs the structure of RenderOpenXrLayer against the stand-in runtime: locate the views, do the per-eye
+// CPU work, (optionally) locate the views again, record the draws of every view, then release the images.
+// For every submitted view we record how old the pose was when its image was released (the same interval
+// the app records with PoseAgeRecord), and how far the pose was off from the actual head pose at display time.
+#include "bench.h"
+#include "core_time.h"
+#include "late_latch.h"
+#include "standin_runtime.h"
+
+#include <cmath>
+#include <string>
+
+static const uint32_t harness_max_views = 4;
+
+struct latency_result_t {
+	pose_age_stats_t pose_age;
+	double error_sum_degrees;
+	uint64_t error_samples;
+};
+
+static void LocateIntoLatches(standin_runtime_t& runtime, XrTime display_time, view_latch_t* latches, uint32_t& view_count) {
+	XrPosef poses[harness_max_views];
+	XrFovf fovs[harness_max_views];
+	view_count = StandinLocateViews(runtime, display_time, poses, fovs, harness_max_views);
+
+	int64_t latched_at = CoreTimeNowNs();
+	for (uint32_t i = 0; i < view_count; i++) {
+		latches[i].pose = poses[i];
+		latches[i].fov = fovs[i];
+		latches[i].display_time = display_time;
+		latches[i].latched_at_ns = latched_at;
+	}
+}
+
+static latency_result_t RunLatencyHarness(bool late_latch, int frame_count, int64_t cpu_work_per_eye_ns, int64_t draw_per_view_ns) {
+	standin_runtime_t runtime;
+	StandinInit(runtime, standin_runtime_config_t());
+
+	latency_result_t result = {};
+	PoseAgeReset(result.pose_age);
+
+	for (int frame = 0; frame < frame_count; frame++) {
+		standin_frame_state_t frame_state = StandinWaitFrame(runtime);
+
+		// Early locate, as RenderOpenXrLayer always did
+		view_latch_t latches[harness_max_views];
+		uint32_t view_count = 0;
+		LocateIntoLatches(runtime, frame_state.predicted_display_time, latches, view_count);
+
+		// Per-eye CPU work (culling, building the constant buffers, ...)
+		BenchSpinFor(cpu_work_per_eye_ns * view_count);
+
+		// The late latch right before the submission
+		if (late_latch) {
+			LocateIntoLatches(runtime, frame_state.predicted_display_time, latches, view_count);
+		}
+
+		// Even with the late latch, the draws of every view are recorded after it, and the images are only
+		// released after that
+		BenchSpinFor(draw_per_view_ns * view_count);
+
+		// Submit. Compare the pose we submitted against where the head actually is at display time
+		int64_t submitted_at = CoreTimeNowNs();
+		XrPosef true_pose = StandinTrueHeadPose(runtime, frame_state.predicted_display_time);
+		for (uint32_t i = 0; i < view_count; i++) {
+			PoseAgeRecord(result.pose_age, latches[i], submitted_at);
+			result.error_sum_degrees += PoseAngularDistance(latches[i].pose, true_pose) * 57.2957795f;
+			result.error_samples++;
+		}
+	}
+
+	return result;
+}
+
+XR_BENCH(late_latch_pose_age) {
+	int frame_count = context.quick ? 30 : 300;
+	const int64_t cpu_work_per_eye_ns = 2500000;
+	const int64_t draw_per_view_ns = 500000; // Recording the draw calls of a view into the command stream
+
+	const char* modes[] = { "early", "late" };
+	for (int mode = 0; mode < 2; mode++) {
+		latency_result_t result = RunLatencyHarness(mode == 1, frame_count, cpu_work_per_eye_ns, draw_per_view_ns);
+		std::string prefix = modes[mode];
+
+		BenchReport(context, prefix + ".pose_age_mean", PoseAgeMeanMs(result.pose_age), "ms");
+		BenchReport(context, prefix + ".pose_age_p99", PoseAgePercentileMs(result.pose_age, 99.0), "ms");
+		BenchReport(context, prefix + ".pose_error_mean", result.error_sum_degrees / (double)result.error_samples, "deg");
+	}
+}
@@ -0,0 +1,166 @@
+//###################################################################################################################
+// Clustered lighting benchmarks
+//###################################################################################################################
+// Builds the light clusters (see light_clusters.h) for a stereo view standing in the city, with more and more
+// moving lights, and measures how long that takes. To get an idea of what the GPU saves, a grid of pixels is
+// then shaded on the CPU with the same function the pixel shader uses, once with the lights of the cell of
+// each pixel and once with all lights. Both have to give the same result, otherwise the clusters miss a light.
+#include "bench.h"
+#include "core_time.h"
+#include "light_clusters.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+static const uint32_t light_bench_pixels = 64; // Pixels per row and column of a view that get shaded
+
+// A point on a surface seen by one of the views, and the cell it's in
+struct light_bench_pixel_t {
+	XrVector3f position;
+	XrVector3f normal;
+	uint32_t view;
+	float image_x;
+	float image_y;
+	float depth;
+};
+
+// A head at standing height at the origin (which is a street crossing), turned by yaw
+static void LightBenchViews(float yaw, XrPosef* poses, XrFovf* fovs) {
+	XrQuaternionf orientation = { 0.0f, sinf(yaw * 0.5f), 0.0f, cosf(yaw * 0.5f) };
+	xr_mat4_t rotation = XrMathQuatToMatrix(orientation);
+	for (int eye = 0; eye < 2; eye++) {
+		float offset = eye == 0 ? -0.032f : 0.032f;
+		poses[eye].orientation = orientation;
+		poses[eye].position = { rotation.m[0][0] * offset, rotation.m[0][1] * offset, rotation.m[0][2] * offset };
+		fovs[eye] = { eye == 0 ? -0.9f : -0.75f, eye == 0 ? 0.75f : 0.9f, 0.8f, -0.85f };
+	}
+}
+
+// Surfaces at random depths (evenly distributed in log space, like the slices) that face the view
+static void LightBenchPixels(const XrPosef* poses, const XrFovf* fovs, uint32_t& random_state, std::vector<light_bench_pixel_t>& pixels) {
+	pixels.clear();
+	for (uint32_t view = 0; view < 2; view++) {
+		xr_mat4_t view_to_world = XrMathPoseToMatrix(poses[view]);
+		float tan_left = tanf(fovs[view].angleLeft);
+		float tan_right = tanf(fovs[view].angleRight);
+		float tan_up = tanf(fovs[view].angleUp);
+		float tan_down = tanf(fovs[view].angleDown);
+
+		for (uint32_t y = 0; y < light_bench_pixels; y++) {
+			for (uint32_t x = 0; x < light_bench_pixels; x++) {
+				random_state = random_state * 1664525u + 1013904223u;
+				float t = (float)(random_state >> 8) / (float)(1 << 24);
+
+				light_bench_pixel_t pixel;
+				pixel.view = view;
+				pixel.image_x = ((float)x + 0.5f) / (float)light_bench_pixels;
+				pixel.image_y = ((float)y + 0.5f) / (float)light_bench_pixels;
+				pixel.depth = 0.5f * powf(120.0f, t);
+
+				float view_x = (tan_left + (tan_right - tan_left) * pixel.image_x) * pixel.depth;
+				float view_y = (tan_up - (tan_up - tan_down) * pixel.image_y) * pixel.depth;
+				float view_z = -pixel.depth;
+				const float(*m)[4] = view_to_world.m;
+				pixel.position = {
+					view_x * m[0][0] + view_y * m[1][0] + view_z * m[2][0] + m[3][0],
+					view_x * m[0][1] + view_y * m[1][1] + view_z * m[2][1] + m[3][1],
+					view_x * m[0][2] + view_y * m[1][2] + view_z * m[2][2] + m[3][2]
+				};
+				pixel.normal = { m[2][0], m[2][1], m[2][2] };
+				pixels.push_back(pixel);
+			}
+		}
+	}
+}
+
+XR_BENCH(light_clusters) {
+	const uint32_t frame_count = context.quick ? 10 : 200;
+	const uint32_t light_counts[] = { 128, 256, 512, 1024, 4096 };
+
+	for (uint32_t light_count : light_counts) {
+		scene_t scene;
+		SceneAddCityLights(scene, 8, 8, -1.6f, light_count - 81, 2);
+
+		light_cluster_grid_t grid;
+		LightClusterInit(grid, 16, 16, 24, 0.05f, 100.0f, 1024 * 1024);
+
+		std::vector<light_bench_pixel_t> pixels;
+		uint32_t random_state = 1;
+		int64_t build_ns = 0;
+		int64_t clustered_ns = 0;
+		int64_t brute_force_ns = 0;
+		uint64_t clustered_lights = 0;
+		uint64_t indices = 0;
+		uint32_t max_per_cell = 0;
+		uint32_t mismatches = 0;
+		float brightness = 0.0f;
+
+		for (uint32_t frame = 0; frame < frame_count; frame++) {
+			SceneMoveLights(scene);
+
+			XrPosef poses[2];
+			XrFovf fovs[2];
+			LightBenchViews((float)frame * 0.05f, poses, fovs);
+
+			int64_t start = CoreTimeNowNs();
+			LightClusterBuild(grid, scene.lights.data(), (uint32_t)scene.lights.size(), poses, fovs, 2, 0.02f);
+			build_ns += CoreTimeNowNs() - start;
+			indices += grid.stats.indices;
+			max_per_cell = std::max(max_per_cell, grid.stats.max_per_cell);
+
+			//------------------------------------------------------------------------------------------------------
+			// Shade the pixels with the lights of their cell, and with all lights
+			//------------------------------------------------------------------------------------------------------
+			LightBenchPixels(poses, fovs, random_state, pixels);
+			std::vector<XrVector3f> clustered(pixels.size());
+			std::vector<XrVector3f> brute_force(pixels.size());
+
+			start = CoreTimeNowNs();
+			for (size_t p = 0; p < pixels.size(); p++) {
+				const light_bench_pixel_t& pixel = pixels[p];
+				const light_cluster_t& cell = LightClusterCell(grid, pixel.view, pixel.image_x, pixel.image_y, pixel.depth);
+				XrVector3f color = { 0.0f, 0.0f, 0.0f };
+				for (uint32_t i = 0; i < cell.count; i++) {
+					XrVector3f light = LightShade(scene.lights[grid.light_indices[cell.offset + i]], pixel.position, pixel.normal);
+					color = { color.x + light.x, color.y + light.y, color.z + light.z };
+				}
+				clustered[p] = color;
+				clustered_lights += cell.count;
+			}
+			int64_t clustered_done = CoreTimeNowNs();
+			for (size_t p = 0; p < pixels.size(); p++) {
+				const light_bench_pixel_t& pixel = pixels[p];
+				XrVector3f color = { 0.0f, 0.0f, 0.0f };
+				for (const light_t& light_data : scene.lights) {
+					XrVector3f light = LightShade(light_data, pixel.position, pixel.normal);
+					color = { color.x + light.x, color.y + light.y, color.z + light.z };
+				}
+				brute_force[p] = color;
+			}
+			brute_force_ns += CoreTimeNowNs() - clustered_done;
+			clustered_ns += clustered_done - start;
+
+			for (size_t p = 0; p < pixels.size(); p++) {
+				float difference = fabsf(clustered[p].x - brute_force[p].x) + fabsf(clustered[p].y - brute_force[p].y) + fabsf(clustered[p].z - brute_force[p].z);
+				if (difference > 1e-4f * (1.0f + brute_force[p].x + brute_force[p].y + brute_force[p].z)) {
+					mismatches++;
+				}
+				brightness += brute_force[p].x + brute_force[p].y + brute_force[p].z;
+			}
+		}
+		BenchKeep(brightness);
+
+		const double pixel_count = (double)frame_count * 2 * light_bench_pixels * light_bench_pixels;
+		std::string prefix = std::to_string(light_count) + "_";
+		BenchReport(context, prefix + "build", (double)build_ns / frame_count / 1000.0, "us");
+		BenchReport(context, prefix + "indices", (double)indices / frame_count, "");
+		BenchReport(context, prefix + "max_per_cell", (double)max_per_cell, "");
+		BenchReport(context, prefix + "lights_per_pixel", (double)clustered_lights / pixel_count, "");
+		BenchReport(context, prefix + "shade_clustered", (double)clustered_ns / pixel_count, "ns");
+		BenchReport(context, prefix + "shade_all", (double)brute_force_ns / pixel_count, "ns");
+		BenchReport(context, prefix + "mismatches", (double)mismatches, "");
+	}
+}
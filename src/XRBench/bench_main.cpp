@@ -0,0 +1,214 @@
+//###################################################################################################################
+// Benchmark runner
+//###################################################################################################################
+// Usage: xrbench [--quick] [--json <file>] [filter]
+//        xrbench [--json <file>] --replay <capture file>
+// Runs all benchmarks whose name contains the filter (or all of them if no filter is given). With --replay, it
+// replays a recording of the application instead (see frame_capture.h) and reports how long the frames took.
+// The results are always printed, with --json they are also written to the given file, such that they can be
+// collected per commit to spot performance regressions.
+#include "bench.h"
+#include "core_time.h"
+#include "replay.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Set by the build to the commit that was built, such that the JSON results can be matched to it
+#ifndef XR_BENCH_COMMIT
+#define XR_BENCH_COMMIT "unknown"
+#endif
+
+std::vector<bench_case_t>& BenchCases() {
+	// Function local static, such that the list is constructed before the first registration
+	// happens, no matter in which order the translation units are initialized
+	static std::vector<bench_case_t> cases;
+	return cases;
+}
+
+int BenchRegister(const char* name, bench_function_t function) {
+	BenchCases().push_back({ name, function });
+	return (int)BenchCases().size();
+}
+
+void BenchReport(bench_context_t& context, const std::string& name, double value, const char* unit) {
+	context.metrics.push_back({ name, value, unit });
+}
+
+void BenchCheck(bench_context_t& context, const std::string& name, bool condition) {
+	if (!condition) {
+		fprintf(stderr, "%s: check %s failed\n", context.name.c_str(), name.c_str());
+		context.failed_checks++;
+	}
+}
+
+void BenchSpinFor(int64_t duration_ns) {
+	int64_t end = CoreTimeNowNs() + duration_ns;
+	while (CoreTimeNowNs() < end) {
+	}
+}
+
+//###################################################################################################################
+// Output
+//###################################################################################################################
+static void PrintResults(const bench_context_t& context) {
+	printf("%s\n", context.name.c_str());
+	for (const bench_metric_t& metric : context.metrics) {
+		printf("  %-48s %14.4f %s\n", metric.name.c_str(), metric.value, metric.unit.c_str());
+	}
+}
+
+static void WriteJsonString(FILE* file, const std::string& text) {
+	fputc('"', file);
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			fputc('\\', file);
+			fputc(c, file);
+		}
+		else if ((unsigned char)c < 0x20) {
+			fprintf(file, "\\u%04x", (unsigned int)c);
+		}
+		else {
+			fputc(c, file);
+		}
+	}
+	fputc('"', file);
+}
+
+// Writes all results as one JSON object:
+// { "commit": "...", "quick": false, "benchmarks": [ { "name": "...", "metrics": [ { "name": "...", "value": 1.0, "unit": "ms" } ] } ] }
+static bool WriteJson(const char* path, const std::vector<bench_context_t>& results, bool quick) {
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		return false;
+	}
+
+	fprintf(file, "{\n  \"commit\": ");
+	WriteJsonString(file, XR_BENCH_COMMIT);
+	fprintf(file, ",\n  \"quick\": %s,\n  \"benchmarks\": [", quick ? "true" : "false");
+	for (size_t i = 0; i < results.size(); i++) {
+		fprintf(file, "%s\n    { \"name\": ", i > 0 ? "," : "");
+		WriteJsonString(file, results[i].name);
+		fprintf(file, ", \"metrics\": [");
+		for (size_t m = 0; m < results[i].metrics.size(); m++) {
+			const bench_metric_t& metric = results[i].metrics[m];
+			fprintf(file, "%s\n      { \"name\": ", m > 0 ? "," : "");
+			WriteJsonString(file, metric.name);
+
+			// JSON has no NaN or infinity
+			if (std::isfinite(metric.value)) {
+				fprintf(file, ", \"value\": %.9g, \"unit\": ", metric.value);
+			}
+			else {
+				fprintf(file, ", \"value\": null, \"unit\": ");
+			}
+			WriteJsonString(file, metric.unit);
+			fprintf(file, " }");
+		}
+		fprintf(file, "\n    ] }");
+	}
+	fprintf(file, "\n  ]\n}\n");
+
+	return fclose(file) == 0;
+}
+
+//###################################################################################################################
+// Replay
+//###################################################################################################################
+
+// Replays a recording made by the application, and reports the same kind of metrics as the benchmarks
+static bool RunReplay(const char* path, bench_context_t& context) {
+	context.name = std::string("replay ") + path;
+
+	capture_reader_t reader;
+	if (!CaptureLoad(reader, path)) {
+		fprintf(stderr, "Couldn't load the capture %s\n", path);
+		return false;
+	}
+
+	static replay_state_t replay;
+	ReplayInit(replay);
+	std::vector<double> frame_ms;
+	bool complete = ReplayCapture(replay, reader, &frame_ms);
+
+	double sum_ms = 0.0;
+	double max_ms = 0.0;
+	for (double ms : frame_ms) {
+		sum_ms += ms;
+		max_ms = ms > max_ms ? ms : max_ms;
+	}
+
+	const frame_schedule_t& schedule = replay.schedule;
+	BenchReport(context, "frames", (double)schedule.frames, "");
+	BenchReport(context, "rendered_frames", (double)schedule.rendered_frames, "");
+	BenchReport(context, "frame_mean", frame_ms.empty() ? 0.0 : sum_ms / (double)frame_ms.size(), "ms");
+	BenchReport(context, "frame_max", max_ms, "ms");
+	BenchReport(context, "drawn_objects_per_frame", schedule.rendered_frames ? (double)replay.drawn_objects / (double)schedule.rendered_frames : 0.0, "");
+	BenchReport(context, "complete", complete ? 1.0 : 0.0, "");
+	BenchReport(context, "truncated", reader.truncated ? 1.0 : 0.0, "");
+
+	// Only the lower 53 bits, such that the checksum survives being stored as a double
+	BenchReport(context, "checksum", (double)(ReplayChecksum(replay) & ((1ull << 53) - 1)), "");
+	return complete;
+}
+
+//###################################################################################################################
+// Main
+//###################################################################################################################
+int main(int argc, char** argv) {
+	bool quick = false;
+	const char* filter = nullptr;
+	const char* json_path = nullptr;
+	const char* replay_path = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--quick") == 0) {
+			quick = true;
+		}
+		else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replay_path = argv[++i];
+		}
+		else {
+			filter = argv[i];
+		}
+	}
+
+	std::vector<bench_context_t> results;
+	bool success = true;
+
+	if (replay_path) {
+		bench_context_t context = {};
+		success = RunReplay(replay_path, context);
+		PrintResults(context);
+		results.push_back(context);
+	}
+	else {
+		for (bench_case_t& bench_case : BenchCases()) {
+			if (filter && strstr(bench_case.name, filter) == nullptr) {
+				continue;
+			}
+
+			bench_context_t context = {};
+			context.name = bench_case.name;
+			context.quick = quick;
+			bench_case.function(context);
+			if (context.failed_checks > 0) {
+				success = false;
+			}
+
+			PrintResults(context);
+			results.push_back(context);
+		}
+	}
+
+	if (json_path && !WriteJson(json_path, results, quick)) {
+		fprintf(stderr, "Couldn't write the results to %s\n", json_path);
+		return 1;
+	}
+
+	return success ? 0 : 1;
+}
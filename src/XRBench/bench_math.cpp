@@ -0,0 +1,315 @@
+//###################################################################################################################
+// XR math benchmarks
+//###################################################################################################################
+// Compares the xr_math routines against the way the application computed the same matrices before, i.e.
+// four tanf calls, a general 4x4 inverse and a transpose per view, and a quaternion and a separate
+// rotation matrix per object. DirectXMath isn't available on Linux, so the reference path is a plain
+// transcription of the DirectXMath functions the application called. Each benchmark also reports the
+// largest difference between the two results, to make sure both compute the same thing. If it's above the
+// tolerance of the benchmark (float rounding, relative to the size of the values), the run fails.
+#include "bench.h"
+#include "core_time.h"
+#include "xr_math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Reference implementation (the previous code path)
+//------------------------------------------------------------------------------------------------------
+struct ref_mat_t {
+	float m[4][4];
+};
+
+static ref_mat_t RefMultiply(const ref_mat_t& a, const ref_mat_t& b) {
+	ref_mat_t result;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			result.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+		}
+	}
+	return result;
+}
+
+static ref_mat_t RefTranspose(const ref_mat_t& a) {
+	ref_mat_t result;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			result.m[i][j] = a.m[j][i];
+		}
+	}
+	return result;
+}
+
+// General 4x4 inverse using cofactors, like XMMatrixInverse
+static ref_mat_t RefInverse(const ref_mat_t& matrix) {
+	const float* m = &matrix.m[0][0];
+	float inv[16];
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float determinant = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	float reciprocal = 1.0f / determinant;
+
+	ref_mat_t result;
+	for (int i = 0; i < 16; i++) {
+		(&result.m[0][0])[i] = inv[i] * reciprocal;
+	}
+	return result;
+}
+
+static ref_mat_t RefRotationQuaternion(const XrQuaternionf& q) {
+	ref_mat_t result = {};
+	result.m[0][0] = 1.0f - 2.0f * q.y * q.y - 2.0f * q.z * q.z;
+	result.m[0][1] = 2.0f * q.x * q.y + 2.0f * q.z * q.w;
+	result.m[0][2] = 2.0f * q.x * q.z - 2.0f * q.y * q.w;
+	result.m[1][0] = 2.0f * q.x * q.y - 2.0f * q.z * q.w;
+	result.m[1][1] = 1.0f - 2.0f * q.x * q.x - 2.0f * q.z * q.z;
+	result.m[1][2] = 2.0f * q.y * q.z + 2.0f * q.x * q.w;
+	result.m[2][0] = 2.0f * q.x * q.z + 2.0f * q.y * q.w;
+	result.m[2][1] = 2.0f * q.y * q.z - 2.0f * q.x * q.w;
+	result.m[2][2] = 1.0f - 2.0f * q.x * q.x - 2.0f * q.y * q.y;
+	result.m[3][3] = 1.0f;
+	return result;
+}
+
+// XMMatrixAffineTransformation with the origin at zero: scaling matrix times rotation matrix plus translation
+static ref_mat_t RefAffineTransformation(float scale, const XrQuaternionf& rotation, const XrVector3f& translation) {
+	ref_mat_t scaling = {};
+	scaling.m[0][0] = scaling.m[1][1] = scaling.m[2][2] = scale;
+	scaling.m[3][3] = 1.0f;
+	ref_mat_t result = RefMultiply(scaling, RefRotationQuaternion(rotation));
+	result.m[3][0] += translation.x;
+	result.m[3][1] += translation.y;
+	result.m[3][2] += translation.z;
+	return result;
+}
+
+// The previous CreateViewProjectionMatrix
+static ref_mat_t RefViewProjection(const XrPosef& pose, const XrFovf& fov, float near_z, float far_z) {
+	float left = near_z * tanf(fov.angleLeft);
+	float right = near_z * tanf(fov.angleRight);
+	float top = near_z * tanf(fov.angleUp);
+	float bottom = near_z * tanf(fov.angleDown);
+
+	// XMMatrixPerspectiveOffCenterRH
+	ref_mat_t projection = {};
+	float reciprocal_width = 1.0f / (right - left);
+	float reciprocal_height = 1.0f / (top - bottom);
+	float range = far_z / (near_z - far_z);
+	projection.m[0][0] = 2.0f * near_z * reciprocal_width;
+	projection.m[1][1] = 2.0f * near_z * reciprocal_height;
+	projection.m[2][0] = (left + right) * reciprocal_width;
+	projection.m[2][1] = (top + bottom) * reciprocal_height;
+	projection.m[2][2] = range;
+	projection.m[2][3] = -1.0f;
+	projection.m[3][2] = range * near_z;
+
+	ref_mat_t view = RefInverse(RefAffineTransformation(1.0f, pose.orientation, pose.position));
+	return RefTranspose(RefMultiply(view, projection));
+}
+
+// The previous per-object part of Draw: quaternion and world matrix, then the rotation matrix from the
+// same angles again
+static void RefObjectTransforms(const XrVector3f& angles, float scale, const XrVector3f& position, ref_mat_t& world, ref_mat_t& rotation) {
+	XrQuaternionf q = XrMathQuatFromEuler(angles.x, angles.y, angles.z);
+	world = RefTranspose(RefAffineTransformation(scale, q, position));
+
+	XrQuaternionf q_again = XrMathQuatFromEuler(angles.x, angles.y, angles.z);
+	rotation = RefRotationQuaternion(q_again);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------------------------------
+static float MaxDifference(const ref_mat_t& a, const xr_mat4_t& b) {
+	float difference = 0.0f;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			difference = std::max(difference, fabsf(a.m[i][j] - b.m[i][j]));
+		}
+	}
+	return difference;
+}
+
+static std::vector<XrPosef> RandomPoses(size_t count) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+	std::vector<XrPosef> poses(count);
+	for (XrPosef& pose : poses) {
+		XrQuaternionf q = { distribution(rng), distribution(rng), distribution(rng), distribution(rng) };
+		float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+		pose.orientation = { q.x / length, q.y / length, q.z / length, q.w / length };
+		pose.position = { distribution(rng), 1.6f + 0.1f * distribution(rng), distribution(rng) };
+	}
+	return poses;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Benchmarks
+//------------------------------------------------------------------------------------------------------
+XR_BENCH(math_view_projection) {
+	const size_t pose_count = 1024;
+	const int rounds = context.quick ? 20 : 500;
+	const float near_z = 0.05f;
+	const float far_z = 100.0f;
+
+	std::vector<XrPosef> poses = RandomPoses(pose_count);
+	const XrFovf fovs[2] = { { -0.82f, 0.75f, 0.80f, -0.86f }, { -0.75f, 0.82f, 0.80f, -0.86f } };
+
+	// Reference path
+	float checksum = 0.0f;
+	int64_t start = CoreTimeNowNs();
+	for (int round = 0; round < rounds; round++) {
+		for (size_t i = 0; i < pose_count; i++) {
+			ref_mat_t result = RefViewProjection(poses[i], fovs[i % 2], near_z, far_z);
+			checksum += result.m[0][0];
+		}
+	}
+	int64_t reference_ns = CoreTimeNowNs() - start;
+
+	// New path, with the projections cached like in the application
+	static xr_projection_cache_t cache;
+	start = CoreTimeNowNs();
+	for (int round = 0; round < rounds; round++) {
+		for (size_t i = 0; i < pose_count; i++) {
+			const xr_mat4_t& projection = XrMathProjectionCached(cache, fovs[i % 2], near_z, far_z);
+			xr_mat4_t result = XrMathViewProjectionTransposed(poses[i], projection);
+			checksum += result.m[0][0];
+		}
+	}
+	int64_t xr_math_ns = CoreTimeNowNs() - start;
+	BenchKeep(checksum);
+
+	float max_difference = 0.0f;
+	for (size_t i = 0; i < pose_count; i++) {
+		ref_mat_t expected = RefViewProjection(poses[i], fovs[i % 2], near_z, far_z);
+		xr_mat4_t actual = XrMathViewProjectionTransposed(poses[i], XrMathProjectionFov(fovs[i % 2], near_z, far_z));
+		max_difference = std::max(max_difference, MaxDifference(expected, actual));
+	}
+
+	double calls = (double)rounds * pose_count;
+	BenchReport(context, "reference", (double)reference_ns / calls, "ns/view");
+	BenchReport(context, "xr_math", (double)xr_math_ns / calls, "ns/view");
+	BenchReport(context, "speedup", (double)reference_ns / (double)xr_math_ns, "x");
+	BenchReport(context, "max_difference", max_difference, "");
+	BenchCheck(context, "max_difference", max_difference <= 1e-4f);
+}
+
+XR_BENCH(math_object_transform) {
+	const size_t object_count = 1024;
+	const int rounds = context.quick ? 20 : 500;
+	const XrVector3f position = { 0.0f, 0.0f, 0.0f };
+
+	std::vector<XrVector3f> angles(object_count);
+	for (size_t i = 0; i < object_count; i++) {
+		angles[i] = { 0.02f * i, 0.04f * i, 0.0f };
+	}
+
+	float checksum = 0.0f;
+	int64_t start = CoreTimeNowNs();
+	for (int round = 0; round < rounds; round++) {
+		for (size_t i = 0; i < object_count; i++) {
+			ref_mat_t world, rotation;
+			RefObjectTransforms(angles[i], 0.1f, position, world, rotation);
+			checksum += world.m[0][0] + rotation.m[1][1];
+		}
+	}
+	int64_t reference_ns = CoreTimeNowNs() - start;
+
+	start = CoreTimeNowNs();
+	for (int round = 0; round < rounds; round++) {
+		for (size_t i = 0; i < object_count; i++) {
+			XrQuaternionf q = XrMathQuatFromEuler(angles[i].x, angles[i].y, angles[i].z);
+			xr_mat4_t rotation = XrMathQuatToMatrix(q);
+			xr_mat4_t world = XrMathTranspose(XrMathAffine(0.1f, q, position));
+			checksum += world.m[0][0] + rotation.m[1][1];
+		}
+	}
+	int64_t xr_math_ns = CoreTimeNowNs() - start;
+	BenchKeep(checksum);
+
+	float max_difference = 0.0f;
+	for (size_t i = 0; i < object_count; i++) {
+		ref_mat_t world, rotation;
+		RefObjectTransforms(angles[i], 0.1f, position, world, rotation);
+		XrQuaternionf q = XrMathQuatFromEuler(angles[i].x, angles[i].y, angles[i].z);
+		max_difference = std::max(max_difference, MaxDifference(world, XrMathTranspose(XrMathAffine(0.1f, q, position))));
+		max_difference = std::max(max_difference, MaxDifference(rotation, XrMathQuatToMatrix(q)));
+	}
+
+	double calls = (double)rounds * object_count;
+	BenchReport(context, "reference", (double)reference_ns / calls, "ns/object");
+	BenchReport(context, "xr_math", (double)xr_math_ns / calls, "ns/object");
+	BenchReport(context, "speedup", (double)reference_ns / (double)xr_math_ns, "x");
+	BenchReport(context, "max_difference", max_difference, "");
+	BenchCheck(context, "max_difference", max_difference <= 1e-5f);
+}
+
+XR_BENCH(math_transform_points) {
+	const size_t point_count = 65536;
+	const int rounds = context.quick ? 5 : 100;
+
+	std::vector<XrPosef> poses = RandomPoses(1);
+	xr_mat4_t matrix = XrMathPoseToMatrix(poses[0]);
+	ref_mat_t reference_matrix;
+	memcpy(&reference_matrix, &matrix, sizeof(reference_matrix));
+
+	std::vector<XrVector3f> points(point_count);
+	for (size_t i = 0; i < point_count; i++) {
+		points[i] = { (float)(i % 64), (float)(i / 64 % 64), (float)(i / 4096) };
+	}
+	std::vector<float> reference_out(point_count * 4);
+	std::vector<float> xr_math_out(point_count * 4);
+
+	// Reference: a 4x4 matrix times each point, component by component
+	int64_t start = CoreTimeNowNs();
+	for (int round = 0; round < rounds; round++) {
+		for (size_t i = 0; i < point_count; i++) {
+			float in[4] = { points[i].x, points[i].y, points[i].z, 1.0f };
+			for (int j = 0; j < 4; j++) {
+				reference_out[i * 4 + j] = in[0] * reference_matrix.m[0][j] + in[1] * reference_matrix.m[1][j] + in[2] * reference_matrix.m[2][j] + in[3] * reference_matrix.m[3][j];
+			}
+		}
+		BenchKeep(reference_out[round]);
+	}
+	int64_t reference_ns = CoreTimeNowNs() - start;
+
+	start = CoreTimeNowNs();
+	for (int round = 0; round < rounds; round++) {
+		XrMathTransformPoints(matrix, points.data(), xr_math_out.data(), point_count);
+		BenchKeep(xr_math_out[round]);
+	}
+	int64_t xr_math_ns = CoreTimeNowNs() - start;
+
+	float max_difference = 0.0f;
+	for (size_t i = 0; i < point_count * 4; i++) {
+		max_difference = std::max(max_difference, fabsf(reference_out[i] - xr_math_out[i]));
+	}
+
+	double points_done = (double)rounds * point_count;
+	BenchReport(context, "reference", (double)reference_ns / points_done, "ns/point");
+	BenchReport(context, "xr_math", (double)xr_math_ns / points_done, "ns/point");
+	BenchReport(context, "speedup", (double)reference_ns / (double)xr_math_ns, "x");
+	BenchReport(context, "max_difference", max_difference, "");
+
+	// The points are up to 64 away from the origin
+	BenchCheck(context, "max_difference", max_difference <= 1e-4f);
+}
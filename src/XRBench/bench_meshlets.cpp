@@ -0,0 +1,262 @@
+//###################################################################################################################
+// Meshlet benchmark
+//###################################################################################################################
+// Splits three meshes into meshlets (see meshlet.h): the cube of the application (12 triangles), a box with finely
+// tessellated sides and a sphere, with up to 64 and 128 triangles per meshlet. Scatters 200 instances of each
+// (100 with --quick) in front of a pair of eyes that look left and right, and culls the meshlets for both eyes
+// every frame. Compares the triangles and the index bytes of the compacted stream to drawing the whole meshes,
+// and to the triangles that actually face one of the eyes and are in its frustum, which no culling of whole
+// meshlets can beat. A meshlet must never be culled if one of its triangles is visible, which the missed
+// triangles check.
+#include "bench.h"
+#include "core_time.h"
+#include "meshlet.h"
+#include "view_layout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct meshlet_bench_mesh_t {
+	const char* name;
+	std::vector<XrVector3f> positions;
+	std::vector<uint16_t> indices;
+};
+
+static float MeshletBenchRandom(uint32_t& state) {
+	state = state * 1664525u + 1013904223u;
+	return (float)(state >> 8) / (float)(1 << 24);
+}
+
+static XrVector3f MeshletBenchNormal(const XrVector3f* positions, const uint16_t* triangle) {
+	const XrVector3f& p0 = positions[triangle[0]];
+	const XrVector3f& p1 = positions[triangle[1]];
+	const XrVector3f& p2 = positions[triangle[2]];
+	XrVector3f a = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+	XrVector3f b = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+// Adds a quad as two triangles, turned such that they face away from the origin (all meshes here are convex and
+// around the origin). Quads that collapsed to a line or a point at the poles of the sphere are left out
+static void MeshletBenchQuad(meshlet_bench_mesh_t& mesh, uint16_t a, uint16_t b, uint16_t c, uint16_t d) {
+	const uint16_t triangles[2][3] = { { a, b, c }, { c, b, d } };
+	for (const uint16_t* triangle : triangles) {
+		uint16_t corners[3] = { triangle[0], triangle[1], triangle[2] };
+		XrVector3f normal = MeshletBenchNormal(mesh.positions.data(), corners);
+		if (normal.x * normal.x + normal.y * normal.y + normal.z * normal.z < 1e-12f) {
+			continue;
+		}
+		const XrVector3f& p = mesh.positions[corners[0]];
+		if (normal.x * p.x + normal.y * p.y + normal.z * p.z < 0.0f) {
+			std::swap(corners[1], corners[2]);
+		}
+		mesh.indices.insert(mesh.indices.end(), corners, corners + 3);
+	}
+}
+
+// A cube from -1 to 1, with segments * segments quads on each side
+static meshlet_bench_mesh_t MeshletBenchBox(uint32_t segments) {
+	meshlet_bench_mesh_t mesh;
+	mesh.name = "box";
+	for (int axis = 0; axis < 3; axis++) {
+		for (float side : { -1.0f, 1.0f }) {
+			uint16_t first = (uint16_t)mesh.positions.size();
+			for (uint32_t j = 0; j <= segments; j++) {
+				for (uint32_t i = 0; i <= segments; i++) {
+					float u = -1.0f + 2.0f * (float)i / (float)segments;
+					float v = -1.0f + 2.0f * (float)j / (float)segments;
+					float p[3];
+					p[axis] = side;
+					p[(axis + 1) % 3] = u;
+					p[(axis + 2) % 3] = v;
+					mesh.positions.push_back({ p[0], p[1], p[2] });
+				}
+			}
+			for (uint32_t j = 0; j < segments; j++) {
+				for (uint32_t i = 0; i < segments; i++) {
+					uint16_t corner = (uint16_t)(first + j * (segments + 1) + i);
+					MeshletBenchQuad(mesh, corner, (uint16_t)(corner + 1), (uint16_t)(corner + segments + 1), (uint16_t)(corner + segments + 2));
+				}
+			}
+		}
+	}
+	return mesh;
+}
+
+static meshlet_bench_mesh_t MeshletBenchSphere(uint32_t rings, uint32_t sectors) {
+	meshlet_bench_mesh_t mesh;
+	mesh.name = "sphere";
+	const float pi = 3.14159265f;
+	for (uint32_t ring = 0; ring <= rings; ring++) {
+		float theta = pi * (float)ring / (float)rings;
+		for (uint32_t sector = 0; sector <= sectors; sector++) {
+			float phi = 2.0f * pi * (float)sector / (float)sectors;
+			mesh.positions.push_back({ sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) });
+		}
+	}
+	for (uint32_t ring = 0; ring < rings; ring++) {
+		for (uint32_t sector = 0; sector < sectors; sector++) {
+			uint16_t corner = (uint16_t)(ring * (sectors + 1) + sector);
+			MeshletBenchQuad(mesh, corner, (uint16_t)(corner + 1), (uint16_t)(corner + sectors + 1), (uint16_t)(corner + sectors + 2));
+		}
+	}
+	return mesh;
+}
+
+// The cube mesh of the application, with the same indices
+static meshlet_bench_mesh_t MeshletBenchCube() {
+	meshlet_bench_mesh_t mesh;
+	mesh.name = "cube";
+	const float corners[24][3] = {
+		{ -1, -1, 1 }, { 1, -1, 1 }, { -1, 1, 1 }, { 1, 1, 1 },
+		{ -1, -1, -1 }, { -1, 1, -1 }, { 1, -1, -1 }, { 1, 1, -1 },
+		{ -1, 1, -1 }, { -1, 1, 1 }, { 1, 1, -1 }, { 1, 1, 1 },
+		{ -1, -1, -1 }, { 1, -1, -1 }, { -1, -1, 1 }, { 1, -1, 1 },
+		{ 1, -1, -1 }, { 1, 1, -1 }, { 1, -1, 1 }, { 1, 1, 1 },
+		{ -1, -1, -1 }, { -1, -1, 1 }, { -1, 1, -1 }, { -1, 1, 1 },
+	};
+	for (const float* corner : corners) {
+		mesh.positions.push_back({ corner[0], corner[1], corner[2] });
+	}
+	for (uint16_t side = 0; side < 6; side++) {
+		uint16_t first = side * 4;
+		const uint16_t side_indices[6] = { (uint16_t)(first + 2), (uint16_t)(first + 1), first, (uint16_t)(first + 3), (uint16_t)(first + 1), (uint16_t)(first + 2) };
+		mesh.indices.insert(mesh.indices.end(), side_indices, side_indices + 6);
+	}
+	return mesh;
+}
+
+// A triangle is visible from an eye if it faces the eye and not all of its corners are outside of the same plane
+static bool MeshletBenchTriangleVisible(const XrVector3f* corners, const XrVector3f& eye, const view_frustum_t& frustum) {
+	const uint16_t triangle[3] = { 0, 1, 2 };
+	XrVector3f normal = MeshletBenchNormal(corners, triangle);
+	XrVector3f to_triangle = { corners[0].x - eye.x, corners[0].y - eye.y, corners[0].z - eye.z };
+	if (normal.x * to_triangle.x + normal.y * to_triangle.y + normal.z * to_triangle.z >= 0.0f) {
+		return false;
+	}
+	for (const XrVector4f& plane : frustum.planes) {
+		bool outside = true;
+		for (int i = 0; i < 3 && outside; i++) {
+			outside = plane.x * corners[i].x + plane.y * corners[i].y + plane.z * corners[i].z + plane.w < 0.0f;
+		}
+		if (outside) {
+			return false;
+		}
+	}
+	return true;
+}
+
+XR_BENCH(meshlets) {
+	const uint32_t instance_count = context.quick ? 100 : 200;
+	const uint32_t frame_count = context.quick ? 8 : 30;
+	const uint32_t max_triangle_counts[] = { 64, 128 };
+	const XrFovf fov = { -0.8f, 0.8f, 0.75f, -0.75f };
+
+	meshlet_bench_mesh_t meshes[] = { MeshletBenchCube(), MeshletBenchBox(24), MeshletBenchSphere(48, 96) };
+
+	// Boxes from 0.2m to 1m in size, turned every way, in front of the eyes and to the sides
+	std::vector<xr_mat4_t> worlds(instance_count);
+	uint32_t random = 7;
+	for (xr_mat4_t& world : worlds) {
+		XrVector3f position = { (MeshletBenchRandom(random) * 2.0f - 1.0f) * 8.0f, (MeshletBenchRandom(random) * 2.0f - 1.0f) * 2.0f, -1.0f - MeshletBenchRandom(random) * 10.0f };
+		XrVector3f scale = { 0.1f + 0.4f * MeshletBenchRandom(random), 0.1f + 0.4f * MeshletBenchRandom(random), 0.1f + 0.4f * MeshletBenchRandom(random) };
+		XrQuaternionf orientation = XrMathQuatFromEuler(MeshletBenchRandom(random) * 6.28f, MeshletBenchRandom(random) * 6.28f, MeshletBenchRandom(random) * 6.28f);
+		world = XrMathAffine(scale, orientation, position);
+	}
+
+	for (const meshlet_bench_mesh_t& mesh : meshes) {
+		uint32_t triangle_count = (uint32_t)mesh.indices.size() / 3;
+		BenchReport(context, std::string(mesh.name) + "_triangles", (double)triangle_count, "");
+
+		for (uint32_t max_triangles : max_triangle_counts) {
+			// The cube is always a single meshlet per side, the limit doesn't change anything
+			if (triangle_count <= 64 && max_triangles != max_triangle_counts[0]) {
+				continue;
+			}
+			std::string prefix = std::string(mesh.name) + "_" + std::to_string(max_triangles) + "_";
+
+			int64_t start = CoreTimeNowNs();
+			meshlet_mesh_t meshlets;
+			MeshletBuild(meshlets, mesh.positions.data(), (uint32_t)mesh.positions.size(), mesh.indices.data(), (uint32_t)mesh.indices.size(), max_triangles);
+			int64_t build_ns = CoreTimeNowNs() - start;
+
+			meshlet_cull_stats_t stats = {};
+			std::vector<uint16_t> stream;
+			std::vector<uint32_t> stream_counts(instance_count);
+			int64_t cull_ns = 0;
+			uint64_t visible_triangles = 0;
+			uint64_t missed_triangles = 0;
+			for (uint32_t frame = 0; frame < frame_count; frame++) {
+				// The head looks left and right, the eyes are 64mm apart
+				XrQuaternionf orientation = XrMathQuatFromEuler(0.0f, 0.7f * sinf(0.1f * (float)frame), 0.0f);
+				xr_mat4_t rotation = XrMathQuatToMatrix(orientation);
+				XrVector3f eyes[2];
+				view_frustum_t frustums[2];
+				for (int eye = 0; eye < 2; eye++) {
+					float offset = eye == 0 ? -0.032f : 0.032f;
+					eyes[eye] = { rotation.m[0][0] * offset, rotation.m[0][1] * offset, rotation.m[0][2] * offset };
+					frustums[eye] = ViewFrustum({ orientation, eyes[eye] }, fov, 0.05f, 100.0f, 0.0f);
+				}
+
+				stream.clear();
+				start = CoreTimeNowNs();
+				for (uint32_t instance = 0; instance < instance_count; instance++) {
+					stream_counts[instance] = MeshletCull(meshlets, worlds[instance], eyes, frustums, 2, stream, stats);
+				}
+				cull_ns += CoreTimeNowNs() - start;
+
+				// Find the meshlets of each instance in the stream. They're in the order of the mesh, so a meshlet
+				// was drawn if the stream goes on with its indices
+				const uint16_t* drawn = stream.data();
+				for (uint32_t instance = 0; instance < instance_count; instance++) {
+					const uint16_t* drawn_end = drawn + stream_counts[instance];
+					for (const meshlet_t& meshlet : meshlets.meshlets) {
+						uint32_t count = meshlet.triangle_count * 3;
+						const uint16_t* indices = meshlets.indices.data() + meshlet.first_index;
+						bool was_drawn = drawn + count <= drawn_end && memcmp(drawn, indices, count * sizeof(uint16_t)) == 0;
+						if (was_drawn) {
+							drawn += count;
+						}
+
+						// Every triangle of the meshlet, drawn or not, in world space
+						for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+							XrVector3f triangle[3];
+							for (int corner = 0; corner < 3; corner++) {
+								uint16_t vertex = indices[t * 3 + corner];
+								const XrVector3f& p = mesh.positions[vertex];
+								const xr_mat4_t& m = worlds[instance];
+								triangle[corner] = {
+									p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+									p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+									p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2],
+								};
+							}
+							bool visible = MeshletBenchTriangleVisible(triangle, eyes[0], frustums[0]) || MeshletBenchTriangleVisible(triangle, eyes[1], frustums[1]);
+							visible_triangles += visible ? 1 : 0;
+							missed_triangles += visible && !was_drawn ? 1 : 0;
+						}
+					}
+					drawn = drawn_end;
+				}
+			}
+
+			double total_triangles = (double)triangle_count * instance_count * frame_count;
+			double full_kb = (double)triangle_count * 3 * sizeof(uint16_t) * instance_count / 1024.0;
+			double stream_kb = (double)stats.drawn_triangles * 3 * sizeof(uint16_t) / frame_count / 1024.0;
+			BenchReport(context, prefix + "meshlets", (double)meshlets.meshlets.size(), "");
+			BenchReport(context, prefix + "triangles_per_meshlet", (double)triangle_count / (double)meshlets.meshlets.size(), "");
+			BenchReport(context, prefix + "build_cpu", CoreNsToMs(build_ns), "ms");
+			BenchReport(context, prefix + "culled_backface", (double)stats.culled_backface / (double)stats.meshlets * 100.0, "%");
+			BenchReport(context, prefix + "culled_frustum", (double)stats.culled_frustum / (double)stats.meshlets * 100.0, "%");
+			BenchReport(context, prefix + "drawn_triangles", (double)stats.drawn_triangles / total_triangles * 100.0, "%");
+			BenchReport(context, prefix + "visible_triangles", (double)visible_triangles / total_triangles * 100.0, "%");
+			BenchReport(context, prefix + "index_kb_full", full_kb, "KB");
+			BenchReport(context, prefix + "index_kb_culled", stream_kb, "KB");
+			BenchReport(context, prefix + "cull_cpu", CoreNsToMs(cull_ns) / frame_count, "ms");
+			BenchReport(context, prefix + "missed_triangles", (double)missed_triangles, "");
+		}
+	}
+}
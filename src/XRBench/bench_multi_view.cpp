@@ -0,0 +1,104 @@
+//###################################################################################################################
+// Multi-view benchmark
+//###################################################################################################################
+// Renders the scene of the application for the stand-in runtime with 1, 2 and 4 views (the last like a quad view
+// headset, with two narrow inner views of a higher pixel density, see view_layout.h). Compares two ways of doing
+// the CPU work of the views: every view on its own (culled and traversed like a separate render), and the way
+// the application does it, with one culling and one draw list for all views that is then split by the frustum
+// of each view. The draw calls are what the render thread would submit. For the GPU side, reports the pixels
+// the views have with the recommended resolution and with the foveated policy, and how many swapchains the views
+// need with and without packing them into texture arrays (each swapchain costs an acquire, wait and release per
+// frame).
+#include "bench.h"
+#include "core_time.h"
+#include "simulation.h"
+#include "standin_runtime.h"
+#include "view_layout.h"
+
+#include <string>
+#include <vector>
+
+static const uint32_t multi_view_max_views = 4;
+static const float multi_view_near = 0.05f;
+static const float multi_view_far = 100.0f;
+
+XR_BENCH(multi_view) {
+	const uint32_t frame_count = context.quick ? 30 : 600;
+	const uint32_t view_counts[] = { 1, 2, 4 };
+
+	for (uint32_t view_count : view_counts) {
+		standin_runtime_config_t config;
+		config.view_count = view_count;
+		config.locate_cost_ns = 0;
+		standin_runtime_t runtime;
+		StandinInit(runtime, config);
+		std::string prefix = std::to_string(view_count) + "_views_";
+
+		//------------------------------------------------------------------------------------------------------
+		// Resolution and swapchains
+		//------------------------------------------------------------------------------------------------------
+		view_config_t configs[multi_view_max_views];
+		uint32_t config_count = StandinViewConfigurations(runtime, configs, multi_view_max_views);
+		view_layout_t recommended;
+		view_layout_t foveated;
+		ViewLayoutBuild(configs, config_count, view_resolution_recommended, 1.0f, false, recommended);
+		ViewLayoutBuild(configs, config_count, view_resolution_foveated, 0.6f, true, foveated);
+		BenchReport(context, prefix + "swapchains_unpacked", (double)recommended.swapchains.size(), "");
+		BenchReport(context, prefix + "swapchains_packed", (double)foveated.swapchains.size(), "");
+		BenchReport(context, prefix + "mpixels_recommended", (double)recommended.pixels / 1e6, "");
+		BenchReport(context, prefix + "mpixels_foveated", (double)foveated.pixels / 1e6, "");
+
+		//------------------------------------------------------------------------------------------------------
+		// CPU work of the views
+		//------------------------------------------------------------------------------------------------------
+		static simulation_t simulation;
+		static occlusion_buffer_t occlusion_buffer;
+		SimulationInit(simulation);
+		OcclusionInit(occlusion_buffer, 256, 128);
+
+		std::vector<uint32_t> draw_list;
+		std::vector<uint32_t> view_lists[multi_view_max_views];
+		int64_t independent_ns = 0;
+		int64_t shared_ns = 0;
+		uint64_t independent_draws = 0;
+		uint64_t shared_draws = 0;
+		for (uint32_t frame = 0; frame < frame_count; frame++) {
+			XrTime display_time = (XrTime)frame * config.display_period;
+			XrPosef poses[multi_view_max_views];
+			XrFovf fovs[multi_view_max_views];
+			uint32_t located = StandinLocateViews(runtime, display_time, poses, fovs, multi_view_max_views);
+			SimulationUpdate(simulation, nullptr);
+
+			// Every view on its own
+			int64_t start = CoreTimeNowNs();
+			for (uint32_t view = 0; view < located; view++) {
+				SimulationCull(simulation, occlusion_buffer, &poses[view], &fovs[view], 1, multi_view_near, multi_view_far);
+				SceneBuildDrawList(simulation.scene, draw_list);
+				independent_draws += draw_list.size();
+			}
+			int64_t independent_done = CoreTimeNowNs();
+
+			// One culling and one draw list for all views, split by the frusta
+			SimulationCull(simulation, occlusion_buffer, poses, fovs, located, multi_view_near, multi_view_far);
+			SceneBuildDrawList(simulation.scene, draw_list);
+			view_frustum_t frustums[multi_view_max_views];
+			for (uint32_t view = 0; view < located; view++) {
+				frustums[view] = ViewFrustum(poses[view], fovs[view], multi_view_near, multi_view_far, simulation_cull_margin);
+			}
+			ViewSplitDrawList(simulation.scene, draw_list, frustums, located, view_lists);
+			int64_t shared_done = CoreTimeNowNs();
+			for (uint32_t view = 0; view < located; view++) {
+				shared_draws += view_lists[view].size();
+			}
+
+			independent_ns += independent_done - start;
+			shared_ns += shared_done - independent_done;
+		}
+
+		BenchReport(context, prefix + "independent_cpu", (double)independent_ns / frame_count / 1000.0, "us");
+		BenchReport(context, prefix + "shared_cpu", (double)shared_ns / frame_count / 1000.0, "us");
+		BenchReport(context, prefix + "shared_cpu_per_view", (double)shared_ns / frame_count / 1000.0 / view_count, "us");
+		BenchReport(context, prefix + "independent_draws", (double)independent_draws / frame_count, "");
+		BenchReport(context, prefix + "shared_draws", (double)shared_draws / frame_count, "");
+	}
+}
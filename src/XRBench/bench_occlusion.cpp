@@ -0,0 +1,263 @@
+//###################################################################################################################
+// Occlusion culling harness
+//###################################################################################################################
+// Walks a stereo camera through a synthetic city (see SceneAddCityBlocks) and runs the occlusion culling every
+// frame, once with the combined view for both eyes and once separately for each eye. The result is compared
+// against a reference visibility, which rasterizes every object into a full resolution depth and id buffer
+// for each eye. An object that is visible in the reference but got culled is a false cull.
+#include "bench.h"
+#include "core_time.h"
+#include "occlusion.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const int32_t reference_resolution = 512;
+static const float harness_near_z = 0.05f;
+static const float harness_far_z = 400.0f;
+
+struct stereo_frame_t {
+	XrPosef poses[2];
+	XrFovf fovs[2];
+};
+
+// A head at standing height, walking down the street along the z axis and looking around
+static stereo_frame_t HarnessFrame(int frame, int frame_count) {
+	float t = (float)frame / (float)frame_count;
+	float yaw = sinf(t * 12.0f) * 1.2f;
+	XrQuaternionf orientation = { 0.0f, sinf(yaw * 0.5f), 0.0f, cosf(yaw * 0.5f) };
+	xr_mat4_t rotation = XrMathQuatToMatrix(orientation);
+
+	XrVector3f head = { 1.5f * sinf(t * 5.0f), 0.0f, 60.0f - 160.0f * t };
+	stereo_frame_t result;
+	for (int eye = 0; eye < 2; eye++) {
+		float offset = eye == 0 ? -0.032f : 0.032f;
+		result.poses[eye].orientation = orientation;
+		result.poses[eye].position = { head.x + rotation.m[0][0] * offset, head.y + rotation.m[0][1] * offset, head.z + rotation.m[0][2] * offset };
+	}
+
+	// Typical fovs of a headset, where each eye sees a bit more towards its own side
+	result.fovs[0] = { -0.90f, 0.75f, 0.85f, -0.90f };
+	result.fovs[1] = { -0.75f, 0.90f, 0.85f, -0.90f };
+	return result;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Reference visibility
+//------------------------------------------------------------------------------------------------------
+// Depth and id buffer of one eye at full resolution
+struct reference_target_t {
+	std::vector<float> depth;
+	std::vector<int32_t> ids;
+};
+
+static void ReferenceTriangle(reference_target_t& target, int32_t object, const float* a, const float* b, const float* c) {
+	const int32_t size = reference_resolution;
+	const float* clip[3] = { a, b, c };
+	float sx[3], sy[3], sz[3];
+	for (int corner = 0; corner < 3; corner++) {
+		sx[corner] = (clip[corner][0] / clip[corner][3] * 0.5f + 0.5f) * (float)size;
+		sy[corner] = (0.5f - clip[corner][1] / clip[corner][3] * 0.5f) * (float)size;
+		sz[corner] = clip[corner][2] / clip[corner][3];
+	}
+
+	float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+	if (fabsf(area) < 1e-9f) {
+		return;
+	}
+
+	int32_t min_x = std::max(0, (int32_t)floorf(std::min(sx[0], std::min(sx[1], sx[2]))));
+	int32_t max_x = std::min(size - 1, (int32_t)floorf(std::max(sx[0], std::max(sx[1], sx[2]))));
+	int32_t min_y = std::max(0, (int32_t)floorf(std::min(sy[0], std::min(sy[1], sy[2]))));
+	int32_t max_y = std::min(size - 1, (int32_t)floorf(std::max(sy[0], std::max(sy[1], sy[2]))));
+	for (int32_t y = min_y; y <= max_y; y++) {
+		for (int32_t x = min_x; x <= max_x; x++) {
+			float px = (float)x + 0.5f;
+			float py = (float)y + 0.5f;
+			float w0 = ((sx[2] - sx[1]) * (py - sy[1]) - (sy[2] - sy[1]) * (px - sx[1])) / area;
+			float w1 = ((sx[0] - sx[2]) * (py - sy[2]) - (sy[0] - sy[2]) * (px - sx[2])) / area;
+			float w2 = 1.0f - w0 - w1;
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+				continue;
+			}
+			float z = w0 * sz[0] + w1 * sz[1] + w2 * sz[2];
+			size_t index = (size_t)y * size + x;
+			if (z < target.depth[index]) {
+				target.depth[index] = z;
+				target.ids[index] = object;
+			}
+		}
+	}
+}
+
+// Rasterizes all objects (not just the occluders) for one eye, with proper clipping at the near plane,
+// and marks the objects that ended up with at least one pixel
+static void ReferenceRasterize(const scene_t& scene, const xr_mat4_t& view_projection, std::vector<bool>& visible) {
+	static const XrVector3f corners[8] = {
+		{ -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f },
+		{ -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f },
+	};
+	static const int triangles[12][3] = {
+		{ 0, 2, 1 }, { 1, 2, 3 }, { 4, 5, 6 }, { 5, 7, 6 }, { 0, 4, 2 }, { 2, 4, 6 },
+		{ 1, 3, 5 }, { 3, 7, 5 }, { 0, 1, 4 }, { 1, 5, 4 }, { 2, 6, 3 }, { 3, 6, 7 },
+	};
+
+	reference_target_t target;
+	target.depth.assign((size_t)reference_resolution * reference_resolution, 1.0f);
+	target.ids.assign((size_t)reference_resolution * reference_resolution, -1);
+
+	for (uint32_t object = 0; object < (uint32_t)scene.objects.size(); object++) {
+		xr_mat4_t to_clip = XrMathMultiply(SceneObjectMatrix(scene.objects[object]), view_projection);
+		float clip[8 * 4];
+		XrMathTransformPoints(to_clip, corners, clip, 8);
+
+		for (int triangle = 0; triangle < 12; triangle++) {
+			// Clip the triangle at the near plane (z >= 0 in clip space), which gives a polygon with
+			// up to four corners
+			float polygon[4][4];
+			int polygon_size = 0;
+			for (int corner = 0; corner < 3; corner++) {
+				const float* current = clip + triangles[triangle][corner] * 4;
+				const float* next = clip + triangles[triangle][(corner + 1) % 3] * 4;
+				if (current[2] >= 0.0f) {
+					memcpy(polygon[polygon_size++], current, sizeof(float) * 4);
+				}
+				if ((current[2] >= 0.0f) != (next[2] >= 0.0f)) {
+					float t = current[2] / (current[2] - next[2]);
+					for (int i = 0; i < 4; i++) {
+						polygon[polygon_size][i] = current[i] + (next[i] - current[i]) * t;
+					}
+					polygon_size++;
+				}
+			}
+
+			for (int i = 2; i < polygon_size; i++) {
+				ReferenceTriangle(target, (int32_t)object, polygon[0], polygon[i - 1], polygon[i]);
+			}
+		}
+	}
+
+	for (int32_t id : target.ids) {
+		if (id >= 0) {
+			visible[id] = true;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// Culling
+//------------------------------------------------------------------------------------------------------
+struct cull_timing_t {
+	int64_t rasterize_ns;
+	int64_t pyramid_ns;
+	int64_t test_ns;
+};
+
+// Runs the culling for one view and marks every object that might be visible
+static void CullForView(occlusion_buffer_t& buffer, const scene_t& scene, const xr_mat4_t& view_projection, std::vector<bool>& visible, cull_timing_t& timing) {
+	int64_t start = CoreTimeNowNs();
+	OcclusionClear(buffer);
+	for (const scene_object_t& object : scene.objects) {
+		if (object.occluder) {
+			OcclusionRasterizeBox(buffer, XrMathMultiply(SceneObjectMatrix(object), view_projection));
+		}
+	}
+	int64_t rasterized = CoreTimeNowNs();
+	OcclusionBuildPyramid(buffer);
+	int64_t pyramid_built = CoreTimeNowNs();
+	for (uint32_t i = 0; i < (uint32_t)scene.objects.size(); i++) {
+		if (OcclusionTestBox(buffer, XrMathMultiply(SceneObjectMatrix(scene.objects[i]), view_projection))) {
+			visible[i] = true;
+		}
+	}
+	int64_t tested = CoreTimeNowNs();
+
+	timing.rasterize_ns += rasterized - start;
+	timing.pyramid_ns += pyramid_built - rasterized;
+	timing.test_ns += tested - pyramid_built;
+}
+
+XR_BENCH(occlusion_city_blocks) {
+	int frame_count = context.quick ? 8 : 64;
+
+	scene_t scene;
+	SceneAddCityBlocks(scene, 16, 16, -1.6f, 1234);
+	size_t object_count = scene.objects.size();
+
+	occlusion_buffer_t combined_buffer;
+	OcclusionInit(combined_buffer, 256, 128);
+	occlusion_buffer_t eye_buffer;
+	OcclusionInit(eye_buffer, 128, 128);
+
+	const char* modes[] = { "combined", "per_eye" };
+	cull_timing_t timings[2] = {};
+	uint64_t kept[2] = {};
+	uint64_t false_culls[2] = {};
+	uint64_t reference_visible = 0;
+	uint64_t frustum_kept = 0; // Objects that a frustum culling alone would keep
+
+	for (int frame = 0; frame < frame_count; frame++) {
+		stereo_frame_t views = HarnessFrame(frame, frame_count);
+		xr_mat4_t eye_view_projections[2];
+		for (int eye = 0; eye < 2; eye++) {
+			eye_view_projections[eye] = XrMathMultiply(XrMathRigidInverse(views.poses[eye]), XrMathProjectionFov(views.fovs[eye], harness_near_z, harness_far_z));
+		}
+
+		std::vector<bool> reference(object_count, false);
+		ReferenceRasterize(scene, eye_view_projections[0], reference);
+		ReferenceRasterize(scene, eye_view_projections[1], reference);
+
+		for (int mode = 0; mode < 2; mode++) {
+			std::vector<bool> visible(object_count, false);
+			if (mode == 0) {
+				int64_t start = CoreTimeNowNs();
+				occlusion_view_t combined = OcclusionCombinedView(views.poses, views.fovs, 2, harness_near_z, harness_far_z);
+				timings[mode].rasterize_ns += CoreTimeNowNs() - start;
+				CullForView(combined_buffer, scene, combined.view_projection, visible, timings[mode]);
+
+				// Without any occluders, only the frustum test is left
+				OcclusionClear(combined_buffer);
+				OcclusionBuildPyramid(combined_buffer);
+				for (const scene_object_t& object : scene.objects) {
+					frustum_kept += OcclusionTestBox(combined_buffer, XrMathMultiply(SceneObjectMatrix(object), combined.view_projection)) ? 1 : 0;
+				}
+			}
+			else {
+				CullForView(eye_buffer, scene, eye_view_projections[0], visible, timings[mode]);
+				CullForView(eye_buffer, scene, eye_view_projections[1], visible, timings[mode]);
+			}
+
+			for (size_t i = 0; i < object_count; i++) {
+				kept[mode] += visible[i] ? 1 : 0;
+				false_culls[mode] += (reference[i] && !visible[i]) ? 1 : 0;
+			}
+		}
+
+		for (size_t i = 0; i < object_count; i++) {
+			reference_visible += reference[i] ? 1 : 0;
+		}
+	}
+
+	double frames = (double)frame_count;
+	BenchReport(context, "objects", (double)object_count, "");
+	BenchReport(context, "reference_visible", (double)reference_visible / frames, "objects/frame");
+	BenchReport(context, "frustum_only.kept", (double)frustum_kept / frames, "objects/frame");
+	for (int mode = 0; mode < 2; mode++) {
+		std::string prefix = modes[mode];
+		BenchReport(context, prefix + ".kept", (double)kept[mode] / frames, "objects/frame");
+		BenchReport(context, prefix + ".culled_fraction", 1.0 - (double)kept[mode] / (frames * (double)object_count), "");
+		BenchReport(context, prefix + ".false_culls", (double)false_culls[mode] / frames, "objects/frame");
+		BenchReport(context, prefix + ".false_cull_rate", (double)false_culls[mode] / (double)reference_visible, "");
+		BenchReport(context, prefix + ".rasterize", CoreNsToMs(timings[mode].rasterize_ns) / frames, "ms/frame");
+		BenchReport(context, prefix + ".pyramid", CoreNsToMs(timings[mode].pyramid_ns) / frames, "ms/frame");
+		BenchReport(context, prefix + ".test", CoreNsToMs(timings[mode].test_ns) / frames, "ms/frame");
+		BenchReport(context, prefix + ".total", CoreNsToMs(timings[mode].rasterize_ns + timings[mode].pyramid_ns + timings[mode].test_ns) / frames, "ms/frame");
+
+		// Culling an object that one of the eyes sees is a bug, not a trade off
+		BenchCheck(context, prefix + ".false_culls", false_culls[mode] == 0);
+	}
+}
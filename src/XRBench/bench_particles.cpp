@@ -0,0 +1,123 @@
+//###################################################################################################################
+// Particle benchmarks
+//###################################################################################################################
+// Keeps a particle system (see particles.h) at a steady number of particles, with emitters that emit as many
+// particles as die, and measures the update and writing the instances with more and more threads of the job
+// system. The throughput is reported per millisecond and per core, so it shows how well the update scales.
+// Every thread count starts from the same particles, and all of them have to end up with the same ones.
+#include "bench.h"
+#include "core_time.h"
+#include "job_system.h"
+#include "particles.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t particle_bench_emitters = 32;
+static const float particle_bench_lifetime = 2.0f;
+
+static uint64_t ParticleBenchHash(const particle_system_t& system) {
+	uint64_t hash = 14695981039346656037ull;
+	for (const std::vector<float>* values : { &system.position_x, &system.position_y, &system.position_z }) {
+		const uint8_t* bytes = (const uint8_t*)values->data();
+		for (size_t i = 0; i < system.count * sizeof(float); i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+	}
+	return hash;
+}
+
+// Emitters spread over a square of 100m, that together emit about as many particles per second as die
+static void ParticleBenchSystem(particle_system_t& system, uint32_t particle_count) {
+	ParticleSystemInit(system, particle_count + particle_count / 8, particle_bench_emitters, { 0.0f, -9.81f, 0.0f }, 0.2f, 0.0f, 0.4f);
+
+	// A particle lives 0.75 * lifetime on average
+	float rate = (float)particle_count / (particle_bench_emitters * 0.75f * particle_bench_lifetime);
+	for (uint32_t i = 0; i < particle_bench_emitters; i++) {
+		particle_emitter_t emitter = {};
+		emitter.position = { (float)(i % 8) * 12.5f - 50.0f, 2.0f, (float)(i / 8) * 25.0f - 50.0f };
+		emitter.position_spread = { 1.0f, 0.5f, 1.0f };
+		emitter.velocity = { 0.0f, 4.0f, 0.0f };
+		emitter.velocity_spread = { 3.0f, 2.0f, 3.0f };
+		emitter.rate = rate;
+		emitter.lifetime = particle_bench_lifetime;
+		emitter.size = 0.01f;
+		emitter.color = 0xFF40A0FFu;
+		emitter.active = true;
+		ParticleEmitterCreate(system, emitter, i);
+	}
+}
+
+XR_BENCH(particles) {
+	const uint32_t frame_count = context.quick ? 5 : 100;
+	std::vector<uint32_t> particle_counts = { 10000, 100000, 1000000 };
+	if (context.quick) {
+		particle_counts = { 10000, 100000 };
+	}
+
+	// 1, 2, 4, ... threads, up to the number of cores. At least up to 4 threads, such that even a small machine
+	// checks that the particles don't depend on the number of threads
+	uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t max_threads = std::max(cores, 4u);
+	std::vector<uint32_t> thread_counts;
+	for (uint32_t threads = 1; threads < max_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(max_threads);
+	BenchReport(context, "cores", (double)cores, "");
+
+	for (uint32_t particle_count : particle_counts) {
+		// Run until the first particles die, from then on the count stays about the same
+		particle_system_t warm;
+		ParticleBenchSystem(warm, particle_count);
+		job_system_t warm_jobs;
+		JobSystemInit(warm_jobs, JobSystemDefaultWorkers());
+		for (uint32_t frame = 0; frame < (uint32_t)(particle_bench_lifetime * 90.0f); frame++) {
+			ParticleSystemUpdate(warm, 1.0f / 90.0f, &warm_jobs);
+		}
+		JobSystemShutdown(warm_jobs);
+		BenchReport(context, std::to_string(particle_count) + "_live", (double)warm.count, "");
+
+		uint64_t first_hash = 0;
+		uint32_t mismatches = 0;
+		std::vector<particle_instance_t> instances(warm.capacity);
+		for (uint32_t threads : thread_counts) {
+			particle_system_t system = warm;
+			job_system_t jobs;
+			JobSystemInit(jobs, threads - 1);
+
+			int64_t update_ns = 0;
+			int64_t instances_ns = 0;
+			uint64_t updated = 0;
+			uint64_t died = 0;
+			for (uint32_t frame = 0; frame < frame_count; frame++) {
+				updated += system.count;
+				int64_t start = CoreTimeNowNs();
+				ParticleSystemUpdate(system, 1.0f / 90.0f, &jobs);
+				int64_t update_done = CoreTimeNowNs();
+				uint32_t written = ParticleWriteInstances(system, instances.data(), (uint32_t)instances.size(), &jobs);
+				instances_ns += CoreTimeNowNs() - update_done;
+				update_ns += update_done - start;
+				died += system.stats.died;
+				BenchKeep(instances[written / 2]);
+			}
+			JobSystemShutdown(jobs);
+
+			uint64_t hash = ParticleBenchHash(system);
+			first_hash = threads == thread_counts[0] ? hash : first_hash;
+			mismatches += hash != first_hash ? 1 : 0;
+
+			double update_ms = CoreNsToMs(update_ns);
+			double used_cores = (double)std::min(threads, cores);
+			std::string prefix = std::to_string(particle_count) + "_t" + std::to_string(threads) + "_";
+			BenchReport(context, prefix + "update", update_ms / frame_count, "ms");
+			BenchReport(context, prefix + "instances", CoreNsToMs(instances_ns) / frame_count, "ms");
+			BenchReport(context, prefix + "particles_per_ms", (double)updated / update_ms, "");
+			BenchReport(context, prefix + "particles_per_ms_per_core", (double)updated / update_ms / used_cores, "");
+			BenchReport(context, prefix + "died_per_frame", (double)died / frame_count, "");
+		}
+		BenchReport(context, std::to_string(particle_count) + "_thread_mismatches", (double)mismatches, "");
+	}
+}
@@ -0,0 +1,219 @@
+//###################################################################################################################
+// Pose cache benchmark
+//###################################################################################################################
+// Runs a frame loop against the stand-in runtime, in which several systems want poses every frame, each at its
+// own time (D is the predicted display time, P the display period):
+//
+// - rendering: the head and both hands at D
+// - physics: both hands at the end of each of 4 sub steps of the last period, D - P + (k + 1) * P / 4
+// - networking: both hands at D - P, where the other side has its state
+// - audio: the head at D + P / 2, when the sound of this frame plays
+//
+// Without the cache, every one of them locates its spaces with the runtime. With the cache, the head and the
+// hands are located once per frame at D, and all systems ask the cache (which interpolates, or extrapolates for
+// the audio). Besides the runtime calls and the time the systems spend getting their poses, we compare the poses
+// against the actual head and hand motion, as the cache trades a bit of accuracy for the calls it saves.
+//
+// The last part measures the cache on its own: random times within the history, asked one at a time or batched.
+#include "bench.h"
+#include "core_time.h"
+#include "late_latch.h"
+#include "pose_cache.h"
+#include "standin_runtime.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+enum pose_bench_space_t {
+	pose_bench_head,
+	pose_bench_hand_left,
+	pose_bench_hand_right,
+	pose_bench_space_count
+};
+
+static const uint32_t pose_bench_substeps = 4;
+static const uint32_t pose_bench_max_views = 4;
+
+struct pose_bench_query_t {
+	uint32_t space;
+	XrTime time;
+};
+
+struct pose_bench_result_t {
+	uint64_t locate_calls;
+	uint64_t queries;
+	int64_t pose_ns; // Everything spent on getting the poses, including the locates that fill the cache
+	int64_t fill_ns; // Only the locates that fill the cache
+	double head_error_degrees;
+	uint64_t head_samples;
+	double hand_error_mm;
+	uint64_t hand_samples;
+	pose_cache_stats_t cache_stats;
+};
+
+// The head pose the runtime predicts for a time. The orientation of the first view is the one of the head
+static XrPosef PoseBenchLocateHead(standin_runtime_t& runtime, XrTime time) {
+	XrPosef poses[pose_bench_max_views];
+	XrFovf fovs[pose_bench_max_views];
+	StandinLocateViews(runtime, time, poses, fovs, pose_bench_max_views);
+	return poses[0];
+}
+
+static XrPosef PoseBenchLocate(standin_runtime_t& runtime, uint32_t space, XrTime time) {
+	return space == pose_bench_head ? PoseBenchLocateHead(runtime, time) : StandinLocateHand(runtime, space - pose_bench_hand_left, time);
+}
+
+// What the systems of a frame ask for, see above
+static void PoseBenchFrameQueries(XrTime display_time, XrDuration period, std::vector<pose_bench_query_t>& queries) {
+	queries.clear();
+	for (uint32_t space = 0; space < pose_bench_space_count; space++) {
+		queries.push_back({ space, display_time });
+	}
+	for (uint32_t step = 0; step < pose_bench_substeps; step++) {
+		XrTime step_time = display_time - period + (XrDuration)(step + 1) * period / pose_bench_substeps;
+		queries.push_back({ pose_bench_hand_left, step_time });
+		queries.push_back({ pose_bench_hand_right, step_time });
+	}
+	queries.push_back({ pose_bench_hand_left, display_time - period });
+	queries.push_back({ pose_bench_hand_right, display_time - period });
+	queries.push_back({ pose_bench_head, display_time + period / 2 });
+}
+
+static pose_bench_result_t RunPoseBench(bool cached, uint32_t frame_count) {
+	standin_runtime_t runtime;
+	StandinInit(runtime, standin_runtime_config_t());
+
+	// Tells us where the head and the hands really were, without counting as calls of the runtime we measure
+	standin_runtime_config_t truth_config;
+	truth_config.locate_cost_ns = 0;
+	standin_runtime_t truth;
+	StandinInit(truth, truth_config);
+
+	pose_cache_t cache;
+	PoseCacheInit(cache, pose_bench_space_count, 2 * runtime.config.display_period);
+
+	pose_bench_result_t result = {};
+	std::vector<pose_bench_query_t> queries;
+	std::vector<XrTime> times[pose_bench_space_count];
+	std::vector<XrPosef> poses[pose_bench_space_count];
+	std::vector<uint32_t> order[pose_bench_space_count]; // Index of each query in queries
+	for (uint32_t frame = 0; frame < frame_count; frame++) {
+		standin_frame_state_t frame_state = StandinWaitFrame(runtime);
+		PoseBenchFrameQueries(frame_state.predicted_display_time, frame_state.predicted_display_period, queries);
+		uint64_t calls_before = runtime.locate_calls;
+
+		int64_t start = CoreTimeNowNs();
+		std::vector<XrPosef> answers(queries.size());
+		if (cached) {
+			// Located once per frame, then each space answers all of its queries in one batch
+			for (uint32_t space = 0; space < pose_bench_space_count; space++) {
+				PoseCachePush(cache, space, frame_state.predicted_display_time, PoseBenchLocate(runtime, space, frame_state.predicted_display_time));
+				times[space].clear();
+				order[space].clear();
+			}
+			result.fill_ns += CoreTimeNowNs() - start;
+			for (uint32_t i = 0; i < (uint32_t)queries.size(); i++) {
+				times[queries[i].space].push_back(queries[i].time);
+				order[queries[i].space].push_back(i);
+			}
+			for (uint32_t space = 0; space < pose_bench_space_count; space++) {
+				poses[space].resize(times[space].size());
+				PoseCacheQuery(cache, space, times[space].data(), poses[space].data(), (uint32_t)times[space].size());
+				for (uint32_t i = 0; i < (uint32_t)order[space].size(); i++) {
+					answers[order[space][i]] = poses[space][i];
+				}
+			}
+		} else {
+			for (uint32_t i = 0; i < (uint32_t)queries.size(); i++) {
+				answers[i] = PoseBenchLocate(runtime, queries[i].space, queries[i].time);
+			}
+		}
+		result.pose_ns += CoreTimeNowNs() - start;
+		result.queries += queries.size();
+
+		// The first frame of the cache has nothing to interpolate with yet
+		result.locate_calls += runtime.locate_calls - calls_before;
+		if (frame == 0) {
+			continue;
+		}
+		for (uint32_t i = 0; i < (uint32_t)queries.size(); i++) {
+			if (queries[i].space == pose_bench_head) {
+				result.head_error_degrees += PoseAngularDistance(answers[i], StandinTrueHeadPose(truth, queries[i].time)) * 57.2957795f;
+				result.head_samples++;
+			} else {
+				XrPosef actual = StandinLocateHand(truth, queries[i].space - pose_bench_hand_left, queries[i].time);
+				float dx = answers[i].position.x - actual.position.x;
+				float dy = answers[i].position.y - actual.position.y;
+				float dz = answers[i].position.z - actual.position.z;
+				result.hand_error_mm += sqrtf(dx * dx + dy * dy + dz * dz) * 1000.0;
+				result.hand_samples++;
+			}
+		}
+	}
+
+	result.cache_stats = cache.stats;
+	return result;
+}
+
+// The cost of the queries on their own: random times within the history of a head that turns
+static void PoseBenchThroughput(bench_context_t& context) {
+	const uint32_t query_count = context.quick ? 4096 : 65536;
+	const XrDuration period = 11111111;
+
+	pose_cache_t cache;
+	PoseCacheInit(cache, 1, 2 * period);
+	for (uint32_t sample = 0; sample < pose_cache_capacity; sample++) {
+		float yaw = 0.8f * sinf(0.05f * (float)sample);
+		XrPosef pose = { { 0.0f, sinf(yaw / 2.0f), 0.0f, cosf(yaw / 2.0f) }, { 0.0f, 1.6f, 0.01f * (float)sample } };
+		PoseCachePush(cache, 0, (XrTime)sample * period, pose);
+	}
+
+	uint32_t random_state = 12345u;
+	std::vector<XrTime> times(query_count);
+	for (XrTime& time : times) {
+		random_state = random_state * 1664525u + 1013904223u;
+		float random = (float)(random_state >> 8) / (float)(1 << 24);
+		time = (XrTime)(random * (float)(pose_cache_capacity - 1) * (float)period);
+	}
+
+	std::vector<XrPosef> poses(query_count);
+	int64_t start = CoreTimeNowNs();
+	for (uint32_t i = 0; i < query_count; i++) {
+		PoseCacheQuery(cache, 0, &times[i], &poses[i], 1);
+	}
+	int64_t single_ns = CoreTimeNowNs() - start;
+	BenchKeep(poses[query_count / 2]);
+
+	start = CoreTimeNowNs();
+	PoseCacheQuery(cache, 0, times.data(), poses.data(), query_count);
+	int64_t batched_ns = CoreTimeNowNs() - start;
+	BenchKeep(poses[query_count / 2]);
+
+	BenchReport(context, "throughput.single", (double)single_ns / query_count, "ns/pose");
+	BenchReport(context, "throughput.batched", (double)batched_ns / query_count, "ns/pose");
+}
+
+XR_BENCH(pose_cache) {
+	const uint32_t frame_count = context.quick ? 20 : 180;
+
+	const char* modes[] = { "direct", "cached" };
+	for (int mode = 0; mode < 2; mode++) {
+		pose_bench_result_t result = RunPoseBench(mode == 1, frame_count);
+		std::string prefix = modes[mode];
+
+		BenchReport(context, prefix + ".locate_calls_per_frame", (double)result.locate_calls / frame_count, "calls");
+		BenchReport(context, prefix + ".query_latency", (double)(result.pose_ns - result.fill_ns) / result.queries / 1000.0, "us");
+		BenchReport(context, prefix + ".pose_cost_per_frame", CoreNsToMs(result.pose_ns) / frame_count, "ms");
+		BenchReport(context, prefix + ".head_error_mean", result.head_error_degrees / (double)result.head_samples, "deg");
+		BenchReport(context, prefix + ".hand_error_mean", result.hand_error_mm / (double)result.hand_samples, "mm");
+		if (mode == 1) {
+			const pose_cache_stats_t& stats = result.cache_stats;
+			BenchReport(context, prefix + ".interpolated", (double)stats.interpolated / (double)stats.queries * 100.0, "%");
+			BenchReport(context, prefix + ".extrapolated", (double)stats.extrapolated / (double)stats.queries * 100.0, "%");
+			BenchReport(context, prefix + ".clamped", (double)stats.clamped / (double)stats.queries * 100.0, "%");
+		}
+	}
+
+	PoseBenchThroughput(context);
+}
@@ -0,0 +1,76 @@
+//###################################################################################################################
+// Cached quad layer harness
+//###################################################################################################################
+// Runs the structure of RenderOpenXrQuadLayers for a few panels with different update rates: A static panel,
+// one that changes about once per second (at 90Hz), and one that changes every 10 frames. Rendering a panel
+// is simulated with a busy wait of a fixed cost, which stands in for the GPU time a real render would take.
+// We compare rendering every panel every frame with only rendering the dirty ones.
+#include "bench.h"
+#include "core_time.h"
+#include "quad_layer.h"
+
+#include <string>
+#include <vector>
+
+static const int64_t panel_render_cost_ns = 200000;
+
+struct panel_harness_result_t {
+	double frame_ms; // Mean time spent on the panels per frame
+	uint64_t renders;
+	double measured_ms; // Total time of the renders we measured
+	double saved_ms; // Saved time as estimated by QuadPanelSavedGpuMs
+};
+
+static panel_harness_result_t RunPanelHarness(bool cached, int frame_count) {
+	const uint32_t update_intervals[] = { 0, 90, 10 }; // 0 means the panel never changes
+	const uint32_t panel_count = sizeof(update_intervals) / sizeof(update_intervals[0]);
+
+	std::vector<quad_panel_t> panels;
+	for (uint32_t i = 0; i < panel_count; i++) {
+		XrPosef pose = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f } };
+		panels.push_back(QuadPanelCreate("panel", pose, { 0.25f, 0.25f }, 512, 512));
+	}
+
+	panel_harness_result_t result = {};
+	int64_t start = CoreTimeNowNs();
+	for (int frame = 0; frame < frame_count; frame++) {
+		for (uint32_t i = 0; i < panel_count; i++) {
+			quad_panel_t& panel = panels[i];
+			if (update_intervals[i] != 0 && frame % update_intervals[i] == 0) {
+				QuadPanelMarkDirty(panel);
+			}
+
+			bool render = !cached || QuadPanelNeedsRender(panel);
+			if (render) {
+				int64_t render_start = CoreTimeNowNs();
+				BenchSpinFor(panel_render_cost_ns);
+				QuadPanelRecordGpuTime(panel, CoreNsToMs(CoreTimeNowNs() - render_start));
+			}
+			QuadPanelSubmitted(panel, render);
+		}
+	}
+	result.frame_ms = CoreNsToMs(CoreTimeNowNs() - start) / (double)frame_count;
+
+	for (const quad_panel_t& panel : panels) {
+		result.renders += panel.stats.renders;
+		result.measured_ms += panel.stats.gpu_ms_sum;
+		result.saved_ms += QuadPanelSavedGpuMs(panel.stats);
+	}
+	return result;
+}
+
+XR_BENCH(quad_layer_rerender) {
+	int frame_count = context.quick ? 90 : 900;
+
+	panel_harness_result_t always = RunPanelHarness(false, frame_count);
+	panel_harness_result_t cached = RunPanelHarness(true, frame_count);
+
+	BenchReport(context, "always.renders_per_frame", (double)always.renders / (double)frame_count, "");
+	BenchReport(context, "always.panel_time", always.frame_ms, "ms/frame");
+	BenchReport(context, "cached.renders_per_frame", (double)cached.renders / (double)frame_count, "");
+	BenchReport(context, "cached.panel_time", cached.frame_ms, "ms/frame");
+
+	// The estimate of the cached run should match what the uncached run actually spent on top
+	BenchReport(context, "cached.saved_estimate", cached.saved_ms / (double)frame_count, "ms/frame");
+	BenchReport(context, "saved_measured", (always.measured_ms - cached.measured_ms) / (double)frame_count, "ms/frame");
+}
@@ -0,0 +1,169 @@
+//###################################################################################################################
+// Capture and replay benchmark
+//###################################################################################################################
+// Records a session against the stand-in runtime, the same way the application records with
+// app_config_capture_file set, and replays the recording twice. The live session depends on the timing of
+// the machine (the display period is short, so the frame timing differs from run to run), the replays must not: Both
+// have to end up with the same checksum, and in the same state the live session ended up in. Also reports
+// the size of the recording and what a replayed frame costs.
+#include "bench.h"
+#include "core_time.h"
+#include "frame_capture.h"
+#include "replay.h"
+#include "simulation.h"
+#include "standin_runtime.h"
+
+#include <algorithm>
+#include <vector>
+
+static double ReplayPercentile(std::vector<double> samples, double percentile) {
+	if (samples.empty()) {
+		return 0.0;
+	}
+	std::sort(samples.begin(), samples.end());
+	size_t index = (size_t)(percentile / 100.0 * (double)(samples.size() - 1));
+	return samples[index];
+}
+
+static double ReplayMean(const std::vector<double>& samples) {
+	double sum = 0.0;
+	for (double sample : samples) {
+		sum += sample;
+	}
+	return samples.empty() ? 0.0 : sum / (double)samples.size();
+}
+
+// One frame of the live session, with the capture calls at the same places as in the application
+static void RecordLiveFrame(standin_runtime_t& runtime, capture_writer_t& writer, frame_schedule_t& schedule, simulation_t& simulation, occlusion_buffer_t& occlusion_buffer, input_snapshot_buffer_t& snapshots, input_snapshot_t& pending, pose_cache_t& hand_poses) {
+	standin_frame_state_t frame_state = StandinWaitFrame(runtime);
+	CaptureFrameState(writer, frame_state.predicted_display_time, frame_state.predicted_display_period, frame_state.should_render);
+	frame_plan_t plan = FrameScheduleBegin(schedule, frame_state.predicted_display_time, frame_state.predicted_display_period, frame_state.should_render);
+
+	// PollOpenXrActions and LocateOpenXrControllers
+	StandinSyncActions(runtime);
+	pending.action_count = app_action_count * input_max_hands;
+	pending.action_changed = 0;
+	for (uint32_t i = 0; i < pending.action_count; i++) {
+		float value = StandinGetActionState(runtime, i);
+		if (value != pending.action_values[i]) {
+			pending.action_changed |= (1ull << i);
+		}
+		pending.action_values[i] = value;
+	}
+	pending.display_time = frame_state.predicted_display_time;
+	pending.hand_pose_valid = 0;
+	for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+		pending.hand_poses[hand] = StandinLocateHand(runtime, hand, frame_state.predicted_display_time);
+		pending.hand_pose_valid |= (1u << hand);
+		PoseCachePush(hand_poses, hand, frame_state.predicted_display_time, pending.hand_poses[hand]);
+	}
+	InputSnapshotPublish(snapshots, pending);
+	CaptureInput(writer, pending);
+
+	// UpdateSimulation
+	input_snapshot_t input;
+	bool has_input = InputSnapshotRead(snapshots, input);
+	SimulationUpdateFrame(simulation, has_input ? &input : nullptr, hand_poses, plan.display_time, plan.display_period, plan.missed_periods);
+
+	// RenderOpenXrLayer: Locate, cull, late latch
+	view_latch_t latches[capture_max_views] = {};
+	XrPosef poses[capture_max_views];
+	XrFovf fovs[capture_max_views];
+	for (uint32_t locate = 0; locate < capture_locate_count; locate++) {
+		uint32_t view_count = StandinLocateViews(runtime, frame_state.predicted_display_time, poses, fovs, capture_max_views);
+		for (uint32_t i = 0; i < view_count; i++) {
+			latches[i].pose = poses[i];
+			latches[i].fov = fovs[i];
+			latches[i].display_time = frame_state.predicted_display_time;
+			latches[i].latched_at_ns = CoreTimeNowNs();
+		}
+		CaptureViews(writer, locate, latches, view_count);
+
+		if (locate == capture_locate_early) {
+			SimulationCull(simulation, occlusion_buffer, poses, fovs, view_count, 0.05f, 100.0f);
+		}
+	}
+
+	CaptureEndFrame(writer);
+	FrameScheduleEnd(schedule);
+}
+
+XR_BENCH(capture_replay) {
+	const uint32_t frame_count = context.quick ? 60 : 600;
+
+	//------------------------------------------------------------------------------------------------------
+	// Record a live session
+	//------------------------------------------------------------------------------------------------------
+	standin_runtime_config_t config;
+	config.display_period = 2000000; // 500Hz, such that the frame loop can't keep up all the time
+	standin_runtime_t runtime;
+	StandinInit(runtime, config);
+
+	static simulation_t simulation;
+	static occlusion_buffer_t occlusion_buffer;
+	static input_snapshot_buffer_t snapshots;
+	SimulationInit(simulation);
+	OcclusionInit(occlusion_buffer, 256, 128);
+	InputSnapshotInit(snapshots);
+	input_snapshot_t pending = {};
+	frame_schedule_t schedule;
+	FrameScheduleInit(schedule);
+	pose_cache_t hand_poses;
+	PoseCacheInit(hand_poses, input_max_hands, 50000000);
+
+	capture_writer_t writer;
+	CaptureOpen(writer, nullptr);
+
+	// The session starts up like it does with a real runtime. In the middle, a system menu takes the focus
+	// for a while, the application stays visible then
+	CaptureEvent(writer, capture_event_session_state, capture_session_ready);
+	CaptureEvent(writer, capture_event_session_state, capture_session_synchronized);
+	CaptureEvent(writer, capture_event_session_state, capture_session_visible);
+	CaptureEvent(writer, capture_event_session_state, capture_session_focused);
+
+	int64_t record_start = CoreTimeNowNs();
+	for (uint32_t frame = 0; frame < frame_count; frame++) {
+		if (frame == frame_count / 2) {
+			CaptureEvent(writer, capture_event_session_state, capture_session_visible);
+		}
+		else if (frame == frame_count * 3 / 4) {
+			CaptureEvent(writer, capture_event_session_state, capture_session_focused);
+		}
+		RecordLiveFrame(runtime, writer, schedule, simulation, occlusion_buffer, snapshots, pending, hand_poses);
+	}
+	double record_ms = CoreNsToMs(CoreTimeNowNs() - record_start);
+	CaptureClose(writer);
+
+	//------------------------------------------------------------------------------------------------------
+	// Replay it twice
+	//------------------------------------------------------------------------------------------------------
+	static replay_state_t replays[2];
+	std::vector<double> frame_ms[2];
+	uint64_t checksums[2] = {};
+	bool replays_ok = true;
+	for (uint32_t run = 0; run < 2; run++) {
+		capture_reader_t reader;
+		replays_ok = CaptureLoadMemory(reader, writer.buffer.data(), writer.buffer.size()) && replays_ok;
+		ReplayInit(replays[run]);
+		replays_ok = ReplayCapture(replays[run], reader, &frame_ms[run]) && replays_ok;
+		checksums[run] = ReplayChecksum(replays[run]);
+	}
+
+	BenchReport(context, "frames", (double)writer.frames, "");
+	BenchReport(context, "dropped_frames_live", (double)((runtime.next_display_time - 2 * config.display_period) / config.display_period - frame_count), "");
+	BenchReport(context, "bytes_per_frame", (double)writer.bytes / (double)writer.frames, "B");
+	BenchReport(context, "live_frame_mean", record_ms / (double)frame_count, "ms");
+	BenchReport(context, "replay_frame_mean", ReplayMean(frame_ms[0]), "ms");
+	BenchReport(context, "replay_frame_p99", ReplayPercentile(frame_ms[0], 99.0), "ms");
+	BenchReport(context, "replayed_frames", (double)replays[0].schedule.frames, "");
+	bool identical = checksums[0] == checksums[1];
+	bool matches_live = SimulationChecksum(replays[0].simulation) == SimulationChecksum(simulation);
+	BenchReport(context, "replay_ok", replays_ok ? 1.0 : 0.0, "");
+	BenchReport(context, "replays_identical", identical ? 1.0 : 0.0, "");
+	BenchReport(context, "replay_matches_live", matches_live ? 1.0 : 0.0, "");
+
+	// A replay that drifts from the live session is exactly what the capture exists to rule out
+	BenchCheck(context, "replay_ok", replays_ok);
+	BenchCheck(context, "replays_identical", identical);
+	BenchCheck(context, "replay_matches_live", matches_live);
+}
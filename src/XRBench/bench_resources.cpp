@@ -0,0 +1,168 @@
+//###################################################################################################################
+// Resource tracking benchmarks
+//###################################################################################################################
+// A soak test of the resource registry on the null backend: Creates the same resources as the application
+// (pipeline, eye swapchains with render and depth targets, a quad layer panel with its GPU timer), then runs
+// many frames in which the panel is recreated now and then and the session restarts with a different
+// resolution. At the end, everything is released again and nothing may be left in the registry, nor on the
+// device. A second run leaks the GPU timer on purpose, which the leak report has to find.
+#include "bench.h"
+#include "core_time.h"
+#include "null_backend.h"
+#include "resource_registry.h"
+
+#include <string>
+
+// What the application creates in InitD3D / InitXr
+struct resource_bench_app_t {
+	uint64_t vertex_shader;
+	uint64_t pixel_shader;
+	uint64_t input_layout;
+	uint64_t const_buffer;
+	uint64_t vertex_buffer;
+	uint64_t index_buffer;
+	null_swapchain_t views[2];
+	null_swapchain_t panel;
+	uint64_t panel_queries[4]; // Disjoint query, start and end timestamps and an occlusion query
+};
+
+static void ResourceBenchCreateViews(null_device_t& device, resource_bench_app_t& app, float resolution_scale) {
+	// Roughly the recommended resolution of a current headset
+	uint32_t width = (uint32_t)(1832 * resolution_scale);
+	uint32_t height = (uint32_t)(1920 * resolution_scale);
+	NullCreateSwapchain(device, width, height, 1, 3, "view 0", app.views[0]);
+	NullCreateSwapchain(device, width, height, 1, 3, "view 1", app.views[1]);
+}
+
+static void ResourceBenchCreatePanel(null_device_t& device, resource_bench_app_t& app, uint32_t size) {
+	NullCreateSwapchain(device, size, size, 1, 3, "status panel", app.panel);
+	for (uint64_t& query : app.panel_queries) {
+		query = NullCreate(device, resource_query, 0, "status panel");
+	}
+}
+
+static void ResourceBenchDestroyPanel(null_device_t& device, resource_bench_app_t& app, bool release_queries) {
+	NullDestroySwapchain(device, app.panel);
+	if (release_queries) {
+		for (uint64_t& query : app.panel_queries) {
+			NullRelease(device, query);
+		}
+	}
+}
+
+static void ResourceBenchInit(null_device_t& device, resource_bench_app_t& app) {
+	app = {};
+	app.vertex_shader = NullCreate(device, resource_shader, 1200, "pipeline");
+	app.pixel_shader = NullCreate(device, resource_shader, 700, "pipeline");
+	app.input_layout = NullCreate(device, resource_input_layout, 0, "pipeline");
+	app.const_buffer = NullCreate(device, resource_buffer, 128, "pipeline");
+	app.vertex_buffer = NullCreate(device, resource_buffer, 24 * 36, "cube");
+	app.index_buffer = NullCreate(device, resource_buffer, 2 * 36, "cube");
+	ResourceBenchCreateViews(device, app, 1.0f);
+	ResourceBenchCreatePanel(device, app, 512);
+}
+
+static void ResourceBenchShutdown(null_device_t& device, resource_bench_app_t& app, bool release_queries) {
+	ResourceBenchDestroyPanel(device, app, release_queries);
+	NullDestroySwapchain(device, app.views[0]);
+	NullDestroySwapchain(device, app.views[1]);
+	NullRelease(device, app.index_buffer);
+	NullRelease(device, app.vertex_buffer);
+	NullRelease(device, app.const_buffer);
+	NullRelease(device, app.input_layout);
+	NullRelease(device, app.pixel_shader);
+	NullRelease(device, app.vertex_shader);
+}
+
+XR_BENCH(resource_soak) {
+	const uint32_t frame_count = context.quick ? 5000 : 500000;
+	const uint32_t session_restart_interval = 1000;
+	const uint32_t panel_recreate_interval = 90;
+	const float resolution_scales[] = { 1.0f, 1.2f, 1.5f };
+
+	// With the largest resolution scale, the eye swapchains alone need more than this
+	resource_registry_t registry;
+	ResourceRegistryInit(registry, 320ull * 1024 * 1024);
+	null_device_t device;
+	NullDeviceInit(device, registry);
+
+	resource_bench_app_t app;
+	ResourceBenchInit(device, app);
+
+	uint64_t mismatched_frames = 0;
+	uint64_t session_restarts = 0;
+	int64_t start = CoreTimeNowNs();
+	for (uint32_t frame = 1; frame <= frame_count; frame++) {
+		if (frame % session_restart_interval == 0) {
+			session_restarts++;
+			NullDestroySwapchain(device, app.views[0]);
+			NullDestroySwapchain(device, app.views[1]);
+			ResourceBenchCreateViews(device, app, resolution_scales[session_restarts % 3]);
+		}
+		if (frame % panel_recreate_interval == 0) {
+			ResourceBenchDestroyPanel(device, app, true);
+			ResourceBenchCreatePanel(device, app, (frame / panel_recreate_interval) % 2 ? 256 : 512);
+		}
+
+		// The upload buffer for the per frame data, like the staging memory of a streaming system
+		uint64_t upload = NullCreate(device, resource_cpu, 64 * 1024, "frame upload");
+		NullRelease(device, upload);
+
+		const resource_totals_t& totals = ResourceFrame(registry);
+		if (totals.count != device.live_objects) {
+			mismatched_frames++;
+		}
+	}
+	int64_t elapsed = CoreTimeNowNs() - start;
+	uint64_t peak_bytes = registry.totals.peak_bytes;
+
+	ResourceBenchShutdown(device, app, true);
+	ResourceFrame(registry);
+
+	// Same again, but the queries of the panel are never released
+	resource_registry_t leak_registry;
+	ResourceRegistryInit(leak_registry, 0);
+	null_device_t leak_device;
+	NullDeviceInit(leak_device, leak_registry);
+	resource_bench_app_t leak_app;
+	ResourceBenchInit(leak_device, leak_app);
+	ResourceBenchShutdown(leak_device, leak_app, false);
+	std::string leak_report = ResourceLeakReport(leak_registry);
+	BenchKeep(leak_report.size());
+
+	BenchReport(context, "frames", (double)frame_count, "");
+	BenchReport(context, "created", (double)device.created_objects, "");
+	BenchReport(context, "session_restarts", (double)session_restarts, "");
+	BenchReport(context, "ns_per_frame", (double)elapsed / frame_count, "ns");
+	BenchReport(context, "peak", (double)peak_bytes / (1024.0 * 1024.0), "MB");
+	BenchReport(context, "frames_over_budget", (double)registry.frames_over_budget, "");
+	BenchReport(context, "mismatched_frames", (double)mismatched_frames, "");
+	BenchReport(context, "leaks", (double)registry.entries.size(), "");
+	BenchReport(context, "device_live", (double)device.live_objects, "");
+	BenchReport(context, "unknown_releases", (double)registry.unknown_releases, "");
+	BenchReport(context, "planted_leaks_found", (double)ResourceLiveEntries(leak_registry).size(), "");
+	BenchReport(context, "planted_leaks_expected", (double)leak_device.live_objects, "");
+}
+
+XR_BENCH(resource_track_release) {
+	const uint32_t count = context.quick ? 100000 : 10000000;
+
+	resource_registry_t registry;
+	ResourceRegistryInit(registry, 0);
+
+	// A few hundred resources alive, like in the application, and one more created and released each time
+	for (uint64_t i = 0; i < 256; i++) {
+		ResourceTrack(registry, 0x100000 + i * 0x40, resource_buffer, 256, "static");
+	}
+
+	int64_t start = CoreTimeNowNs();
+	for (uint32_t i = 0; i < count; i++) {
+		uint64_t handle = 0x200000 + (uint64_t)(i & 1023) * 0x40;
+		ResourceTrack(registry, handle, resource_cpu, 4096, "transient");
+		ResourceRelease(registry, handle);
+	}
+	int64_t elapsed = CoreTimeNowNs() - start;
+
+	BenchReport(context, "track_release", (double)elapsed / count, "ns");
+	BenchReport(context, "live", (double)registry.entries.size(), "");
+}
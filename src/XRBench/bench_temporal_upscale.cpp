@@ -0,0 +1,222 @@
+//###################################################################################################################
+// Temporal upscaling benchmark
+//###################################################################################################################
+// Renders a test scene on the CPU (a fine pattern that scrolls by, like when the head turns, and a striped disk
+// that moves on its own) and compares the ways of getting to the output resolution:
+//
+// - native: every output pixel shaded once, like rendering at the recommended resolution
+// - bilinear: rendered at a lower internal resolution and stretched
+// - temporal: rendered at the internal resolution with jitter and motion vectors, and resolved with the CPU backend
+//   of temporal_upscale.h. At a scale of 1, this is plain temporal anti-aliasing
+//
+// The quality is the PSNR against the scene rendered with 16 samples per output pixel, averaged over the frames
+// after the history had some time to fill up. The shaded pixels are what the GPU would save, the resolve time is
+// what the CPU backend costs (the GPU resolve is a single pass over the output). The temporal case without the
+// history clamp shows the ghosting the clamp prevents, the one with only the camera motion on the disk shows what
+// the motion vectors of the moving objects are worth. Temporal upscaling has to look better than stretching at
+// 75%, and temporal anti-aliasing better than rendering at the native resolution, or the benchmark fails.
+#include "bench.h"
+#include "core_time.h"
+#include "temporal_upscale.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+// The disk at a frame, in texture coordinates
+static XrVector2f UpscaleBenchDiskCenter(float frame) {
+	return { 0.5f + 0.3f * sinf(0.05f * frame), 0.5f + 0.2f * cosf(0.04f * frame) };
+}
+
+// How far the pattern scrolled by a frame, in texture coordinates
+static XrVector2f UpscaleBenchCamera(float frame) {
+	return { 0.0021f * frame, 0.0007f * frame };
+}
+
+static const float upscale_bench_disk_radius = 0.12f;
+
+// The color at a point of the screen (in texture coordinates), and the motion of the surface there. Without
+// object_motion, the disk gets the motion of the camera, as if it stood still
+static void UpscaleBenchShade(float u, float v, float frame, bool object_motion, float* rgba, float* motion) {
+	XrVector2f disk = UpscaleBenchDiskCenter(frame);
+	float du = u - disk.x;
+	float dv = v - disk.y;
+	bool on_disk = du * du + dv * dv < upscale_bench_disk_radius * upscale_bench_disk_radius;
+	if (on_disk) {
+		// Stripes that move with the disk
+		float stripe = sinf((du + dv) * 60.0f) > 0.0f ? 1.0f : 0.0f;
+		rgba[0] = 0.9f;
+		rgba[1] = 0.3f + 0.5f * stripe;
+		rgba[2] = 0.1f;
+		if (motion && object_motion) {
+			XrVector2f previous = UpscaleBenchDiskCenter(frame - 1.0f);
+			motion[0] = disk.x - previous.x;
+			motion[1] = disk.y - previous.y;
+		}
+	} else {
+		// A rotated checkerboard with thin lines in between, fixed to the world
+		XrVector2f camera = UpscaleBenchCamera(frame);
+		float x = u + camera.x;
+		float y = v + camera.y;
+		float rx = x * 0.94f - y * 0.34f;
+		float ry = x * 0.34f + y * 0.94f;
+		float checker = ((int32_t)floorf(rx * 10.0f) + (int32_t)floorf(ry * 10.0f)) & 1 ? 1.0f : 0.0f;
+		float line = fabsf(sinf((x + 2.0f * y) * 50.0f)) > 0.93f ? 1.0f : 0.0f;
+		rgba[0] = 0.15f + 0.6f * checker;
+		rgba[1] = 0.2f + 0.5f * checker + 0.3f * line;
+		rgba[2] = 0.35f + 0.4f * line;
+	}
+	if (motion && (!on_disk || !object_motion)) {
+		XrVector2f camera = UpscaleBenchCamera(frame);
+		XrVector2f previous = UpscaleBenchCamera(frame - 1.0f);
+		motion[0] = -(camera.x - previous.x);
+		motion[1] = -(camera.y - previous.y);
+	}
+	rgba[3] = 1.0f;
+}
+
+// Renders the scene like the rasterizer would, with one sample per pixel, moved by the jitter
+static void UpscaleBenchRender(uint32_t width, uint32_t height, float frame, const temporal_jitter_t& jitter, bool object_motion, std::vector<float>& color, std::vector<float>& motion) {
+	color.resize((size_t)width * height * 4);
+	motion.resize((size_t)width * height * 2);
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			size_t index = (size_t)y * width + x;
+			float u = ((float)x + 0.5f + jitter.pixels.x) / (float)width;
+			float v = ((float)y + 0.5f + jitter.pixels.y) / (float)height;
+			UpscaleBenchShade(u, v, frame, object_motion, &color[index * 4], &motion[index * 2]);
+		}
+	}
+}
+
+// What the output should look like: 4x4 samples per pixel
+static void UpscaleBenchReference(uint32_t width, uint32_t height, float frame, std::vector<float>& color) {
+	color.assign((size_t)width * height * 4, 0.0f);
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			float* pixel = &color[((size_t)y * width + x) * 4];
+			for (uint32_t s = 0; s < 16; s++) {
+				float rgba[4];
+				float u = ((float)x + ((float)(s % 4) + 0.5f) / 4.0f) / (float)width;
+				float v = ((float)y + ((float)(s / 4) + 0.5f) / 4.0f) / (float)height;
+				UpscaleBenchShade(u, v, frame, true, rgba, nullptr);
+				for (int c = 0; c < 4; c++) {
+					pixel[c] += rgba[c] / 16.0f;
+				}
+			}
+		}
+	}
+}
+
+// Stretches the image to the output size, with bilinear filtering
+static void UpscaleBenchBilinear(const std::vector<float>& input, uint32_t in_w, uint32_t in_h, uint32_t out_w, uint32_t out_h, std::vector<float>& output) {
+	output.resize((size_t)out_w * out_h * 4);
+	for (uint32_t y = 0; y < out_h; y++) {
+		float sy = std::min(std::max(((float)y + 0.5f) * in_h / out_h - 0.5f, 0.0f), (float)(in_h - 1));
+		uint32_t y0 = (uint32_t)sy;
+		uint32_t y1 = std::min(y0 + 1, in_h - 1);
+		float fy = sy - (float)y0;
+		for (uint32_t x = 0; x < out_w; x++) {
+			float sx = std::min(std::max(((float)x + 0.5f) * in_w / out_w - 0.5f, 0.0f), (float)(in_w - 1));
+			uint32_t x0 = (uint32_t)sx;
+			uint32_t x1 = std::min(x0 + 1, in_w - 1);
+			float fx = sx - (float)x0;
+			for (int c = 0; c < 4; c++) {
+				float top = input[((size_t)y0 * in_w + x0) * 4 + c] * (1.0f - fx) + input[((size_t)y0 * in_w + x1) * 4 + c] * fx;
+				float bottom = input[((size_t)y1 * in_w + x0) * 4 + c] * (1.0f - fx) + input[((size_t)y1 * in_w + x1) * 4 + c] * fx;
+				output[((size_t)y * out_w + x) * 4 + c] = top * (1.0f - fy) + bottom * fy;
+			}
+		}
+	}
+}
+
+// Peak signal to noise ratio of the RGB channels, in dB
+static double UpscaleBenchPsnr(const float* image, const float* reference, size_t pixels) {
+	double error = 0.0;
+	for (size_t i = 0; i < pixels; i++) {
+		for (int c = 0; c < 3; c++) {
+			double difference = (double)std::min(std::max(image[i * 4 + c], 0.0f), 1.0f) - (double)reference[i * 4 + c];
+			error += difference * difference;
+		}
+	}
+	double mse = error / (double)(pixels * 3);
+	return mse > 0.0 ? 10.0 * log10(1.0 / mse) : 100.0;
+}
+
+XR_BENCH(temporal_upscale) {
+	const uint32_t size = context.quick ? 160 : 512;
+	const uint32_t frame_count = context.quick ? 24 : 96;
+	const uint32_t warmup = 8;
+
+	struct upscale_bench_case_t {
+		const char* name;
+		float scale; // Internal resolution per axis
+		bool temporal;
+		bool clamp;
+		bool object_motion; // The disk has motion vectors of its own
+		const char* must_beat; // The case that has to have a lower PSNR than this one, if any
+	};
+	const upscale_bench_case_t cases[] = {
+		{ "native", 1.0f, false, true, true, nullptr },
+		{ "temporal_aa", 1.0f, true, true, true, "native" },
+		{ "bilinear_75pct", 0.75f, false, true, true, nullptr },
+		{ "temporal_75pct", 0.75f, true, true, true, "bilinear_75pct" },
+		{ "temporal_75pct_camera_motion", 0.75f, true, true, false, nullptr },
+		{ "bilinear_50pct", 0.5f, false, true, true, nullptr },
+		{ "temporal_50pct", 0.5f, true, true, true, "bilinear_50pct" },
+		{ "temporal_50pct_no_clamp", 0.5f, true, false, true, nullptr },
+	};
+	std::map<std::string, double> psnrs;
+
+	// The reference of every frame is the same for all cases
+	std::vector<std::vector<float>> references(frame_count);
+	for (uint32_t frame = warmup; frame < frame_count; frame++) {
+		UpscaleBenchReference(size, size, (float)frame, references[frame]);
+	}
+
+	std::vector<float> color;
+	std::vector<float> motion;
+	std::vector<float> stretched;
+	for (const upscale_bench_case_t& bench_case : cases) {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		TemporalInternalSize(size, size, bench_case.scale, width, height);
+		temporal_upscaler_t upscaler;
+		TemporalUpscaleInit(upscaler, width, height, size, size);
+		upscaler.clamp_history = bench_case.clamp;
+
+		double psnr = 0.0;
+		int64_t resolve_ns = 0;
+		for (uint32_t frame = 0; frame < frame_count; frame++) {
+			temporal_jitter_t jitter = bench_case.temporal ? TemporalJitter(frame, width, height) : temporal_jitter_t{};
+			UpscaleBenchRender(width, height, (float)frame, jitter, bench_case.object_motion, color, motion);
+
+			int64_t start = CoreTimeNowNs();
+			const float* output = nullptr;
+			if (bench_case.temporal) {
+				output = TemporalUpscaleResolve(upscaler, color.data(), motion.data(), jitter);
+			} else if (width != size) {
+				UpscaleBenchBilinear(color, width, height, size, size, stretched);
+				output = stretched.data();
+			} else {
+				output = color.data();
+			}
+			resolve_ns += CoreTimeNowNs() - start;
+
+			if (frame >= warmup) {
+				psnr += UpscaleBenchPsnr(output, references[frame].data(), (size_t)size * size) / (frame_count - warmup);
+			}
+		}
+
+		std::string prefix = std::string(bench_case.name) + "_";
+		BenchReport(context, prefix + "psnr", psnr, "dB");
+		BenchReport(context, prefix + "shaded_pixels", (double)width * height / ((double)size * size) * 100.0, "%");
+		BenchReport(context, prefix + "resolve_cpu", CoreNsToMs(resolve_ns) / frame_count, "ms");
+		psnrs[bench_case.name] = psnr;
+		if (bench_case.must_beat) {
+			BenchCheck(context, prefix + "psnr", psnr > psnrs[bench_case.must_beat]);
+		}
+	}
+}
@@ -0,0 +1,162 @@
+//###################################################################################################################
+// Transform graph benchmark
+//###################################################################################################################
+// Builds two hierarchies of 100k nodes (10k with --quick): a deep one, made of chains of 1000 nodes each below one
+// another, and a wide one, with one root, 100 children below it and the rest of the nodes below those. Every
+// frame, 1%, 10% or all of the nodes get a new local matrix, spread over the whole hierarchy. Compares computing
+// every world matrix again (one multiplication per node, in the order the nodes were added) to the update of
+// transform_graph.h, which only computes the subtrees that changed. In the deep hierarchy, a moving node moves
+// the rest of its chain, so even a few moving nodes change most of the world matrices. The new local matrices are
+// made before the timing starts, and both sides store them within it. The world matrices of both have to be the
+// same, up to rounding.
+#include "bench.h"
+#include "core_time.h"
+#include "transform_graph.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+// The nodes in the order they're added: the parent of each (an earlier node, or transform_no_parent) and its
+// local matrix
+struct transform_bench_tree_t {
+	std::vector<uint32_t> parents;
+	std::vector<xr_mat4_t> locals;
+};
+
+static xr_mat4_t TransformBenchLocal(uint32_t node, uint32_t frame) {
+	float angle = 0.01f * (float)frame + 0.1f * (float)(node % 7);
+	return XrMathAffine(1.0f, XrMathQuatFromEuler(0.0f, angle, 0.0f), { 0.1f, 0.05f * (float)(node % 3), 0.0f });
+}
+
+static void TransformBenchAdd(transform_bench_tree_t& tree, uint32_t parent) {
+	tree.locals.push_back(TransformBenchLocal((uint32_t)tree.parents.size(), 0));
+	tree.parents.push_back(parent);
+}
+
+static transform_bench_tree_t TransformBenchDeep(uint32_t node_count, uint32_t chain_length) {
+	transform_bench_tree_t tree;
+	while (tree.parents.size() < node_count) {
+		TransformBenchAdd(tree, transform_no_parent);
+		for (uint32_t i = 1; i < chain_length && tree.parents.size() < node_count; i++) {
+			TransformBenchAdd(tree, (uint32_t)tree.parents.size() - 1);
+		}
+	}
+	return tree;
+}
+
+static transform_bench_tree_t TransformBenchWide(uint32_t node_count, uint32_t branches) {
+	transform_bench_tree_t tree;
+	TransformBenchAdd(tree, transform_no_parent);
+	uint32_t leaves_per_branch = (node_count - 1) / branches - 1;
+	for (uint32_t branch = 0; branch < branches; branch++) {
+		uint32_t branch_node = (uint32_t)tree.parents.size();
+		TransformBenchAdd(tree, 0);
+		for (uint32_t i = 0; i < leaves_per_branch; i++) {
+			TransformBenchAdd(tree, branch_node);
+		}
+	}
+	return tree;
+}
+
+XR_BENCH(transform_graph) {
+	const uint32_t node_count = context.quick ? 10000 : 100000;
+	const uint32_t frame_count = context.quick ? 10 : 60;
+
+	struct transform_bench_shape_t {
+		const char* name;
+		transform_bench_tree_t tree;
+	};
+	transform_bench_shape_t shapes[] = {
+		{ "deep", TransformBenchDeep(node_count, 1000) },
+		{ "wide", TransformBenchWide(node_count, 100) },
+	};
+
+	struct transform_bench_case_t {
+		const char* name;
+		uint32_t stride; // Every stride-th node moves
+	};
+	const transform_bench_case_t cases[] = {
+		{ "moving_1pct", 100 },
+		{ "moving_10pct", 10 },
+		{ "moving_all", 1 },
+	};
+
+	for (const transform_bench_shape_t& shape : shapes) {
+		const transform_bench_tree_t& tree = shape.tree;
+		uint32_t count = (uint32_t)tree.parents.size();
+		BenchReport(context, std::string(shape.name) + "_nodes", (double)count, "");
+
+		for (const transform_bench_case_t& bench_case : cases) {
+			std::vector<xr_mat4_t> new_locals = tree.locals;
+			std::vector<xr_mat4_t> locals = tree.locals;
+			std::vector<xr_mat4_t> worlds(count);
+
+			transform_graph_t graph;
+			TransformGraphInit(graph);
+			for (uint32_t node = 0; node < count; node++) {
+				TransformGraphAdd(graph, tree.parents[node], tree.locals[node]);
+			}
+			TransformGraphUpdate(graph);
+
+			// Both sides run every frame, one after the other, such that the noise of the machine hits both alike
+			int64_t full_ns = 0;
+			int64_t graph_ns = 0;
+			uint64_t changed = 0;
+			uint32_t full_passes_before = graph.stats.full_passes;
+			for (uint32_t frame = 1; frame <= frame_count; frame++) {
+				for (uint32_t node = frame % bench_case.stride; node < count; node += bench_case.stride) {
+					new_locals[node] = TransformBenchLocal(node, frame);
+				}
+
+				//--------------------------------------------------------------------------------------------------
+				// The transform graph. Setting the local matrices is part of the timing, as that's what marks the
+				// nodes dirty
+				//--------------------------------------------------------------------------------------------------
+				int64_t start = CoreTimeNowNs();
+				for (uint32_t node = frame % bench_case.stride; node < count; node += bench_case.stride) {
+					TransformGraphSetLocal(graph, node, new_locals[node]);
+				}
+				TransformGraphUpdate(graph);
+				graph_ns += CoreTimeNowNs() - start;
+				changed += graph.stats.changed;
+
+				//--------------------------------------------------------------------------------------------------
+				// Every world matrix again
+				//--------------------------------------------------------------------------------------------------
+				start = CoreTimeNowNs();
+				for (uint32_t node = frame % bench_case.stride; node < count; node += bench_case.stride) {
+					locals[node] = new_locals[node];
+				}
+				for (uint32_t node = 0; node < count; node++) {
+					uint32_t parent = tree.parents[node];
+					worlds[node] = parent == transform_no_parent ? locals[node] : XrMathMultiply(locals[node], worlds[parent]);
+				}
+				full_ns += CoreTimeNowNs() - start;
+				BenchKeep(worlds[frame % count].m[3][0]);
+			}
+
+			uint32_t mismatches = 0;
+			for (uint32_t node = 0; node < count; node++) {
+				const xr_mat4_t& a = worlds[node];
+				const xr_mat4_t& b = TransformGraphWorld(graph, node);
+				for (int i = 0; i < 16; i++) {
+					float expected = a.m[i / 4][i % 4];
+					if (std::fabs(expected - b.m[i / 4][i % 4]) > 1e-4f * (1.0f + std::fabs(expected))) {
+						mismatches++;
+						break;
+					}
+				}
+			}
+
+			std::string prefix = std::string(shape.name) + "_" + bench_case.name + "_";
+			BenchReport(context, prefix + "full_cpu", (double)full_ns / frame_count / 1000.0, "us");
+			BenchReport(context, prefix + "graph_cpu", (double)graph_ns / frame_count / 1000.0, "us");
+			BenchReport(context, prefix + "speedup", graph_ns > 0 ? (double)full_ns / (double)graph_ns : 0.0, "x");
+			BenchReport(context, prefix + "changed_per_frame", (double)changed / frame_count, "");
+			BenchReport(context, prefix + "full_passes", (double)(graph.stats.full_passes - full_passes_before), "");
+			BenchReport(context, prefix + "mismatches", (double)mismatches, "");
+			BenchCheck(context, prefix + "mismatches", mismatches == 0);
+		}
+	}
+}
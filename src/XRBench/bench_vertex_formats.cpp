@@ -0,0 +1,175 @@
+//###################################################################################################################
+// Vertex format benchmarks
+//###################################################################################################################
+// Fills a vertex buffer with the same mesh in several formats (see vertex_format.h) and transforms it on the
+// CPU, once with the version generated for the format and once with the version that looks at the layout at
+// runtime. Both have to give exactly the same result. The positions and normals are also compared with the
+// unquantized mesh, to see what the smaller formats cost in precision.
+#include "bench.h"
+#include "core_time.h"
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// The vertex of the cube (24 bytes)
+typedef vertex_format<
+	vertex_attribute<vertex_semantic_position, vertex_component_float3>,
+	vertex_attribute<vertex_semantic_normal, vertex_component_float3>> vertex_format_position_normal;
+
+// Only the position, e.g. for a depth pass (12 bytes)
+typedef vertex_format<
+	vertex_attribute<vertex_semantic_position, vertex_component_float3>> vertex_format_position;
+
+// A normal only needs 8 bit per component (16 bytes)
+typedef vertex_format<
+	vertex_attribute<vertex_semantic_position, vertex_component_float3>,
+	vertex_attribute<vertex_semantic_normal, vertex_component_snorm8x4>> vertex_format_compact;
+
+// Everything quantized, with a color (16 bytes)
+typedef vertex_format<
+	vertex_attribute<vertex_semantic_position, vertex_component_half4>,
+	vertex_attribute<vertex_semantic_normal, vertex_component_snorm8x4>,
+	vertex_attribute<vertex_semantic_color, vertex_component_unorm8x4>> vertex_format_half;
+
+// A textured mesh, where the transform has to skip over the attributes it doesn't need (36 bytes)
+typedef vertex_format<
+	vertex_attribute<vertex_semantic_position, vertex_component_float3>,
+	vertex_attribute<vertex_semantic_normal, vertex_component_float3>,
+	vertex_attribute<vertex_semantic_texcoord, vertex_component_float2>,
+	vertex_attribute<vertex_semantic_color, vertex_component_unorm8x4>> vertex_format_textured;
+
+static_assert(vertex_format_position_normal::stride == 24 && vertex_format_compact::stride == 16 && vertex_format_half::stride == 16 && vertex_format_textured::stride == 36, "Unexpected vertex format strides");
+static_assert(vertex_format_textured::Attribute(vertex_semantic_color).offset == 32, "Unexpected attribute offset");
+
+// A sphere with its normals, in float. Small enough that it doesn't need more than a half for the positions
+struct vertex_bench_mesh_t {
+	std::vector<XrVector3f> positions;
+	std::vector<XrVector3f> normals;
+};
+
+static void VertexBenchMesh(size_t vertex_count, vertex_bench_mesh_t& mesh) {
+	mesh.positions.resize(vertex_count);
+	mesh.normals.resize(vertex_count);
+	const float golden_angle = 2.39996323f;
+	for (size_t i = 0; i < vertex_count; i++) {
+		float y = 1.0f - 2.0f * ((float)i + 0.5f) / (float)vertex_count;
+		float ring = sqrtf(1.0f - y * y);
+		XrVector3f normal = { cosf(golden_angle * i) * ring, y, sinf(golden_angle * i) * ring };
+		float radius = 1.5f + 0.1f * sinf(7.0f * normal.x) * cosf(5.0f * normal.z);
+		mesh.normals[i] = normal;
+		mesh.positions[i] = { normal.x * radius, normal.y * radius, normal.z * radius };
+	}
+}
+
+// Writes the mesh into a vertex buffer of the format, with a color from the normal and texture coordinates
+// from the position
+template <typename Format>
+static std::vector<uint8_t> VertexBenchBuffer(const vertex_bench_mesh_t& mesh) {
+	std::vector<uint8_t> buffer(mesh.positions.size() * Format::stride);
+	for (size_t i = 0; i < mesh.positions.size(); i++) {
+		uint8_t* vertex = buffer.data() + i * Format::stride;
+		const XrVector3f& p = mesh.positions[i];
+		const XrVector3f& n = mesh.normals[i];
+		for (const vertex_attribute_t& attribute : Format::attributes) {
+			float values[4] = {};
+			switch (attribute.semantic) {
+			case vertex_semantic_position: values[0] = p.x; values[1] = p.y; values[2] = p.z; values[3] = 1.0f; break;
+			case vertex_semantic_normal: values[0] = n.x; values[1] = n.y; values[2] = n.z; break;
+			case vertex_semantic_color: values[0] = n.x * 0.5f + 0.5f; values[1] = n.y * 0.5f + 0.5f; values[2] = n.z * 0.5f + 0.5f; values[3] = 1.0f; break;
+			case vertex_semantic_texcoord: values[0] = p.x * 0.25f + 0.5f; values[1] = p.z * 0.25f + 0.5f; break;
+			}
+			VertexEncode(attribute.component, values, vertex + attribute.offset);
+		}
+	}
+	return buffer;
+}
+
+template <typename Format>
+static void VertexBenchFormat(bench_context_t& context, const char* name, const vertex_bench_mesh_t& mesh, uint32_t repetitions) {
+	const size_t vertex_count = mesh.positions.size();
+	std::vector<uint8_t> buffer = VertexBenchBuffer<Format>(mesh);
+	const vertex_layout_t layout = VertexLayoutOf<Format>();
+
+	xr_mat4_t world = XrMathAffine(2.0f, XrMathQuatFromEuler(0.3f, 0.7f, 0.1f), { 1.0f, 2.0f, -3.0f });
+	xr_mat4_t rotation = XrMathQuatToMatrix(XrMathQuatFromEuler(0.3f, 0.7f, 0.1f));
+	std::vector<float> specialized_xyzw(vertex_count * 4);
+	std::vector<float> runtime_xyzw(vertex_count * 4);
+	std::vector<XrVector3f> specialized_normals(vertex_count);
+	std::vector<XrVector3f> runtime_normals(vertex_count);
+
+	int64_t specialized_ns = 0;
+	int64_t runtime_ns = 0;
+	for (uint32_t r = 0; r < repetitions; r++) {
+		int64_t start = CoreTimeNowNs();
+		VertexTransform<Format>(buffer.data(), vertex_count, world, rotation, specialized_xyzw.data(), specialized_normals.data());
+		int64_t specialized_done = CoreTimeNowNs();
+		VertexTransform(layout, buffer.data(), vertex_count, world, rotation, runtime_xyzw.data(), runtime_normals.data());
+		runtime_ns += CoreTimeNowNs() - specialized_done;
+		specialized_ns += specialized_done - start;
+	}
+	BenchKeep(specialized_xyzw[vertex_count / 2]);
+	BenchKeep(runtime_xyzw[vertex_count / 2]);
+
+	//------------------------------------------------------------------------------------------------------
+	// Compare both versions with each other, and with the unquantized mesh
+	//------------------------------------------------------------------------------------------------------
+	std::vector<float> reference_xyzw(vertex_count * 4);
+	XrMathTransformPoints(world, mesh.positions.data(), reference_xyzw.data(), vertex_count);
+
+	uint32_t mismatches = 0;
+	float position_error = 0.0f;
+	float normal_error = 0.0f;
+	const bool has_normals = Format::Has(vertex_semantic_normal);
+	for (size_t i = 0; i < vertex_count; i++) {
+		if (memcmp(&specialized_xyzw[i * 4], &runtime_xyzw[i * 4], 4 * sizeof(float)) != 0 ||
+			(has_normals && memcmp(&specialized_normals[i], &runtime_normals[i], sizeof(XrVector3f)) != 0)) {
+			mismatches++;
+		}
+		for (int c = 0; c < 3; c++) {
+			position_error = std::max(position_error, fabsf(specialized_xyzw[i * 4 + c] - reference_xyzw[i * 4 + c]));
+		}
+		if (has_normals) {
+			const XrVector3f& n = mesh.normals[i];
+			const float(*m)[4] = rotation.m;
+			XrVector3f expected = {
+				n.x * m[0][0] + n.y * m[1][0] + n.z * m[2][0],
+				n.x * m[0][1] + n.y * m[1][1] + n.z * m[2][1],
+				n.x * m[0][2] + n.y * m[1][2] + n.z * m[2][2]
+			};
+			// The angle between the two from their cross product, which is more precise than acos for small angles
+			const XrVector3f& actual = specialized_normals[i];
+			XrVector3f cross = { expected.y * actual.z - expected.z * actual.y, expected.z * actual.x - expected.x * actual.z, expected.x * actual.y - expected.y * actual.x };
+			float sine = sqrtf(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z);
+			normal_error = std::max(normal_error, asinf(std::min(sine, 1.0f)) * 57.2957795f);
+		}
+	}
+
+	const double vertices = (double)vertex_count * repetitions;
+	std::string prefix = std::string(name) + "_";
+	BenchReport(context, prefix + "stride", (double)Format::stride, "B");
+	BenchReport(context, prefix + "specialized", (double)specialized_ns / vertices, "ns");
+	BenchReport(context, prefix + "runtime", (double)runtime_ns / vertices, "ns");
+	BenchReport(context, prefix + "mismatches", (double)mismatches, "");
+	BenchCheck(context, prefix + "mismatches", mismatches == 0);
+	BenchReport(context, prefix + "position_error", position_error * 1000.0f, "mm");
+	if (has_normals) {
+		BenchReport(context, prefix + "normal_error", normal_error, "deg");
+	}
+}
+
+XR_BENCH(vertex_formats) {
+	const size_t vertex_count = context.quick ? 4096 : 262144;
+	const uint32_t repetitions = context.quick ? 4 : 40;
+
+	vertex_bench_mesh_t mesh;
+	VertexBenchMesh(vertex_count, mesh);
+
+	VertexBenchFormat<vertex_format_position>(context, "position", mesh, repetitions);
+	VertexBenchFormat<vertex_format_position_normal>(context, "position_normal", mesh, repetitions);
+	VertexBenchFormat<vertex_format_compact>(context, "compact", mesh, repetitions);
+	VertexBenchFormat<vertex_format_half>(context, "half", mesh, repetitions);
+	VertexBenchFormat<vertex_format_textured>(context, "textured", mesh, repetitions);
+}
@@ -0,0 +1,49 @@
+#include "null_backend.h"
+
+void NullDeviceInit(null_device_t& device, resource_registry_t& registry) {
+	device = {};
+	device.registry = &registry;
+	device.next_handle = 0x1000;
+}
+
+uint64_t NullCreate(null_device_t& device, resource_category_t category, uint64_t bytes, const char* owner) {
+	// Handles look like pointers of a real device, so they're spread out the same way
+	uint64_t handle = device.next_handle;
+	device.next_handle += 0x40;
+	device.live_objects++;
+	device.created_objects++;
+	ResourceTrack(*device.registry, handle, category, bytes, owner);
+	return handle;
+}
+
+void NullRelease(null_device_t& device, uint64_t& handle) {
+	if (handle == 0) {
+		return;
+	}
+	ResourceRelease(*device.registry, handle);
+	device.live_objects--;
+	handle = 0;
+}
+
+void NullCreateSwapchain(null_device_t& device, uint32_t width, uint32_t height, uint32_t sample_count, uint32_t image_count, const char* owner, null_swapchain_t& swapchain) {
+	swapchain = {};
+	swapchain.width = width;
+	swapchain.height = height;
+	swapchain.handle = NullCreate(device, resource_swapchain, ResourceTextureBytes(width, height, 4, sample_count, 1, 1) * image_count, owner);
+	for (uint32_t i = 0; i < image_count; i++) {
+		swapchain.render_targets.push_back(NullCreate(device, resource_render_target_view, 0, owner));
+		swapchain.depth_targets.push_back(NullCreate(device, resource_depth_target, ResourceTextureBytes(width, height, 4, sample_count, 1, 1), owner));
+	}
+}
+
+void NullDestroySwapchain(null_device_t& device, null_swapchain_t& swapchain) {
+	for (uint64_t& render_target : swapchain.render_targets) {
+		NullRelease(device, render_target);
+	}
+	for (uint64_t& depth_target : swapchain.depth_targets) {
+		NullRelease(device, depth_target);
+	}
+	swapchain.render_targets.clear();
+	swapchain.depth_targets.clear();
+	NullRelease(device, swapchain.handle);
+}
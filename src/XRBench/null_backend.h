@@ -0,0 +1,46 @@
+#pragma once
+//###################################################################################################################
+// Null graphics backend
+//###################################################################################################################
+// A backend that doesn't draw anything. It hands out handles for the resources the application creates (with
+// the same structure: swapchains with a render target and a depth target per image, shaders, buffers, ...) and
+// tracks them in a resource registry exactly like the D3D11 code does. It also counts the live objects on its
+// own, like the debug layer of a real device would, such that the registry can be checked against it.
+
+#include "resource_registry.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+struct null_device_t {
+	resource_registry_t* registry;
+	uint64_t next_handle;
+	uint64_t live_objects; // Objects created and not released yet, counted independently of the registry
+	uint64_t created_objects;
+};
+
+struct null_swapchain_t {
+	uint64_t handle;
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint64_t> render_targets; // One per image
+	std::vector<uint64_t> depth_targets;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void NullDeviceInit(null_device_t& device, resource_registry_t& registry);
+
+// Creates a resource and tracks it. Returns its handle
+uint64_t NullCreate(null_device_t& device, resource_category_t category, uint64_t bytes, const char* owner);
+
+// Releases a resource and sets the handle to 0. Does nothing for a 0 handle
+void NullRelease(null_device_t& device, uint64_t& handle);
+
+// Same as CreateXrSwapchain in the application: the swapchain, and a render target and depth target per image
+void NullCreateSwapchain(null_device_t& device, uint32_t width, uint32_t height, uint32_t sample_count, uint32_t image_count, const char* owner, null_swapchain_t& swapchain);
+void NullDestroySwapchain(null_device_t& device, null_swapchain_t& swapchain);
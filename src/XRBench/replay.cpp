@@ -0,0 +1,120 @@
+#include "replay.h"
+#include "core_time.h"
+
+// Same clipping planes as the application
+static const float replay_near_clipping = 0.05f;
+static const float replay_far_clipping = 100.0f;
+static const XrDuration replay_pose_max_extrapolation = 50000000; // 50ms
+
+// FNV-1a, continued from the given hash
+static uint64_t ReplayHash(uint64_t hash, const void* data, size_t size) {
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+void ReplayInit(replay_state_t& replay) {
+	SimulationInit(replay.simulation);
+	OcclusionInit(replay.occlusion_buffer, 256, 128);
+	InputSnapshotInit(replay.input_snapshots);
+	PoseCacheInit(replay.hand_poses, input_max_hands, replay_pose_max_extrapolation);
+	FrameScheduleInit(replay.schedule);
+	replay.instance_lost = false;
+	SceneDrawCacheInit(replay.draw_cache);
+	replay.draw_list.clear();
+	replay.drawn_objects = 0;
+	replay.draw_hash = 14695981039346656037ull;
+}
+
+void ReplayFrame(replay_state_t& replay, const capture_frame_t& frame) {
+	//------------------------------------------------------------------------------------------------------
+	// Session events
+	//------------------------------------------------------------------------------------------------------
+	for (uint32_t i = 0; i < frame.event_count; i++) {
+		if (frame.events[i].kind == capture_event_session_state) {
+			FrameScheduleSessionState(replay.schedule, (uint32_t)frame.events[i].value);
+		}
+		else if (frame.events[i].kind == capture_event_instance_loss) {
+			replay.instance_lost = true;
+		}
+	}
+
+	frame_plan_t plan = FrameScheduleBegin(replay.schedule, frame.predicted_display_time, frame.predicted_display_period, frame.should_render);
+
+	//------------------------------------------------------------------------------------------------------
+	// Input and simulation
+	//------------------------------------------------------------------------------------------------------
+	// The recorded snapshot is published exactly like LocateOpenXrControllers does, such that the
+	// simulation reads it the same way. The hands go into the pose cache the same way as well: the ones that
+	// were located are pushed, the others lose their history
+	if (frame.has_input) {
+		input_snapshot_t input = frame.input;
+		InputSnapshotPublish(replay.input_snapshots, input);
+		for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+			if (input.hand_pose_valid & (1u << hand)) {
+				PoseCachePush(replay.hand_poses, hand, input.display_time, input.hand_poses[hand]);
+			} else {
+				PoseCacheClear(replay.hand_poses, hand);
+			}
+		}
+	}
+
+	input_snapshot_t input;
+	bool has_input = InputSnapshotRead(replay.input_snapshots, input);
+	SimulationUpdateFrame(replay.simulation, has_input ? &input : nullptr, replay.hand_poses, plan.display_time, plan.display_period, plan.missed_periods);
+
+	if (!plan.render) {
+		FrameScheduleEnd(replay.schedule);
+		return;
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Culling with the early views, drawing with the late latched ones
+	//------------------------------------------------------------------------------------------------------
+	// Like RenderOpenXrLayer, this also culls (and builds the draw list) if the runtime didn't locate any views
+	const capture_views_t& early_views = frame.views[capture_locate_early];
+	SimulationCull(replay.simulation, replay.occlusion_buffer, early_views.poses, early_views.fovs, early_views.count, replay_near_clipping, replay_far_clipping);
+	SceneUpdateDrawCache(replay.simulation.scene, replay.draw_cache, simulation_sun);
+	SceneBuildDrawList(replay.simulation.scene, replay.draw_list);
+	for (uint32_t object : replay.draw_list) {
+		replay.draw_hash = ReplayHash(replay.draw_hash, &replay.draw_cache.items[object], sizeof(scene_draw_item_t));
+	}
+
+	view_frustum_t frustums[capture_max_views];
+	for (uint32_t view = 0; view < early_views.count; view++) {
+		frustums[view] = ViewFrustum(early_views.poses[view], early_views.fovs[view], replay_near_clipping, replay_far_clipping, simulation_cull_margin);
+	}
+	ViewSplitDrawList(replay.simulation.scene, replay.draw_list, frustums, early_views.count, replay.view_draw_lists);
+
+	// The app draws as many views as the early locate returned. The late locate only replaces the poses of the
+	// views it returned, the others keep their early ones
+	const capture_views_t& late_views = frame.views[capture_locate_late];
+	for (uint32_t view = 0; view < early_views.count; view++) {
+		const capture_views_t& views = view < late_views.count ? late_views : early_views;
+		xr_mat4_t view_projection = XrMathViewProjectionTransposed(views.poses[view], XrMathProjectionFov(views.fovs[view], replay_near_clipping, replay_far_clipping));
+		replay.draw_hash = ReplayHash(replay.draw_hash, &view_projection, sizeof(view_projection));
+		replay.drawn_objects += replay.view_draw_lists[view].size();
+	}
+	FrameScheduleEnd(replay.schedule);
+}
+
+uint64_t ReplayChecksum(const replay_state_t& replay) {
+	uint64_t simulation_hash = SimulationChecksum(replay.simulation);
+	uint64_t hash = ReplayHash(replay.draw_hash, &simulation_hash, sizeof(simulation_hash));
+	hash = ReplayHash(hash, &replay.schedule.rendered_frames, sizeof(replay.schedule.rendered_frames));
+	return ReplayHash(hash, &replay.drawn_objects, sizeof(replay.drawn_objects));
+}
+
+bool ReplayCapture(replay_state_t& replay, capture_reader_t& reader, std::vector<double>* frame_ms) {
+	capture_frame_t frame;
+	while (CaptureReadFrame(reader, frame)) {
+		int64_t start = CoreTimeNowNs();
+		ReplayFrame(replay, frame);
+		if (frame_ms) {
+			frame_ms->push_back(CoreNsToMs(CoreTimeNowNs() - start));
+		}
+	}
+	return !reader.failed;
+}
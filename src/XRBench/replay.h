@@ -0,0 +1,56 @@
+#pragma once
+//###################################################################################################################
+// Replay of recorded frames
+//###################################################################################################################
+// Feeds a recording (see frame_capture.h) back through the CPU side of the frame loop of the application: The
+// session events, the input, the simulation update, the culling and the per-object matrices for each view. The
+// D3D calls are left out, the matrices are what the application would upload for them. As all inputs come from
+// the recording, two replays of the same recording always end up in the same state, no matter how fast the
+// machine is, so the time they take can be compared directly.
+
+#include "frame_capture.h"
+#include "frame_schedule.h"
+#include "input_snapshot.h"
+#include "occlusion.h"
+#include "pose_cache.h"
+#include "simulation.h"
+#include "view_layout.h"
+#include "xr_math.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+struct replay_state_t {
+	simulation_t simulation;
+	occlusion_buffer_t occlusion_buffer;
+	input_snapshot_buffer_t input_snapshots;
+	pose_cache_t hand_poses; // Filled from the recorded snapshots, like the application fills it when it locates the hands
+	frame_schedule_t schedule;
+	bool instance_lost;
+
+	scene_draw_cache_t draw_cache;
+	std::vector<uint32_t> draw_list; // The visible objects of the last rendered frame
+	std::vector<uint32_t> view_draw_lists[capture_max_views]; // The part of the draw list in the frustum of each view
+	uint64_t drawn_objects; // Summed over all rendered views
+	uint64_t draw_hash; // Hash over all draw items and view-projection matrices so far
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+// Sets up the same scene and buffers as the application does at startup
+void ReplayInit(replay_state_t& replay);
+
+// Does the work of RenderOpenXrFrame (and PollOpenXrEvents before it) for a recorded frame
+void ReplayFrame(replay_state_t& replay, const capture_frame_t& frame);
+
+// Hash of the simulation state and of everything that was drawn so far
+uint64_t ReplayChecksum(const replay_state_t& replay);
+
+// Replays a whole recording. Returns false if the recording is broken. frame_ms (optional) gets the CPU time
+// of every frame
+bool ReplayCapture(replay_state_t& replay, capture_reader_t& reader, std::vector<double>* frame_ms);
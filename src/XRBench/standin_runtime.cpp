@@ -0,0 +1,161 @@
+#include "standin_runtime.h"
+#include "core_time.h"
+#include "bench.h"
+
+#include <cmath>
+#include <thread>
+
+static const float standin_two_pi = 6.28318530718f;
+
+void StandinInit(standin_runtime_t& runtime, const standin_runtime_config_t& config) {
+	runtime = {};
+	runtime.config = config;
+	runtime.start_ns = CoreTimeNowNs();
+	runtime.next_display_time = 2 * config.display_period;
+}
+
+XrTime StandinNow(const standin_runtime_t& runtime) {
+	return CoreTimeNowNs() - runtime.start_ns;
+}
+
+// Yaw angle of the head and its first derivative at a given time
+static void StandinHeadYaw(const standin_runtime_t& runtime, XrTime time, float& yaw, float& yaw_velocity) {
+	float seconds = (float)((double)time / 1000000000.0);
+	float omega = standin_two_pi * runtime.config.head_yaw_frequency;
+	yaw = runtime.config.head_yaw_amplitude * sinf(omega * seconds);
+	yaw_velocity = runtime.config.head_yaw_amplitude * omega * cosf(omega * seconds);
+}
+
+static XrPosef StandinPoseFromYaw(float yaw) {
+	XrPosef pose = {};
+	pose.orientation = { 0.0f, sinf(yaw * 0.5f), 0.0f, cosf(yaw * 0.5f) };
+	pose.position = { 0.0f, 1.6f, 0.0f };
+	return pose;
+}
+
+// The inner views of a quad view setup have a much narrower fov than the outer ones
+static float StandinViewHalfAngle(uint32_t view) {
+	return view < 2 ? 0.785f : 0.35f;
+}
+
+XrPosef StandinTrueHeadPose(const standin_runtime_t& runtime, XrTime time) {
+	float yaw, yaw_velocity;
+	StandinHeadYaw(runtime, time, yaw, yaw_velocity);
+	return StandinPoseFromYaw(yaw);
+}
+
+uint32_t StandinLocateViews(standin_runtime_t& runtime, XrTime display_time, XrPosef* poses, XrFovf* fovs, uint32_t capacity) {
+	// Crossing into the runtime isn't free
+	BenchSpinFor(runtime.config.locate_cost_ns);
+	runtime.locate_calls++;
+
+	// Predict the head pose with a constant velocity model, starting from what is known right now
+	XrTime now = StandinNow(runtime);
+	float yaw, yaw_velocity;
+	StandinHeadYaw(runtime, now, yaw, yaw_velocity);
+	float horizon = (float)((double)(display_time - now) / 1000000000.0);
+	float predicted_yaw = yaw + yaw_velocity * horizon;
+	XrPosef head = StandinPoseFromYaw(predicted_yaw);
+
+	uint32_t view_count = runtime.config.view_count < capacity ? runtime.config.view_count : capacity;
+	for (uint32_t i = 0; i < view_count; i++) {
+		// Spread the eyes along the x axis of the head. With more than two views (e.g. quad view headsets),
+		// the additional views share the positions of the first two
+		float side = (i % 2 == 0) ? -0.5f : 0.5f;
+		float offset = side * runtime.config.eye_separation;
+		poses[i] = head;
+		poses[i].position.x += offset * cosf(predicted_yaw);
+		poses[i].position.z -= offset * sinf(predicted_yaw);
+
+		float half_angle = StandinViewHalfAngle(i);
+		fovs[i] = { -half_angle, half_angle, half_angle, -half_angle };
+	}
+
+	return view_count;
+}
+
+uint32_t StandinViewConfigurations(const standin_runtime_t& runtime, view_config_t* configs, uint32_t capacity) {
+	uint32_t view_count = runtime.config.view_count < capacity ? runtime.config.view_count : capacity;
+	for (uint32_t i = 0; i < view_count; i++) {
+		float density = runtime.config.pixels_per_radian * (i < 2 ? 1.0f : runtime.config.inner_density);
+		uint32_t size = (uint32_t)(2.0f * StandinViewHalfAngle(i) * density);
+		configs[i] = { size, size, 2 * size, 2 * size, 1 };
+	}
+	return view_count;
+}
+
+standin_frame_state_t StandinWaitFrame(standin_runtime_t& runtime) {
+	const XrDuration period = runtime.config.display_period;
+
+	// The application gets woken up two display periods before the frame is shown: one period
+	// for the CPU work, one for the GPU and the compositor. If the application is too late for
+	// a frame, that frame is dropped and we move on to the next one
+	XrTime now = StandinNow(runtime);
+	while (runtime.next_display_time - 2 * period < now - period / 2) {
+		runtime.next_display_time += period;
+	}
+
+	XrTime wake_time = runtime.next_display_time - 2 * period;
+	if (wake_time > now) {
+		std::this_thread::sleep_for(std::chrono::nanoseconds(wake_time - now));
+	}
+
+	standin_frame_state_t frame_state = {};
+	frame_state.predicted_display_time = runtime.next_display_time;
+	frame_state.predicted_display_period = period;
+	frame_state.should_render = true;
+
+	runtime.next_display_time += period;
+	runtime.frames_waited++;
+	return frame_state;
+}
+
+XrTime StandinEndFrame(standin_runtime_t& runtime, XrTime predicted_display_time) {
+	const XrDuration period = runtime.config.display_period;
+	XrTime now = StandinNow(runtime);
+	runtime.gpu_done_time = (now > runtime.gpu_done_time ? now : runtime.gpu_done_time) + runtime.config.gpu_cost_ns;
+
+	XrTime shown_time = predicted_display_time;
+	while (shown_time - runtime.config.compositor_ns < runtime.gpu_done_time) {
+		shown_time += period;
+	}
+
+	// The GPU works through the frames in order, so a frame is never due before the one before it. A frame
+	// that's late doesn't push the frames after it back as well, the newer one is shown instead
+	if (shown_time > predicted_display_time) {
+		runtime.frames_late++;
+	}
+	if (runtime.frames_shown > 0 && shown_time == runtime.last_shown_time) {
+		runtime.frames_replaced++;
+	}
+	runtime.frames_shown++;
+	runtime.last_shown_time = shown_time;
+	return shown_time;
+}
+
+void StandinSyncActions(standin_runtime_t& runtime) {
+	BenchSpinFor(runtime.config.sync_actions_cost_ns);
+	runtime.sync_calls++;
+	runtime.synced_frame = runtime.frames_waited;
+}
+
+float StandinGetActionState(standin_runtime_t& runtime, uint32_t action_index) {
+	BenchSpinFor(runtime.config.action_state_cost_ns);
+	runtime.action_state_calls++;
+
+	// Every action toggles with its own period, such that the states change every now and then
+	return ((runtime.synced_frame / (action_index + 7)) % 2) ? 1.0f : 0.0f;
+}
+
+XrPosef StandinLocateHand(standin_runtime_t& runtime, uint32_t hand, XrTime time) {
+	BenchSpinFor(runtime.config.locate_cost_ns);
+	runtime.locate_calls++;
+
+	// The hands move on small circles in front of the user
+	float seconds = (float)((double)time / 1000000000.0);
+	float angle = standin_two_pi * 0.5f * seconds + (hand == 0 ? 0.0f : 3.14159265f);
+	XrPosef pose = {};
+	pose.orientation = { 0.0f, 0.0f, 0.0f, 1.0f };
+	pose.position = { (hand == 0 ? -0.2f : 0.2f) + 0.05f * cosf(angle), 1.2f + 0.05f * sinf(angle), -0.4f };
+	return pose;
+}
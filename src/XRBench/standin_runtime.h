@@ -0,0 +1,99 @@
+#pragma once
+//###################################################################################################################
+// Stand-in OpenXR runtime
+//###################################################################################################################
+// A tiny simulation of the parts of an OpenXR runtime that matter for frame timing and pose prediction.
+// It lets us measure the frame loop on machines without a headset (or without an OpenXR runtime at all).
+//
+// The simulated head rotates back and forth around the vertical axis. Like a real runtime, the stand-in
+// predicts the pose for a display time by extrapolating the pose it "measured" at the time of the call
+// with the angular velocity at that time. The prediction error therefore grows with the prediction
+// horizon, which is exactly what late latching tries to reduce.
+
+#include "view_layout.h"
+#include "xr_core_types.h"
+
+#include <cstdint>
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+struct standin_runtime_config_t {
+	uint32_t view_count = 2; // Number of views returned by StandinLocateViews
+	XrDuration display_period = 11111111; // 90Hz
+	int64_t locate_cost_ns = 20000; // CPU cost of a call that locates views or spaces
+	float head_yaw_amplitude = 0.8f; // Amplitude of the head motion in radians
+	float head_yaw_frequency = 0.7f; // Frequency of the head motion in Hz
+	float eye_separation = 0.064f; // Distance between the two eyes in meters
+	float pixels_per_radian = 700.0f; // Recommended pixel density of the views
+	float inner_density = 2.0f; // The inner views of a quad view setup have this many times the pixel density
+	int64_t sync_actions_cost_ns = 15000; // CPU cost of xrSyncActions
+	int64_t action_state_cost_ns = 300; // CPU cost of a single xrGetActionState* call
+	int64_t gpu_cost_ns = 0; // GPU time of a frame submitted with StandinEndFrame
+	int64_t compositor_ns = 2000000; // The GPU work of a frame has to be done this long before it's displayed
+};
+
+// Mirrors the fields of XrFrameState that we care about
+struct standin_frame_state_t {
+	XrTime predicted_display_time;
+	XrDuration predicted_display_period;
+	bool should_render;
+};
+
+struct standin_runtime_t {
+	standin_runtime_config_t config;
+	int64_t start_ns; // CPU time at which the runtime was started, XrTime 0
+	XrTime next_display_time; // Display time of the next frame xrWaitFrame will return
+	uint64_t locate_calls; // Number of StandinLocateViews / StandinLocateHand calls
+	uint64_t frames_waited;
+	uint64_t sync_calls; // Number of StandinSyncActions calls
+	uint64_t action_state_calls; // Number of StandinGetActionState calls
+	uint64_t synced_frame; // Input state is only updated by StandinSyncActions, like in OpenXR
+
+	// The simulated GPU and display, see StandinEndFrame
+	XrTime gpu_done_time; // When the GPU finishes the work submitted so far
+	XrTime last_shown_time; // Display time of the last frame that was shown
+	uint64_t frames_shown;
+	uint64_t frames_late; // Frames that were shown later than their predicted display time
+	uint64_t frames_replaced; // Late frames that were never shown, as the next frame was ready for the same display time
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void StandinInit(standin_runtime_t& runtime, const standin_runtime_config_t& config);
+
+// Current time of the runtime clock
+XrTime StandinNow(const standin_runtime_t& runtime);
+
+// The actual pose of the head at a given time. Not something a real runtime could tell us, but
+// we need it to find out how wrong a predicted pose was
+XrPosef StandinTrueHeadPose(const standin_runtime_t& runtime, XrTime time);
+
+// Equivalent of xrLocateViews: Predicts the poses of the views for the given display time, based on
+// the head motion known at the time of the call
+uint32_t StandinLocateViews(standin_runtime_t& runtime, XrTime display_time, XrPosef* poses, XrFovf* fovs, uint32_t capacity);
+
+// Equivalent of xrEnumerateViewConfigurationViews: The recommended resolution of each view is its fov times
+// its pixel density, the maximum twice that
+uint32_t StandinViewConfigurations(const standin_runtime_t& runtime, view_config_t* configs, uint32_t capacity);
+
+// Equivalent of xrWaitFrame: Blocks until the runtime wants the application to start the next frame
+// and returns when that frame will be displayed
+standin_frame_state_t StandinWaitFrame(standin_runtime_t& runtime);
+
+// Equivalent of xrEndFrame: The GPU starts the work of the frame once it's done with the previous one. The
+// frame is shown at the first display time (starting at the predicted one) at which the GPU work is done
+// compositor_ns before. If the frame before was late and is due at the same display time, this frame replaces
+// it, like a compositor always shows the newest frame that's ready. Returns that display time. Must be called
+// from the thread that locates the views
+XrTime StandinEndFrame(standin_runtime_t& runtime, XrTime predicted_display_time);
+
+// Equivalent of xrSyncActions: Updates the action states that StandinGetActionState returns
+void StandinSyncActions(standin_runtime_t& runtime);
+
+// Equivalent of xrGetActionStateFloat (boolean actions just return 0.0 or 1.0)
+float StandinGetActionState(standin_runtime_t& runtime, uint32_t action_index);
+
+// Equivalent of xrLocateSpace for the grip space of a hand (0 = left, 1 = right)
+XrPosef StandinLocateHand(standin_runtime_t& runtime, uint32_t hand, XrTime time);
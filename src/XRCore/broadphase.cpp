@@ -0,0 +1,341 @@
+#include "broadphase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void BroadphaseInit(broadphase_t& broadphase, broadphase_method_t method, float cell_size) {
+	broadphase.method = method;
+	broadphase.body_count = 0;
+	broadphase.stats = {};
+	broadphase.cell_size = cell_size;
+	broadphase.bucket_mask = 0;
+	broadphase.order.clear();
+	broadphase.bucket_heads.clear();
+	broadphase.oversized.clear();
+}
+
+static void BroadphaseAddPair(std::vector<broadphase_pair_t>& pairs, uint32_t a, uint32_t b) {
+	pairs.push_back(a < b ? broadphase_pair_t{ a, b } : broadphase_pair_t{ b, a });
+}
+
+//------------------------------------------------------------------------------------------------------
+// Sweep and prune
+//------------------------------------------------------------------------------------------------------
+
+// Copies the bounds into the sorted arrays, in the current order
+static void BroadphaseGatherSorted(broadphase_t& broadphase, const broadphase_box_t* boxes, uint32_t count) {
+	for (uint32_t k = 0; k < count; k++) {
+		const broadphase_box_t& box = boxes[broadphase.order[k]];
+		broadphase.sorted_min_x[k] = box.min.x;
+		broadphase.sorted_max_x[k] = box.max.x;
+		broadphase.sorted_min_y[k] = box.min.y;
+		broadphase.sorted_max_y[k] = box.max.y;
+		broadphase.sorted_min_z[k] = box.min.z;
+		broadphase.sorted_max_z[k] = box.max.z;
+	}
+}
+
+static void BroadphaseSortFromScratch(broadphase_t& broadphase, const broadphase_box_t* boxes) {
+	std::sort(broadphase.order.begin(), broadphase.order.end(), [&](uint32_t a, uint32_t b) {
+		return boxes[a].min.x < boxes[b].min.x;
+	});
+}
+
+static void BroadphaseSweepAndPrune(broadphase_t& broadphase, const broadphase_box_t* boxes, uint32_t count, std::vector<broadphase_pair_t>& pairs) {
+	std::vector<uint32_t>& order = broadphase.order;
+	std::vector<float>& min_x = broadphase.sorted_min_x;
+
+	if (broadphase.stats.rebuilt) {
+		order.resize(count);
+		for (uint32_t i = 0; i < count; i++) {
+			order[i] = i;
+		}
+		BroadphaseSortFromScratch(broadphase, boxes);
+
+		// The padding is empty: it starts after everything ends, so the sweep always stops at it
+		const float inf = std::numeric_limits<float>::infinity();
+		for (std::vector<float>* mins : { &broadphase.sorted_min_x, &broadphase.sorted_min_y, &broadphase.sorted_min_z }) {
+			mins->assign(count + 4, inf);
+		}
+		for (std::vector<float>* maxs : { &broadphase.sorted_max_x, &broadphase.sorted_max_y, &broadphase.sorted_max_z }) {
+			maxs->assign(count + 4, -inf);
+		}
+	} else {
+		// Insertion sort of last frame's order by the new lower bounds. If the bodies jumped around instead of
+		// moving a little, it gives up and sorts from scratch
+		for (uint32_t k = 0; k < count; k++) {
+			min_x[k] = boxes[order[k]].min.x;
+		}
+		uint32_t max_moves = 8 * count + 64;
+		for (uint32_t k = 1; k < count && broadphase.stats.moved <= max_moves; k++) {
+			float key = min_x[k];
+			uint32_t body = order[k];
+			uint32_t j = k;
+			for (; j > 0 && min_x[j - 1] > key; j--) {
+				min_x[j] = min_x[j - 1];
+				order[j] = order[j - 1];
+			}
+			min_x[j] = key;
+			order[j] = body;
+			broadphase.stats.moved += k - j;
+		}
+		if (broadphase.stats.moved > max_moves) {
+			BroadphaseSortFromScratch(broadphase, boxes);
+		}
+	}
+	BroadphaseGatherSorted(broadphase, boxes, count);
+
+	// Each box against the following ones, four at a time, until one of them starts after it ends in x. As
+	// the boxes are sorted, the ones that start before it ends are always the first lanes
+	const float* max_x = broadphase.sorted_max_x.data();
+	const float* min_y = broadphase.sorted_min_y.data();
+	const float* max_y = broadphase.sorted_max_y.data();
+	const float* min_z = broadphase.sorted_min_z.data();
+	const float* max_z = broadphase.sorted_max_z.data();
+	for (uint32_t k = 0; k < count; k++) {
+		xr_vec4_t box_max_x = XrVecSplat(max_x[k]);
+		xr_vec4_t box_min_y = XrVecSplat(min_y[k]);
+		xr_vec4_t box_max_y = XrVecSplat(max_y[k]);
+		xr_vec4_t box_min_z = XrVecSplat(min_z[k]);
+		xr_vec4_t box_max_z = XrVecSplat(max_z[k]);
+
+		for (uint32_t j = k + 1;; j += 4) {
+			xr_vec4_t overlap_x = XrVecGreaterEqual(box_max_x, XrVecLoadUnaligned(min_x.data() + j));
+			uint32_t in_x = XrVecMaskBits(overlap_x);
+			if (in_x == 0) {
+				break;
+			}
+			broadphase.stats.tests++;
+
+			xr_vec4_t overlap_y = XrVecAnd(XrVecGreaterEqual(box_max_y, XrVecLoadUnaligned(min_y + j)), XrVecGreaterEqual(XrVecLoadUnaligned(max_y + j), box_min_y));
+			xr_vec4_t overlap_z = XrVecAnd(XrVecGreaterEqual(box_max_z, XrVecLoadUnaligned(min_z + j)), XrVecGreaterEqual(XrVecLoadUnaligned(max_z + j), box_min_z));
+			uint32_t hits = XrVecMaskBits(XrVecAnd(overlap_x, XrVecAnd(overlap_y, overlap_z)));
+			for (uint32_t lane = 0; hits; lane++, hits >>= 1) {
+				if (hits & 1) {
+					BroadphaseAddPair(pairs, order[k], order[j + lane]);
+				}
+			}
+			if (in_x != 0xF) {
+				break;
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// Spatial hash
+//------------------------------------------------------------------------------------------------------
+
+// The half of the neighbouring cells that are visited from each cell. For every other neighbour, this cell is
+// in that neighbour's half instead
+static const int32_t broadphase_half_neighbours[13][3] = {
+	{ 1, -1, -1 }, { 1, -1, 0 }, { 1, -1, 1 }, { 1, 0, -1 }, { 1, 0, 0 }, { 1, 0, 1 }, { 1, 1, -1 }, { 1, 1, 0 }, { 1, 1, 1 },
+	{ 0, 1, -1 }, { 0, 1, 0 }, { 0, 1, 1 },
+	{ 0, 0, 1 },
+};
+
+static uint32_t BroadphaseCellBucket(const broadphase_t& broadphase, int32_t x, int32_t y, int32_t z) {
+	return (((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u)) & broadphase.bucket_mask;
+}
+
+static void BroadphaseLink(broadphase_t& broadphase, uint32_t body, uint32_t bucket) {
+	uint32_t head = broadphase.bucket_heads[bucket];
+	broadphase.body_next[body] = head;
+	broadphase.body_prev[body] = broadphase_none;
+	if (head != broadphase_none) {
+		broadphase.body_prev[head] = body;
+	}
+	broadphase.bucket_heads[bucket] = body;
+	broadphase.body_bucket[body] = bucket;
+}
+
+static void BroadphaseUnlink(broadphase_t& broadphase, uint32_t body) {
+	uint32_t next = broadphase.body_next[body];
+	uint32_t prev = broadphase.body_prev[body];
+	if (prev != broadphase_none) {
+		broadphase.body_next[prev] = next;
+	} else {
+		broadphase.bucket_heads[broadphase.body_bucket[body]] = next;
+	}
+	if (next != broadphase_none) {
+		broadphase.body_prev[next] = prev;
+	}
+	broadphase.body_bucket[body] = broadphase_none;
+}
+
+static void BroadphaseSpatialHash(broadphase_t& broadphase, const broadphase_box_t* boxes, uint32_t count, std::vector<broadphase_pair_t>& pairs) {
+	if (broadphase.stats.rebuilt) {
+		// About two buckets per body, such that most lists are short
+		uint32_t bucket_count = 16;
+		while (bucket_count < count * 2) {
+			bucket_count *= 2;
+		}
+		broadphase.bucket_mask = bucket_count - 1;
+		broadphase.bucket_heads.assign(bucket_count, broadphase_none);
+		broadphase.body_next.assign(count, broadphase_none);
+		broadphase.body_prev.assign(count, broadphase_none);
+		broadphase.body_bucket.assign(count, broadphase_none);
+		broadphase.body_cells.assign(count * 3, 0);
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Move the bodies that changed their cell
+	//------------------------------------------------------------------------------------------------------
+	float inverse_cell = 1.0f / broadphase.cell_size;
+	broadphase.oversized.clear();
+	for (uint32_t i = 0; i < count; i++) {
+		const broadphase_box_t& box = boxes[i];
+		float cell_size = broadphase.cell_size;
+		bool oversized = box.max.x - box.min.x > cell_size || box.max.y - box.min.y > cell_size || box.max.z - box.min.z > cell_size;
+		int32_t cell[3] = {
+			(int32_t)std::floor((box.min.x + box.max.x) * 0.5f * inverse_cell),
+			(int32_t)std::floor((box.min.y + box.max.y) * 0.5f * inverse_cell),
+			(int32_t)std::floor((box.min.z + box.max.z) * 0.5f * inverse_cell),
+		};
+		int32_t* body_cell = &broadphase.body_cells[i * 3];
+		uint32_t bucket = oversized ? broadphase_none : BroadphaseCellBucket(broadphase, cell[0], cell[1], cell[2]);
+		bool same_cell = cell[0] == body_cell[0] && cell[1] == body_cell[1] && cell[2] == body_cell[2];
+
+		if (broadphase.stats.rebuilt || !same_cell || bucket != broadphase.body_bucket[i]) {
+			if (broadphase.body_bucket[i] != broadphase_none) {
+				BroadphaseUnlink(broadphase, i);
+			}
+			if (bucket != broadphase_none) {
+				BroadphaseLink(broadphase, i, bucket);
+			}
+			body_cell[0] = cell[0];
+			body_cell[1] = cell[1];
+			body_cell[2] = cell[2];
+			broadphase.stats.moved += broadphase.stats.rebuilt ? 0 : 1;
+		}
+		if (oversized) {
+			broadphase.oversized.push_back(i);
+		}
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Pairs
+	//------------------------------------------------------------------------------------------------------
+	// Different cells can share a bucket, so the cell of each body in the list is checked as well
+	for (uint32_t a = 0; a < count; a++) {
+		if (broadphase.body_bucket[a] == broadphase_none) {
+			continue;
+		}
+		const int32_t* cell = &broadphase.body_cells[a * 3];
+
+		// The own cell first, where only the bodies after this one are tested
+		for (uint32_t b = broadphase.bucket_heads[broadphase.body_bucket[a]]; b != broadphase_none; b = broadphase.body_next[b]) {
+			const int32_t* other = &broadphase.body_cells[b * 3];
+			if (b <= a || other[0] != cell[0] || other[1] != cell[1] || other[2] != cell[2]) {
+				continue;
+			}
+			broadphase.stats.tests++;
+			if (BroadphaseOverlap(boxes[a], boxes[b])) {
+				BroadphaseAddPair(pairs, a, b);
+			}
+		}
+
+		for (const int32_t* offset : broadphase_half_neighbours) {
+			int32_t x = cell[0] + offset[0];
+			int32_t y = cell[1] + offset[1];
+			int32_t z = cell[2] + offset[2];
+			uint32_t bucket = BroadphaseCellBucket(broadphase, x, y, z);
+			for (uint32_t b = broadphase.bucket_heads[bucket]; b != broadphase_none; b = broadphase.body_next[b]) {
+				const int32_t* other = &broadphase.body_cells[b * 3];
+				if (other[0] != x || other[1] != y || other[2] != z) {
+					continue;
+				}
+				broadphase.stats.tests++;
+				if (BroadphaseOverlap(boxes[a], boxes[b])) {
+					BroadphaseAddPair(pairs, a, b);
+				}
+			}
+		}
+	}
+
+	// Bodies larger than a cell against the bodies in the cells their box covers, plus one cell around it, as
+	// the bodies are in the cell of their center. Against the other large ones, each pair once. If a body
+	// covers more cells than there are bodies, it's faster to test all of them
+	for (uint32_t a : broadphase.oversized) {
+		const broadphase_box_t& box = boxes[a];
+		int32_t low[3] = {
+			(int32_t)std::floor(box.min.x * inverse_cell) - 1,
+			(int32_t)std::floor(box.min.y * inverse_cell) - 1,
+			(int32_t)std::floor(box.min.z * inverse_cell) - 1,
+		};
+		int32_t high[3] = {
+			(int32_t)std::floor(box.max.x * inverse_cell) + 1,
+			(int32_t)std::floor(box.max.y * inverse_cell) + 1,
+			(int32_t)std::floor(box.max.z * inverse_cell) + 1,
+		};
+		double covered = (double)(high[0] - low[0] + 1) * (double)(high[1] - low[1] + 1) * (double)(high[2] - low[2] + 1);
+
+		if (covered > (double)count) {
+			for (uint32_t b = 0; b < count; b++) {
+				if (broadphase.body_bucket[b] == broadphase_none) {
+					continue;
+				}
+				broadphase.stats.tests++;
+				if (BroadphaseOverlap(box, boxes[b])) {
+					BroadphaseAddPair(pairs, a, b);
+				}
+			}
+		} else {
+			for (int32_t x = low[0]; x <= high[0]; x++) {
+				for (int32_t y = low[1]; y <= high[1]; y++) {
+					for (int32_t z = low[2]; z <= high[2]; z++) {
+						uint32_t bucket = BroadphaseCellBucket(broadphase, x, y, z);
+						for (uint32_t b = broadphase.bucket_heads[bucket]; b != broadphase_none; b = broadphase.body_next[b]) {
+							const int32_t* other = &broadphase.body_cells[b * 3];
+							if (other[0] != x || other[1] != y || other[2] != z) {
+								continue;
+							}
+							broadphase.stats.tests++;
+							if (BroadphaseOverlap(box, boxes[b])) {
+								BroadphaseAddPair(pairs, a, b);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		for (uint32_t b : broadphase.oversized) {
+			if (b > a) {
+				broadphase.stats.tests++;
+				if (BroadphaseOverlap(box, boxes[b])) {
+					BroadphaseAddPair(pairs, a, b);
+				}
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// Update
+//------------------------------------------------------------------------------------------------------
+void BroadphaseUpdate(broadphase_t& broadphase, const broadphase_box_t* boxes, uint32_t count, std::vector<broadphase_pair_t>& pairs) {
+	pairs.clear();
+	broadphase.stats = {};
+	broadphase.stats.rebuilt = count != broadphase.body_count || (broadphase.method == broadphase_sweep_and_prune ? broadphase.order.size() != count : broadphase.bucket_heads.empty());
+	broadphase.body_count = count;
+
+	if (broadphase.method == broadphase_sweep_and_prune) {
+		BroadphaseSweepAndPrune(broadphase, boxes, count, pairs);
+	} else {
+		BroadphaseSpatialHash(broadphase, boxes, count, pairs);
+	}
+	broadphase.stats.pairs = (uint32_t)pairs.size();
+}
+
+void BroadphaseBruteForce(const broadphase_box_t* boxes, uint32_t count, std::vector<broadphase_pair_t>& pairs) {
+	pairs.clear();
+	for (uint32_t a = 0; a < count; a++) {
+		for (uint32_t b = a + 1; b < count; b++) {
+			if (BroadphaseOverlap(boxes[a], boxes[b])) {
+				pairs.push_back({ a, b });
+			}
+		}
+	}
+}
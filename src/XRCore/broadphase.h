@@ -0,0 +1,105 @@
+#pragma once
+//###################################################################################################################
+// Broadphase
+//###################################################################################################################
+// Finds the pairs of bodies whose axis aligned bounding boxes overlap, which are the only ones that can collide.
+// Testing every body against every other one is O(n²), which is already too slow for a few thousand bodies, so
+// there are two methods that only test bodies that are close to each other:
+//
+// Sweep and prune: the boxes are kept sorted by their lower x bound. Going through them in that order, a box
+// only needs to be tested against the following boxes up to the first one that starts after it ends in x.
+// The bounds are stored sorted as a structure of arrays, such that the following boxes are tested four at a
+// time with the vector functions of xr_math.h. The order is kept from frame to frame: as the bodies only move
+// a little, it's almost sorted already, and an insertion sort fixes it in close to linear time.
+//
+// Spatial hash: space is divided into a uniform grid of cells, which are hashed into a table of buckets. Each
+// body is in the bucket of the cell its center is in, and as a cell is at least as large as a body, a body can
+// only overlap bodies in its own cell and the 26 cells around it. Half of those neighbours are enough, as
+// every pair of cells is then visited once. A body is only moved to another bucket when it crosses into
+// another cell. Bodies that are larger than a cell are tested against the bodies in all the cells they cover.
+//
+// Sweep and prune works for any mix of sizes, the spatial hash is better for many bodies of about the same
+// size that are spread evenly, where the boxes along the x axis overlap a lot.
+
+#include "xr_core_types.h"
+#include "xr_math.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Enums
+//------------------------------------------------------------------------------------------------------
+enum broadphase_method_t {
+	broadphase_sweep_and_prune = 0,
+	broadphase_spatial_hash = 1
+};
+
+struct broadphase_box_t {
+	XrVector3f min;
+	XrVector3f max;
+};
+
+// Two bodies whose boxes overlap (touching counts as overlapping), a < b
+struct broadphase_pair_t {
+	uint32_t a;
+	uint32_t b;
+};
+
+// Of the last update
+struct broadphase_stats_t {
+	uint32_t moved; // Sweep and prune: steps of the insertion sort. Spatial hash: bodies that changed their cell
+	uint32_t tests; // Box tests, a group of four counts as one for sweep and prune
+	uint32_t pairs;
+	bool rebuilt; // The number of bodies changed, so everything was built from scratch
+};
+
+struct broadphase_t {
+	broadphase_method_t method;
+	uint32_t body_count;
+	broadphase_stats_t stats;
+
+	// Sweep and prune: the bodies sorted by their lower x bound, and their bounds in that order. There are
+	// 4 more entries than bodies, which never overlap anything, such that the last group of four can be loaded
+	std::vector<uint32_t> order;
+	std::vector<float> sorted_min_x;
+	std::vector<float> sorted_max_x;
+	std::vector<float> sorted_min_y;
+	std::vector<float> sorted_max_y;
+	std::vector<float> sorted_min_z;
+	std::vector<float> sorted_max_z;
+
+	// Spatial hash: each bucket is a doubly linked list of the bodies in it, such that a body can be moved to
+	// another bucket without going through the list
+	float cell_size;
+	uint32_t bucket_mask; // The number of buckets is a power of two
+	std::vector<uint32_t> bucket_heads;
+	std::vector<uint32_t> body_next;
+	std::vector<uint32_t> body_prev;
+	std::vector<uint32_t> body_bucket; // broadphase_none for the bodies that are larger than a cell
+	std::vector<int32_t> body_cells; // x, y and z of the cell of each body
+	std::vector<uint32_t> oversized;
+};
+
+const uint32_t broadphase_none = 0xFFFFFFFFu;
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+// cell_size is only used by the spatial hash. It should be about the size of the largest of the bodies
+void BroadphaseInit(broadphase_t& broadphase, broadphase_method_t method, float cell_size);
+
+// Finds the overlapping pairs of count boxes (the box of body i is boxes[i]) and replaces pairs with them.
+// If count is the same as in the last update, the bodies are taken to be the same, and only the changes
+// are applied
+void BroadphaseUpdate(broadphase_t& broadphase, const broadphase_box_t* boxes, uint32_t count, std::vector<broadphase_pair_t>& pairs);
+
+// Tests every pair, for checking the results of the other methods
+void BroadphaseBruteForce(const broadphase_box_t* boxes, uint32_t count, std::vector<broadphase_pair_t>& pairs);
+
+inline bool BroadphaseOverlap(const broadphase_box_t& a, const broadphase_box_t& b) {
+	return a.min.x <= b.max.x && b.min.x <= a.max.x &&
+		a.min.y <= b.max.y && b.min.y <= a.max.y &&
+		a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
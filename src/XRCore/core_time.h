@@ -0,0 +1,17 @@
+#pragma once
+//###################################################################################################################
+// CPU clock helpers
+//###################################################################################################################
+#include <chrono>
+#include <cstdint>
+
+// Returns a monotonic CPU timestamp in nanoseconds. This is used to measure how old data (e.g. a pose)
+// is when we finally use it, so only differences between two timestamps are meaningful
+inline int64_t CoreTimeNowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Converts a difference of two nanosecond timestamps to milliseconds
+inline double CoreNsToMs(int64_t ns) {
+	return (double)ns / 1000000.0;
+}
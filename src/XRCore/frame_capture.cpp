@@ -0,0 +1,385 @@
+#include "frame_capture.h"
+
+#include <cstring>
+
+// Identifies a capture file, followed by the version
+static const char capture_magic[8] = { 'X', 'R', 'C', 'A', 'P', 'T', 'U', 'R' };
+
+// Once the buffer of a writer is larger than this, it's written to the file
+static const size_t capture_flush_size = 64 * 1024;
+
+enum capture_record_t {
+	capture_record_frame_state = 1,
+	capture_record_views = 2,
+	capture_record_event = 3,
+	capture_record_input = 4,
+	capture_record_end_frame = 5
+};
+
+//###################################################################################################################
+// Encoding helpers
+//###################################################################################################################
+static void PutByte(std::vector<uint8_t>& out, uint8_t value) {
+	out.push_back(value);
+}
+
+static void PutVarint(std::vector<uint8_t>& out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+// Zigzag encoding maps small negative numbers to small positive ones (0, -1, 1, -2, ... to 0, 1, 2, 3, ...),
+// so they also only need a few bytes as a varint
+static void PutSignedVarint(std::vector<uint8_t>& out, int64_t value) {
+	PutVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void PutFloat(std::vector<uint8_t>& out, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	for (int i = 0; i < 4; i++) {
+		out.push_back((uint8_t)(bits >> (i * 8)));
+	}
+}
+
+static void PutPose(std::vector<uint8_t>& out, const XrPosef& pose) {
+	PutFloat(out, pose.orientation.x);
+	PutFloat(out, pose.orientation.y);
+	PutFloat(out, pose.orientation.z);
+	PutFloat(out, pose.orientation.w);
+	PutFloat(out, pose.position.x);
+	PutFloat(out, pose.position.y);
+	PutFloat(out, pose.position.z);
+}
+
+static void PutFov(std::vector<uint8_t>& out, const XrFovf& fov) {
+	PutFloat(out, fov.angleLeft);
+	PutFloat(out, fov.angleRight);
+	PutFloat(out, fov.angleUp);
+	PutFloat(out, fov.angleDown);
+}
+
+// The reading helpers set reader.truncated when they run past the end of the data, and return 0 from then on,
+// so the callers don't need to check after every value
+static uint8_t GetByte(capture_reader_t& reader) {
+	if (reader.position >= reader.data.size()) {
+		reader.truncated = true;
+		return 0;
+	}
+	return reader.data[reader.position++];
+}
+
+static uint64_t GetVarint(capture_reader_t& reader) {
+	uint64_t value = 0;
+	for (uint32_t shift = 0; shift < 64; shift += 7) {
+		uint8_t byte = GetByte(reader);
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			return value;
+		}
+	}
+	reader.failed = true;
+	return 0;
+}
+
+static int64_t GetSignedVarint(capture_reader_t& reader) {
+	uint64_t value = GetVarint(reader);
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static float GetFloat(capture_reader_t& reader) {
+	uint32_t bits = 0;
+	for (int i = 0; i < 4; i++) {
+		bits |= (uint32_t)GetByte(reader) << (i * 8);
+	}
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static XrPosef GetPose(capture_reader_t& reader) {
+	XrPosef pose;
+	pose.orientation.x = GetFloat(reader);
+	pose.orientation.y = GetFloat(reader);
+	pose.orientation.z = GetFloat(reader);
+	pose.orientation.w = GetFloat(reader);
+	pose.position.x = GetFloat(reader);
+	pose.position.y = GetFloat(reader);
+	pose.position.z = GetFloat(reader);
+	return pose;
+}
+
+static XrFovf GetFov(capture_reader_t& reader) {
+	XrFovf fov;
+	fov.angleLeft = GetFloat(reader);
+	fov.angleRight = GetFloat(reader);
+	fov.angleUp = GetFloat(reader);
+	fov.angleDown = GetFloat(reader);
+	return fov;
+}
+
+//###################################################################################################################
+// Writing
+//###################################################################################################################
+static void FlushCapture(capture_writer_t& writer) {
+	if (writer.file && !writer.buffer.empty()) {
+		fwrite(writer.buffer.data(), 1, writer.buffer.size(), writer.file);
+		writer.buffer.clear();
+	}
+}
+
+bool CaptureOpen(capture_writer_t& writer, const char* path) {
+	writer = {};
+	if (path) {
+		writer.file = fopen(path, "wb");
+		if (!writer.file) {
+			return false;
+		}
+	}
+
+	writer.buffer.reserve(capture_flush_size + 1024);
+	writer.buffer.insert(writer.buffer.end(), capture_magic, capture_magic + sizeof(capture_magic));
+	PutVarint(writer.buffer, capture_version);
+
+	writer.bytes = writer.buffer.size();
+	writer.open = true;
+	return true;
+}
+
+void CaptureClose(capture_writer_t& writer) {
+	if (writer.file) {
+		FlushCapture(writer);
+		fclose(writer.file);
+		writer.file = nullptr;
+	}
+	writer.open = false;
+}
+
+bool CaptureIsOpen(const capture_writer_t& writer) {
+	return writer.open;
+}
+
+// Called after every record, to keep track of the size and write out full buffers
+static void EndRecord(capture_writer_t& writer, size_t record_start) {
+	writer.bytes += writer.buffer.size() - record_start;
+	if (writer.buffer.size() >= capture_flush_size) {
+		FlushCapture(writer);
+	}
+}
+
+void CaptureFrameState(capture_writer_t& writer, XrTime predicted_display_time, XrDuration predicted_display_period, bool should_render) {
+	if (!CaptureIsOpen(writer)) {
+		return;
+	}
+
+	size_t start = writer.buffer.size();
+	PutByte(writer.buffer, capture_record_frame_state);
+	PutSignedVarint(writer.buffer, predicted_display_time - writer.last_display_time);
+	PutVarint(writer.buffer, (uint64_t)predicted_display_period);
+	PutByte(writer.buffer, should_render ? 1 : 0);
+	writer.last_display_time = predicted_display_time;
+	EndRecord(writer, start);
+}
+
+void CaptureViews(capture_writer_t& writer, uint32_t locate_index, const view_latch_t* latches, uint32_t view_count) {
+	if (!CaptureIsOpen(writer)) {
+		return;
+	}
+
+	if (view_count > capture_max_views) {
+		view_count = capture_max_views;
+	}
+
+	size_t start = writer.buffer.size();
+	PutByte(writer.buffer, capture_record_views);
+	PutByte(writer.buffer, (uint8_t)locate_index);
+	PutByte(writer.buffer, (uint8_t)view_count);
+	for (uint32_t i = 0; i < view_count; i++) {
+		PutPose(writer.buffer, latches[i].pose);
+		PutFov(writer.buffer, latches[i].fov);
+	}
+	EndRecord(writer, start);
+}
+
+void CaptureEvent(capture_writer_t& writer, capture_event_kind_t kind, int64_t value) {
+	if (!CaptureIsOpen(writer)) {
+		return;
+	}
+
+	size_t start = writer.buffer.size();
+	PutByte(writer.buffer, capture_record_event);
+	PutVarint(writer.buffer, (uint64_t)kind);
+	PutSignedVarint(writer.buffer, value);
+	EndRecord(writer, start);
+}
+
+void CaptureInput(capture_writer_t& writer, const input_snapshot_t& input) {
+	if (!CaptureIsOpen(writer)) {
+		return;
+	}
+
+	uint32_t action_count = input.action_count < input_max_actions ? input.action_count : input_max_actions;
+
+	// Most of the time, the buttons aren't touched, so only the values that differ from the last recorded
+	// input are stored
+	uint64_t differing = 0;
+	for (uint32_t i = 0; i < action_count; i++) {
+		if (input.action_values[i] != writer.last_input.action_values[i] || i >= writer.last_input.action_count) {
+			differing |= 1ull << i;
+		}
+	}
+
+	size_t start = writer.buffer.size();
+	PutByte(writer.buffer, capture_record_input);
+	PutVarint(writer.buffer, input.version - writer.last_input.version);
+	PutSignedVarint(writer.buffer, input.display_time - writer.last_display_time);
+	PutByte(writer.buffer, (uint8_t)input.hand_pose_valid);
+	PutByte(writer.buffer, (uint8_t)action_count);
+	PutVarint(writer.buffer, input.action_changed);
+	PutVarint(writer.buffer, differing);
+	for (uint32_t i = 0; i < action_count; i++) {
+		if (differing & (1ull << i)) {
+			PutFloat(writer.buffer, input.action_values[i]);
+		}
+	}
+	for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+		if (input.hand_pose_valid & (1u << hand)) {
+			PutPose(writer.buffer, input.hand_poses[hand]);
+		}
+	}
+	writer.last_input = input;
+	EndRecord(writer, start);
+}
+
+void CaptureEndFrame(capture_writer_t& writer) {
+	if (!CaptureIsOpen(writer)) {
+		return;
+	}
+
+	size_t start = writer.buffer.size();
+	PutByte(writer.buffer, capture_record_end_frame);
+	writer.frames++;
+	EndRecord(writer, start);
+}
+
+//###################################################################################################################
+// Reading
+//###################################################################################################################
+bool CaptureLoadMemory(capture_reader_t& reader, const uint8_t* data, size_t size) {
+	reader = {};
+	reader.data.assign(data, data + size);
+
+	if (size < sizeof(capture_magic) || memcmp(data, capture_magic, sizeof(capture_magic)) != 0) {
+		reader.failed = true;
+		return false;
+	}
+
+	reader.position = sizeof(capture_magic);
+	if (GetVarint(reader) != capture_version || reader.truncated) {
+		reader.failed = true;
+	}
+	return !reader.failed;
+}
+
+bool CaptureLoad(capture_reader_t& reader, const char* path) {
+	reader = {};
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		reader.failed = true;
+		return false;
+	}
+
+	std::vector<uint8_t> data;
+	uint8_t chunk[64 * 1024];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		data.insert(data.end(), chunk, chunk + read);
+	}
+	fclose(file);
+
+	return CaptureLoadMemory(reader, data.data(), data.size());
+}
+
+bool CaptureReadFrame(capture_reader_t& reader, capture_frame_t& frame) {
+	frame = {};
+	size_t frame_start = reader.position;
+	while (!reader.failed && reader.position < reader.data.size()) {
+		switch (GetByte(reader)) {
+		case capture_record_frame_state:
+			frame.predicted_display_time = reader.last_display_time + GetSignedVarint(reader);
+			frame.predicted_display_period = (XrDuration)GetVarint(reader);
+			frame.should_render = GetByte(reader) != 0;
+			reader.last_display_time = frame.predicted_display_time;
+			break;
+
+		case capture_record_views: {
+			uint32_t locate_index = GetByte(reader);
+			uint32_t view_count = GetByte(reader);
+			if (locate_index >= capture_locate_count || view_count > capture_max_views) {
+				reader.failed = true;
+				break;
+			}
+			capture_views_t& views = frame.views[locate_index];
+			views.count = view_count;
+			for (uint32_t i = 0; i < view_count; i++) {
+				views.poses[i] = GetPose(reader);
+				views.fovs[i] = GetFov(reader);
+			}
+			break;
+		}
+
+		case capture_record_event: {
+			capture_event_t event;
+			event.kind = (uint32_t)GetVarint(reader);
+			event.value = GetSignedVarint(reader);
+			if (frame.event_count < capture_max_events) {
+				frame.events[frame.event_count++] = event;
+			}
+			break;
+		}
+
+		case capture_record_input: {
+			input_snapshot_t& input = reader.last_input;
+			input.version += GetVarint(reader);
+			input.display_time = reader.last_display_time + GetSignedVarint(reader);
+			input.hand_pose_valid = GetByte(reader);
+			input.action_count = GetByte(reader);
+			input.action_changed = GetVarint(reader);
+			uint64_t differing = GetVarint(reader);
+			if (input.action_count > input_max_actions) {
+				reader.failed = true;
+				break;
+			}
+			for (uint32_t i = 0; i < input.action_count; i++) {
+				if (differing & (1ull << i)) {
+					input.action_values[i] = GetFloat(reader);
+				}
+			}
+			for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+				if (input.hand_pose_valid & (1u << hand)) {
+					input.hand_poses[hand] = GetPose(reader);
+				}
+			}
+			frame.has_input = true;
+			frame.input = input;
+			break;
+		}
+
+		case capture_record_end_frame:
+			return true;
+
+		default:
+			reader.failed = true;
+			break;
+		}
+	}
+
+	// Ran out of data before the end of the frame
+	if (reader.position > frame_start) {
+		reader.truncated = true;
+	}
+	return false;
+}
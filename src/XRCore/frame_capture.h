@@ -0,0 +1,134 @@
+#pragma once
+//###################################################################################################################
+// Frame capture
+//###################################################################################################################
+// Records everything from the outside world that goes into a frame: The frame state from xrWaitFrame, the
+// located views, the session events and the input. Everything else the application does only depends on
+// these, so feeding a recording back through the frame loop reproduces a session exactly, on any machine and
+// without a headset. That's what we use to compare the performance of two builds with the same workload.
+//
+// The recording is a compact binary stream. After a small header, it's a sequence of records, each of them a
+// type byte followed by its data. Integers are stored as varints (7 bits per byte, the high bit means "more
+// bytes follow"), times as the (zigzag encoded) difference to the previous frame, and floats as their 4 raw
+// bytes. All records between two frame end records belong to the same frame, a typical stereo frame takes
+// a bit more than 200 bytes.
+
+#include "input_snapshot.h"
+#include "late_latch.h"
+#include "xr_core_types.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------------------------------
+const uint32_t capture_version = 1;
+const uint32_t capture_max_views = 4;
+const uint32_t capture_max_events = 16; // Per frame, further events are dropped by the reader
+
+// The views are located twice per frame (see late_latch.h)
+const uint32_t capture_locate_early = 0; // The views the frame is prepared and culled with
+const uint32_t capture_locate_late = 1; // The late latched views the frame is rendered with
+const uint32_t capture_locate_count = 2;
+
+//------------------------------------------------------------------------------------------------------
+// Enums
+//------------------------------------------------------------------------------------------------------
+enum capture_event_kind_t {
+	capture_event_session_state = 1, // value is the new session state
+	capture_event_instance_loss = 2 // value is the time at which the instance will be lost
+};
+
+// Same values as XrSessionState, such that they can be converted directly
+enum capture_session_state_t {
+	capture_session_unknown = 0,
+	capture_session_idle = 1,
+	capture_session_ready = 2,
+	capture_session_synchronized = 3,
+	capture_session_visible = 4,
+	capture_session_focused = 5,
+	capture_session_stopping = 6,
+	capture_session_loss_pending = 7,
+	capture_session_exiting = 8
+};
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+struct capture_event_t {
+	uint32_t kind; // A capture_event_kind_t
+	int64_t value;
+};
+
+struct capture_views_t {
+	uint32_t count; // 0 if the views weren't located
+	XrPosef poses[capture_max_views];
+	XrFovf fovs[capture_max_views];
+};
+
+// Everything that was recorded for one frame
+struct capture_frame_t {
+	// From xrWaitFrame
+	XrTime predicted_display_time;
+	XrDuration predicted_display_period;
+	bool should_render;
+
+	capture_views_t views[capture_locate_count]; // Indexed by capture_locate_early / capture_locate_late
+
+	// The session events that were polled before this frame
+	uint32_t event_count;
+	capture_event_t events[capture_max_events];
+
+	bool has_input; // Only set for frames in which input was published
+	input_snapshot_t input;
+};
+
+struct capture_writer_t {
+	bool open;
+	FILE* file; // nullptr for a capture that's only kept in memory
+	std::vector<uint8_t> buffer; // Records that weren't written to the file yet (or the whole capture, if in memory)
+	XrTime last_display_time;
+	input_snapshot_t last_input; // Only values that changed since the last input are stored
+	uint64_t frames;
+	uint64_t bytes; // Total size of the capture so far
+};
+
+struct capture_reader_t {
+	std::vector<uint8_t> data;
+	size_t position;
+	XrTime last_display_time;
+	input_snapshot_t last_input;
+	bool failed; // Set if the data is broken, the reader doesn't return any further frames then
+	bool truncated; // Set if the capture ends in the middle of a frame (e.g. as the application crashed)
+};
+
+//------------------------------------------------------------------------------------------------------
+// Writing
+//------------------------------------------------------------------------------------------------------
+
+// Starts a new capture. If path is nullptr, the capture is only kept in writer.buffer
+bool CaptureOpen(capture_writer_t& writer, const char* path);
+
+// Writes out the rest of the capture and closes the file. An in memory capture stays in writer.buffer
+void CaptureClose(capture_writer_t& writer);
+
+bool CaptureIsOpen(const capture_writer_t& writer);
+
+// The record functions do nothing if the capture isn't open, so they can just be called unconditionally
+void CaptureFrameState(capture_writer_t& writer, XrTime predicted_display_time, XrDuration predicted_display_period, bool should_render);
+void CaptureViews(capture_writer_t& writer, uint32_t locate_index, const view_latch_t* latches, uint32_t view_count);
+void CaptureEvent(capture_writer_t& writer, capture_event_kind_t kind, int64_t value);
+void CaptureInput(capture_writer_t& writer, const input_snapshot_t& input);
+void CaptureEndFrame(capture_writer_t& writer);
+
+//------------------------------------------------------------------------------------------------------
+// Reading
+//------------------------------------------------------------------------------------------------------
+bool CaptureLoad(capture_reader_t& reader, const char* path);
+bool CaptureLoadMemory(capture_reader_t& reader, const uint8_t* data, size_t size);
+
+// Reads the next frame. Returns false at the end of the capture, or if the data is broken (then reader.failed
+// is set). A frame that was cut off at the end is ignored
+bool CaptureReadFrame(capture_reader_t& reader, capture_frame_t& frame);
@@ -0,0 +1,150 @@
+#include "frame_pacer.h"
+#include "core_time.h"
+
+#include <cmath>
+
+// Weight of a new sample in the moving averages. Costs above the expected one get a much higher weight
+static const double frame_cost_weight = 0.05;
+static const double frame_cost_weight_up = 0.5;
+
+void FrameCostInit(frame_cost_estimator_t& estimator) {
+	estimator = {};
+}
+
+void FrameCostAdd(frame_cost_estimator_t& estimator, int64_t cost_ns) {
+	double cost = (double)cost_ns;
+	if (estimator.samples == 0) {
+		estimator.mean_ns = cost;
+		estimator.variance_ns = 0.0;
+	} else {
+		double weight = cost > (double)FrameCostExpected(estimator) ? frame_cost_weight_up : frame_cost_weight;
+		double difference = cost - estimator.mean_ns;
+		estimator.mean_ns += weight * difference;
+		estimator.variance_ns = (1.0 - weight) * (estimator.variance_ns + weight * difference * difference);
+	}
+	estimator.samples++;
+}
+
+int64_t FrameCostExpected(const frame_cost_estimator_t& estimator) {
+	return (int64_t)(estimator.mean_ns + 2.0 * sqrt(estimator.variance_ns));
+}
+
+void FramePacerInit(frame_pacer_t& pacer, int64_t safety_ns) {
+	pacer.running = false;
+	pacer.has_frame = false;
+	pacer.frame_begun = true;
+	pacer.frame = {};
+	pacer.wait_function = nullptr;
+	pacer.wait_user = nullptr;
+	FrameCostInit(pacer.cost);
+	pacer.safety_ns = safety_ns;
+	pacer.submit_periods = 1.0;
+	pacer.work_start_ns = 0;
+	pacer.deadline_ns = 0;
+	pacer.stats = {};
+}
+
+// The wait thread
+static void FramePacerThread(frame_pacer_t* pacer) {
+	while (true) {
+		// OpenXR only allows the next xrWaitFrame once the frame of the last one was begun
+		{
+			std::unique_lock<std::mutex> lock(pacer->mutex);
+			pacer->changed.wait(lock, [pacer] { return !pacer->running || (pacer->frame_begun && !pacer->has_frame); });
+			if (!pacer->running) {
+				return;
+			}
+		}
+
+		frame_wait_result_t frame = {};
+		bool waited = pacer->wait_function(pacer->wait_user, frame);
+		frame.woke_ns = CoreTimeNowNs();
+
+		std::lock_guard<std::mutex> lock(pacer->mutex);
+		if (!waited) {
+			pacer->running = false;
+			pacer->changed.notify_all();
+			return;
+		}
+		pacer->frame = frame;
+		pacer->has_frame = true;
+		pacer->frame_begun = false;
+		pacer->changed.notify_all();
+	}
+}
+
+void FramePacerStart(frame_pacer_t& pacer, frame_wait_function_t wait_function, void* user) {
+	FramePacerStop(pacer);
+
+	pacer.running = true;
+	pacer.has_frame = false;
+	pacer.frame_begun = true;
+	pacer.wait_function = wait_function;
+	pacer.wait_user = user;
+	pacer.thread = std::thread(FramePacerThread, &pacer);
+}
+
+void FramePacerRequestStop(frame_pacer_t& pacer) {
+	std::lock_guard<std::mutex> lock(pacer.mutex);
+	pacer.running = false;
+	pacer.changed.notify_all();
+}
+
+void FramePacerStop(frame_pacer_t& pacer) {
+	FramePacerRequestStop(pacer);
+	if (pacer.thread.joinable()) {
+		pacer.thread.join();
+	}
+	pacer.has_frame = false;
+}
+
+bool FramePacerRunning(frame_pacer_t& pacer) {
+	std::lock_guard<std::mutex> lock(pacer.mutex);
+	return pacer.running;
+}
+
+bool FramePacerTakeFrame(frame_pacer_t& pacer, frame_wait_result_t& frame) {
+	int64_t start = CoreTimeNowNs();
+	std::unique_lock<std::mutex> lock(pacer.mutex);
+	pacer.changed.wait(lock, [&pacer] { return !pacer.running || pacer.has_frame; });
+	if (!pacer.has_frame) {
+		return false;
+	}
+	frame = pacer.frame;
+	pacer.has_frame = false;
+	pacer.stats.take_wait_ns += CoreTimeNowNs() - start;
+	return true;
+}
+
+void FramePacerWaitToStart(frame_pacer_t& pacer, const frame_wait_result_t& frame) {
+	pacer.deadline_ns = frame.display_ns - (int64_t)(pacer.submit_periods * (double)frame.predicted_display_period);
+
+	// Without any measured frames yet, we just start right away. A frame we got too late to make its deadline
+	// starts right away as well
+	int64_t now = CoreTimeNowNs();
+	if (pacer.cost.samples > 0) {
+		int64_t start = pacer.deadline_ns - FrameCostExpected(pacer.cost) - pacer.safety_ns;
+		if (start > now) {
+			std::this_thread::sleep_for(std::chrono::nanoseconds(start - now));
+			int64_t woke = CoreTimeNowNs();
+			pacer.stats.delayed_ns += woke - now;
+			now = woke;
+		}
+	}
+	pacer.work_start_ns = now;
+}
+
+void FramePacerBegun(frame_pacer_t& pacer) {
+	std::lock_guard<std::mutex> lock(pacer.mutex);
+	pacer.frame_begun = true;
+	pacer.changed.notify_all();
+}
+
+void FramePacerFrameDone(frame_pacer_t& pacer) {
+	int64_t now = CoreTimeNowNs();
+	FrameCostAdd(pacer.cost, now - pacer.work_start_ns);
+	pacer.stats.frames++;
+	if (now > pacer.deadline_ns) {
+		pacer.stats.late_frames++;
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+//###################################################################################################################
+// Frame pacing
+//###################################################################################################################
+// If one thread calls xrWaitFrame, xrBeginFrame, does the CPU work of the frame and calls xrEndFrame, nothing of
+// the next frame can start before xrEndFrame returned, and the wait for the next frame comes on top of the
+// work of the current one. So xrWaitFrame gets its own thread: it waits for a frame, hands the frame state to
+// the render thread, and as soon as the render thread began that frame (OpenXR doesn't allow waiting for the
+// next frame before that), it waits for the next one. While the render thread works on frame N, the wait for
+// frame N + 1 already runs.
+//
+// The render thread also doesn't start its work right when it gets the frame state: the later it starts, the
+// newer the poses it renders with. The frame has to be submitted one display period before its predicted
+// display time, the rest is left to the GPU and the compositor. The deadline comes from the predicted display
+// time and not from when the wait returned, as a wait thread that wakes up late would move the deadline (and
+// every frame after it) later as well. The work starts just in time for that deadline, as far before it as
+// the work is expected to take. The expected cost is the mean of the recent frames plus twice their standard deviation, plus a fixed
+// safety margin. A frame that starts late is worse than one that starts a bit early, so the estimate goes up
+// quickly when a frame takes longer than expected, and only slowly goes down again.
+//
+// Nothing in here knows about OpenXR: the application passes a function that calls xrWaitFrame, the
+// benchmarks one that calls the stand-in runtime.
+
+#include "xr_core_types.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+
+// What xrWaitFrame returned, and when
+struct frame_wait_result_t {
+	XrTime predicted_display_time;
+	XrDuration predicted_display_period;
+	bool should_render;
+	int64_t display_ns; // predicted_display_time on the CPU clock of CoreTimeNowNs, filled in by the wait function
+	int64_t woke_ns; // CPU time at which the wait returned
+};
+
+// Calls xrWaitFrame (or the equivalent). Returns false if the wait failed, the pacer stops then
+typedef bool (*frame_wait_function_t)(void* user, frame_wait_result_t& result);
+
+// Mean and variance of the recent CPU costs of a frame, as exponential moving averages
+struct frame_cost_estimator_t {
+	double mean_ns;
+	double variance_ns;
+	uint64_t samples;
+};
+
+struct frame_pacer_stats_t {
+	uint64_t frames;
+	uint64_t late_frames; // Frames whose work ended after the deadline
+	int64_t delayed_ns; // Time the render thread waited to start just in time, summed over all frames
+	int64_t take_wait_ns; // Time the render thread waited for a frame state, summed over all frames
+};
+
+struct frame_pacer_t {
+	// Shared between the two threads, guarded by mutex
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool running;
+	bool has_frame; // A frame state is waiting for the render thread
+	bool frame_begun; // The render thread began the last frame it took, so the next one may be waited for
+	frame_wait_result_t frame;
+
+	frame_wait_function_t wait_function;
+	void* wait_user;
+
+	// Only used by the render thread
+	frame_cost_estimator_t cost;
+	int64_t safety_ns; // Added to the expected cost
+	double submit_periods; // The deadline is this many display periods before the predicted display time
+	int64_t work_start_ns; // When the render thread started the work of the current frame
+	int64_t deadline_ns;
+	frame_pacer_stats_t stats;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void FrameCostInit(frame_cost_estimator_t& estimator);
+void FrameCostAdd(frame_cost_estimator_t& estimator, int64_t cost_ns);
+
+// The cost we plan with: the mean plus twice the standard deviation
+int64_t FrameCostExpected(const frame_cost_estimator_t& estimator);
+
+void FramePacerInit(frame_pacer_t& pacer, int64_t safety_ns);
+
+// Starts the wait thread. Waiting for the first frame starts right away
+void FramePacerStart(frame_pacer_t& pacer, frame_wait_function_t wait_function, void* user);
+
+// Tells the wait thread to stop, without waiting for it. It doesn't start another wait, but the one it's
+// in finishes first. Use this if something else has to happen before that wait can return
+void FramePacerRequestStop(frame_pacer_t& pacer);
+
+// Stops the wait thread, after its current wait returned. Does nothing if it isn't running
+void FramePacerStop(frame_pacer_t& pacer);
+
+bool FramePacerRunning(frame_pacer_t& pacer);
+
+// Render thread: Blocks until the wait thread has a frame state. Returns false if the pacer was stopped
+bool FramePacerTakeFrame(frame_pacer_t& pacer, frame_wait_result_t& frame);
+
+// Render thread: Sleeps until the work of the frame has to start, such that it ends just in time
+void FramePacerWaitToStart(frame_pacer_t& pacer, const frame_wait_result_t& frame);
+
+// Render thread: Call right after xrBeginFrame, lets the wait thread wait for the next frame
+void FramePacerBegun(frame_pacer_t& pacer);
+
+// Render thread: Call right after xrEndFrame, to learn the cost of the frame
+void FramePacerFrameDone(frame_pacer_t& pacer);
@@ -0,0 +1,60 @@
+#include "frame_schedule.h"
+#include "core_time.h"
+
+// XrSessionState values we need to know about
+static const uint32_t frame_session_visible = 4;
+static const uint32_t frame_session_focused = 5;
+
+void FrameScheduleInit(frame_schedule_t& schedule) {
+	schedule = {};
+}
+
+bool FrameSessionActive(uint32_t session_state) {
+	return session_state == frame_session_visible || session_state == frame_session_focused;
+}
+
+void FrameScheduleSessionState(frame_schedule_t& schedule, uint32_t session_state) {
+	schedule.session_state = session_state;
+}
+
+frame_plan_t FrameScheduleBegin(frame_schedule_t& schedule, XrTime display_time, XrDuration display_period, bool should_render) {
+	schedule.frame_start_ns = CoreTimeNowNs();
+
+	frame_plan_t plan = {};
+	plan.display_time = display_time;
+	plan.display_period = display_period;
+
+	// If the session isn't visible, or the runtime tells us it won't show the frame anyway (e.g. as the
+	// headset was taken off), we still have to end the frame, but without rendering any layers
+	plan.render = should_render && FrameSessionActive(schedule.session_state);
+
+	// Every display period without a frame of ours is one the compositor had to fill by reprojecting an
+	// older one
+	if (schedule.frames > 0 && display_period > 0 && display_time > schedule.last_display_time) {
+		XrDuration periods = (display_time - schedule.last_display_time + display_period / 2) / display_period;
+		plan.missed_periods = periods > 1 ? (uint32_t)(periods - 1) : 0;
+	}
+
+	schedule.last_display_time = display_time;
+	schedule.missed_periods += plan.missed_periods;
+	schedule.frames++;
+	if (plan.render) {
+		schedule.rendered_frames++;
+	}
+	return plan;
+}
+
+void FrameScheduleEnd(frame_schedule_t& schedule) {
+	if (schedule.frame_start_ns == 0) {
+		return;
+	}
+
+	double cpu_ms = CoreNsToMs(CoreTimeNowNs() - schedule.frame_start_ns);
+	schedule.cpu_ms_sum += cpu_ms;
+	schedule.cpu_ms_max = cpu_ms > schedule.cpu_ms_max ? cpu_ms : schedule.cpu_ms_max;
+	schedule.frame_start_ns = 0;
+}
+
+double FrameScheduleMeanCpuMs(const frame_schedule_t& schedule) {
+	return schedule.frames > 0 ? schedule.cpu_ms_sum / (double)schedule.frames : 0.0;
+}
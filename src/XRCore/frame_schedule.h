@@ -0,0 +1,56 @@
+#pragma once
+//###################################################################################################################
+// Frame scheduling
+//###################################################################################################################
+// The part of RenderOpenXrFrame that decides what a frame does, without calling into OpenXR: Given the frame
+// state from xrWaitFrame and the session state, should the layers be rendered at all, and how many display
+// periods did we miss since the last frame. It also keeps track of the CPU time each frame takes from the
+// end of xrWaitFrame to the end of xrEndFrame. The application, the replay and the benchmarks all schedule
+// their frames with it.
+
+#include "xr_core_types.h"
+
+#include <cstdint>
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+
+// What the current frame has to do
+struct frame_plan_t {
+	XrTime display_time; // Predicted display time of the frame
+	XrDuration display_period;
+	bool render; // If false, the frame is ended without any layers
+	uint32_t missed_periods; // Display periods between the last frame and this one that didn't get a frame
+};
+
+struct frame_schedule_t {
+	uint32_t session_state; // Same values as XrSessionState
+	XrTime last_display_time;
+	int64_t frame_start_ns; // CPU time at which the current frame started, 0 if there is no current frame
+
+	uint64_t frames;
+	uint64_t rendered_frames;
+	uint64_t missed_periods;
+	double cpu_ms_sum;
+	double cpu_ms_max;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void FrameScheduleInit(frame_schedule_t& schedule);
+
+// Only the VISIBLE and the FOCUSED state show anything we render
+bool FrameSessionActive(uint32_t session_state);
+
+// Called for every session state change event
+void FrameScheduleSessionState(frame_schedule_t& schedule, uint32_t session_state);
+
+// Called right after xrWaitFrame returned
+frame_plan_t FrameScheduleBegin(frame_schedule_t& schedule, XrTime display_time, XrDuration display_period, bool should_render);
+
+// Called right after xrEndFrame returned
+void FrameScheduleEnd(frame_schedule_t& schedule);
+
+double FrameScheduleMeanCpuMs(const frame_schedule_t& schedule);
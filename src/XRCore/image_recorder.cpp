@@ -0,0 +1,423 @@
+#include "image_recorder.h"
+#include "core_time.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+//------------------------------------------------------------------------------------------------------
+// Encoders
+//------------------------------------------------------------------------------------------------------
+static bool ImageRecorderWrite(const std::string& directory, uint64_t frame, uint32_t view, const std::vector<uint8_t>& encoded) {
+	char name[64];
+	snprintf(name, sizeof(name), "/frame_%06llu_view%u.qoi", (unsigned long long)frame, view);
+	FILE* file = fopen((directory + name).c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	bool written = fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size();
+	return fclose(file) == 0 && written;
+}
+
+static void ImageRecorderEncoder(image_recorder_t* recorder) {
+	std::vector<uint8_t> encoded;
+	std::unique_lock<std::mutex> lock(recorder->mutex);
+	while (true) {
+		recorder->work_ready.wait(lock, [&] { return !recorder->running || !recorder->encode_queue.empty(); });
+		// The queue is emptied before the encoders stop
+		if (recorder->encode_queue.empty()) {
+			return;
+		}
+		uint32_t index = recorder->encode_queue.front();
+		recorder->encode_queue.pop_front();
+		image_slot_t slot = recorder->slots[index];
+		lock.unlock();
+
+		int64_t start = CoreTimeNowNs();
+		encoded.clear();
+		ImageEncodeQoi(slot.pixels, slot.width, slot.height, slot.row_pitch, recorder->readback.bgra, encoded);
+		int64_t encode_ns = CoreTimeNowNs() - start;
+		bool written = recorder->directory.empty() || ImageRecorderWrite(recorder->directory, slot.frame, slot.view, encoded);
+
+		lock.lock();
+		recorder->stats.written += written ? 1 : 0;
+		recorder->stats.failed_writes += written ? 0 : 1;
+		recorder->stats.raw_bytes += (uint64_t)slot.width * slot.height * 4;
+		recorder->stats.encoded_bytes += encoded.size();
+		recorder->stats.encode_ns += encode_ns;
+		recorder->slots[index].state = image_slot_encoded;
+		recorder->work_done.notify_all();
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// Recorder
+//------------------------------------------------------------------------------------------------------
+void ImageRecorderInit(image_recorder_t& recorder, const image_readback_t& readback, uint32_t slot_count, uint32_t encoder_count, const char* directory, uint32_t interval, uint32_t latency_frames) {
+	recorder.readback = readback;
+	recorder.directory = directory ? directory : "";
+	recorder.interval = interval;
+	recorder.latency_frames = latency_frames;
+	recorder.frame = 0;
+	recorder.record_frame = false;
+	recorder.requested = false;
+	recorder.running = true;
+	recorder.encode_queue.clear();
+	recorder.slots.assign(slot_count, image_slot_t{});
+	recorder.stats = {};
+	// Without an encoder, nothing would ever be written
+	for (uint32_t i = 0; i < std::max(encoder_count, 1u); i++) {
+		recorder.encoders.emplace_back(ImageRecorderEncoder, &recorder);
+	}
+}
+
+// Unmaps the slots the encoders are done with and hands the copies that are done to the encoders. With
+// any_age, the copies are mapped no matter how recent they are. Returns the number of slots in use
+//
+// Mapping and unmapping go to the graphics API and can take a while, so they run without holding the mutex,
+// which the encoders need to get their next image. That's safe as only the render thread moves a slot out of
+// the copying and the encoded states, the encoders only ever move it from encoding to encoded
+static uint32_t ImageRecorderPoll(image_recorder_t& recorder, bool any_age) {
+	std::vector<uint32_t> encoded;
+	std::vector<uint32_t> copied;
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		for (uint32_t i = 0; i < (uint32_t)recorder.slots.size(); i++) {
+			const image_slot_t& slot = recorder.slots[i];
+			if (slot.state == image_slot_encoded) {
+				encoded.push_back(i);
+			}
+			else if (slot.state == image_slot_copying && (any_age || recorder.frame >= slot.frame + recorder.latency_frames)) {
+				copied.push_back(i);
+			}
+		}
+	}
+
+	for (uint32_t slot : encoded) {
+		recorder.readback.unmap(recorder.readback.user, slot);
+	}
+	std::vector<bool> mapped(copied.size());
+	std::vector<const uint8_t*> pixels(copied.size(), nullptr);
+	std::vector<uint32_t> row_pitches(copied.size(), 0);
+	for (uint32_t i = 0; i < (uint32_t)copied.size(); i++) {
+		mapped[i] = recorder.readback.map(recorder.readback.user, copied[i], pixels[i], row_pitches[i]);
+	}
+
+	uint32_t busy = 0;
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		for (uint32_t slot : encoded) {
+			recorder.slots[slot] = {};
+		}
+		for (uint32_t i = 0; i < (uint32_t)copied.size(); i++) {
+			image_slot_t& slot = recorder.slots[copied[i]];
+			if (mapped[i]) {
+				slot.pixels = pixels[i];
+				slot.row_pitch = row_pitches[i];
+				slot.state = image_slot_encoding;
+				recorder.encode_queue.push_back(copied[i]);
+				queued = true;
+			} else {
+				recorder.stats.map_retries++;
+			}
+		}
+		for (const image_slot_t& slot : recorder.slots) {
+			busy += slot.state != image_slot_free ? 1 : 0;
+		}
+	}
+	if (queued) {
+		recorder.work_ready.notify_all();
+	}
+	return busy;
+}
+
+void ImageRecorderShutdown(image_recorder_t& recorder, uint32_t timeout_ms) {
+	int64_t give_up_ns = CoreTimeNowNs() + (int64_t)timeout_ms * 1000000;
+	while (ImageRecorderPoll(recorder, true) > 0) {
+		std::unique_lock<std::mutex> lock(recorder.mutex);
+		bool encoding = false;
+		for (image_slot_t& slot : recorder.slots) {
+			encoding = encoding || slot.state == image_slot_encoding;
+		}
+
+		// Copies that still aren't done are dropped, but the ones being encoded are always waited for, as
+		// the encoders read from their mapped memory
+		if (!encoding && CoreTimeNowNs() > give_up_ns) {
+			for (image_slot_t& slot : recorder.slots) {
+				if (slot.state == image_slot_copying) {
+					recorder.stats.dropped++;
+					slot = {};
+				}
+			}
+			continue;
+		}
+		recorder.work_done.wait_for(lock, std::chrono::milliseconds(1));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		recorder.running = false;
+	}
+	recorder.work_ready.notify_all();
+	for (std::thread& encoder : recorder.encoders) {
+		encoder.join();
+	}
+	recorder.encoders.clear();
+}
+
+void ImageRecorderRequest(image_recorder_t& recorder) {
+	recorder.requested = true;
+}
+
+bool ImageRecorderBeginFrame(image_recorder_t& recorder, uint64_t frame) {
+	int64_t start = CoreTimeNowNs();
+	recorder.frame = frame;
+	recorder.record_frame = recorder.requested || (recorder.interval > 0 && frame % recorder.interval == 0);
+	recorder.requested = false;
+	ImageRecorderPoll(recorder, false);
+
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	recorder.stats.render_thread_ns += CoreTimeNowNs() - start;
+	return recorder.record_frame;
+}
+
+void ImageRecorderCaptureView(image_recorder_t& recorder, uint32_t view, const void* source, uint32_t width, uint32_t height) {
+	if (!recorder.record_frame) {
+		return;
+	}
+	int64_t start = CoreTimeNowNs();
+
+	// Only the render thread takes free slots, so the slot can't be taken while the copy is queued
+	uint32_t free_slot = (uint32_t)recorder.slots.size();
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		recorder.stats.requested++;
+		for (uint32_t i = 0; i < (uint32_t)recorder.slots.size() && free_slot == recorder.slots.size(); i++) {
+			free_slot = recorder.slots[i].state == image_slot_free ? i : free_slot;
+		}
+	}
+
+	bool copied = free_slot < recorder.slots.size() && recorder.readback.copy(recorder.readback.user, free_slot, source, width, height);
+
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	if (copied) {
+		image_slot_t& slot = recorder.slots[free_slot];
+		slot = {};
+		slot.state = image_slot_copying;
+		slot.frame = recorder.frame;
+		slot.view = view;
+		slot.width = width;
+		slot.height = height;
+	} else {
+		recorder.stats.dropped++;
+	}
+	recorder.stats.render_thread_ns += CoreTimeNowNs() - start;
+}
+
+image_recorder_stats_t ImageRecorderStats(image_recorder_t& recorder) {
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	return recorder.stats;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Software readback
+//------------------------------------------------------------------------------------------------------
+static bool ImageSoftwareCopy(void* user, uint32_t slot, const void* source, uint32_t width, uint32_t height) {
+	image_readback_software_t& software = *(image_readback_software_t*)user;
+	if (slot >= software.staging.size()) {
+		software.staging.resize(slot + 1);
+		software.widths.resize(slot + 1);
+	}
+	const uint8_t* pixels = (const uint8_t*)source;
+	software.staging[slot].assign(pixels, pixels + (size_t)width * height * 4);
+	software.widths[slot] = width;
+	return true;
+}
+
+static bool ImageSoftwareMap(void* user, uint32_t slot, const uint8_t*& pixels, uint32_t& row_pitch) {
+	image_readback_software_t& software = *(image_readback_software_t*)user;
+	pixels = software.staging[slot].data();
+	row_pitch = software.widths[slot] * 4;
+	return true;
+}
+
+static void ImageSoftwareUnmap(void*, uint32_t) {
+}
+
+image_readback_t ImageReadbackSoftware(image_readback_software_t& software) {
+	image_readback_t readback = {};
+	readback.copy = ImageSoftwareCopy;
+	readback.map = ImageSoftwareMap;
+	readback.unmap = ImageSoftwareUnmap;
+	readback.user = &software;
+	readback.bgra = false;
+	return readback;
+}
+
+//------------------------------------------------------------------------------------------------------
+// QOI
+//------------------------------------------------------------------------------------------------------
+// Every pixel becomes one of: a run of the previous pixel, an index into the 64 recently seen pixels, a small
+// difference to the previous pixel (in 1 or 2 bytes), or the full pixel
+static const uint8_t qoi_op_index = 0x00;
+static const uint8_t qoi_op_diff = 0x40;
+static const uint8_t qoi_op_luma = 0x80;
+static const uint8_t qoi_op_run = 0xC0;
+static const uint8_t qoi_op_rgb = 0xFE;
+static const uint8_t qoi_op_rgba = 0xFF;
+static const uint8_t qoi_end_marker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+struct qoi_pixel_t {
+	uint8_t r, g, b, a;
+};
+
+static uint32_t QoiHash(const qoi_pixel_t& pixel) {
+	return (pixel.r * 3u + pixel.g * 5u + pixel.b * 7u + pixel.a * 11u) % 64u;
+}
+
+static bool QoiEqual(const qoi_pixel_t& a, const qoi_pixel_t& b) {
+	return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+void ImageEncodeQoi(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t row_pitch, bool bgra, std::vector<uint8_t>& out) {
+	// The worst case is 5 bytes per pixel, so reserving that avoids growing the vector while encoding
+	size_t start = out.size();
+	out.resize(start + 14 + (size_t)width * height * 5 + sizeof(qoi_end_marker));
+	uint8_t* write = out.data() + start;
+
+	memcpy(write, "qoif", 4);
+	write[4] = (uint8_t)(width >> 24); write[5] = (uint8_t)(width >> 16); write[6] = (uint8_t)(width >> 8); write[7] = (uint8_t)width;
+	write[8] = (uint8_t)(height >> 24); write[9] = (uint8_t)(height >> 16); write[10] = (uint8_t)(height >> 8); write[11] = (uint8_t)height;
+	write[12] = 4; // RGBA
+	write[13] = 0; // sRGB with linear alpha
+	write += 14;
+
+	qoi_pixel_t index[64] = {};
+	qoi_pixel_t previous = { 0, 0, 0, 255 };
+	uint32_t run = 0;
+	uint32_t red = bgra ? 2 : 0;
+	uint32_t blue = bgra ? 0 : 2;
+
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t* row = pixels + (size_t)y * row_pitch;
+		for (uint32_t x = 0; x < width; x++) {
+			const uint8_t* source = row + x * 4;
+			qoi_pixel_t pixel = { source[red], source[1], source[blue], source[3] };
+
+			if (QoiEqual(pixel, previous)) {
+				run++;
+				if (run == 62) {
+					*write++ = qoi_op_run | (uint8_t)(run - 1);
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0) {
+				*write++ = qoi_op_run | (uint8_t)(run - 1);
+				run = 0;
+			}
+
+			uint32_t hash = QoiHash(pixel);
+			if (QoiEqual(index[hash], pixel)) {
+				*write++ = qoi_op_index | (uint8_t)hash;
+			} else {
+				index[hash] = pixel;
+				if (pixel.a == previous.a) {
+					int8_t dr = (int8_t)(pixel.r - previous.r);
+					int8_t dg = (int8_t)(pixel.g - previous.g);
+					int8_t db = (int8_t)(pixel.b - previous.b);
+					int8_t dr_dg = (int8_t)(dr - dg);
+					int8_t db_dg = (int8_t)(db - dg);
+					if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+						*write++ = qoi_op_diff | (uint8_t)((dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+					} else if (dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8) {
+						*write++ = qoi_op_luma | (uint8_t)(dg + 32);
+						*write++ = (uint8_t)((dr_dg + 8) << 4 | (db_dg + 8));
+					} else {
+						*write++ = qoi_op_rgb;
+						*write++ = pixel.r;
+						*write++ = pixel.g;
+						*write++ = pixel.b;
+					}
+				} else {
+					*write++ = qoi_op_rgba;
+					*write++ = pixel.r;
+					*write++ = pixel.g;
+					*write++ = pixel.b;
+					*write++ = pixel.a;
+				}
+			}
+			previous = pixel;
+		}
+	}
+	if (run > 0) {
+		*write++ = qoi_op_run | (uint8_t)(run - 1);
+	}
+
+	memcpy(write, qoi_end_marker, sizeof(qoi_end_marker));
+	write += sizeof(qoi_end_marker);
+	out.resize(write - out.data());
+}
+
+bool ImageDecodeQoi(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height, std::vector<uint8_t>& pixels) {
+	if (size < 14 + sizeof(qoi_end_marker) || memcmp(data, "qoif", 4) != 0 || data[12] != 4) {
+		return false;
+	}
+	width = (uint32_t)data[4] << 24 | (uint32_t)data[5] << 16 | (uint32_t)data[6] << 8 | data[7];
+	height = (uint32_t)data[8] << 24 | (uint32_t)data[9] << 16 | (uint32_t)data[10] << 8 | data[11];
+	size_t pixel_count = (size_t)width * height;
+	pixels.resize(pixel_count * 4);
+
+	qoi_pixel_t index[64] = {};
+	qoi_pixel_t pixel = { 0, 0, 0, 255 };
+	uint32_t run = 0;
+	size_t read = 14;
+	size_t chunks_end = size - sizeof(qoi_end_marker);
+
+	for (size_t i = 0; i < pixel_count; i++) {
+		if (run > 0) {
+			run--;
+		} else if (read < chunks_end) {
+			uint8_t op = data[read++];
+			if (op == qoi_op_rgb) {
+				if (read + 3 > chunks_end) {
+					return false;
+				}
+				pixel.r = data[read++];
+				pixel.g = data[read++];
+				pixel.b = data[read++];
+			} else if (op == qoi_op_rgba) {
+				if (read + 4 > chunks_end) {
+					return false;
+				}
+				pixel.r = data[read++];
+				pixel.g = data[read++];
+				pixel.b = data[read++];
+				pixel.a = data[read++];
+			} else if ((op & 0xC0) == qoi_op_index) {
+				pixel = index[op];
+			} else if ((op & 0xC0) == qoi_op_diff) {
+				pixel.r += ((op >> 4) & 3) - 2;
+				pixel.g += ((op >> 2) & 3) - 2;
+				pixel.b += (op & 3) - 2;
+			} else if ((op & 0xC0) == qoi_op_luma && read < chunks_end) {
+				uint8_t second = data[read++];
+				int dg = (op & 0x3F) - 32;
+				pixel.r += dg - 8 + ((second >> 4) & 0xF);
+				pixel.g += dg;
+				pixel.b += dg - 8 + (second & 0xF);
+			} else if ((op & 0xC0) == qoi_op_run) {
+				run = op & 0x3F;
+			} else {
+				return false;
+			}
+			index[QoiHash(pixel)] = pixel;
+		} else {
+			return false;
+		}
+		memcpy(&pixels[i * 4], &pixel, 4);
+	}
+	return true;
+}
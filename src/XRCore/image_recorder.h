@@ -0,0 +1,141 @@
+#pragma once
+//###################################################################################################################
+// Image recording
+//###################################################################################################################
+// Writes the images we rendered to disk, for QA and for comparing what two builds rendered. Reading back a
+// swapchain image right after rendering it would stall the render thread until the GPU is done with it, so
+// the recording is split into stages, none of which ever waits for the GPU:
+//
+// 1. After a view is rendered, its image is copied into a staging image from a fixed pool of slots. This only
+//    queues the copy on the GPU. If no slot is free, the image is dropped rather than waiting for one.
+// 2. At the start of each frame, the slots whose copy was queued at least latency_frames frames ago are
+//    mapped, if the GPU is done with them (otherwise they're tried again next frame).
+// 3. The mapped images are encoded as QOI (a simple, fast lossless format, see qoiformat.org) and written to
+//    disk on the encoder threads of the recorder, straight from the mapped memory.
+// 4. At the start of a later frame, the render thread unmaps the images the encoders are done with, and their
+//    slots are free again.
+//
+// The graphics API is behind a readback (image_readback_t), which queues the copies and maps and unmaps the
+// staging images. The application implements it with D3D11 staging textures, the benchmarks use the software
+// readback from here, which copies images from memory.
+
+#include "xr_core_types.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+
+// Queues a copy of source (a view image of the graphics API) into the staging image of slot. Returns false if
+// the copy couldn't be queued
+typedef bool (*image_copy_function_t)(void* user, uint32_t slot, const void* source, uint32_t width, uint32_t height);
+
+// Maps the staging image of slot, if its copy is done, and sets pixels to its rows of RGBA8 (or BGRA8) pixels,
+// row_pitch bytes apart. Must not wait for the copy, but return false if it isn't done yet
+typedef bool (*image_map_function_t)(void* user, uint32_t slot, const uint8_t*& pixels, uint32_t& row_pitch);
+typedef void (*image_unmap_function_t)(void* user, uint32_t slot);
+
+struct image_readback_t {
+	image_copy_function_t copy;
+	image_map_function_t map;
+	image_unmap_function_t unmap;
+	void* user;
+	bool bgra; // The staging images are BGRA8 instead of RGBA8
+};
+
+enum image_slot_state_t {
+	image_slot_free,
+	image_slot_copying, // The copy was queued, waiting until it's old enough to be mapped
+	image_slot_encoding, // Mapped, queued for or being encoded
+	image_slot_encoded // The encoder is done, waiting to be unmapped
+};
+
+struct image_slot_t {
+	image_slot_state_t state;
+	uint64_t frame; // The frame the image is from
+	uint32_t view;
+	uint32_t width;
+	uint32_t height;
+	const uint8_t* pixels; // While mapped
+	uint32_t row_pitch;
+};
+
+struct image_recorder_stats_t {
+	uint64_t requested; // Views that were selected for recording
+	uint64_t written; // Images that were encoded (and written, if there's a directory)
+	uint64_t dropped; // Views that weren't recorded, as no slot was free or the copy failed
+	uint64_t failed_writes;
+	uint64_t raw_bytes; // Size of the written images before and after encoding
+	uint64_t encoded_bytes;
+	int64_t encode_ns; // Time the encoders spent, summed over all images
+	int64_t render_thread_ns; // Time the render thread spent in the recorder, summed over all frames
+	uint64_t map_retries; // Slots that were old enough, but whose copy wasn't done yet
+};
+
+struct image_recorder_t {
+	image_readback_t readback;
+	std::string directory; // Empty to only encode the images, without writing them
+	uint32_t interval; // Every interval-th frame is recorded, 0 to only record requested frames
+	uint32_t latency_frames; // Frames between queueing a copy and mapping it
+	uint64_t frame; // The current frame, set by ImageRecorderBeginFrame
+	bool record_frame; // Whether the views of the current frame are recorded
+	bool requested; // Record the next frame, even if it's not one of the interval
+
+	// Shared with the encoder threads, guarded by mutex
+	std::mutex mutex;
+	std::condition_variable work_ready;
+	std::condition_variable work_done;
+	bool running;
+	std::deque<uint32_t> encode_queue;
+	std::vector<image_slot_t> slots;
+	image_recorder_stats_t stats;
+
+	std::vector<std::thread> encoders;
+};
+
+// Readback from images in memory, tightly packed RGBA8. The copy happens right away, on the calling thread
+struct image_readback_software_t {
+	std::vector<std::vector<uint8_t>> staging;
+	std::vector<uint32_t> widths;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+// directory may be nullptr or empty to only encode the images. There is always at least one encoder. The pool
+// has slot_count staging images, which should be enough for the views of latency_frames + 1 recorded frames
+void ImageRecorderInit(image_recorder_t& recorder, const image_readback_t& readback, uint32_t slot_count, uint32_t encoder_count, const char* directory, uint32_t interval, uint32_t latency_frames);
+
+// Waits for the images that were already copied to be written, then stops the encoders. Gives up on images
+// whose copy isn't done after timeout_ms
+void ImageRecorderShutdown(image_recorder_t& recorder, uint32_t timeout_ms);
+
+// Records the next frame, regardless of the interval
+void ImageRecorderRequest(image_recorder_t& recorder);
+
+// Called by the render thread at the start of each frame, before any ImageRecorderCaptureView. Maps the
+// copies that are done, hands them to the encoders, and frees the slots the encoders are done with.
+// Returns whether the views of this frame are recorded
+bool ImageRecorderBeginFrame(image_recorder_t& recorder, uint64_t frame);
+
+// Called by the render thread after rendering a view. Queues the copy of its image, if the frame is recorded
+void ImageRecorderCaptureView(image_recorder_t& recorder, uint32_t view, const void* source, uint32_t width, uint32_t height);
+
+// A copy of the statistics, as the encoders update them
+image_recorder_stats_t ImageRecorderStats(image_recorder_t& recorder);
+
+image_readback_t ImageReadbackSoftware(image_readback_software_t& software);
+
+// Appends a QOI file of the image to out. With bgra, the pixels are BGRA8 and are swizzled to RGBA
+void ImageEncodeQoi(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t row_pitch, bool bgra, std::vector<uint8_t>& out);
+
+// Decodes a QOI file with 4 channels into tightly packed RGBA8. Returns false if it's not one
+bool ImageDecodeQoi(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height, std::vector<uint8_t>& pixels);
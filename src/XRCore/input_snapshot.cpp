@@ -0,0 +1,74 @@
+#include "input_snapshot.h"
+
+#include <cstring>
+#include <type_traits>
+
+// The snapshot gets copied word by word, so it has to be plain data
+static_assert(std::is_trivially_copyable<input_snapshot_t>::value, "input_snapshot_t must be trivially copyable");
+
+void InputSnapshotInit(input_snapshot_buffer_t& buffer) {
+	for (uint32_t i = 0; i < input_snapshot_slots; i++) {
+		buffer.slots[i].sequence.store(0, std::memory_order_relaxed);
+		for (uint32_t w = 0; w < input_snapshot_words; w++) {
+			buffer.slots[i].words[w].store(0, std::memory_order_relaxed);
+		}
+	}
+	buffer.published = 0;
+	buffer.latest_version.store(0, std::memory_order_release);
+}
+
+void InputSnapshotPublish(input_snapshot_buffer_t& buffer, input_snapshot_t& snapshot) {
+	snapshot.version = ++buffer.published;
+	input_snapshot_slot_t& slot = buffer.slots[snapshot.version % input_snapshot_slots];
+
+	uint64_t words[input_snapshot_words] = {};
+	memcpy(words, &snapshot, sizeof(input_snapshot_t));
+
+	// Mark the slot as "being written" (odd sequence). The fence makes sure that no reader can see
+	// any of the new words without also seeing the odd sequence
+	uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (uint32_t w = 0; w < input_snapshot_words; w++) {
+		slot.words[w].store(words[w], std::memory_order_relaxed);
+	}
+
+	// Done, make the sequence even again and point the readers to the new snapshot
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+	buffer.latest_version.store(snapshot.version, std::memory_order_release);
+}
+
+bool InputSnapshotRead(const input_snapshot_buffer_t& buffer, input_snapshot_t& out, uint32_t* retries) {
+	uint64_t words[input_snapshot_words];
+
+	for (;;) {
+		uint64_t version = buffer.latest_version.load(std::memory_order_acquire);
+		if (version == 0) {
+			return false;
+		}
+
+		const input_snapshot_slot_t& slot = buffer.slots[version % input_snapshot_slots];
+		uint64_t sequence_before = slot.sequence.load(std::memory_order_acquire);
+
+		// Only copy the slot if the writer isn't in the middle of writing it
+		if ((sequence_before & 1) == 0) {
+			for (uint32_t w = 0; w < input_snapshot_words; w++) {
+				words[w] = slot.words[w].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			// If the sequence didn't change, nobody wrote the slot while we copied it. (If the writer went
+			// around the whole ring in the meantime, the slot simply holds an even newer snapshot)
+			uint64_t sequence_after = slot.sequence.load(std::memory_order_relaxed);
+			if (sequence_before == sequence_after) {
+				memcpy(&out, words, sizeof(input_snapshot_t));
+				return true;
+			}
+		}
+
+		if (retries) {
+			(*retries)++;
+		}
+	}
+}
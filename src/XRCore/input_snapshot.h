@@ -0,0 +1,64 @@
+#pragma once
+//###################################################################################################################
+// Input snapshots
+//###################################################################################################################
+// Once per frame, the render thread syncs the OpenXR actions, locates the controllers for the predicted
+// display time and publishes the result as an input_snapshot_t. Other threads (e.g. the simulation) can
+// read the latest snapshot at any time without taking a lock, and without ever blocking the render thread.
+//
+// The snapshots live in a small ring of slots, each guarded by a sequence counter (a "seqlock"). The
+// writer makes the counter odd while it writes a slot and even again when it's done. A reader copies a
+// slot and checks that the counter didn't change in the meantime, otherwise it just tries again. As the
+// writer always writes to the next slot in the ring, a reader only has to retry if it is slower than a
+// full round of the ring, which basically never happens.
+
+#include "xr_core_types.h"
+
+#include <atomic>
+#include <cstdint>
+
+//------------------------------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------------------------------
+const uint32_t input_max_hands = 2;
+const uint32_t input_max_actions = 64; // Maximum number of action values (per hand values count separately)
+const uint32_t input_snapshot_slots = 4;
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+struct input_snapshot_t {
+	uint64_t version; // Increases by one with every published snapshot, 0 means "no input yet"
+	XrTime display_time; // The predicted display time the hand poses were located for
+	XrPosef hand_poses[input_max_hands];
+	uint32_t hand_pose_valid; // Bit i is set if hand_poses[i] is valid
+	uint32_t action_count;
+	uint64_t action_changed; // Bit i is set if action_values[i] changed since the last snapshot
+	float action_values[input_max_actions]; // Boolean actions are stored as 0.0 / 1.0
+};
+
+// Number of 64 bit words a snapshot takes in a slot
+const uint32_t input_snapshot_words = (sizeof(input_snapshot_t) + 7) / 8;
+
+struct input_snapshot_slot_t {
+	std::atomic<uint64_t> sequence;
+	std::atomic<uint64_t> words[input_snapshot_words];
+};
+
+struct input_snapshot_buffer_t {
+	input_snapshot_slot_t slots[input_snapshot_slots];
+	std::atomic<uint64_t> latest_version;
+	uint64_t published; // Only touched by the writer
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void InputSnapshotInit(input_snapshot_buffer_t& buffer);
+
+// Publishes a new snapshot. Sets snapshot.version. Must only be called from a single thread
+void InputSnapshotPublish(input_snapshot_buffer_t& buffer, input_snapshot_t& snapshot);
+
+// Copies the latest snapshot into out. Can be called from any thread. Returns false if nothing
+// has been published yet. retries (optional) is increased for every torn read we had to repeat
+bool InputSnapshotRead(const input_snapshot_buffer_t& buffer, input_snapshot_t& out, uint32_t* retries = nullptr);
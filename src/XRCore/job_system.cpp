@@ -0,0 +1,94 @@
+#include "job_system.h"
+
+// Takes jobs of the current batch until there are none left
+static void JobSystemWork(job_system_t& jobs) {
+	while (true) {
+		uint32_t job = jobs.next_job.fetch_add(1, std::memory_order_relaxed);
+		if (job >= jobs.job_count) {
+			return;
+		}
+		jobs.function(jobs.user, job);
+	}
+}
+
+static void JobSystemWorker(job_system_t* jobs) {
+	uint64_t last_batch = 0;
+	std::unique_lock<std::mutex> lock(jobs->mutex);
+	while (true) {
+		jobs->batch_ready.wait(lock, [&] { return !jobs->running || jobs->batch != last_batch; });
+		if (!jobs->running) {
+			return;
+		}
+		last_batch = jobs->batch;
+
+		lock.unlock();
+		JobSystemWork(*jobs);
+		lock.lock();
+
+		if (--jobs->busy_workers == 0) {
+			jobs->batch_done.notify_one();
+		}
+	}
+}
+
+void JobSystemInit(job_system_t& jobs, uint32_t worker_count) {
+	jobs.running = true;
+	jobs.batch = 0;
+	jobs.function = nullptr;
+	jobs.user = nullptr;
+	jobs.job_count = 0;
+	jobs.busy_workers = 0;
+	jobs.next_job = 0;
+	for (uint32_t i = 0; i < worker_count; i++) {
+		jobs.workers.emplace_back(JobSystemWorker, &jobs);
+	}
+}
+
+void JobSystemShutdown(job_system_t& jobs) {
+	{
+		std::lock_guard<std::mutex> lock(jobs.mutex);
+		jobs.running = false;
+	}
+	jobs.batch_ready.notify_all();
+	for (std::thread& worker : jobs.workers) {
+		worker.join();
+	}
+	jobs.workers.clear();
+}
+
+uint32_t JobSystemDefaultWorkers() {
+	uint32_t cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 0;
+}
+
+uint32_t JobSystemThreads(const job_system_t* jobs) {
+	return jobs ? (uint32_t)jobs->workers.size() + 1 : 1;
+}
+
+void JobSystemRun(job_system_t* jobs, uint32_t job_count, job_function_t function, void* user) {
+	// Waking the workers isn't worth it for a single job
+	if (!jobs || jobs->workers.empty() || job_count <= 1) {
+		for (uint32_t job = 0; job < job_count; job++) {
+			function(user, job);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobs->mutex);
+		jobs->function = function;
+		jobs->user = user;
+		jobs->job_count = job_count;
+		jobs->next_job = 0;
+		jobs->busy_workers = (uint32_t)jobs->workers.size();
+		jobs->batch++;
+	}
+	jobs->batch_ready.notify_all();
+
+	JobSystemWork(*jobs);
+
+	// Even the workers that woke too late to get a job have to be done with the batch before the next one
+	// can be written
+	std::unique_lock<std::mutex> lock(jobs->mutex);
+	jobs->batch_done.wait(lock, [&] { return jobs->busy_workers == 0; });
+}
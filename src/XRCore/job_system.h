@@ -0,0 +1,65 @@
+#pragma once
+//###################################################################################################################
+// Job system
+//###################################################################################################################
+// A small pool of worker threads for work that splits into many independent pieces, like updating a large
+// number of particles. The work is handed out as a batch of jobs 0 to job_count - 1, and the threads (including
+// the one that started the batch) take the next job from an atomic counter until none are left. Handing out the
+// jobs one at a time balances the load by itself, so the jobs don't need to be of the same cost, but each job
+// should be big enough (tens of microseconds) that taking it costs nothing in comparison.
+//
+// Only one thread may run batches on a job system, and JobSystemRun only returns once every job of the batch
+// is done, so the jobs can use anything the calling thread set up before. While there is no batch, the workers
+// sleep on a condition variable.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+
+// Runs job number job of a batch
+typedef void (*job_function_t)(void* user, uint32_t job);
+
+struct job_system_t {
+	std::vector<std::thread> workers;
+
+	// The current batch. Written by the calling thread while the workers sleep, guarded by mutex
+	std::mutex mutex;
+	std::condition_variable batch_ready;
+	std::condition_variable batch_done;
+	bool running;
+	uint64_t batch; // Increases with every batch, such that the workers can tell a new one from the last one
+	job_function_t function;
+	void* user;
+	uint32_t job_count;
+	uint32_t busy_workers; // Workers that haven't finished with the current batch yet
+
+	std::atomic<uint32_t> next_job;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+// Starts worker_count workers. With 0 workers, all jobs run on the calling thread
+void JobSystemInit(job_system_t& jobs, uint32_t worker_count);
+
+// Stops and joins the workers. Has to be called on every way out after JobSystemInit, as a std::thread that is
+// destroyed without being joined ends the program
+void JobSystemShutdown(job_system_t& jobs);
+
+// One worker less than there are cores, as the calling thread works on the batches as well
+uint32_t JobSystemDefaultWorkers();
+
+// The number of threads working on a batch: the workers and the calling thread. 1 if jobs is nullptr
+uint32_t JobSystemThreads(const job_system_t* jobs);
+
+// Runs the jobs 0 to job_count - 1 and returns once all of them are done. If jobs is nullptr, they run one after
+// the other on the calling thread
+void JobSystemRun(job_system_t* jobs, uint32_t job_count, job_function_t function, void* user);
@@ -0,0 +1,62 @@
+#include "late_latch.h"
+
+#include <algorithm>
+#include <cmath>
+
+// We only keep this many samples for the percentiles, which is a bit more than a minute at 90Hz
+static const size_t max_pose_age_samples = 8192;
+
+void PoseAgeReset(pose_age_stats_t& stats) {
+	stats.samples_ms.clear();
+	stats.recorded = 0;
+	stats.max_ms = 0.0;
+	stats.sum_ms = 0.0;
+}
+
+void PoseAgeRecord(pose_age_stats_t& stats, const view_latch_t& latch, int64_t submitted_at_ns) {
+	double age_ms = (double)(submitted_at_ns - latch.latched_at_ns) / 1000000.0;
+
+	// Once the buffer is full, overwrite the samples round robin, such that the percentiles
+	// follow the recent frames
+	if (stats.samples_ms.size() < max_pose_age_samples) {
+		stats.samples_ms.push_back(age_ms);
+	}
+	else {
+		stats.samples_ms[stats.recorded % max_pose_age_samples] = age_ms;
+	}
+
+	stats.recorded++;
+	stats.sum_ms += age_ms;
+	stats.max_ms = std::max(stats.max_ms, age_ms);
+}
+
+double PoseAgeMeanMs(const pose_age_stats_t& stats) {
+	if (stats.samples_ms.empty()) {
+		return 0.0;
+	}
+	double sum = 0.0;
+	for (double sample : stats.samples_ms) {
+		sum += sample;
+	}
+	return sum / (double)stats.samples_ms.size();
+}
+
+double PoseAgePercentileMs(const pose_age_stats_t& stats, double percentile) {
+	if (stats.samples_ms.empty()) {
+		return 0.0;
+	}
+
+	// Work on a copy, as nth_element reorders the samples
+	std::vector<double> sorted = stats.samples_ms;
+	size_t index = (size_t)(percentile / 100.0 * (double)(sorted.size() - 1));
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+	return sorted[index];
+}
+
+float PoseAngularDistance(const XrPosef& a, const XrPosef& b) {
+	// For two unit quaternions, the angle between the rotations is 2 * acos(|<a, b>|)
+	const XrQuaternionf& qa = a.orientation;
+	const XrQuaternionf& qb = b.orientation;
+	float dot = fabsf(qa.x * qb.x + qa.y * qb.y + qa.z * qb.z + qa.w * qb.w);
+	return 2.0f * acosf(std::min(dot, 1.0f));
+}
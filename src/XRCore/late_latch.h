@@ -0,0 +1,43 @@
+#pragma once
+//###################################################################################################################
+// Late latching of view poses
+//###################################################################################################################
+// Every millisecond between locating the views and handing the rendered images to the runtime makes the
+// pose we rendered with older (and thus less accurate). To keep this time small, the views are located
+// a second time right before the GPU commands are submitted. The structs in here keep track of when a
+// pose was sampled, such that we can measure how old it was at submit time.
+
+#include "xr_core_types.h"
+
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+
+// A located view, together with the CPU time at which we got it from the runtime
+struct view_latch_t {
+	XrPosef pose;
+	XrFovf fov;
+	XrTime display_time; // The display time the pose was predicted for
+	int64_t latched_at_ns; // CPU timestamp (see CoreTimeNowNs) at which the runtime returned the pose
+};
+
+// Collects the age of the submitted poses over multiple frames
+struct pose_age_stats_t {
+	std::vector<double> samples_ms;
+	uint64_t recorded = 0; // Total number of recorded samples, might be more than samples_ms holds
+	double max_ms = 0.0;
+	double sum_ms = 0.0;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void PoseAgeReset(pose_age_stats_t& stats);
+void PoseAgeRecord(pose_age_stats_t& stats, const view_latch_t& latch, int64_t submitted_at_ns);
+double PoseAgeMeanMs(const pose_age_stats_t& stats);
+double PoseAgePercentileMs(const pose_age_stats_t& stats, double percentile);
+
+// Returns the angle (in radians) between the orientations of two poses
+float PoseAngularDistance(const XrPosef& a, const XrPosef& b);
@@ -0,0 +1,222 @@
+#include "light_clusters.h"
+
+#include <algorithm>
+
+void LightClusterInit(light_cluster_grid_t& grid, uint32_t tiles_x, uint32_t tiles_y, uint32_t slices, float near_z, float far_z, uint32_t max_indices) {
+	grid = {};
+	grid.tiles_x = tiles_x;
+	grid.tiles_y = tiles_y;
+	grid.slices = slices;
+	grid.cells_per_view = tiles_x * tiles_y * slices;
+	grid.max_indices = max_indices;
+	grid.near_z = near_z;
+	grid.far_z = far_z;
+
+	// Slice k starts at the depth near * (far / near)^(k / slices)
+	grid.slice_scale = (float)slices / logf(far_z / near_z);
+	grid.slice_bias = -logf(near_z) * grid.slice_scale;
+}
+
+uint32_t LightClusterSlice(const light_cluster_grid_t& grid, float depth) {
+	float slice = logf(fmaxf(depth, grid.near_z)) * grid.slice_scale + grid.slice_bias;
+	return (uint32_t)fmaxf(0.0f, fminf(slice, (float)grid.slices - 1.0f));
+}
+
+// Depth at which a slice starts
+static float LightClusterSliceDepth(const light_cluster_grid_t& grid, uint32_t slice) {
+	return grid.near_z * powf(grid.far_z / grid.near_z, (float)slice / (float)grid.slices);
+}
+
+// Transforms the lights into the space of the view and finds the slices each of them touches. Returns the number
+// of lights that are in the view
+static uint32_t LightClusterPrepareView(light_cluster_grid_t& grid, const light_t* lights, uint32_t light_count, const XrPosef& pose, const XrFovf& fov, float margin) {
+	grid.light_positions.resize(light_count);
+	for (uint32_t i = 0; i < light_count; i++) {
+		grid.light_positions[i] = lights[i].position;
+	}
+	grid.view_lights.resize((size_t)light_count * 4);
+	XrMathTransformPoints(XrMathRigidInverse(pose), grid.light_positions.data(), grid.view_lights.data(), light_count);
+
+	// The planes of the sides of the frustum. The view looks along -z, so a point is inside if it's on the
+	// positive side of all four. Normalized, such that we get the distance to the plane
+	const float tan_left = tanf(fov.angleLeft);
+	const float tan_right = tanf(fov.angleRight);
+	const float tan_up = tanf(fov.angleUp);
+	const float tan_down = tanf(fov.angleDown);
+	const float planes[4][3] = {
+		{ 1.0f, 0.0f, tan_left },
+		{ -1.0f, 0.0f, -tan_right },
+		{ 0.0f, -1.0f, -tan_up },
+		{ 0.0f, 1.0f, tan_down }
+	};
+	float plane_scales[4];
+	for (int p = 0; p < 4; p++) {
+		plane_scales[p] = 1.0f / sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+	}
+
+	grid.slice_ranges.resize((size_t)light_count * 2);
+	uint32_t in_view = 0;
+	for (uint32_t i = 0; i < light_count; i++) {
+		float* light = &grid.view_lights[(size_t)i * 4];
+		float x = light[0], y = light[1], z = light[2];
+
+		// Make the light bigger with its distance, to cover the rotation between the two locates
+		float radius = lights[i].range + margin * sqrtf(x * x + y * y + z * z);
+		light[3] = radius;
+
+		bool visible = -z + radius >= grid.near_z && -z - radius <= grid.far_z;
+		for (int p = 0; p < 4 && visible; p++) {
+			visible = (planes[p][0] * x + planes[p][1] * y + planes[p][2] * z) * plane_scales[p] >= -radius;
+		}
+
+		if (visible) {
+			grid.slice_ranges[(size_t)i * 2] = LightClusterSlice(grid, -z - radius);
+			grid.slice_ranges[(size_t)i * 2 + 1] = LightClusterSlice(grid, fminf(-z + radius, grid.far_z));
+			in_view++;
+		} else {
+			grid.slice_ranges[(size_t)i * 2] = ~0u;
+			grid.slice_ranges[(size_t)i * 2 + 1] = 0;
+		}
+	}
+	return in_view;
+}
+
+static void LightClusterBuildView(light_cluster_grid_t& grid, uint32_t view, uint32_t light_count, const XrFovf& fov) {
+	const float tan_left = tanf(fov.angleLeft);
+	const float tan_right = tanf(fov.angleRight);
+	const float tan_up = tanf(fov.angleUp);
+	const float tan_down = tanf(fov.angleDown);
+	const float tile_width = (tan_right - tan_left) / (float)grid.tiles_x;
+	const float tile_height = (tan_up - tan_down) / (float)grid.tiles_y;
+
+	light_cluster_t* cells = &grid.cells[(size_t)view * grid.cells_per_view];
+	for (uint32_t slice = 0; slice < grid.slices; slice++) {
+		//------------------------------------------------------------------------------------------------------
+		// Collect the lights of the slice
+		//------------------------------------------------------------------------------------------------------
+		grid.slice_lights.clear();
+		for (uint32_t i = 0; i < light_count; i++) {
+			if (grid.slice_ranges[(size_t)i * 2] <= slice && slice <= grid.slice_ranges[(size_t)i * 2 + 1]) {
+				grid.slice_lights.push_back(i);
+			}
+		}
+
+		// As four arrays x[], y[], z[], radius²[], plus one for the part of the distance that only depends on
+		// the row. Padded to a multiple of 4 with lights that can't reach anything
+		const uint32_t count = (uint32_t)grid.slice_lights.size();
+		const uint32_t padded = (count + 3) & ~3u;
+		grid.slice_soa.resize((size_t)padded * 5);
+		float* soa_x = &grid.slice_soa[0];
+		float* soa_y = soa_x + padded;
+		float* soa_z = soa_y + padded;
+		float* soa_radius_sq = soa_z + padded;
+		float* soa_yz_sq = soa_radius_sq + padded;
+		for (uint32_t i = 0; i < padded; i++) {
+			if (i < count) {
+				const float* light = &grid.view_lights[(size_t)grid.slice_lights[i] * 4];
+				soa_x[i] = light[0];
+				soa_y[i] = light[1];
+				soa_z[i] = light[2];
+				soa_radius_sq[i] = light[3] * light[3];
+			} else {
+				soa_x[i] = 0.0f;
+				soa_y[i] = 0.0f;
+				soa_z[i] = 0.0f;
+				soa_radius_sq[i] = -1.0f;
+			}
+		}
+
+		// The view looks along -z, so the slice covers z from -far_depth to -near_depth
+		const float near_depth = LightClusterSliceDepth(grid, slice);
+		const float far_depth = LightClusterSliceDepth(grid, slice + 1);
+		const xr_vec4_t min_z = XrVecSplat(-far_depth);
+		const xr_vec4_t max_z = XrVecSplat(-near_depth);
+		const xr_vec4_t zero = XrVecSplat(0.0f);
+
+		for (uint32_t tile_y = 0; tile_y < grid.tiles_y; tile_y++) {
+			// Row 0 is at the top of the image. The bounding box of the cell has to contain the cell at both
+			// of its depths
+			const float top = tan_up - tile_height * (float)tile_y;
+			const float bottom = top - tile_height;
+			const xr_vec4_t min_y = XrVecSplat(std::min(bottom * near_depth, bottom * far_depth));
+			const xr_vec4_t max_y = XrVecSplat(std::max(top * near_depth, top * far_depth));
+
+			// The distance in y and z is the same for the whole row
+			for (uint32_t i = 0; i < padded; i += 4) {
+				xr_vec4_t y = XrVecLoadUnaligned(soa_y + i);
+				xr_vec4_t z = XrVecLoadUnaligned(soa_z + i);
+				xr_vec4_t dy = XrVecMax(XrVecMax(XrVecSub(min_y, y), XrVecSub(y, max_y)), zero);
+				xr_vec4_t dz = XrVecMax(XrVecMax(XrVecSub(min_z, z), XrVecSub(z, max_z)), zero);
+				XrVecStoreUnaligned(soa_yz_sq + i, XrVecMulAdd(dy, dy, XrVecMul(dz, dz)));
+			}
+
+			for (uint32_t tile_x = 0; tile_x < grid.tiles_x; tile_x++) {
+				const float left = tan_left + tile_width * (float)tile_x;
+				const float right = left + tile_width;
+				const xr_vec4_t min_x = XrVecSplat(std::min(left * near_depth, left * far_depth));
+				const xr_vec4_t max_x = XrVecSplat(std::max(right * near_depth, right * far_depth));
+
+				light_cluster_t& cell = cells[(slice * grid.tiles_y + tile_y) * grid.tiles_x + tile_x];
+				cell.offset = (uint32_t)grid.light_indices.size();
+				cell.count = 0;
+
+				// Sphere against box: the squared distance of the center to the box has to be within the radius
+				for (uint32_t i = 0; i < padded; i += 4) {
+					xr_vec4_t x = XrVecLoadUnaligned(soa_x + i);
+					xr_vec4_t dx = XrVecMax(XrVecMax(XrVecSub(min_x, x), XrVecSub(x, max_x)), zero);
+					xr_vec4_t distance_sq = XrVecMulAdd(dx, dx, XrVecLoadUnaligned(soa_yz_sq + i));
+					uint32_t hits = XrVecMaskBits(XrVecGreaterEqual(XrVecLoadUnaligned(soa_radius_sq + i), distance_sq));
+					grid.stats.cell_tests++;
+
+					while (hits) {
+						uint32_t lane = 0;
+						while (!(hits & (1u << lane))) {
+							lane++;
+						}
+						hits &= ~(1u << lane);
+
+						if (grid.light_indices.size() < grid.max_indices) {
+							grid.light_indices.push_back(grid.slice_lights[i + lane]);
+							cell.count++;
+						} else {
+							grid.stats.dropped++;
+						}
+					}
+				}
+				grid.stats.max_per_cell = std::max(grid.stats.max_per_cell, cell.count);
+			}
+		}
+	}
+}
+
+void LightClusterBuild(light_cluster_grid_t& grid, const light_t* lights, uint32_t light_count, const XrPosef* poses, const XrFovf* fovs, uint32_t view_count, float margin) {
+	grid.view_count = view_count;
+	grid.cells.resize((size_t)view_count * grid.cells_per_view);
+	grid.light_indices.clear();
+	grid.stats = {};
+
+	for (uint32_t view = 0; view < view_count; view++) {
+		grid.stats.lights_in_view += LightClusterPrepareView(grid, lights, light_count, poses[view], fovs[view], margin);
+		LightClusterBuildView(grid, view, light_count, fovs[view]);
+	}
+	grid.stats.indices = (uint32_t)grid.light_indices.size();
+}
+
+XrVector3f LightShade(const light_t& light, const XrVector3f& position, const XrVector3f& normal) {
+	XrVector3f to_light = { light.position.x - position.x, light.position.y - position.y, light.position.z - position.z };
+	float distance = sqrtf(to_light.x * to_light.x + to_light.y * to_light.y + to_light.z * to_light.z);
+	if (distance >= light.range || distance <= 0.0f) {
+		return { 0.0f, 0.0f, 0.0f };
+	}
+	to_light = { to_light.x / distance, to_light.y / distance, to_light.z / distance };
+
+	// Quadratic falloff that reaches 0 at the range, such that a light can't reach past its cells
+	float falloff = 1.0f - distance / light.range;
+	float brightness = falloff * falloff * fmaxf(0.0f, normal.x * to_light.x + normal.y * to_light.y + normal.z * to_light.z);
+
+	if (light.type == light_type_spot) {
+		float cos_angle = -(light.direction.x * to_light.x + light.direction.y * to_light.y + light.direction.z * to_light.z);
+		brightness *= fmaxf(0.0f, fminf(1.0f, (cos_angle - light.spot_cos_outer) / (light.spot_cos_inner - light.spot_cos_outer)));
+	}
+	return { light.color.x * brightness, light.color.y * brightness, light.color.z * brightness };
+}
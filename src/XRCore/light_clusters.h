@@ -0,0 +1,110 @@
+#pragma once
+//###################################################################################################################
+// Clustered lighting
+//###################################################################################################################
+// With hundreds of lights, evaluating every light for every pixel is far too expensive, even though most lights
+// only reach a few meters. So we split the frustum of each view into a grid of cells ("froxels"): tiles across
+// the image, and slices along the depth. The slices get thicker with the distance (exponentially), such that
+// the cells are roughly as deep as they are wide. Once per frame, we find out on the CPU which lights reach
+// into which cells, and upload that as a compact list of light indices per cell. The pixel shader then finds
+// the cell its pixel is in, and only evaluates the lights in that list.
+//
+// To find the lights of the cells, the lights are first transformed into the space of the view and sorted
+// into the slices they touch. Then, each cell of a slice is tested against the lights of that slice, four
+// lights at once with the vector functions of xr_math.h (a sphere against the bounding box of the cell).
+//
+// The cells are built from the poses of the first locate, while the image is rendered with the late latched
+// poses (see late_latch.h). To not lose a light at the border of a cell, the lights get a bit bigger with
+// their distance, by the same margin the culling widens the fovs with.
+
+#include "xr_core_types.h"
+#include "xr_math.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Enums
+//------------------------------------------------------------------------------------------------------
+enum light_type_t {
+	light_type_point = 0,
+	light_type_spot = 1
+};
+
+// A light as the shaders want it, 4 float4 (see shaders.shader). Positions and directions are in the app space
+struct light_t {
+	XrVector3f position;
+	float range; // The light falls off to 0 at this distance
+	XrVector3f color; // Already multiplied with the intensity
+	uint32_t type; // A light_type_t
+	XrVector3f direction; // Spot lights only, normalized
+	float spot_cos_outer; // Cosine of the angle at which the spot light falls off to 0
+	float spot_cos_inner; // Cosine of the angle up to which the spot light has its full intensity
+	float padding[3];
+};
+static_assert(sizeof(light_t) == 64, "light_t needs to match the light struct in the shaders");
+
+// The lights of a cell are light_indices[offset] to light_indices[offset + count - 1]
+struct light_cluster_t {
+	uint32_t offset;
+	uint32_t count;
+};
+
+struct light_cluster_stats_t {
+	uint32_t lights_in_view; // Summed over all views
+	uint32_t cell_tests; // Number of four-light tests
+	uint32_t indices; // Length of the index list
+	uint32_t dropped; // Light indices that didn't fit into the index list
+	uint32_t max_per_cell;
+};
+
+struct light_cluster_grid_t {
+	uint32_t tiles_x;
+	uint32_t tiles_y;
+	uint32_t slices;
+	uint32_t cells_per_view; // tiles_x * tiles_y * slices
+	uint32_t max_indices; // Size of the index buffer on the GPU
+	float near_z;
+	float far_z;
+
+	// The slice of a depth d is log(d) * slice_scale + slice_bias, the shaders need these two
+	float slice_scale;
+	float slice_bias;
+
+	// Output of LightClusterBuild, the cells of view v start at v * cells_per_view
+	uint32_t view_count;
+	std::vector<light_cluster_t> cells;
+	std::vector<uint32_t> light_indices;
+	light_cluster_stats_t stats;
+
+	// Scratch memory, kept around such that building the grid doesn't allocate
+	std::vector<XrVector3f> light_positions;
+	std::vector<float> view_lights; // x, y, z (view space), radius per light
+	std::vector<uint32_t> slice_ranges; // First and last slice per light, or ~0 if it's not in the view
+	std::vector<float> slice_soa; // The lights of the current slice as x[], y[], z[], radius²[] and the distance² in y and z
+	std::vector<uint32_t> slice_lights; // Light index of each entry of slice_soa
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void LightClusterInit(light_cluster_grid_t& grid, uint32_t tiles_x, uint32_t tiles_y, uint32_t slices, float near_z, float far_z, uint32_t max_indices);
+
+// Finds the lights of every cell for each of the views. margin is in radians (see above). If the index list is
+// full, the remaining cells get fewer lights than they should, which stats.dropped counts
+void LightClusterBuild(light_cluster_grid_t& grid, const light_t* lights, uint32_t light_count, const XrPosef* poses, const XrFovf* fovs, uint32_t view_count, float margin);
+
+// The slice of a depth (the distance along the view direction), same as in the shaders. Depths in front of the
+// near plane end up in slice 0, behind the far plane in the last slice
+uint32_t LightClusterSlice(const light_cluster_grid_t& grid, float depth);
+
+// The cell of a position in the image (0 to 1 from the left / top border) and a depth
+inline const light_cluster_t& LightClusterCell(const light_cluster_grid_t& grid, uint32_t view, float image_x, float image_y, float depth) {
+	uint32_t tile_x = (uint32_t)fmaxf(0.0f, fminf(image_x * grid.tiles_x, (float)grid.tiles_x - 1.0f));
+	uint32_t tile_y = (uint32_t)fmaxf(0.0f, fminf(image_y * grid.tiles_y, (float)grid.tiles_y - 1.0f));
+	uint32_t slice = LightClusterSlice(grid, depth);
+	return grid.cells[view * grid.cells_per_view + (slice * grid.tiles_y + tile_y) * grid.tiles_x + tile_x];
+}
+
+// How much light reaches a surface point with the given normal, same as in the shaders
+XrVector3f LightShade(const light_t& light, const XrVector3f& position, const XrVector3f& normal);
@@ -0,0 +1,258 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+static XrVector3f MeshletSub(const XrVector3f& a, const XrVector3f& b) {
+	return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static float MeshletDot(const XrVector3f& a, const XrVector3f& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static XrVector3f MeshletCross(const XrVector3f& a, const XrVector3f& b) {
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+// Zero stays zero, for degenerate triangles
+static XrVector3f MeshletNormalize(const XrVector3f& v) {
+	float length = sqrtf(MeshletDot(v, v));
+	return length > 0.0f ? XrVector3f{ v.x / length, v.y / length, v.z / length } : XrVector3f{ 0.0f, 0.0f, 0.0f };
+}
+
+// The front of a triangle is where its corners are clockwise, see meshlet.h
+static XrVector3f MeshletTriangleNormal(const XrVector3f* positions, const uint16_t* triangle) {
+	const XrVector3f& p0 = positions[triangle[0]];
+	return MeshletNormalize(MeshletCross(MeshletSub(positions[triangle[2]], p0), MeshletSub(positions[triangle[1]], p0)));
+}
+
+// The bounding sphere and the normal cone of the triangles of a meshlet, which are already in mesh.indices
+static void MeshletComputeBounds(meshlet_t& meshlet, const meshlet_mesh_t& mesh, const XrVector3f* positions) {
+	const uint16_t* triangles = mesh.indices.data() + meshlet.first_index;
+	uint32_t index_count = meshlet.triangle_count * 3;
+
+	// The sphere around the center of the bounding box. Not the smallest sphere, but close for these small patches
+	XrVector3f low = positions[triangles[0]];
+	XrVector3f high = low;
+	for (uint32_t i = 1; i < index_count; i++) {
+		const XrVector3f& p = positions[triangles[i]];
+		low = { std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z) };
+		high = { std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z) };
+	}
+	meshlet.center = { (low.x + high.x) * 0.5f, (low.y + high.y) * 0.5f, (low.z + high.z) * 0.5f };
+	float radius_squared = 0.0f;
+	for (uint32_t i = 0; i < index_count; i++) {
+		XrVector3f offset = MeshletSub(positions[triangles[i]], meshlet.center);
+		radius_squared = std::max(radius_squared, MeshletDot(offset, offset));
+	}
+	meshlet.radius = sqrtf(radius_squared);
+
+	// The axis of the cone is the average normal, and the triangle that is furthest away from it decides how wide
+	// the cone is
+	XrVector3f normal_sum = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+		XrVector3f normal = MeshletTriangleNormal(positions, triangles + t * 3);
+		normal_sum = { normal_sum.x + normal.x, normal_sum.y + normal.y, normal_sum.z + normal.z };
+	}
+	meshlet.cone_axis = MeshletNormalize(normal_sum);
+	meshlet.cone_apex = meshlet.center;
+	meshlet.cone_cutoff = 2.0f;
+	float min_dot = 1.0f;
+	for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+		XrVector3f normal = MeshletTriangleNormal(positions, triangles + t * 3);
+		if (MeshletDot(normal, normal) > 0.0f) {
+			min_dot = std::min(min_dot, MeshletDot(normal, meshlet.cone_axis));
+		}
+	}
+	if (MeshletDot(meshlet.cone_axis, meshlet.cone_axis) == 0.0f || min_dot <= 0.1f) {
+		return;
+	}
+
+	// A triangle with normal n faces away from a view direction d if dot(d, n) >= 0. All normals are within
+	// acos(min_dot) of the axis, so that holds for all of them if d is within 90 degrees minus that of the axis,
+	// i.e. if dot(d, axis) >= sin(acos(min_dot))
+	meshlet.cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+
+	// The cone starts at the point on the axis behind the center that is behind every triangle, such that the
+	// directions from the eye to the apex cover the whole meshlet
+	float max_t = 0.0f;
+	for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+		XrVector3f normal = MeshletTriangleNormal(positions, triangles + t * 3);
+		float along_axis = MeshletDot(normal, meshlet.cone_axis);
+		if (along_axis > 0.0f) {
+			max_t = std::max(max_t, MeshletDot(MeshletSub(meshlet.center, positions[triangles[t * 3]]), normal) / along_axis);
+		}
+	}
+	meshlet.cone_apex = { meshlet.center.x - meshlet.cone_axis.x * max_t, meshlet.center.y - meshlet.cone_axis.y * max_t, meshlet.center.z - meshlet.cone_axis.z * max_t };
+}
+
+void MeshletBuild(meshlet_mesh_t& mesh, const XrVector3f* positions, uint32_t vertex_count, const uint16_t* indices, uint32_t index_count, uint32_t max_triangles) {
+	mesh.meshlets.clear();
+	mesh.indices.clear();
+	mesh.indices.reserve(index_count);
+	uint32_t triangle_count = index_count / 3;
+	max_triangles = std::max(max_triangles, 1u);
+
+	std::vector<XrVector3f> normals(triangle_count);
+	for (uint32_t t = 0; t < triangle_count; t++) {
+		normals[t] = MeshletTriangleNormal(positions, indices + t * 3);
+	}
+
+	// The triangles around each vertex
+	std::vector<uint32_t> vertex_first(vertex_count + 1, 0);
+	for (uint32_t i = 0; i < triangle_count * 3; i++) {
+		vertex_first[indices[i] + 1]++;
+	}
+	for (uint32_t v = 0; v < vertex_count; v++) {
+		vertex_first[v + 1] += vertex_first[v];
+	}
+	std::vector<uint32_t> vertex_triangles(triangle_count * 3);
+	std::vector<uint32_t> vertex_fill(vertex_first.begin(), vertex_first.end() - 1);
+	for (uint32_t i = 0; i < triangle_count * 3; i++) {
+		vertex_triangles[vertex_fill[indices[i]]++] = i / 3;
+	}
+
+	// Per vertex and triangle, the last meshlet it was added to (as a vertex) or was a candidate of. That way
+	// nothing has to be cleared between the meshlets
+	const uint32_t none = 0xFFFFFFFF;
+	std::vector<uint32_t> vertex_meshlet(vertex_count, none);
+	std::vector<uint32_t> candidate_meshlet(triangle_count, none);
+	std::vector<uint8_t> assigned(triangle_count, 0);
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> triangles;
+
+	for (uint32_t seed = 0; seed < triangle_count; seed++) {
+		if (assigned[seed]) {
+			continue;
+		}
+		uint32_t meshlet_index = (uint32_t)mesh.meshlets.size();
+		XrVector3f normal_sum = { 0.0f, 0.0f, 0.0f };
+		candidates.clear();
+		triangles.clear();
+
+		uint32_t next = seed;
+		while (next != none) {
+			assigned[next] = 1;
+			triangles.push_back(next);
+			normal_sum = { normal_sum.x + normals[next].x, normal_sum.y + normals[next].y, normal_sum.z + normals[next].z };
+
+			// The triangles around the corners of the new triangle can join next
+			for (int corner = 0; corner < 3; corner++) {
+				uint16_t vertex = indices[next * 3 + corner];
+				vertex_meshlet[vertex] = meshlet_index;
+				for (uint32_t i = vertex_first[vertex]; i < vertex_first[vertex + 1]; i++) {
+					uint32_t triangle = vertex_triangles[i];
+					if (!assigned[triangle] && candidate_meshlet[triangle] != meshlet_index) {
+						candidate_meshlet[triangle] = meshlet_index;
+						candidates.push_back(triangle);
+					}
+				}
+			}
+			if (triangles.size() >= max_triangles) {
+				break;
+			}
+
+			// The neighbor that shares the most corners, and of those the one that faces most like the meshlet
+			XrVector3f axis = MeshletNormalize(normal_sum);
+			next = none;
+			float best_score = -1.0f;
+			size_t best_candidate = 0;
+			for (size_t c = 0; c < candidates.size(); c++) {
+				uint32_t triangle = candidates[c];
+				float facing = MeshletDot(normals[triangle], axis);
+				if (assigned[triangle] || facing < meshlet_cone_limit) {
+					continue;
+				}
+				uint32_t shared = 0;
+				for (int corner = 0; corner < 3; corner++) {
+					shared += vertex_meshlet[indices[triangle * 3 + corner]] == meshlet_index ? 1 : 0;
+				}
+				float score = (float)shared + facing;
+				if (score > best_score) {
+					best_score = score;
+					best_candidate = c;
+					next = triangle;
+				}
+			}
+			if (next != none) {
+				candidates[best_candidate] = candidates.back();
+				candidates.pop_back();
+			}
+		}
+
+		meshlet_t meshlet = {};
+		meshlet.first_index = (uint32_t)mesh.indices.size();
+		meshlet.triangle_count = (uint32_t)triangles.size();
+		for (uint32_t triangle : triangles) {
+			mesh.indices.insert(mesh.indices.end(), indices + triangle * 3, indices + triangle * 3 + 3);
+		}
+		MeshletComputeBounds(meshlet, mesh, positions);
+		mesh.meshlets.push_back(meshlet);
+	}
+}
+
+uint32_t MeshletCull(const meshlet_mesh_t& mesh, const xr_mat4_t& world, const XrVector3f* view_positions, const view_frustum_t* frustums, uint32_t view_count, std::vector<uint16_t>& stream, meshlet_cull_stats_t& stats) {
+	// The cones are tested in the space of the mesh, with the eyes moved into it. Whether a point is in front
+	// of or behind a plane doesn't change with an affine transform, even if it scales the axes differently, so
+	// this is exact. The spheres are moved into world space for the frusta instead, and grow with the largest scale
+	xr_mat4_t inverse = XrMathAffineInverse(world);
+	XrVector3f local_positions[meshlet_max_views];
+	view_count = std::min(view_count, meshlet_max_views);
+	for (uint32_t v = 0; v < view_count; v++) {
+		const XrVector3f& p = view_positions[v];
+		local_positions[v] = {
+			p.x * inverse.m[0][0] + p.y * inverse.m[1][0] + p.z * inverse.m[2][0] + inverse.m[3][0],
+			p.x * inverse.m[0][1] + p.y * inverse.m[1][1] + p.z * inverse.m[2][1] + inverse.m[3][1],
+			p.x * inverse.m[0][2] + p.y * inverse.m[1][2] + p.z * inverse.m[2][2] + inverse.m[3][2],
+		};
+	}
+	float scale = 0.0f;
+	for (int row = 0; row < 3; row++) {
+		scale = std::max(scale, sqrtf(world.m[row][0] * world.m[row][0] + world.m[row][1] * world.m[row][1] + world.m[row][2] * world.m[row][2]));
+	}
+
+	uint32_t appended = 0;
+	for (const meshlet_t& meshlet : mesh.meshlets) {
+		const XrVector3f& c = meshlet.center;
+		XrVector3f center = {
+			c.x * world.m[0][0] + c.y * world.m[1][0] + c.z * world.m[2][0] + world.m[3][0],
+			c.x * world.m[0][1] + c.y * world.m[1][1] + c.z * world.m[2][1] + world.m[3][1],
+			c.x * world.m[0][2] + c.y * world.m[1][2] + c.z * world.m[2][2] + world.m[3][2],
+		};
+		float radius = meshlet.radius * scale;
+
+		// Visible if one of the views has it in its frustum and doesn't look at its back
+		bool in_frustum = false;
+		bool visible = false;
+		for (uint32_t v = 0; v < view_count && !visible; v++) {
+			bool inside = true;
+			for (int i = 0; i < 6 && inside; i++) {
+				const XrVector4f& plane = frustums[v].planes[i];
+				inside = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w >= -radius;
+			}
+			if (!inside) {
+				continue;
+			}
+			in_frustum = true;
+			XrVector3f to_apex = MeshletSub(meshlet.cone_apex, local_positions[v]);
+			visible = meshlet.cone_cutoff > 1.0f || MeshletDot(to_apex, meshlet.cone_axis) < meshlet.cone_cutoff * sqrtf(MeshletDot(to_apex, to_apex));
+		}
+
+		stats.meshlets++;
+		stats.triangles += meshlet.triangle_count;
+		if (!visible) {
+			if (in_frustum) {
+				stats.culled_backface++;
+			} else {
+				stats.culled_frustum++;
+			}
+			continue;
+		}
+		const uint16_t* indices = mesh.indices.data() + meshlet.first_index;
+		stream.insert(stream.end(), indices, indices + meshlet.triangle_count * 3);
+		stats.drawn_triangles += meshlet.triangle_count;
+		appended += meshlet.triangle_count * 3;
+	}
+	return appended;
+}
@@ -0,0 +1,79 @@
+#pragma once
+//###################################################################################################################
+// Meshlets
+//###################################################################################################################
+// A draw call hands the whole index buffer of a mesh to the GPU, even though about half of the triangles of a
+// closed mesh face away from the eye, and parts of it may be outside of the view. The GPU only finds that out
+// per triangle, after it has read the indices and transformed the vertices.
+//
+// So the meshes are split into meshlets up front: small clusters of triangles (64 to 128 is what mesh shaders
+// like) that are next to each other and face about the same way. Each meshlet gets
+//
+// - a bounding sphere, to test it against the frustum of a view, and
+// - a normal cone: the average direction of its triangles (the axis), and how far they spread around it. If
+//   the eye looks at the meshlet from within the back of the cone, every one of its triangles faces away.
+//
+// Every frame, MeshletCull tests the meshlets of a mesh against all views at once (both eyes, or the four views
+// of a quad view headset) and only writes the indices of the meshlets that one of the views may see to a
+// compacted index stream, which is then drawn instead of the whole mesh. A meshlet has to face away from or be
+// outside of every view to be left out, so the stream works for all views.
+//
+// Triangles are front facing when their corners are clockwise seen from the front, the default of D3D.
+
+#include "view_layout.h"
+#include "xr_core_types.h"
+#include "xr_math.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+
+// A triangle only joins a meshlet if its normal is at most 60 degrees away from the average normal of the
+// meshlet, such that the normal cones stay narrow enough to be culled
+const float meshlet_cone_limit = 0.5f;
+
+// MeshletCull looks at up to this many views
+const uint32_t meshlet_max_views = 8;
+
+// All in the space of the mesh
+struct meshlet_t {
+	uint32_t first_index; // Into meshlet_mesh_t::indices
+	uint32_t triangle_count;
+	XrVector3f center; // Bounding sphere
+	float radius;
+	XrVector3f cone_apex; // The meshlet faces away from an eye at p if dot(normalize(cone_apex - p), cone_axis) >= cone_cutoff
+	XrVector3f cone_axis;
+	float cone_cutoff; // Above 1 if the triangles face too many ways to ever face away all at once
+};
+
+// The indices of the mesh, ordered by meshlet. They still refer to the vertices of the mesh, so the vertex
+// buffer stays the same
+struct meshlet_mesh_t {
+	std::vector<meshlet_t> meshlets;
+	std::vector<uint16_t> indices;
+};
+
+struct meshlet_cull_stats_t {
+	uint32_t meshlets; // Meshlets tested
+	uint32_t culled_backface; // In the frustum of a view, but facing away from all views
+	uint32_t culled_frustum; // Outside of all frusta
+	uint32_t triangles; // Triangles of all meshlets tested
+	uint32_t drawn_triangles; // Triangles written to the index stream
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+// Splits a triangle list into meshlets of up to max_triangles triangles. A meshlet starts with the first
+// triangle that isn't in one yet and grows by the neighboring triangle that shares the most corners with it and
+// faces the most like it, until it's full or no neighbor is within meshlet_cone_limit
+void MeshletBuild(meshlet_mesh_t& mesh, const XrVector3f* positions, uint32_t vertex_count, const uint16_t* indices, uint32_t index_count, uint32_t max_triangles);
+
+// Appends the indices of the meshlets that may be visible in one of the views to stream, for the mesh drawn
+// with the given world matrix (affine, without mirroring). view_positions are the positions of the eyes, the
+// frusta are in world space (see ViewFrustum). Returns the number of indices appended, and adds to stats
+uint32_t MeshletCull(const meshlet_mesh_t& mesh, const xr_mat4_t& world, const XrVector3f* view_positions, const view_frustum_t* frustums, uint32_t view_count, std::vector<uint16_t>& stream, meshlet_cull_stats_t& stats);
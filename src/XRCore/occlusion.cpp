@@ -0,0 +1,396 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The corners of the cube mesh, and its 12 triangles
+static const XrVector3f box_corners[8] = {
+	{ -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f },
+	{ -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f },
+};
+
+static const uint16_t box_indices[36] = {
+	0, 2, 1, 1, 2, 3, // -z
+	4, 5, 6, 5, 7, 6, // +z
+	0, 4, 2, 2, 4, 6, // -x
+	1, 3, 5, 3, 7, 5, // +x
+	0, 1, 4, 1, 5, 4, // -y
+	2, 6, 3, 3, 6, 7, // +y
+};
+
+//------------------------------------------------------------------------------------------------------
+// Setup
+//------------------------------------------------------------------------------------------------------
+void OcclusionInit(occlusion_buffer_t& buffer, int32_t width, int32_t height) {
+	buffer.width = (std::max(width, 4) + 3) & ~3;
+	buffer.height = std::max(height, 1);
+	buffer.depth.assign((size_t)buffer.width * buffer.height, 1.0f);
+
+	buffer.level_widths.clear();
+	buffer.level_heights.clear();
+	buffer.level_offsets.clear();
+
+	int32_t level_width = buffer.width;
+	int32_t level_height = buffer.height;
+	uint32_t offset = 0;
+	while (true) {
+		buffer.level_widths.push_back(level_width);
+		buffer.level_heights.push_back(level_height);
+		buffer.level_offsets.push_back(offset);
+		offset += (uint32_t)(level_width * level_height);
+		if (level_width == 1 && level_height == 1) {
+			break;
+		}
+		level_width = (level_width + 1) / 2;
+		level_height = (level_height + 1) / 2;
+	}
+
+	buffer.level_count = (uint32_t)buffer.level_offsets.size();
+	buffer.min_depth.assign(offset, 1.0f);
+	buffer.max_depth.assign(offset, 1.0f);
+	buffer.stats = {};
+}
+
+occlusion_view_t OcclusionCombinedView(const XrPosef* poses, const XrFovf* fovs, uint32_t view_count, float near_z, float far_z) {
+	occlusion_view_t result = {};
+	result.pose = poses[0];
+	result.fov = fovs[0];
+
+	// The union of the fovs, and the center of the views
+	XrVector3f center = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t i = 0; i < view_count; i++) {
+		result.fov.angleLeft = std::min(result.fov.angleLeft, fovs[i].angleLeft);
+		result.fov.angleRight = std::max(result.fov.angleRight, fovs[i].angleRight);
+		result.fov.angleUp = std::max(result.fov.angleUp, fovs[i].angleUp);
+		result.fov.angleDown = std::min(result.fov.angleDown, fovs[i].angleDown);
+		center.x += poses[i].position.x / (float)view_count;
+		center.y += poses[i].position.y / (float)view_count;
+		center.z += poses[i].position.z / (float)view_count;
+	}
+
+	// A frustum with the union of the fovs, starting in the center, would miss the outer edges of the
+	// views (e.g. the left edge of the left eye). Moving it back by the distance b makes its edges pass
+	// through (or outside of) the position of each view. For the left edge, that's tan(left) * b <= x,
+	// where x is the offset of the view from the center, in the space of the view
+	xr_mat4_t rotation = XrMathQuatToMatrix(result.pose.orientation);
+	float tan_left = tanf(result.fov.angleLeft);
+	float tan_right = tanf(result.fov.angleRight);
+	float tan_up = tanf(result.fov.angleUp);
+	float tan_down = tanf(result.fov.angleDown);
+
+	float pull_back = 0.0f;
+	for (uint32_t i = 0; i < view_count; i++) {
+		XrVector3f offset = { poses[i].position.x - center.x, poses[i].position.y - center.y, poses[i].position.z - center.z };
+		float local_x = offset.x * rotation.m[0][0] + offset.y * rotation.m[0][1] + offset.z * rotation.m[0][2];
+		float local_y = offset.x * rotation.m[1][0] + offset.y * rotation.m[1][1] + offset.z * rotation.m[1][2];
+
+		if (tan_left < 0.0f) {
+			pull_back = std::max(pull_back, local_x / tan_left);
+		}
+		if (tan_right > 0.0f) {
+			pull_back = std::max(pull_back, local_x / tan_right);
+		}
+		if (tan_down < 0.0f) {
+			pull_back = std::max(pull_back, local_y / tan_down);
+		}
+		if (tan_up > 0.0f) {
+			pull_back = std::max(pull_back, local_y / tan_up);
+		}
+	}
+
+	// The z axis of the view points backwards
+	result.pose.position.x = center.x + rotation.m[2][0] * pull_back;
+	result.pose.position.y = center.y + rotation.m[2][1] * pull_back;
+	result.pose.position.z = center.z + rotation.m[2][2] * pull_back;
+	result.pull_back = pull_back;
+	result.near_z = near_z + pull_back;
+	result.far_z = far_z + pull_back;
+	result.view_projection = XrMathMultiply(XrMathRigidInverse(result.pose), XrMathProjectionFov(result.fov, result.near_z, result.far_z));
+	return result;
+}
+
+void OcclusionClear(occlusion_buffer_t& buffer) {
+	std::fill(buffer.depth.begin(), buffer.depth.end(), 1.0f);
+	buffer.stats = {};
+}
+
+//------------------------------------------------------------------------------------------------------
+// Rasterizer
+//------------------------------------------------------------------------------------------------------
+struct screen_vertex_t {
+	float x;
+	float y;
+	float z;
+};
+
+static void RasterizeTriangle(occlusion_buffer_t& buffer, screen_vertex_t v0, screen_vertex_t v1, screen_vertex_t v2) {
+	// Make sure the triangle is always counter clockwise in screen space, such that the inside of the
+	// triangle is where all edge functions are positive. We don't cull back faces, as the occluders
+	// are closed meshes anyway and the depth test sorts it out
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+	if (fabsf(area) < 1e-6f) {
+		return;
+	}
+	if (area < 0.0f) {
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	// Bounding rectangle of the triangle, clamped to the buffer. The first column is rounded down to a
+	// multiple of 4, as we always handle four pixels at once
+	int32_t min_x = std::max(0, (int32_t)floorf(std::min(v0.x, std::min(v1.x, v2.x))));
+	int32_t max_x = std::min(buffer.width - 1, (int32_t)floorf(std::max(v0.x, std::max(v1.x, v2.x))));
+	int32_t min_y = std::max(0, (int32_t)floorf(std::min(v0.y, std::min(v1.y, v2.y))));
+	int32_t max_y = std::min(buffer.height - 1, (int32_t)floorf(std::max(v0.y, std::max(v1.y, v2.y))));
+	if (min_x > max_x || min_y > max_y) {
+		return;
+	}
+	min_x &= ~3;
+
+	// Edge functions E(x, y) = a * x + b * y + c, one for each edge, which are positive on the inside
+	const screen_vertex_t* edge_start[3] = { &v1, &v2, &v0 };
+	const screen_vertex_t* edge_end[3] = { &v2, &v0, &v1 };
+	float edge_a[3], edge_b[3], edge_c[3];
+	for (int i = 0; i < 3; i++) {
+		edge_a[i] = -(edge_end[i]->y - edge_start[i]->y);
+		edge_b[i] = edge_end[i]->x - edge_start[i]->x;
+		edge_c[i] = -(edge_a[i] * edge_start[i]->x + edge_b[i] * edge_start[i]->y);
+	}
+
+	// The depth is linear in screen space: z = z0 + (E_1 * (z1 - z0) + E_2 * (z2 - z0)) / area, where
+	// E_1 is the edge opposite of v1 and E_2 the one opposite of v2
+	float inverse_area = 1.0f / area;
+	float dz1 = (v1.z - v0.z) * inverse_area;
+	float dz2 = (v2.z - v0.z) * inverse_area;
+	float z_a = edge_a[1] * dz1 + edge_a[2] * dz2;
+	float z_b = edge_b[1] * dz1 + edge_b[2] * dz2;
+	float z_c = v0.z + edge_c[1] * dz1 + edge_c[2] * dz2;
+
+	// The rasterizer has to be conservative: a texel may only hide what's behind it if the occluder covers
+	// all of it, and only as far as the farthest point of the occluder within the texel. We evaluate
+	// everything at the texel centers, so each edge function is moved by half a texel towards the inside
+	// (its value at the corner of the texel that is least inside), and the depth by half a texel towards
+	// the far plane (its value at the farthest corner)
+	for (int i = 0; i < 3; i++) {
+		edge_c[i] -= 0.5f * (fabsf(edge_a[i]) + fabsf(edge_b[i]));
+	}
+	z_c += 0.5f * (fabsf(z_a) + fabsf(z_b));
+
+	const xr_vec4_t zero = XrVecSplat(0.0f);
+	const xr_vec4_t column_offsets = XrVecSet(0.5f, 1.5f, 2.5f, 3.5f);
+	xr_vec4_t e_step[3];
+	for (int i = 0; i < 3; i++) {
+		e_step[i] = XrVecSplat(edge_a[i] * 4.0f);
+	}
+	xr_vec4_t z_step = XrVecSplat(z_a * 4.0f);
+
+	for (int32_t y = min_y; y <= max_y; y++) {
+		float py = (float)y + 0.5f;
+		xr_vec4_t px = XrVecAdd(XrVecSplat((float)min_x), column_offsets);
+
+		xr_vec4_t e[3];
+		for (int i = 0; i < 3; i++) {
+			e[i] = XrVecMulAdd(XrVecSplat(edge_a[i]), px, XrVecSplat(edge_b[i] * py + edge_c[i]));
+		}
+		xr_vec4_t z = XrVecMulAdd(XrVecSplat(z_a), px, XrVecSplat(z_b * py + z_c));
+
+		float* row = buffer.depth.data() + (size_t)y * buffer.width;
+		for (int32_t x = min_x; x <= max_x; x += 4) {
+			xr_vec4_t inside = XrVecAnd(XrVecAnd(XrVecGreaterEqual(e[0], zero), XrVecGreaterEqual(e[1], zero)), XrVecGreaterEqual(e[2], zero));
+			if (XrVecMaskBits(inside) != 0) {
+				xr_vec4_t depth = XrVecLoadUnaligned(row + x);
+				XrVecStoreUnaligned(row + x, XrVecSelect(inside, XrVecMin(depth, z), depth));
+			}
+
+			e[0] = XrVecAdd(e[0], e_step[0]);
+			e[1] = XrVecAdd(e[1], e_step[1]);
+			e[2] = XrVecAdd(e[2], e_step[2]);
+			z = XrVecAdd(z, z_step);
+		}
+	}
+}
+
+void OcclusionRasterizeTriangles(occlusion_buffer_t& buffer, const xr_mat4_t& to_clip, const XrVector3f* vertices, const uint16_t* indices, uint32_t index_count) {
+	// Transform all vertices to clip space first, most of them are used by multiple triangles
+	uint32_t vertex_count = 0;
+	for (uint32_t i = 0; i < index_count; i++) {
+		vertex_count = std::max(vertex_count, (uint32_t)indices[i] + 1);
+	}
+
+	std::vector<float> clip(vertex_count * 4);
+	XrMathTransformPoints(to_clip, vertices, clip.data(), vertex_count);
+
+	for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+		screen_vertex_t screen[3];
+		bool clipped = false;
+		for (int corner = 0; corner < 3; corner++) {
+			const float* v = &clip[indices[i + corner] * 4];
+
+			// In front of the near plane (or behind the view). Proper clipping would split the triangle,
+			// but skipping an occluder triangle is always safe
+			if (v[2] < 0.0f || v[3] <= 0.0f) {
+				clipped = true;
+				break;
+			}
+
+			float inverse_w = 1.0f / v[3];
+			screen[corner].x = (v[0] * inverse_w * 0.5f + 0.5f) * (float)buffer.width;
+			screen[corner].y = (0.5f - v[1] * inverse_w * 0.5f) * (float)buffer.height;
+			screen[corner].z = v[2] * inverse_w;
+		}
+
+		if (!clipped) {
+			RasterizeTriangle(buffer, screen[0], screen[1], screen[2]);
+			buffer.stats.triangles++;
+		}
+	}
+}
+
+void OcclusionRasterizeBox(occlusion_buffer_t& buffer, const xr_mat4_t& box_to_clip) {
+	OcclusionRasterizeTriangles(buffer, box_to_clip, box_corners, box_indices, 36);
+	buffer.stats.occluders++;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Depth pyramid
+//------------------------------------------------------------------------------------------------------
+void OcclusionBuildPyramid(occlusion_buffer_t& buffer) {
+	std::copy(buffer.depth.begin(), buffer.depth.end(), buffer.min_depth.begin());
+	std::copy(buffer.depth.begin(), buffer.depth.end(), buffer.max_depth.begin());
+
+	for (uint32_t level = 1; level < buffer.level_count; level++) {
+		int32_t width = buffer.level_widths[level];
+		int32_t height = buffer.level_heights[level];
+		int32_t source_width = buffer.level_widths[level - 1];
+		int32_t source_height = buffer.level_heights[level - 1];
+		const float* source_min = buffer.min_depth.data() + buffer.level_offsets[level - 1];
+		const float* source_max = buffer.max_depth.data() + buffer.level_offsets[level - 1];
+		float* target_min = buffer.min_depth.data() + buffer.level_offsets[level];
+		float* target_max = buffer.max_depth.data() + buffer.level_offsets[level];
+
+		for (int32_t y = 0; y < height; y++) {
+			// With an odd size, the last texel of a level only covers one texel of the previous level
+			int32_t y0 = y * 2;
+			int32_t y1 = std::min(y0 + 1, source_height - 1);
+			for (int32_t x = 0; x < width; x++) {
+				int32_t x0 = x * 2;
+				int32_t x1 = std::min(x0 + 1, source_width - 1);
+
+				float min_value = std::min(std::min(source_min[y0 * source_width + x0], source_min[y0 * source_width + x1]), std::min(source_min[y1 * source_width + x0], source_min[y1 * source_width + x1]));
+				float max_value = std::max(std::max(source_max[y0 * source_width + x0], source_max[y0 * source_width + x1]), std::max(source_max[y1 * source_width + x0], source_max[y1 * source_width + x1]));
+				target_min[y * width + x] = min_value;
+				target_max[y * width + x] = max_value;
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// Box test
+//------------------------------------------------------------------------------------------------------
+bool OcclusionTestBox(occlusion_buffer_t& buffer, const xr_mat4_t& box_to_clip) {
+	buffer.stats.tested++;
+
+	float clip[8 * 4];
+	XrMathTransformPoints(box_to_clip, box_corners, clip, 8);
+
+	//----------------------------------------------------------------------------------
+	// Frustum test
+	//----------------------------------------------------------------------------------
+	// If all corners are on the outside of the same plane of the frustum, the box is outside
+	uint32_t outside_all = 0x3F;
+	bool crosses_near_plane = false;
+	for (int i = 0; i < 8; i++) {
+		const float* v = clip + i * 4;
+		uint32_t outside = 0;
+		outside |= (v[0] < -v[3]) ? 0x01 : 0;
+		outside |= (v[0] > v[3]) ? 0x02 : 0;
+		outside |= (v[1] < -v[3]) ? 0x04 : 0;
+		outside |= (v[1] > v[3]) ? 0x08 : 0;
+		outside |= (v[2] < 0.0f) ? 0x10 : 0;
+		outside |= (v[2] > v[3]) ? 0x20 : 0;
+		outside_all &= outside;
+		crosses_near_plane |= (v[2] < 0.0f || v[3] <= 0.0f);
+	}
+	if (outside_all != 0) {
+		buffer.stats.culled++;
+		return false;
+	}
+
+	// We can't project a box that reaches behind the view, and it's very close anyway
+	if (crosses_near_plane) {
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	// Screen rectangle and nearest depth of the box
+	//----------------------------------------------------------------------------------
+	float min_x = 1e30f, max_x = -1e30f, min_y = 1e30f, max_y = -1e30f, nearest = 1.0f;
+	for (int i = 0; i < 8; i++) {
+		const float* v = clip + i * 4;
+		float inverse_w = 1.0f / v[3];
+		float x = (v[0] * inverse_w * 0.5f + 0.5f) * (float)buffer.width;
+		float y = (0.5f - v[1] * inverse_w * 0.5f) * (float)buffer.height;
+		min_x = std::min(min_x, x);
+		max_x = std::max(max_x, x);
+		min_y = std::min(min_y, y);
+		max_y = std::max(max_y, y);
+		nearest = std::min(nearest, v[2] * inverse_w);
+	}
+
+	// All texels the rectangle touches
+	int32_t x0 = std::max(0, (int32_t)floorf(min_x));
+	int32_t x1 = std::min(buffer.width - 1, (int32_t)floorf(max_x));
+	int32_t y0 = std::max(0, (int32_t)floorf(min_y));
+	int32_t y1 = std::min(buffer.height - 1, (int32_t)floorf(max_y));
+
+	//----------------------------------------------------------------------------------
+	// Walk down the pyramid
+	//----------------------------------------------------------------------------------
+	// Start at the level where the rectangle covers at most 2x2 texels
+	uint32_t start_level = 0;
+	while (start_level + 1 < buffer.level_count && (((x1 >> start_level) - (x0 >> start_level)) > 1 || ((y1 >> start_level) - (y0 >> start_level)) > 1)) {
+		start_level++;
+	}
+
+	// For each texel: If the box is behind the farthest occluder in there, that part of the box is hidden.
+	// If it's in front of the nearest occluder, it's visible. Otherwise we need to look at the finer level
+	struct texel_t {
+		uint32_t level;
+		int32_t x;
+		int32_t y;
+	};
+	texel_t stack[64];
+	uint32_t stack_size = 0;
+	for (int32_t y = y0 >> start_level; y <= (y1 >> start_level); y++) {
+		for (int32_t x = x0 >> start_level; x <= (x1 >> start_level); x++) {
+			stack[stack_size++] = { start_level, x, y };
+		}
+	}
+
+	while (stack_size > 0) {
+		texel_t texel = stack[--stack_size];
+		uint32_t index = buffer.level_offsets[texel.level] + (uint32_t)(texel.y * buffer.level_widths[texel.level] + texel.x);
+		if (nearest > buffer.max_depth[index]) {
+			continue;
+		}
+		if (nearest <= buffer.min_depth[index] || texel.level == 0) {
+			return true;
+		}
+
+		// Only the children that are inside of the rectangle
+		uint32_t child_level = texel.level - 1;
+		int32_t child_x0 = std::max(texel.x * 2, x0 >> child_level);
+		int32_t child_x1 = std::min(std::min(texel.x * 2 + 1, x1 >> child_level), buffer.level_widths[child_level] - 1);
+		int32_t child_y0 = std::max(texel.y * 2, y0 >> child_level);
+		int32_t child_y1 = std::min(std::min(texel.y * 2 + 1, y1 >> child_level), buffer.level_heights[child_level] - 1);
+		for (int32_t y = child_y0; y <= child_y1; y++) {
+			for (int32_t x = child_x0; x <= child_x1; x++) {
+				stack[stack_size++] = { child_level, x, y };
+			}
+		}
+	}
+
+	buffer.stats.culled++;
+	return false;
+}
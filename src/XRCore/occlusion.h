@@ -0,0 +1,97 @@
+#pragma once
+//###################################################################################################################
+// Software occlusion culling
+//###################################################################################################################
+// In a dense scene (e.g. a city), most objects are hidden behind others, but the GPU would still have to
+// process them. To find out which objects are hidden before we submit any draw calls, we rasterize a few large
+// objects ("occluders") into a small depth buffer on the CPU, and test the bounding box of every object against
+// that depth buffer.
+//
+// The depth buffer only stores depth (no color), has a low resolution, and the rasterizer handles four pixels
+// of a row at once with the vector functions of xr_math.h. From the depth buffer, we build a pyramid of min/max
+// depths, where each level halves the resolution. A box test starts at the level where the box only covers a
+// few texels, and only goes to a finer level where the coarse one can't decide.
+//
+// The rasterizer is conservative: a texel only gets the depth of an occluder if the occluder covers all of
+// the texel, and then the farthest depth of the occluder within it. So the depth buffer never claims more is
+// hidden than really is, at the cost of leaving out the texels along the edges of every occluder triangle.
+//
+// Instead of rasterizing and testing once per eye, we use a single combined view whose frustum contains the
+// frusta of all views. It's slightly pulled back behind the eyes, so it sees the occluders from a bit
+// further back than either eye does, and an object that only one eye sees through a narrow gap could be
+// culled. The benchmarks compare both against a full resolution rasterization of each eye, and fail if any
+// visible object was culled.
+//
+// Depth uses the same convention as XrMathProjectionFov, i.e. 0 at the near plane and 1 at the far plane.
+
+#include "xr_core_types.h"
+#include "xr_math.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+
+// A view whose frustum contains the frusta of all views of a frame
+struct occlusion_view_t {
+	XrPosef pose;
+	XrFovf fov;
+	float near_z;
+	float far_z;
+	float pull_back; // How far the view was moved back behind the views, in meters
+	xr_mat4_t view_projection; // Not transposed, i.e. for use on the CPU
+};
+
+struct occlusion_stats_t {
+	uint32_t occluders; // Number of occluders rasterized this frame
+	uint32_t triangles; // Number of triangles that were actually rasterized (i.e. not clipped away)
+	uint32_t tested; // Number of boxes tested this frame
+	uint32_t culled; // Number of boxes that were hidden or outside of the frustum
+};
+
+struct occlusion_buffer_t {
+	int32_t width; // Multiple of 4
+	int32_t height;
+	std::vector<float> depth;
+
+	// The depth pyramid. Level 0 has the resolution of the depth buffer, every following level half of the
+	// previous one. All levels are stored after each other, starting at level_offsets[level]
+	uint32_t level_count;
+	std::vector<int32_t> level_widths;
+	std::vector<int32_t> level_heights;
+	std::vector<uint32_t> level_offsets;
+	std::vector<float> min_depth; // Depth of the nearest occluder in the texel
+	std::vector<float> max_depth; // Depth of the farthest occluder in the texel (1 if there is a gap)
+
+	occlusion_stats_t stats;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+// Sets up the buffer for the given resolution. The width is rounded up to a multiple of 4
+void OcclusionInit(occlusion_buffer_t& buffer, int32_t width, int32_t height);
+
+// Builds the combined view for the views of a frame. Assumes the views all look in the same direction (which
+// is true for most headsets), the orientation of the first view is used
+occlusion_view_t OcclusionCombinedView(const XrPosef* poses, const XrFovf* fovs, uint32_t view_count, float near_z, float far_z);
+
+// Clears the depth buffer and the stats, call once at the start of every frame
+void OcclusionClear(occlusion_buffer_t& buffer);
+
+// Rasterizes the cube mesh (from -1 to 1 on each axis), transformed to clip space by box_to_clip
+void OcclusionRasterizeBox(occlusion_buffer_t& buffer, const xr_mat4_t& box_to_clip);
+
+// Rasterizes an indexed triangle list. Triangles that cross the near plane are skipped, which only
+// makes the culling less effective, but never wrong
+void OcclusionRasterizeTriangles(occlusion_buffer_t& buffer, const xr_mat4_t& to_clip, const XrVector3f* vertices, const uint16_t* indices, uint32_t index_count);
+
+// Builds the min/max depth pyramid, call after all occluders are rasterized
+void OcclusionBuildPyramid(occlusion_buffer_t& buffer);
+
+// Returns false if the box (the cube mesh transformed by box_to_clip) is outside of the frustum or hidden
+// behind the occluders, and true if it might be visible
+bool OcclusionTestBox(occlusion_buffer_t& buffer, const xr_mat4_t& box_to_clip);
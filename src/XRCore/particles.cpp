@@ -0,0 +1,238 @@
+#include "particles.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ParticleSystemInit(particle_system_t& system, uint32_t capacity, uint32_t max_emitters, const XrVector3f& gravity, float drag, float ground_y, float bounce) {
+	system.capacity = (capacity + 3) & ~3u;
+	system.count = 0;
+	system.gravity = gravity;
+	system.drag = drag;
+	system.ground_y = ground_y;
+	system.bounce = bounce;
+
+	// The arrays are never resized after this, so the jobs can keep pointers into them
+	for (std::vector<float>* values : { &system.position_x, &system.position_y, &system.position_z, &system.velocity_x, &system.velocity_y, &system.velocity_z, &system.age, &system.lifetime, &system.size }) {
+		values->assign(system.capacity, 0.0f);
+	}
+	system.color.assign(system.capacity, 0);
+
+	system.emitters.assign(max_emitters, particle_emitter_t{});
+	system.free_emitters.clear();
+	for (uint32_t i = max_emitters; i > 0; i--) {
+		system.free_emitters.push_back(i - 1);
+	}
+
+	uint32_t chunk_count = (system.capacity + particle_chunk_size - 1) / particle_chunk_size;
+	system.chunk_dead.assign(chunk_count, std::vector<uint32_t>());
+	system.stats = {};
+}
+
+uint32_t ParticleEmitterCreate(particle_system_t& system, const particle_emitter_t& emitter, uint32_t random_seed) {
+	if (system.free_emitters.empty()) {
+		return particle_no_emitter;
+	}
+	uint32_t index = system.free_emitters.back();
+	system.free_emitters.pop_back();
+
+	particle_emitter_t& slot = system.emitters[index];
+	slot = emitter;
+	slot.in_use = true;
+	slot.pending = 0.0f;
+	slot.random_state = random_seed * 2654435761u + 1;
+	return index;
+}
+
+void ParticleEmitterDestroy(particle_system_t& system, uint32_t emitter) {
+	if (emitter < system.emitters.size() && system.emitters[emitter].in_use) {
+		system.emitters[emitter].in_use = false;
+		system.free_emitters.push_back(emitter);
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// Update
+//------------------------------------------------------------------------------------------------------
+struct particle_update_job_t {
+	particle_system_t* system;
+	float dt;
+};
+
+// Integrates the particles of a chunk, four at a time, and notes which ones died
+static void ParticleIntegrateJob(void* user, uint32_t chunk) {
+	const particle_update_job_t& job = *(const particle_update_job_t*)user;
+	particle_system_t& system = *job.system;
+	uint32_t begin = chunk * particle_chunk_size;
+	uint32_t end = std::min(begin + particle_chunk_size, system.count);
+
+	xr_vec4_t dt = XrVecSplat(job.dt);
+	xr_vec4_t gravity_x = XrVecSplat(system.gravity.x * job.dt);
+	xr_vec4_t gravity_y = XrVecSplat(system.gravity.y * job.dt);
+	xr_vec4_t gravity_z = XrVecSplat(system.gravity.z * job.dt);
+	xr_vec4_t damping = XrVecSplat(std::max(0.0f, 1.0f - system.drag * job.dt));
+	xr_vec4_t ground = XrVecSplat(system.ground_y);
+	xr_vec4_t bounce = XrVecSplat(-system.bounce);
+	xr_vec4_t friction = XrVecSplat(0.7f);
+	xr_vec4_t zero = XrVecSplat(0.0f);
+
+	float* px = system.position_x.data();
+	float* py = system.position_y.data();
+	float* pz = system.position_z.data();
+	float* vx = system.velocity_x.data();
+	float* vy = system.velocity_y.data();
+	float* vz = system.velocity_z.data();
+	float* age = system.age.data();
+	const float* lifetime = system.lifetime.data();
+	std::vector<uint32_t>& dead = system.chunk_dead[chunk];
+	dead.clear();
+
+	// The capacity is a multiple of 4, so the last group can run over count. Those lanes are never used
+	for (uint32_t i = begin; i < end; i += 4) {
+		xr_vec4_t velocity_x = XrVecMul(XrVecAdd(XrVecLoadUnaligned(vx + i), gravity_x), damping);
+		xr_vec4_t velocity_y = XrVecMul(XrVecAdd(XrVecLoadUnaligned(vy + i), gravity_y), damping);
+		xr_vec4_t velocity_z = XrVecMul(XrVecAdd(XrVecLoadUnaligned(vz + i), gravity_z), damping);
+		xr_vec4_t position_x = XrVecMulAdd(velocity_x, dt, XrVecLoadUnaligned(px + i));
+		xr_vec4_t position_y = XrVecMulAdd(velocity_y, dt, XrVecLoadUnaligned(py + i));
+		xr_vec4_t position_z = XrVecMulAdd(velocity_z, dt, XrVecLoadUnaligned(pz + i));
+
+		// Particles that fell below the ground are put back onto it. If they were falling, they bounce and lose
+		// some of their speed along the ground
+		xr_vec4_t below = XrVecGreaterEqual(ground, position_y);
+		xr_vec4_t bouncing = XrVecAnd(below, XrVecGreaterEqual(zero, velocity_y));
+		position_y = XrVecSelect(below, ground, position_y);
+		velocity_y = XrVecSelect(bouncing, XrVecMul(velocity_y, bounce), velocity_y);
+		velocity_x = XrVecSelect(bouncing, XrVecMul(velocity_x, friction), velocity_x);
+		velocity_z = XrVecSelect(bouncing, XrVecMul(velocity_z, friction), velocity_z);
+
+		xr_vec4_t new_age = XrVecAdd(XrVecLoadUnaligned(age + i), dt);
+		uint32_t died = XrVecMaskBits(XrVecGreaterEqual(new_age, XrVecLoadUnaligned(lifetime + i)));
+
+		XrVecStoreUnaligned(vx + i, velocity_x);
+		XrVecStoreUnaligned(vy + i, velocity_y);
+		XrVecStoreUnaligned(vz + i, velocity_z);
+		XrVecStoreUnaligned(px + i, position_x);
+		XrVecStoreUnaligned(py + i, position_y);
+		XrVecStoreUnaligned(pz + i, position_z);
+		XrVecStoreUnaligned(age + i, new_age);
+
+		while (died) {
+			uint32_t lane = 0;
+			while (!(died & (1u << lane))) {
+				lane++;
+			}
+			died &= ~(1u << lane);
+			if (i + lane < end) {
+				dead.push_back(i + lane);
+			}
+		}
+	}
+}
+
+// Copies the particle from into the place of to
+static void ParticleMove(particle_system_t& system, uint32_t from, uint32_t to) {
+	system.position_x[to] = system.position_x[from];
+	system.position_y[to] = system.position_y[from];
+	system.position_z[to] = system.position_z[from];
+	system.velocity_x[to] = system.velocity_x[from];
+	system.velocity_y[to] = system.velocity_y[from];
+	system.velocity_z[to] = system.velocity_z[from];
+	system.age[to] = system.age[from];
+	system.lifetime[to] = system.lifetime[from];
+	system.size[to] = system.size[from];
+	system.color[to] = system.color[from];
+}
+
+// A random number from -1 to 1
+static float ParticleRandom(uint32_t& state) {
+	state = state * 1664525u + 1013904223u;
+	return (float)(state >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+static void ParticleEmit(particle_system_t& system, particle_emitter_t& emitter, float dt) {
+	emitter.pending += emitter.rate * dt;
+	uint32_t new_particles = (uint32_t)emitter.pending;
+	emitter.pending -= (float)new_particles;
+
+	for (uint32_t n = 0; n < new_particles; n++) {
+		if (system.count == system.capacity) {
+			system.stats.dropped += new_particles - n;
+			return;
+		}
+		uint32_t i = system.count++;
+		uint32_t& random = emitter.random_state;
+		system.position_x[i] = emitter.position.x + emitter.position_spread.x * ParticleRandom(random);
+		system.position_y[i] = emitter.position.y + emitter.position_spread.y * ParticleRandom(random);
+		system.position_z[i] = emitter.position.z + emitter.position_spread.z * ParticleRandom(random);
+		system.velocity_x[i] = emitter.velocity.x + emitter.velocity_spread.x * ParticleRandom(random);
+		system.velocity_y[i] = emitter.velocity.y + emitter.velocity_spread.y * ParticleRandom(random);
+		system.velocity_z[i] = emitter.velocity.z + emitter.velocity_spread.z * ParticleRandom(random);
+		system.age[i] = 0.0f;
+		system.lifetime[i] = emitter.lifetime * (0.75f + 0.25f * ParticleRandom(random));
+		system.size[i] = emitter.size;
+		system.color[i] = emitter.color;
+		system.stats.emitted++;
+	}
+}
+
+void ParticleSystemUpdate(particle_system_t& system, float dt, job_system_t* jobs) {
+	system.stats = {};
+
+	particle_update_job_t job = { &system, dt };
+	uint32_t chunk_count = (system.count + particle_chunk_size - 1) / particle_chunk_size;
+	JobSystemRun(jobs, chunk_count, ParticleIntegrateJob, &job);
+
+	//------------------------------------------------------------------------------------------------------
+	// Remove the particles that died
+	//------------------------------------------------------------------------------------------------------
+	// Going from the highest index down, everything behind the current dead particle is alive, so the last
+	// particle can always take its place
+	for (uint32_t chunk = chunk_count; chunk > 0; chunk--) {
+		const std::vector<uint32_t>& dead = system.chunk_dead[chunk - 1];
+		for (size_t d = dead.size(); d > 0; d--) {
+			uint32_t last = --system.count;
+			if (dead[d - 1] != last) {
+				ParticleMove(system, last, dead[d - 1]);
+			}
+			system.stats.died++;
+		}
+	}
+
+	for (particle_emitter_t& emitter : system.emitters) {
+		if (emitter.in_use && emitter.active) {
+			ParticleEmit(system, emitter, dt);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------
+// Instances
+//------------------------------------------------------------------------------------------------------
+struct particle_instance_job_t {
+	const particle_system_t* system;
+	particle_instance_t* instances;
+	uint32_t count;
+};
+
+static void ParticleInstanceJob(void* user, uint32_t chunk) {
+	const particle_instance_job_t& job = *(const particle_instance_job_t*)user;
+	const particle_system_t& system = *job.system;
+	uint32_t begin = chunk * particle_chunk_size;
+	uint32_t end = std::min(begin + particle_chunk_size, job.count);
+
+	for (uint32_t i = begin; i < end; i++) {
+		// The particles fade out over their life
+		float fade = std::max(0.0f, 1.0f - system.age[i] / system.lifetime[i]);
+		uint32_t alpha = (uint32_t)((float)(system.color[i] >> 24) * fade);
+
+		particle_instance_t& instance = job.instances[i];
+		instance.position = { system.position_x[i], system.position_y[i], system.position_z[i] };
+		instance.size = system.size[i];
+		instance.color = (system.color[i] & 0x00FFFFFFu) | (alpha << 24);
+	}
+}
+
+uint32_t ParticleWriteInstances(const particle_system_t& system, particle_instance_t* instances, uint32_t max_instances, job_system_t* jobs) {
+	particle_instance_job_t job = { &system, instances, std::min(system.count, max_instances) };
+	JobSystemRun(jobs, (job.count + particle_chunk_size - 1) / particle_chunk_size, ParticleInstanceJob, &job);
+	return job.count;
+}
@@ -0,0 +1,118 @@
+#pragma once
+//###################################################################################################################
+// Particles
+//###################################################################################################################
+// Effects like sparks and dust need tens of thousands of small particles, which are far too many to be objects
+// of the scene. A particle system keeps its particles as a structure of arrays: one array for the x positions,
+// one for the y positions and so on. That way, the update loads four particles at once into a vector register
+// per attribute and integrates them with the vector functions of xr_math.h, without any shuffling.
+//
+// The particles are split into chunks of particle_chunk_size, and each chunk is a job for the job system (see
+// job_system.h): integrating the particles, and later writing the instances for the GPU. Particles that died
+// are removed afterwards on the calling thread, by moving the last particle into their place, which only
+// costs something for the particles that actually died.
+//
+// New particles come from emitters. The emitters of a system live in a fixed pool, such that creating and
+// destroying them (e.g. for a short burst of sparks) doesn't allocate. All particles of a system share the
+// gravity, drag and ground; different effects (sparks and dust) are different systems. The update only
+// depends on the time step, not on the number of threads, so a replay ends up with the same particles.
+//
+// For drawing, each particle becomes an instance of a camera facing quad (see particle_instance_t), and all
+// of them are drawn with a single instanced draw call.
+
+#include "job_system.h"
+#include "vertex_format.h"
+#include "xr_core_types.h"
+#include "xr_math.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+const uint32_t particle_chunk_size = 4096; // Particles per job, a multiple of 4
+const uint32_t particle_no_emitter = 0xFFFFFFFFu;
+
+struct particle_emitter_t {
+	XrVector3f position;
+	XrVector3f position_spread; // The particles start anywhere in a box with these half extents around position
+	XrVector3f velocity; // Mean start velocity
+	XrVector3f velocity_spread; // Up to this much is added to or subtracted from each axis of the velocity
+	float rate; // Particles per second
+	float lifetime; // Each particle lives between half of this and this many seconds
+	float size; // Half the width of the quad of a particle, in meters
+	uint32_t color; // RGBA8. The alpha fades out over the life of a particle
+	bool active; // Inactive emitters don't emit, but keep their slot in the pool
+
+	// Set by the particle system
+	bool in_use;
+	float pending; // Fraction of a particle left over from the last update
+	uint32_t random_state;
+};
+
+// Of the last update
+struct particle_stats_t {
+	uint32_t emitted;
+	uint32_t died;
+	uint32_t dropped; // Particles that weren't emitted, because the system was full
+};
+
+struct particle_system_t {
+	uint32_t capacity; // A multiple of 4, such that the update never needs a scalar tail
+	uint32_t count; // The live particles are 0 to count - 1
+
+	XrVector3f gravity;
+	float drag; // Fraction of the velocity lost per second
+	float ground_y; // The particles bounce off this height
+	float bounce; // Fraction of the vertical speed that's left after a bounce
+
+	// One entry per particle in each of these
+	std::vector<float> position_x;
+	std::vector<float> position_y;
+	std::vector<float> position_z;
+	std::vector<float> velocity_x;
+	std::vector<float> velocity_y;
+	std::vector<float> velocity_z;
+	std::vector<float> age; // Seconds since the particle was emitted
+	std::vector<float> lifetime;
+	std::vector<float> size;
+	std::vector<uint32_t> color;
+
+	std::vector<particle_emitter_t> emitters;
+	std::vector<uint32_t> free_emitters;
+
+	// The particles of each chunk that died in the current update, filled by the jobs
+	std::vector<std::vector<uint32_t>> chunk_dead;
+	particle_stats_t stats;
+};
+
+// A particle as the vertex shader gets it, one per instance (see PartVShader in shaders.shader)
+struct particle_instance_t {
+	XrVector3f position;
+	float size;
+	uint32_t color; // The alpha is already faded by the age
+};
+
+typedef vertex_format<
+	vertex_attribute<vertex_semantic_position, vertex_component_float4>,
+	vertex_attribute<vertex_semantic_color, vertex_component_unorm8x4>> particle_instance_format;
+static_assert(sizeof(particle_instance_t) == particle_instance_format::stride, "particle_instance_format needs to match particle_instance_t");
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void ParticleSystemInit(particle_system_t& system, uint32_t capacity, uint32_t max_emitters, const XrVector3f& gravity, float drag, float ground_y, float bounce);
+
+// Takes an emitter from the pool and returns its index, or particle_no_emitter if the pool is empty.
+// random_seed makes the emitted particles differ between emitters
+uint32_t ParticleEmitterCreate(particle_system_t& system, const particle_emitter_t& emitter, uint32_t random_seed);
+
+// Returns the emitter to the pool. Its particles live on until they die
+void ParticleEmitterDestroy(particle_system_t& system, uint32_t emitter);
+
+// Advances the particles by dt seconds, removes the ones that died and emits new ones. jobs may be nullptr
+void ParticleSystemUpdate(particle_system_t& system, float dt, job_system_t* jobs);
+
+// Writes up to max_instances instances (e.g. into a mapped buffer) and returns how many were written
+uint32_t ParticleWriteInstances(const particle_system_t& system, particle_instance_t* instances, uint32_t max_instances, job_system_t* jobs);
@@ -0,0 +1,226 @@
+#include "pose_cache.h"
+#include "xr_math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Below this angle between two orientations (the cosine of about 0.8 degrees), the slerp weights are too
+// close to 0 / 0 to be computed, and a plain lerp is just as good
+static const float pose_cache_lerp_cosine = 0.9999f;
+
+// Physical index of the k-th oldest sample of a space
+static uint32_t PoseCacheSlot(const pose_cache_space_t& space, uint32_t k) {
+	return (space.head + pose_cache_capacity - space.count + k) % pose_cache_capacity;
+}
+
+void PoseCacheInit(pose_cache_t& cache, uint32_t space_count, XrDuration max_extrapolation) {
+	cache.spaces.assign(space_count, pose_cache_space_t{});
+	cache.max_extrapolation = max_extrapolation;
+	cache.stats = {};
+}
+
+void PoseCacheClear(pose_cache_t& cache, uint32_t space) {
+	cache.spaces[space].head = 0;
+	cache.spaces[space].count = 0;
+}
+
+bool PoseCachePush(pose_cache_t& cache, uint32_t space, XrTime time, const XrPosef& pose) {
+	pose_cache_space_t& history = cache.spaces[space];
+	if (history.count > 0) {
+		uint32_t newest = PoseCacheSlot(history, history.count - 1);
+		if (time < history.times[newest]) {
+			return false;
+		}
+		if (time == history.times[newest]) {
+			history.poses[newest] = pose;
+			cache.stats.pushes++;
+			return true;
+		}
+	}
+
+	history.times[history.head] = time;
+	history.poses[history.head] = pose;
+	history.head = (history.head + 1) % pose_cache_capacity;
+	history.count = std::min(history.count + 1, pose_cache_capacity);
+	cache.stats.pushes++;
+	return true;
+}
+
+XrTime PoseCacheNewest(const pose_cache_t& cache, uint32_t space) {
+	const pose_cache_space_t& history = cache.spaces[space];
+	return history.count > 0 ? history.times[PoseCacheSlot(history, history.count - 1)] : 0;
+}
+
+// Finds the two samples to blend for a time (as physical indices), and how far to go from the first to the
+// second. The factor is above 1 when extrapolating
+static void PoseCacheBracket(pose_cache_t& cache, const pose_cache_space_t& history, XrTime time, uint32_t& a, uint32_t& b, float& factor) {
+	// The first sample after the time
+	uint32_t low = 0;
+	uint32_t high = history.count;
+	while (low < high) {
+		uint32_t middle = (low + high) / 2;
+		if (history.times[PoseCacheSlot(history, middle)] <= time) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	factor = 0.0f;
+	if (low == 0) {
+		// Older than everything we have
+		a = b = PoseCacheSlot(history, 0);
+		cache.stats.clamped++;
+		return;
+	}
+
+	if (low < history.count) {
+		a = PoseCacheSlot(history, low - 1);
+		b = PoseCacheSlot(history, low);
+		factor = (float)((double)(time - history.times[a]) / (double)(history.times[b] - history.times[a]));
+		cache.stats.interpolated++;
+		return;
+	}
+
+	// At or after the newest sample. With a single sample, there's no motion to continue
+	XrTime newest = history.times[PoseCacheSlot(history, history.count - 1)];
+	if (time == newest || history.count == 1) {
+		a = b = PoseCacheSlot(history, history.count - 1);
+		if (time == newest) {
+			cache.stats.interpolated++;
+		} else {
+			cache.stats.clamped++;
+		}
+		return;
+	}
+
+	a = PoseCacheSlot(history, history.count - 2);
+	b = PoseCacheSlot(history, history.count - 1);
+	XrTime limited = std::min(time, newest + cache.max_extrapolation);
+	factor = (float)((double)(limited - history.times[a]) / (double)(newest - history.times[a]));
+	if (limited == time) {
+		cache.stats.extrapolated++;
+	} else {
+		cache.stats.clamped++;
+	}
+}
+
+bool PoseCacheQuery(pose_cache_t& cache, uint32_t space, const XrTime* times, XrPosef* poses, uint32_t count) {
+	const pose_cache_space_t& history = cache.spaces[space];
+	cache.stats.queries += count;
+	if (history.count == 0) {
+		for (uint32_t i = 0; i < count; i++) {
+			poses[i] = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+		}
+		cache.stats.missing += count;
+		return false;
+	}
+
+	// Four poses at a time, one per lane. A batch that isn't full repeats its last pose in the unused lanes
+	for (uint32_t first = 0; first < count; first += 4) {
+		uint32_t batch = std::min(count - first, 4u);
+
+		// Gather the two samples of each lane, as rows: x y z w of the orientations, x y z 0 of the positions
+		alignas(16) float rows[4][4][4]; // orientation a, orientation b, position a, position b
+		alignas(16) float factors[4];
+		uint32_t a[4];
+		uint32_t b[4];
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			if (lane < batch) {
+				PoseCacheBracket(cache, history, times[first + lane], a[lane], b[lane], factors[lane]);
+			} else {
+				a[lane] = a[batch - 1];
+				b[lane] = b[batch - 1];
+				factors[lane] = factors[batch - 1];
+			}
+			const XrPosef& pose_a = history.poses[a[lane]];
+			const XrPosef& pose_b = history.poses[b[lane]];
+			memcpy(rows[0][lane], &pose_a.orientation, sizeof(float) * 4);
+			memcpy(rows[1][lane], &pose_b.orientation, sizeof(float) * 4);
+			memcpy(rows[2][lane], &pose_a.position, sizeof(float) * 3);
+			memcpy(rows[3][lane], &pose_b.position, sizeof(float) * 3);
+			rows[2][lane][3] = 0.0f;
+			rows[3][lane][3] = 0.0f;
+		}
+
+		// Transpose, such that each vector holds one component of all four lanes
+		xr_vec4_t columns[4][4];
+		for (uint32_t r = 0; r < 4; r++) {
+			for (uint32_t c = 0; c < 4; c++) {
+				columns[r][c] = XrVecLoad(rows[r][c]);
+			}
+			XrVecTranspose(columns[r][0], columns[r][1], columns[r][2], columns[r][3]);
+		}
+		xr_vec4_t t = XrVecLoad(factors);
+
+		// The positions are a lerp
+		xr_vec4_t position[3];
+		for (uint32_t c = 0; c < 3; c++) {
+			position[c] = XrVecMulAdd(XrVecSub(columns[3][c], columns[2][c]), t, columns[2][c]);
+		}
+
+		// The orientations are a slerp. q and -q are the same rotation, so b is flipped if that's closer to a
+		xr_vec4_t dot = XrVecMul(columns[0][0], columns[1][0]);
+		for (uint32_t c = 1; c < 4; c++) {
+			dot = XrVecMulAdd(columns[0][c], columns[1][c], dot);
+		}
+		alignas(16) float cosines[4];
+		XrVecStore(cosines, dot);
+
+		// xr_math.h has no vector acos and sin, so the weights are computed per lane
+		alignas(16) float weights_a[4];
+		alignas(16) float weights_b[4];
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			float cosine = fabsf(cosines[lane]);
+			float factor = factors[lane];
+			if (cosine > pose_cache_lerp_cosine) {
+				weights_a[lane] = 1.0f - factor;
+				weights_b[lane] = factor;
+			} else {
+				float angle = acosf(cosine);
+				float inverse_sine = 1.0f / sinf(angle);
+				weights_a[lane] = sinf((1.0f - factor) * angle) * inverse_sine;
+				weights_b[lane] = sinf(factor * angle) * inverse_sine;
+			}
+			if (cosines[lane] < 0.0f) {
+				weights_b[lane] = -weights_b[lane];
+			}
+		}
+		xr_vec4_t weight_a = XrVecLoad(weights_a);
+		xr_vec4_t weight_b = XrVecLoad(weights_b);
+
+		xr_vec4_t orientation[4];
+		xr_vec4_t length_squared = XrVecSplat(0.0f);
+		for (uint32_t c = 0; c < 4; c++) {
+			orientation[c] = XrVecMulAdd(columns[1][c], weight_b, XrVecMul(columns[0][c], weight_a));
+			length_squared = XrVecMulAdd(orientation[c], orientation[c], length_squared);
+		}
+
+		// The slerp keeps the length, the lerp doesn't. Normalizing both costs less than telling them apart
+		alignas(16) float inverse_lengths[4];
+		XrVecStore(inverse_lengths, length_squared);
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			inverse_lengths[lane] = 1.0f / sqrtf(inverse_lengths[lane]);
+		}
+		xr_vec4_t inverse_length = XrVecLoad(inverse_lengths);
+		for (uint32_t c = 0; c < 4; c++) {
+			orientation[c] = XrVecMul(orientation[c], inverse_length);
+		}
+
+		// Back to one pose per lane
+		xr_vec4_t position_w = XrVecSplat(0.0f);
+		XrVecTranspose(orientation[0], orientation[1], orientation[2], orientation[3]);
+		XrVecTranspose(position[0], position[1], position[2], position_w);
+		xr_vec4_t position_lanes[4] = { position[0], position[1], position[2], position_w };
+		for (uint32_t lane = 0; lane < batch; lane++) {
+			alignas(16) float values[4];
+			XrVecStore(values, orientation[lane]);
+			memcpy(&poses[first + lane].orientation, values, sizeof(float) * 4);
+			XrVecStore(values, position_lanes[lane]);
+			memcpy(&poses[first + lane].position, values, sizeof(float) * 3);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+//###################################################################################################################
+// Pose cache
+//###################################################################################################################
+// Every xrLocateSpace / xrLocateViews call goes into the runtime, which takes a while (the stand-in runtime
+// charges 20us per call). That's fine as long as each space is located once per frame, but the controllers,
+// anchors, the simulation and the audio all want poses, and often not at the display time of the frame, but at
+// the time of a simulation step, of an audio buffer, or of the frame before.
+//
+// So we keep a short history of every space instead: the poses are located once per frame (at the predicted
+// display time, same as now) and pushed into a ring of timestamped samples. Everyone else asks the cache for
+// the pose at whatever XrTime they need:
+//
+// - Between two samples, the position is interpolated linearly and the orientation with a slerp.
+// - Before the oldest sample, we return the oldest sample.
+// - After the newest sample, we continue the motion between the last two samples, but at most for
+//   max_extrapolation. Further out, the pose stays where it was at that limit, as guessing any further
+//   would only make it more wrong.
+//
+// The queries are batched: PoseCacheQuery takes a whole list of times, and interpolates four poses at a time
+// with the SIMD operations of xr_math.h (one pose per lane).
+//
+// The cache isn't thread safe. It belongs to the thread that fills it, which would be the render thread in the
+// app; other threads get the poses through the input snapshots, and can keep a cache of their own.
+//
+// The app fills it from LocateOpenXrControllers (the hands, cleared when they lose tracking) and
+// LocateOpenXrViews (the views). SimulationUpdateFrame asks it for the hands: when frames were missed, it
+// runs a step for every missed display period, and each step sees the hands where they were at its own time
+// instead of where they are at the display time. The replay rebuilds the same cache from the recorded input
+// snapshots, so it still ends up in the same state as the live session.
+
+#include "xr_core_types.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+
+// Samples kept per space. At 90Hz, that's a bit more than the last 170ms
+const uint32_t pose_cache_capacity = 16;
+
+// The history of a single space. The samples are ordered by time, the oldest one at
+// (head + capacity - count) % capacity
+struct pose_cache_space_t {
+	XrTime times[pose_cache_capacity];
+	XrPosef poses[pose_cache_capacity];
+	uint32_t head; // Where the next sample goes
+	uint32_t count;
+};
+
+struct pose_cache_stats_t {
+	uint64_t pushes;
+	uint64_t queries; // Poses asked for, not calls
+	uint64_t interpolated; // Between two samples
+	uint64_t extrapolated; // After the newest sample, within max_extrapolation
+	uint64_t clamped; // Before the oldest sample, or too far after the newest one
+	uint64_t missing; // The space has no samples yet
+};
+
+struct pose_cache_t {
+	std::vector<pose_cache_space_t> spaces;
+	XrDuration max_extrapolation;
+	pose_cache_stats_t stats;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void PoseCacheInit(pose_cache_t& cache, uint32_t space_count, XrDuration max_extrapolation);
+
+// Forgets all samples of a space, e.g. when it lost tracking
+void PoseCacheClear(pose_cache_t& cache, uint32_t space);
+
+// Adds the pose of a space at a time. A sample at the same time as the newest one replaces it (like the poses
+// of a late latch), older ones are dropped. Returns false if the sample was dropped
+bool PoseCachePush(pose_cache_t& cache, uint32_t space, XrTime time, const XrPosef& pose);
+
+// The time of the newest sample of a space, 0 if it has none
+XrTime PoseCacheNewest(const pose_cache_t& cache, uint32_t space);
+
+// Writes the pose of a space at each of the count times to poses. Returns false (and identity poses) if the
+// space has no samples yet
+bool PoseCacheQuery(pose_cache_t& cache, uint32_t space, const XrTime* times, XrPosef* poses, uint32_t count);
@@ -0,0 +1,53 @@
+#include "quad_layer.h"
+
+#include <algorithm>
+
+quad_panel_t QuadPanelCreate(const char* name, const XrPosef& pose, XrExtent2Df size, int32_t width, int32_t height) {
+	quad_panel_t panel = {};
+	panel.name = name;
+	panel.pose = pose;
+	panel.size = size;
+	panel.width = width;
+	panel.height = height;
+
+	// The swapchain is empty in the beginning, so the panel starts out dirty
+	panel.content_version = 1;
+	panel.rendered_version = 0;
+	panel.has_image = false;
+	return panel;
+}
+
+void QuadPanelMarkDirty(quad_panel_t& panel) {
+	panel.content_version++;
+}
+
+bool QuadPanelNeedsRender(const quad_panel_t& panel) {
+	return !panel.has_image || panel.rendered_version != panel.content_version;
+}
+
+void QuadPanelSubmitted(quad_panel_t& panel, bool rendered) {
+	if (rendered) {
+		panel.rendered_version = panel.content_version;
+		panel.has_image = true;
+		panel.stats.renders++;
+	}
+	panel.stats.frames++;
+}
+
+void QuadPanelRecordGpuTime(quad_panel_t& panel, double gpu_ms) {
+	panel.stats.gpu_samples++;
+	panel.stats.gpu_ms_sum += gpu_ms;
+	panel.stats.gpu_ms_max = std::max(panel.stats.gpu_ms_max, gpu_ms);
+}
+
+double QuadPanelMeanGpuMs(const quad_layer_stats_t& stats) {
+	if (stats.gpu_samples == 0) {
+		return 0.0;
+	}
+	return stats.gpu_ms_sum / (double)stats.gpu_samples;
+}
+
+double QuadPanelSavedGpuMs(const quad_layer_stats_t& stats) {
+	uint64_t reused_frames = stats.frames - stats.renders;
+	return (double)reused_frames * QuadPanelMeanGpuMs(stats);
+}
@@ -0,0 +1,61 @@
+#pragma once
+//###################################################################################################################
+// Cached quad layers
+//###################################################################################################################
+// Content that rarely changes (menus, status panels, ...) doesn't need to be rendered into the projection
+// layer every frame. Instead, each such panel gets its own swapchain which is submitted as a quad layer
+// (XrCompositionLayerQuad). The compositor keeps showing the last image we released into that swapchain,
+// so we only have to render the panel again when its content actually changed.
+//
+// The structs in here keep track of which panels are dirty, and of how often we rendered them and how much
+// GPU time that cost, such that we can tell how much GPU time the caching saves.
+
+#include "xr_core_types.h"
+
+#include <cstdint>
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+struct quad_layer_stats_t {
+	uint64_t frames; // Number of frames the panel was submitted in
+	uint64_t renders; // Number of frames the panel had to be rendered in
+	uint64_t gpu_samples; // Number of renders we got a GPU time for
+	double gpu_ms_sum; // Sum of the GPU time of these renders
+	double gpu_ms_max;
+};
+
+struct quad_panel_t {
+	const char* name;
+	XrPosef pose; // Pose of the center of the panel in the app space
+	XrExtent2Df size; // Size of the panel in meters
+	int32_t width; // Resolution of the swapchain of the panel
+	int32_t height;
+	uint64_t content_version; // Increased whenever the content of the panel changes
+	uint64_t rendered_version; // The content_version that is currently in the swapchain
+	bool has_image; // Set once the panel was rendered at least once
+	quad_layer_stats_t stats;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+quad_panel_t QuadPanelCreate(const char* name, const XrPosef& pose, XrExtent2Df size, int32_t width, int32_t height);
+
+// Call whenever something changed that is visible on the panel
+void QuadPanelMarkDirty(quad_panel_t& panel);
+
+// Whether the swapchain of the panel doesn't contain the current content
+bool QuadPanelNeedsRender(const quad_panel_t& panel);
+
+// Call once per frame for each submitted panel, with rendered set if the panel was rendered this frame
+void QuadPanelSubmitted(quad_panel_t& panel, bool rendered);
+
+// GPU time measurements arrive a few frames after the render, so they are recorded separately
+void QuadPanelRecordGpuTime(quad_panel_t& panel, double gpu_ms);
+
+double QuadPanelMeanGpuMs(const quad_layer_stats_t& stats);
+
+// GPU time we didn't spend because the panel was reused instead of rendered, based on the mean
+// GPU time of the renders we measured
+double QuadPanelSavedGpuMs(const quad_layer_stats_t& stats);
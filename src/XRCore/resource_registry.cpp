@@ -0,0 +1,124 @@
+#include "resource_registry.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void ResourceRegistryInit(resource_registry_t& registry, uint64_t budget_bytes) {
+	registry.entries.clear();
+	registry.totals = {};
+	registry.totals.budget_bytes = budget_bytes;
+	registry.next_id = 1;
+	registry.frame = 0;
+	registry.unknown_releases = 0;
+	registry.frames_over_budget = 0;
+}
+
+void ResourceTrack(resource_registry_t& registry, uint64_t handle, resource_category_t category, uint64_t bytes, const char* owner) {
+	if (handle == 0) {
+		return;
+	}
+
+	// A handle that is tracked twice was released without telling us, and the driver reused the address
+	if (registry.entries.count(handle) > 0) {
+		ResourceRelease(registry, handle);
+	}
+
+	resource_entry_t entry;
+	entry.handle = handle;
+	entry.id = registry.next_id++;
+	entry.category = category;
+	entry.bytes = bytes;
+	entry.owner = owner ? owner : "";
+	entry.created_frame = registry.frame;
+	registry.entries.emplace(handle, std::move(entry));
+
+	resource_totals_t& totals = registry.totals;
+	totals.live_count[category]++;
+	totals.live_bytes[category] += bytes;
+	totals.count++;
+	totals.bytes += bytes;
+	totals.peak_bytes = std::max(totals.peak_bytes, totals.bytes);
+}
+
+bool ResourceRelease(resource_registry_t& registry, uint64_t handle) {
+	auto found = registry.entries.find(handle);
+	if (found == registry.entries.end()) {
+		if (handle != 0) {
+			registry.unknown_releases++;
+		}
+		return false;
+	}
+
+	resource_totals_t& totals = registry.totals;
+	const resource_entry_t& entry = found->second;
+	totals.live_count[entry.category]--;
+	totals.live_bytes[entry.category] -= entry.bytes;
+	totals.count--;
+	totals.bytes -= entry.bytes;
+	registry.entries.erase(found);
+	return true;
+}
+
+const resource_totals_t& ResourceFrame(resource_registry_t& registry) {
+	resource_totals_t& totals = registry.totals;
+	totals.over_budget = totals.budget_bytes > 0 && totals.bytes > totals.budget_bytes;
+	if (totals.over_budget) {
+		registry.frames_over_budget++;
+	}
+	registry.frame++;
+	return totals;
+}
+
+std::vector<resource_entry_t> ResourceLiveEntries(const resource_registry_t& registry) {
+	std::vector<resource_entry_t> live;
+	live.reserve(registry.entries.size());
+	for (const auto& entry : registry.entries) {
+		live.push_back(entry.second);
+	}
+	std::sort(live.begin(), live.end(), [](const resource_entry_t& a, const resource_entry_t& b) { return a.id < b.id; });
+	return live;
+}
+
+std::string ResourceLeakReport(const resource_registry_t& registry) {
+	std::vector<resource_entry_t> live = ResourceLiveEntries(registry);
+	if (live.empty()) {
+		return std::string();
+	}
+
+	std::string report;
+	char line[256];
+	for (const resource_entry_t& entry : live) {
+		snprintf(line, sizeof(line), "Leaked %s (%llu bytes), created by %s in frame %llu\n", ResourceCategoryName(entry.category),
+			(unsigned long long)entry.bytes, entry.owner.c_str(), (unsigned long long)entry.created_frame);
+		report += line;
+	}
+	snprintf(line, sizeof(line), "%llu resources with %llu bytes were never released\n", (unsigned long long)registry.totals.count, (unsigned long long)registry.totals.bytes);
+	report += line;
+	return report;
+}
+
+const char* ResourceCategoryName(resource_category_t category) {
+	switch (category) {
+		case resource_swapchain: return "swapchain";
+		case resource_depth_target: return "depth target";
+		case resource_render_target_view: return "render target view";
+		case resource_buffer: return "buffer";
+		case resource_shader: return "shader";
+		case resource_input_layout: return "input layout";
+		case resource_query: return "query";
+		case resource_state: return "state";
+		case resource_staging: return "staging";
+		case resource_cpu: return "cpu allocation";
+		default: return "unknown";
+	}
+}
+
+uint64_t ResourceTextureBytes(uint32_t width, uint32_t height, uint32_t bytes_per_pixel, uint32_t sample_count, uint32_t array_size, uint32_t mip_count) {
+	uint64_t bytes = 0;
+	for (uint32_t mip = 0; mip < std::max(mip_count, 1u); mip++) {
+		uint64_t mip_width = std::max(width >> mip, 1u);
+		uint64_t mip_height = std::max(height >> mip, 1u);
+		bytes += mip_width * mip_height;
+	}
+	return bytes * bytes_per_pixel * std::max(sample_count, 1u) * std::max(array_size, 1u);
+}
@@ -0,0 +1,95 @@
+#pragma once
+//###################################################################################################################
+// Resource registry
+//###################################################################################################################
+// Keeps track of every resource we create (D3D objects, OpenXR swapchains, larger CPU allocations), together
+// with its category, an estimate of the memory it takes and who owns it. Every create call is followed by
+// ResourceTrack, every release by ResourceRelease. With that, we can compare the memory in use against a
+// budget every frame, and list everything that was never released when the application shuts down.
+//
+// The registry only knows handles (as a number) and sizes, not the graphics API, so it works the same with
+// the D3D11 backend of the application and with the null backend of the benchmarks.
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Enums
+//------------------------------------------------------------------------------------------------------
+enum resource_category_t {
+	resource_swapchain, // Images owned by the runtime, that we render into
+	resource_depth_target, // Depth buffers (and their views)
+	resource_render_target_view,
+	resource_buffer, // Vertex, index and constant buffers
+	resource_shader,
+	resource_input_layout,
+	resource_query,
+	resource_state, // Blend, depth and other pipeline states
+	resource_staging, // Textures the GPU copies images into, for the CPU to read them
+	resource_cpu, // Larger CPU side allocations
+	resource_category_count
+};
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+struct resource_entry_t {
+	uint64_t handle;
+	uint64_t id; // Increases with every tracked resource, so the entries can be listed in creation order
+	resource_category_t category;
+	uint64_t bytes; // Estimate, the driver might need more (alignment, compression metadata, ...)
+	std::string owner; // Who created the resource, e.g. "swapchain 0" or "pipeline"
+	uint64_t created_frame;
+};
+
+struct resource_totals_t {
+	uint64_t live_count[resource_category_count];
+	uint64_t live_bytes[resource_category_count];
+	uint64_t count; // Over all categories
+	uint64_t bytes;
+	uint64_t peak_bytes; // Highest value of bytes so far
+	uint64_t budget_bytes; // 0 means no budget
+	bool over_budget;
+};
+
+struct resource_registry_t {
+	std::unordered_map<uint64_t, resource_entry_t> entries;
+	resource_totals_t totals;
+	uint64_t next_id;
+	uint64_t frame;
+	uint64_t unknown_releases; // ResourceRelease calls for handles that were never tracked
+	uint64_t frames_over_budget;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void ResourceRegistryInit(resource_registry_t& registry, uint64_t budget_bytes);
+
+// Turns a pointer (e.g. an ID3D11Buffer*) into a handle for the registry
+inline uint64_t ResourceHandle(const void* pointer) {
+	return (uint64_t)(uintptr_t)pointer;
+}
+
+// Adds a resource. Does nothing for a null handle, such that it can be called right after a create call
+// without checking whether it succeeded
+void ResourceTrack(resource_registry_t& registry, uint64_t handle, resource_category_t category, uint64_t bytes, const char* owner);
+
+// Removes a resource. Returns false if the handle wasn't tracked
+bool ResourceRelease(resource_registry_t& registry, uint64_t handle);
+
+// Called once per frame. Returns the current totals, and counts the frames that went over the budget
+const resource_totals_t& ResourceFrame(resource_registry_t& registry);
+
+// The resources that are still alive, in the order they were created. At shutdown, these are the leaks
+std::vector<resource_entry_t> ResourceLiveEntries(const resource_registry_t& registry);
+
+// One line per live resource plus a summary, or an empty string if nothing is alive anymore
+std::string ResourceLeakReport(const resource_registry_t& registry);
+
+const char* ResourceCategoryName(resource_category_t category);
+
+// Memory of a 2D texture (all mip levels, array slices and samples)
+uint64_t ResourceTextureBytes(uint32_t width, uint32_t height, uint32_t bytes_per_pixel, uint32_t sample_count, uint32_t array_size, uint32_t mip_count);
@@ -0,0 +1,244 @@
+#include "scene.h"
+
+#include <algorithm>
+
+// Size of a city block and width of the streets between them, in meters
+static const float city_block_size = 24.0f;
+static const float city_street_width = 8.0f;
+
+// Small deterministic random generator (xorshift), such that the same seed always gives the same city
+static float CityRandom(uint32_t& state, float min_value, float max_value) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return min_value + (max_value - min_value) * (float)(state & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+uint32_t SceneAddBox(scene_t& scene, const XrVector3f& position, const XrVector3f& half_extents, bool occluder) {
+	scene_object_t object = {};
+	object.position = position;
+	object.orientation = { 0.0f, 0.0f, 0.0f, 1.0f };
+	object.half_extents = half_extents;
+	object.occluder = occluder;
+	object.visible = true;
+	object.moved = true;
+	scene.objects.push_back(object);
+	return (uint32_t)scene.objects.size() - 1;
+}
+
+void SceneAddCityBlocks(scene_t& scene, uint32_t blocks_x, uint32_t blocks_z, float ground_y, uint32_t seed) {
+	uint32_t random_state = seed != 0 ? seed : 1;
+	const float pitch = city_block_size + city_street_width;
+	const float lot_half_size = city_block_size / 4.0f - 0.5f; // Each block has 2x2 lots with a small gap between them
+
+	for (uint32_t block_x = 0; block_x < blocks_x; block_x++) {
+		for (uint32_t block_z = 0; block_z < blocks_z; block_z++) {
+			// With an even number of blocks, the origin lies in the middle of a street crossing
+			float center_x = ((float)block_x + 0.5f - (float)blocks_x * 0.5f) * pitch;
+			float center_z = ((float)block_z + 0.5f - (float)blocks_z * 0.5f) * pitch;
+
+			//------------------------------------------------------------------------------------------------------
+			// Buildings
+			//------------------------------------------------------------------------------------------------------
+			for (int lot = 0; lot < 4; lot++) {
+				float lot_x = center_x + ((lot & 1) ? 0.25f : -0.25f) * city_block_size;
+				float lot_z = center_z + ((lot & 2) ? 0.25f : -0.25f) * city_block_size;
+				float half_height = CityRandom(random_state, 3.0f, 20.0f);
+				SceneAddBox(scene, { lot_x, ground_y + half_height, lot_z }, { lot_half_size, half_height, lot_half_size }, true);
+			}
+
+			//------------------------------------------------------------------------------------------------------
+			// Props on the streets along the +x and +z side of the block
+			//------------------------------------------------------------------------------------------------------
+			for (int prop = 0; prop < 3; prop++) {
+				float lane = (prop & 1) ? 2.0f : -2.0f;
+				float along_x = center_x + CityRandom(random_state, -10.0f, 10.0f);
+				float along_z = center_z + CityRandom(random_state, -10.0f, 10.0f);
+				SceneAddBox(scene, { center_x + pitch * 0.5f + lane, ground_y + 0.75f, along_z }, { 0.9f, 0.75f, 2.2f }, false);
+				SceneAddBox(scene, { along_x, ground_y + 0.75f, center_z + pitch * 0.5f + lane }, { 2.2f, 0.75f, 0.9f }, false);
+			}
+
+			// A kiosk in the courtyard in the middle of the block, which is hidden from almost everywhere
+			SceneAddBox(scene, { center_x, ground_y + 1.25f, center_z }, { 0.4f, 1.25f, 0.4f }, false);
+		}
+	}
+}
+
+void SceneAddCityLights(scene_t& scene, uint32_t blocks_x, uint32_t blocks_z, float ground_y, uint32_t moving_lights, uint32_t seed) {
+	uint32_t random_state = seed != 0 ? seed : 1;
+	const float pitch = city_block_size + city_street_width;
+	scene.light_bounds = { (float)blocks_x * 0.5f * pitch, 10.0f, (float)blocks_z * 0.5f * pitch };
+
+	//------------------------------------------------------------------------------------------------------
+	// Street lamps
+	//------------------------------------------------------------------------------------------------------
+	// The streets lie between the blocks, so there's a crossing at every multiple of the pitch
+	for (uint32_t crossing_x = 0; crossing_x <= blocks_x; crossing_x++) {
+		for (uint32_t crossing_z = 0; crossing_z <= blocks_z; crossing_z++) {
+			light_t lamp = {};
+			lamp.position = { ((float)crossing_x - (float)blocks_x * 0.5f) * pitch, ground_y + 6.0f, ((float)crossing_z - (float)blocks_z * 0.5f) * pitch };
+			lamp.range = 9.0f;
+			lamp.color = { 1.6f, 1.3f, 0.8f };
+			lamp.type = light_type_spot;
+			lamp.direction = { 0.0f, -1.0f, 0.0f };
+			lamp.spot_cos_outer = cosf(0.9f);
+			lamp.spot_cos_inner = cosf(0.6f);
+			scene.lights.push_back(lamp);
+			scene.light_velocities.push_back({ 0.0f, 0.0f, 0.0f });
+		}
+	}
+
+	//------------------------------------------------------------------------------------------------------
+	// Moving lights
+	//------------------------------------------------------------------------------------------------------
+	// Each drives along a random street, in one of its two lanes
+	for (uint32_t i = 0; i < moving_lights; i++) {
+		float street = (float)(uint32_t)CityRandom(random_state, 0.0f, (float)(i % 2 ? blocks_x : blocks_z) + 0.99f);
+		float across = (street - (float)(i % 2 ? blocks_x : blocks_z) * 0.5f) * pitch + ((i / 2) % 2 ? 2.0f : -2.0f);
+		float along = CityRandom(random_state, -1.0f, 1.0f) * (i % 2 ? scene.light_bounds.z : scene.light_bounds.x);
+		float speed = CityRandom(random_state, 0.05f, 0.2f) * ((i / 2) % 2 ? 1.0f : -1.0f);
+
+		light_t light = {};
+		light.range = CityRandom(random_state, 3.0f, 6.0f);
+		light.color = { CityRandom(random_state, 0.2f, 1.5f), CityRandom(random_state, 0.2f, 1.5f), CityRandom(random_state, 0.2f, 1.5f) };
+		light.type = light_type_point;
+		if (i % 2) {
+			light.position = { across, ground_y + 1.0f, along };
+			scene.light_velocities.push_back({ 0.0f, 0.0f, speed });
+		} else {
+			light.position = { along, ground_y + 1.0f, across };
+			scene.light_velocities.push_back({ speed, 0.0f, 0.0f });
+		}
+		scene.lights.push_back(light);
+	}
+}
+
+// Moves a coordinate by a velocity and wraps it into -bound to bound
+static float SceneWrap(float value, float velocity, float bound) {
+	value += velocity;
+	if (value > bound) {
+		value -= 2.0f * bound;
+	} else if (value < -bound) {
+		value += 2.0f * bound;
+	}
+	return value;
+}
+
+void SceneMoveLights(scene_t& scene) {
+	for (size_t i = 0; i < scene.lights.size(); i++) {
+		const XrVector3f& velocity = scene.light_velocities[i];
+		XrVector3f& position = scene.lights[i].position;
+		position.x = SceneWrap(position.x, velocity.x, scene.light_bounds.x);
+		position.z = SceneWrap(position.z, velocity.z, scene.light_bounds.z);
+	}
+}
+
+void SceneCull(scene_t& scene, occlusion_buffer_t& buffer, const occlusion_view_t& view) {
+	OcclusionClear(buffer);
+	for (const scene_object_t& object : scene.objects) {
+		if (object.occluder) {
+			OcclusionRasterizeBox(buffer, XrMathMultiply(SceneObjectMatrix(object), view.view_projection));
+		}
+	}
+	OcclusionBuildPyramid(buffer);
+
+	for (scene_object_t& object : scene.objects) {
+		object.visible = OcclusionTestBox(buffer, XrMathMultiply(SceneObjectMatrix(object), view.view_projection));
+	}
+}
+
+// Lights the 6 faces of the cube mesh. The shader turns the normals with mul(rotation, normal), which turns the
+// normal of the x, y and z axis into the first, second and third row of the rotation
+static void SceneLightFaces(scene_draw_item_t& item, const scene_sun_t& sun) {
+	for (int axis = 0; axis < 3; axis++) {
+		const float* normal = item.rotation.m[axis];
+		float sun_amount = normal[0] * sun.direction.x + normal[1] * sun.direction.y + normal[2] * sun.direction.z;
+		for (int side = 0; side < 2; side++) {
+			// Same as saturate in the shader, the back side faces the sun where the front side doesn't
+			float brightness = std::min(std::max(side == 0 ? sun_amount : -sun_amount, 0.0f), 1.0f);
+			item.face_light[axis * 2 + side] = {
+				sun.ambient.x + sun.color.x * brightness,
+				sun.ambient.y + sun.color.y * brightness,
+				sun.ambient.z + sun.color.z * brightness,
+				1.0f,
+			};
+		}
+	}
+}
+
+static bool SceneSunEqual(const scene_sun_t& a, const scene_sun_t& b) {
+	return a.direction.x == b.direction.x && a.direction.y == b.direction.y && a.direction.z == b.direction.z &&
+		a.color.x == b.color.x && a.color.y == b.color.y && a.color.z == b.color.z &&
+		a.ambient.x == b.ambient.x && a.ambient.y == b.ambient.y && a.ambient.z == b.ambient.z;
+}
+
+scene_draw_item_t SceneDrawItem(const scene_object_t& object, const scene_sun_t& sun) {
+	// The rotation is needed on its own to light up the object correctly. As far as this item knows, the object
+	// didn't move before
+	scene_draw_item_t item;
+	item.world = XrMathTranspose(SceneObjectMatrix(object));
+	item.previous_world = item.world;
+	item.rotation = XrMathQuatToMatrix(object.orientation);
+	SceneLightFaces(item, sun);
+	return item;
+}
+
+void SceneDrawCacheInit(scene_draw_cache_t& cache) {
+	cache.items.clear();
+	cache.versions.clear();
+	cache.moving.clear();
+	cache.sun = {};
+	cache.has_sun = false;
+	cache.stats = {};
+}
+
+void SceneUpdateDrawCache(scene_t& scene, scene_draw_cache_t& cache, const scene_sun_t& sun) {
+	cache.stats = {};
+	bool sun_changed = !cache.has_sun || !SceneSunEqual(cache.sun, sun);
+	cache.sun = sun;
+	cache.has_sun = true;
+
+	// Objects that were added since the last update are treated like objects that moved
+	size_t known = cache.items.size();
+	cache.items.resize(scene.objects.size());
+	cache.versions.resize(scene.objects.size(), 0);
+	cache.moving.resize(scene.objects.size(), 0);
+	for (size_t i = 0; i < scene.objects.size(); i++) {
+		scene_object_t& object = scene.objects[i];
+		if (object.moved || i >= known) {
+			xr_mat4_t previous_world = cache.items[i].world;
+			cache.items[i] = SceneDrawItem(object, sun);
+			if (i < known) {
+				cache.items[i].previous_world = previous_world;
+			}
+			cache.moving[i] = object.moved ? 1 : 0;
+			object.moved = false;
+			cache.stats.transforms++;
+			cache.stats.lit++;
+		}
+		else if (cache.moving[i] || sun_changed) {
+			// An object that stood still since the last update has to show that in its motion vectors as well
+			if (cache.moving[i]) {
+				cache.items[i].previous_world = cache.items[i].world;
+				cache.moving[i] = 0;
+			}
+			if (sun_changed) {
+				SceneLightFaces(cache.items[i], sun);
+				cache.stats.lit++;
+			}
+		}
+		else {
+			continue;
+		}
+		cache.versions[i]++;
+	}
+}
+
+void SceneBuildDrawList(const scene_t& scene, std::vector<uint32_t>& objects) {
+	objects.clear();
+	for (uint32_t i = 0; i < (uint32_t)scene.objects.size(); i++) {
+		if (scene.objects[i].visible) {
+			objects.push_back(i);
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+//###################################################################################################################
+// Scene
+//###################################################################################################################
+// The objects we draw. For now, every object is a box (the cube mesh, scaled to the half extents of the
+// object), which is all the application draws. The scene also has the lights that light up the objects.
+
+#include "light_clusters.h"
+#include "occlusion.h"
+#include "xr_core_types.h"
+#include "xr_math.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs
+//------------------------------------------------------------------------------------------------------
+struct scene_object_t {
+	XrVector3f position; // Center of the box
+	XrQuaternionf orientation;
+	XrVector3f half_extents; // Half the size of the box along each of its axes
+	bool occluder; // Large objects that are good at hiding others are rasterized into the occlusion buffer
+	bool visible; // Result of the culling for the current frame
+	bool moved; // Set whenever the box changed, cleared once its draw item is updated (see SceneUpdateDrawCache)
+};
+
+struct scene_t {
+	std::vector<scene_object_t> objects;
+	std::vector<light_t> lights;
+	std::vector<XrVector3f> light_velocities; // Per light, in meters per frame. Zero for lights that don't move
+	XrVector3f light_bounds; // Half extents of the area around the origin the moving lights stay in
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+// Adds an axis aligned box and returns its index
+uint32_t SceneAddBox(scene_t& scene, const XrVector3f& position, const XrVector3f& half_extents, bool occluder);
+
+// Matrix that transforms the cube mesh (from -1 to 1 on each axis) into the box of the object
+inline xr_mat4_t SceneObjectMatrix(const scene_object_t& object) {
+	return XrMathAffine(object.half_extents, object.orientation, object.position);
+}
+
+// Adds a grid of city blocks_x * blocks_z blocks on the ground at ground_y, centered around the origin, such that
+// the origin lies on a street crossing. Each block has a few buildings (occluders) of random height, and the
+// streets have small props (cars, kiosks, ...) that are mostly hidden behind the buildings
+void SceneAddCityBlocks(scene_t& scene, uint32_t blocks_x, uint32_t blocks_z, float ground_y, uint32_t seed);
+
+// Adds the lights of the city blocks (see SceneAddCityBlocks): A street lamp (a spot light shining down) at every
+// crossing, and moving_lights point lights that drive along the streets
+void SceneAddCityLights(scene_t& scene, uint32_t blocks_x, uint32_t blocks_z, float ground_y, uint32_t moving_lights, uint32_t seed);
+
+// Moves the moving lights by one frame. They wrap around at the border of the light bounds
+void SceneMoveLights(scene_t& scene);
+
+// Sets the visible flag of every object: The occluders are rasterized into the occlusion buffer from the given
+// view, then every object (including the occluders, as a building can be hidden behind another one) is tested
+// against it
+void SceneCull(scene_t& scene, occlusion_buffer_t& buffer, const occlusion_view_t& view);
+
+// The sun and the ambient light. They're the same for every object, and the faces of a box are flat, so each
+// face gets the same amount of sun everywhere on it. That's computed once per face on the CPU (see
+// scene_draw_item_t), instead of once per pixel in the shader
+struct scene_sun_t {
+	XrVector3f direction; // Towards the sun, the length scales the light like a brighter sun would
+	XrVector3f color;
+	XrVector3f ambient;
+};
+
+// The per-object constants of a draw call, as the shaders want them. HLSL expects column-major matrices, so the
+// world matrices are transposed
+struct scene_draw_item_t {
+	xr_mat4_t world;
+	xr_mat4_t previous_world; // The world matrix of the last update, for the motion vectors (see temporal_upscale.h)
+	xr_mat4_t rotation;
+	XrVector4f face_light[6]; // Ambient plus sun of the faces facing +x, -x, +y, -y, +z and -z of the cube mesh
+};
+
+// The draw items of all objects, kept from frame to frame. Most objects of the scene never move, so their
+// items only have to be made once, and only uploaded to the GPU once. Whenever an item changes, the version
+// of its object goes up, such that the renderer knows which of its copies are out of date
+struct scene_draw_cache_stats_t {
+	uint32_t transforms; // Objects whose matrices were rebuilt by the last update
+	uint32_t lit; // Objects whose face lights were computed again by the last update
+};
+
+struct scene_draw_cache_t {
+	std::vector<scene_draw_item_t> items; // One per object of the scene
+	std::vector<uint32_t> versions; // Per object, starting at 1. 0 is never used, for copies that were never made
+	std::vector<uint8_t> moving; // Per object, 1 if it moved in the last update, such that its previous world still differs
+	scene_sun_t sun; // The sun the face lights were computed with
+	bool has_sun;
+	scene_draw_cache_stats_t stats;
+};
+
+scene_draw_item_t SceneDrawItem(const scene_object_t& object, const scene_sun_t& sun);
+
+void SceneDrawCacheInit(scene_draw_cache_t& cache);
+
+// Makes the draw items of new objects and of the objects that moved since the last update (and clears their
+// moved flag). Their previous world is the world they had before, objects that stopped moving get their world
+// as the previous world once more. If the sun changed, the face lights of all objects are computed again, from
+// the rotations they already have. Objects that did none of that cost just the check of their flags
+void SceneUpdateDrawCache(scene_t& scene, scene_draw_cache_t& cache, const scene_sun_t& sun);
+
+// Collects the indices of the visible objects, their items are in the draw cache. Done once per frame and not
+// once per view
+void SceneBuildDrawList(const scene_t& scene, std::vector<uint32_t>& objects);
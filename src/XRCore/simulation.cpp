@@ -0,0 +1,340 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static const uint32_t simulation_crate_rows = 6;
+static const float simulation_crate_half_size = 0.2f;
+
+// Per moon, the moon it's attached to (or simulation_moon_count for the cube), where it is relative to that, and
+// its half size
+struct simulation_moon_t {
+	uint32_t parent;
+	XrVector3f offset;
+	float half_size;
+};
+static const simulation_moon_t simulation_moons[simulation_moon_count] = {
+	{ simulation_moon_count, { 0.2f, 0.0f, 0.0f }, 0.025f },
+	{ simulation_moon_count, { -0.2f, 0.0f, 0.0f }, 0.025f },
+	{ 0, { 0.0f, 0.06f, 0.0f }, 0.012f },
+};
+
+void SimulationInit(simulation_t& simulation) {
+	simulation = {};
+
+	// The cube stays where it always was, at the origin of the app space. It's small, so it's not an occluder
+	simulation.cube_object = SceneAddBox(simulation.scene, { 0.0f, 0.0f, 0.0f }, { 0.1f, 0.1f, 0.1f }, false);
+
+	// The city blocks around it. The LOCAL reference space has its origin at the head of the user, so the
+	// ground is roughly at the height of the user below that
+	SceneAddCityBlocks(simulation.scene, 8, 8, -1.6f, 1);
+
+	// A street lamp at each of the 81 crossings, and enough cars to get to 256 lights
+	SceneAddCityLights(simulation.scene, 8, 8, -1.6f, 175, 2);
+
+	// The crates start on a grid around the feet of the user, with random offsets and velocities (of up to about
+	// 1m/s). They come after the city, so the indices of its objects don't change
+	simulation.first_crate = (uint32_t)simulation.scene.objects.size();
+	simulation.crate_count = simulation_crate_rows * simulation_crate_rows;
+	uint32_t random = 12345;
+	auto next_random = [&random]() {
+		random = random * 1664525u + 1013904223u;
+		return (float)(random >> 8) / (float)(1 << 23) - 1.0f;
+	};
+	float crate_spacing = 2.0f * simulation_crate_area / simulation_crate_rows;
+	for (uint32_t i = 0; i < simulation.crate_count; i++) {
+		float x = ((float)(i % simulation_crate_rows) + 0.5f) * crate_spacing - simulation_crate_area + next_random() * 0.2f;
+		float z = ((float)(i / simulation_crate_rows) + 0.5f) * crate_spacing - simulation_crate_area + next_random() * 0.2f;
+		const float h = simulation_crate_half_size;
+		SceneAddBox(simulation.scene, { x, -1.6f + h, z }, { h, h, h }, false);
+		simulation.crate_velocities.push_back({ next_random() * 0.011f, 0.0f, next_random() * 0.011f });
+	}
+	simulation.crate_boxes.resize(simulation.crate_count);
+	BroadphaseInit(simulation.broadphase, broadphase_sweep_and_prune, 2.0f * simulation_crate_half_size);
+
+	// The moons come after the crates. The cube is the root of the transform graph, the moons hang below it
+	TransformGraphInit(simulation.transforms);
+	simulation.cube_node = TransformGraphAdd(simulation.transforms, transform_no_parent, XrMathIdentity());
+	simulation.first_moon = (uint32_t)simulation.scene.objects.size();
+	for (uint32_t i = 0; i < simulation_moon_count; i++) {
+		const simulation_moon_t& moon = simulation_moons[i];
+		uint32_t parent = moon.parent == simulation_moon_count ? simulation.cube_node : simulation.moon_nodes[moon.parent];
+		simulation.moon_nodes[i] = TransformGraphAdd(simulation.transforms, parent, XrMathAffine(1.0f, { 0.0f, 0.0f, 0.0f, 1.0f }, moon.offset));
+		SceneAddBox(simulation.scene, { 0.0f, 0.0f, 0.0f }, { moon.half_size, moon.half_size, moon.half_size }, false);
+	}
+
+	simulation.cube_rotation_angles = { 0.0f, 0.0f, 0.0f };
+	simulation.cube_spinning = true;
+	simulation.cube_grab_hand = input_max_hands;
+	simulation.input_version = 0;
+
+	// The sparks fall down and bounce off the ground, the dust floats and only slowly settles
+	ParticleSystemInit(simulation.sparks, 8192, 4, { 0.0f, -9.81f, 0.0f }, 0.3f, -1.6f, 0.35f);
+	ParticleSystemInit(simulation.dust, 16384, 16, { 0.0f, -0.02f, 0.0f }, 0.5f, -1.6f, 0.0f);
+
+	particle_emitter_t sparks = {};
+	sparks.position = { 0.0f, 0.0f, 0.0f };
+	sparks.position_spread = { 0.08f, 0.08f, 0.08f };
+	sparks.velocity = { 0.0f, 1.2f, 0.0f };
+	sparks.velocity_spread = { 1.5f, 1.0f, 1.5f };
+	sparks.rate = 1500.0f;
+	sparks.lifetime = 1.2f;
+	sparks.size = 0.006f;
+	sparks.color = 0xFF40A0FFu; // Orange
+	sparks.active = true;
+	simulation.spark_emitter = ParticleEmitterCreate(simulation.sparks, sparks, 1);
+
+	// A dust emitter at each of the 9 crossings around the origin, which are a block and a street apart
+	for (int x = -1; x <= 1; x++) {
+		for (int z = -1; z <= 1; z++) {
+			particle_emitter_t dust = {};
+			dust.position = { (float)x * 32.0f, 1.4f, (float)z * 32.0f };
+			dust.position_spread = { 4.0f, 3.0f, 4.0f };
+			dust.velocity = { 0.3f, 0.05f, 0.1f };
+			dust.velocity_spread = { 0.2f, 0.1f, 0.2f };
+			dust.rate = 300.0f;
+			dust.lifetime = 6.0f;
+			dust.size = 0.02f;
+			dust.color = 0x60B0C0D0u; // Light gray, mostly transparent
+			dust.active = true;
+			ParticleEmitterCreate(simulation.dust, dust, (uint32_t)((x + 1) * 3 + z + 1) + 2);
+		}
+	}
+}
+
+// Moves the crates, bounces them off the edges of the crossing and off each other
+static void SimulationMoveCrates(simulation_t& simulation) {
+	for (uint32_t i = 0; i < simulation.crate_count; i++) {
+		scene_object_t& crate = simulation.scene.objects[simulation.first_crate + i];
+		XrVector3f& velocity = simulation.crate_velocities[i];
+		crate.position.x += velocity.x;
+		crate.position.z += velocity.z;
+		crate.moved = true;
+
+		float limit = simulation_crate_area - crate.half_extents.x;
+		if ((crate.position.x > limit && velocity.x > 0.0f) || (crate.position.x < -limit && velocity.x < 0.0f)) {
+			velocity.x = -velocity.x;
+		}
+		if ((crate.position.z > limit && velocity.z > 0.0f) || (crate.position.z < -limit && velocity.z < 0.0f)) {
+			velocity.z = -velocity.z;
+		}
+
+		broadphase_box_t& box = simulation.crate_boxes[i];
+		box.min = { crate.position.x - crate.half_extents.x, crate.position.y - crate.half_extents.y, crate.position.z - crate.half_extents.z };
+		box.max = { crate.position.x + crate.half_extents.x, crate.position.y + crate.half_extents.y, crate.position.z + crate.half_extents.z };
+	}
+
+	BroadphaseUpdate(simulation.broadphase, simulation.crate_boxes.data(), simulation.crate_count, simulation.crate_pairs);
+
+	// The crates are axis aligned and all equally heavy. Two crates that overlap are pushed apart along the axis
+	// they overlap the least on, and if they move towards each other, they swap their velocities on that axis.
+	// The positions may have changed since the boxes were made, by an earlier pair, so they're checked again
+	simulation.crate_collisions = 0;
+	for (const broadphase_pair_t& pair : simulation.crate_pairs) {
+		scene_object_t& a = simulation.scene.objects[simulation.first_crate + pair.a];
+		scene_object_t& b = simulation.scene.objects[simulation.first_crate + pair.b];
+		float overlap_x = a.half_extents.x + b.half_extents.x - std::fabs(a.position.x - b.position.x);
+		float overlap_z = a.half_extents.z + b.half_extents.z - std::fabs(a.position.z - b.position.z);
+		if (overlap_x <= 0.0f || overlap_z <= 0.0f) {
+			continue;
+		}
+		simulation.crate_collisions++;
+
+		XrVector3f& velocity_a = simulation.crate_velocities[pair.a];
+		XrVector3f& velocity_b = simulation.crate_velocities[pair.b];
+		if (overlap_x < overlap_z) {
+			float side = a.position.x < b.position.x ? -1.0f : 1.0f;
+			a.position.x += side * overlap_x * 0.5f;
+			b.position.x -= side * overlap_x * 0.5f;
+			if ((velocity_a.x - velocity_b.x) * side < 0.0f) {
+				std::swap(velocity_a.x, velocity_b.x);
+			}
+		} else {
+			float side = a.position.z < b.position.z ? -1.0f : 1.0f;
+			a.position.z += side * overlap_z * 0.5f;
+			b.position.z -= side * overlap_z * 0.5f;
+			if ((velocity_a.z - velocity_b.z) * side < 0.0f) {
+				std::swap(velocity_a.z, velocity_b.z);
+			}
+		}
+	}
+}
+
+bool SimulationUpdate(simulation_t& simulation, const input_snapshot_t* input) {
+	bool toggled = false;
+
+	// Pressing select on either controller pauses / resumes the spinning of the cube. The changed flags are
+	// relative to the snapshot before, so a snapshot we already handled must not toggle again
+	if (input && input->version > simulation.input_version) {
+		simulation.input_version = input->version;
+		for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+			uint32_t select_index = app_action_select * input_max_hands + hand;
+			bool select_changed = (input->action_changed & (1ull << select_index)) != 0;
+			if (select_changed && input->action_values[select_index] > 0.5f) {
+				simulation.cube_spinning = !simulation.cube_spinning;
+				toggled = true;
+			}
+
+			// Squeezing grab with a hand close to the cube picks it up, unless the other hand already holds it
+			uint32_t grab_index = app_action_grab * input_max_hands + hand;
+			bool grab_changed = (input->action_changed & (1ull << grab_index)) != 0;
+			bool hand_valid = (input->hand_pose_valid & (1u << hand)) != 0;
+			if (grab_changed && input->action_values[grab_index] > 0.5f && hand_valid && simulation.cube_grab_hand == input_max_hands) {
+				const XrVector3f& hand_position = input->hand_poses[hand].position;
+				const XrVector3f& cube_position = simulation.scene.objects[simulation.cube_object].position;
+				XrVector3f offset = { cube_position.x - hand_position.x, cube_position.y - hand_position.y, cube_position.z - hand_position.z };
+				if (offset.x * offset.x + offset.y * offset.y + offset.z * offset.z < simulation_grab_reach * simulation_grab_reach) {
+					simulation.cube_grab_hand = hand;
+					simulation.cube_grab_offset = offset;
+				}
+			}
+		}
+	}
+
+	// The cube drops (and stays where it is) when the hand that holds it lets go or loses tracking. Until then,
+	// it follows the hand. Without any input, nothing changes
+	scene_object_t& cube = simulation.scene.objects[simulation.cube_object];
+	bool cube_moved = false;
+	if (input && simulation.cube_grab_hand < input_max_hands) {
+		uint32_t hand = simulation.cube_grab_hand;
+		if (input->action_values[app_action_grab * input_max_hands + hand] <= 0.5f || (input->hand_pose_valid & (1u << hand)) == 0) {
+			simulation.cube_grab_hand = input_max_hands;
+		} else {
+			const XrVector3f& hand_position = input->hand_poses[hand].position;
+			const XrVector3f& offset = simulation.cube_grab_offset;
+			cube.position = { hand_position.x + offset.x, hand_position.y + offset.y, hand_position.z + offset.z };
+			cube_moved = true;
+		}
+	}
+
+	// Get the rotation we'll apply to the cube from the rotation angles. Here, we need a quaternion. While the
+	// cube is paused, it keeps its rotation and doesn't need to be drawn any differently
+	if (simulation.cube_spinning) {
+		simulation.cube_rotation_angles.x += 0.02f;
+		simulation.cube_rotation_angles.y += 0.04f;
+
+		XrVector3f& angles = simulation.cube_rotation_angles;
+		cube.orientation = XrMathQuatFromEuler(angles.x, angles.y, angles.z);
+		cube_moved = true;
+	}
+	if (cube_moved) {
+		cube.moved = true;
+		TransformGraphSetLocal(simulation.transforms, simulation.cube_node, XrMathAffine(1.0f, cube.orientation, cube.position));
+	}
+
+	// Only the moons whose world matrix changed are moved, which is none of them while the cube is paused
+	TransformGraphUpdate(simulation.transforms);
+	for (uint32_t i = 0; i < simulation_moon_count; i++) {
+		if (TransformGraphChanged(simulation.transforms, simulation.moon_nodes[i])) {
+			XrPosef pose = TransformGraphWorldPose(simulation.transforms, simulation.moon_nodes[i]);
+			scene_object_t& moon = simulation.scene.objects[simulation.first_moon + i];
+			moon.position = pose.position;
+			moon.orientation = pose.orientation;
+			moon.moved = true;
+		}
+	}
+
+	SceneMoveLights(simulation.scene);
+	SimulationMoveCrates(simulation);
+
+	// The sparks fly off wherever the cube is
+	simulation.sparks.emitters[simulation.spark_emitter].active = simulation.cube_spinning;
+	simulation.sparks.emitters[simulation.spark_emitter].position = cube.position;
+	ParticleSystemUpdate(simulation.sparks, simulation_step_seconds, simulation.jobs);
+	ParticleSystemUpdate(simulation.dust, simulation_step_seconds, simulation.jobs);
+
+	simulation.frame++;
+	return toggled;
+}
+
+bool SimulationUpdateFrame(simulation_t& simulation, const input_snapshot_t* input, pose_cache_t& hand_poses, XrTime display_time, XrDuration display_period, uint32_t missed_periods) {
+	uint32_t steps = std::min(missed_periods + 1, simulation_max_frame_steps);
+	if (!input) {
+		bool toggled = false;
+		for (uint32_t step = 0; step < steps; step++) {
+			toggled = SimulationUpdate(simulation, nullptr) || toggled;
+		}
+		return toggled;
+	}
+
+	// The times of the steps, the oldest first. The hands were located at the display time of this frame and of
+	// the ones before, so the cache interpolates between those for the steps of the missed periods
+	XrTime step_times[simulation_max_frame_steps];
+	for (uint32_t step = 0; step < steps; step++) {
+		step_times[step] = display_time - (XrTime)(steps - 1 - step) * display_period;
+	}
+	XrPosef step_poses[input_max_hands][simulation_max_frame_steps];
+	for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+		if (input->hand_pose_valid & (1u << hand)) {
+			PoseCacheQuery(hand_poses, hand, step_times, step_poses[hand], steps);
+		}
+	}
+
+	// Every step gets the same buttons. SimulationUpdate only applies their changes once, with the first step
+	bool toggled = false;
+	input_snapshot_t step_input = *input;
+	for (uint32_t step = 0; step < steps; step++) {
+		for (uint32_t hand = 0; hand < input_max_hands; hand++) {
+			if (input->hand_pose_valid & (1u << hand)) {
+				step_input.hand_poses[hand] = step_poses[hand][step];
+			}
+		}
+		toggled = SimulationUpdate(simulation, &step_input) || toggled;
+	}
+	return toggled;
+}
+
+void SimulationCull(simulation_t& simulation, occlusion_buffer_t& buffer, const XrPosef* poses, const XrFovf* fovs, uint32_t view_count, float near_z, float far_z) {
+	// Without any views, there is nothing to cull against
+	if (view_count == 0) {
+		for (scene_object_t& object : simulation.scene.objects) {
+			object.visible = true;
+		}
+		return;
+	}
+
+	std::vector<XrFovf> widened_fovs(fovs, fovs + view_count);
+	for (XrFovf& fov : widened_fovs) {
+		fov.angleLeft -= simulation_cull_margin;
+		fov.angleRight += simulation_cull_margin;
+		fov.angleUp += simulation_cull_margin;
+		fov.angleDown -= simulation_cull_margin;
+	}
+
+	occlusion_view_t combined_view = OcclusionCombinedView(poses, widened_fovs.data(), view_count, near_z, far_z);
+	SceneCull(simulation.scene, buffer, combined_view);
+}
+
+uint64_t SimulationChecksum(const simulation_t& simulation) {
+	// FNV-1a over the bytes of the state
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const void* data, size_t size) {
+		const uint8_t* bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+	};
+
+	mix(&simulation.cube_rotation_angles, sizeof(simulation.cube_rotation_angles));
+	mix(&simulation.cube_spinning, sizeof(simulation.cube_spinning));
+	mix(&simulation.cube_grab_hand, sizeof(simulation.cube_grab_hand));
+	mix(&simulation.cube_grab_offset, sizeof(simulation.cube_grab_offset));
+	mix(&simulation.frame, sizeof(simulation.frame));
+	for (const scene_object_t& object : simulation.scene.objects) {
+		mix(&object.position, sizeof(object.position));
+		mix(&object.orientation, sizeof(object.orientation));
+		mix(&object.visible, sizeof(object.visible));
+	}
+	mix(simulation.crate_velocities.data(), simulation.crate_velocities.size() * sizeof(XrVector3f));
+	for (const light_t& light : simulation.scene.lights) {
+		mix(&light.position, sizeof(light.position));
+	}
+	for (const particle_system_t* particles : { &simulation.sparks, &simulation.dust }) {
+		mix(&particles->count, sizeof(particles->count));
+		mix(particles->position_x.data(), particles->count * sizeof(float));
+		mix(particles->position_y.data(), particles->count * sizeof(float));
+		mix(particles->position_z.data(), particles->count * sizeof(float));
+	}
+	return hash;
+}
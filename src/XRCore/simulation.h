@@ -0,0 +1,118 @@
+#pragma once
+//###################################################################################################################
+// Simulation
+//###################################################################################################################
+// The state of the application that changes from frame to frame, and how it changes. It only depends on the
+// input of a frame, not on OpenXR or the graphics API, such that a recorded session (see frame_capture.h) can
+// be replayed on any machine and always ends up in exactly the same state.
+
+#include "broadphase.h"
+#include "input_snapshot.h"
+#include "job_system.h"
+#include "particles.h"
+#include "pose_cache.h"
+#include "scene.h"
+#include "transform_graph.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Enums
+//------------------------------------------------------------------------------------------------------
+
+// The actions we read for each hand. In the input snapshot, the value of an action for a hand is
+// stored at action_values[action * input_max_hands + hand]
+// The simulation advances by one frame per update, which the particles take to be this long
+const float simulation_step_seconds = 1.0f / 90.0f;
+
+// Most steps SimulationUpdateFrame runs for one frame. A frame that comes even later only catches up this far,
+// such that a slow frame doesn't make the next one slower still
+const uint32_t simulation_max_frame_steps = 4;
+
+// How close to the center of the cube a hand has to be to grab it, in meters
+const float simulation_grab_reach = 0.15f;
+
+// The crates stay on the street crossing the user stands on, within this distance of the origin along x and z
+const float simulation_crate_area = 3.6f;
+
+// How much SimulationCull widens the fovs on each side, in radians, as the late latched poses can be turned a
+// bit compared to the early ones the culling uses
+const float simulation_cull_margin = 0.02f;
+
+// Small boxes that circle the spinning cube, see simulation_t
+const uint32_t simulation_moon_count = 3;
+
+// The sun and the ambient light that light up the scene, on top of the lights of the scene
+const scene_sun_t simulation_sun = { { 1.0f, 1.0f, 1.0f }, { 0.5f, 0.5f, 0.5f }, { 0.2f, 0.2f, 0.2f } };
+
+enum app_action_t {
+	app_action_select,
+	app_action_grab,
+	app_action_menu,
+	app_action_count
+};
+
+struct simulation_t {
+	scene_t scene; // Everything we draw: The spinning cube, surrounded by a few city blocks with their lights
+	uint32_t cube_object; // Index of the spinning cube in the scene
+	XrVector3f cube_rotation_angles; // Pitch, yaw and roll of the cube
+	bool cube_spinning; // Toggled with the select button of the controllers
+	uint32_t cube_grab_hand; // The hand that holds the cube, input_max_hands if none does
+	XrVector3f cube_grab_offset; // From the hand that holds the cube to the cube, kept while it's held
+	uint64_t input_version; // Version of the last input snapshot whose button changes were applied, see SimulationUpdate
+	uint64_t frame; // Number of updates so far
+
+	// Sparks fly off the cube while it spins, and dust drifts around the street crossings near the user
+	particle_system_t sparks;
+	particle_system_t dust;
+	uint32_t spark_emitter;
+
+	// Crates that slide around on the crossing and bounce off each other. They're objects of the scene from
+	// first_crate on. The broadphase finds the crates that might touch, which are then pushed apart
+	uint32_t first_crate;
+	uint32_t crate_count;
+	std::vector<XrVector3f> crate_velocities; // Meters per frame
+	broadphase_t broadphase;
+	std::vector<broadphase_box_t> crate_boxes;
+	std::vector<broadphase_pair_t> crate_pairs; // Of the last update
+	uint32_t crate_collisions; // Of the last update, pairs that actually touched
+
+	// Moons that are attached to the cube: two on opposite sides of it, and a smaller one attached to the first
+	// moon. They're objects of the scene from first_moon on, and nodes of the transform graph below the node of
+	// the cube, so they turn with the cube without the simulation moving them itself
+	transform_graph_t transforms;
+	uint32_t cube_node;
+	uint32_t moon_nodes[simulation_moon_count];
+	uint32_t first_moon;
+
+	// The particles are updated on these threads, or on the calling thread if this is nullptr. Not part of
+	// the state: the particles end up the same with any number of threads
+	job_system_t* jobs;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+void SimulationInit(simulation_t& simulation);
+
+// Advances the simulation by one frame. input is the newest input snapshot, or nullptr if there is no input
+// yet. The button changes of a snapshot are only applied once, even if the same snapshot is passed again (the
+// simulation can run more often than input is published). Returns true if the spinning of the cube was toggled
+bool SimulationUpdate(simulation_t& simulation, const input_snapshot_t* input);
+
+// Advances the simulation by the steps of a frame: one, plus one for every display period that was missed since
+// the last frame (at most simulation_max_frame_steps in all), such that it keeps up with the display. The steps
+// are a display period apart, the last one at the display time of the frame, and each of them sees the hands
+// where they were at its own time. hand_poses has the poses the hands were located at for the last frames, in
+// its first input_max_hands spaces. Returns true if the spinning of the cube was toggled
+bool SimulationUpdateFrame(simulation_t& simulation, const input_snapshot_t* input, pose_cache_t& hand_poses, XrTime display_time, XrDuration display_period, uint32_t missed_periods);
+
+// Culls the scene for the views of a frame, all views at once (see occlusion.h). The poses are the ones located
+// early in the frame, the fovs are widened a little, as the late latched poses (which we render with) can be
+// turned a bit compared to them. Without any views, every object is visible
+void SimulationCull(simulation_t& simulation, occlusion_buffer_t& buffer, const XrPosef* poses, const XrFovf* fovs, uint32_t view_count, float near_z, float far_z);
+
+// A hash of the whole simulation state (including which objects are visible), to check that two runs
+// ended up in the same state
+uint64_t SimulationChecksum(const simulation_t& simulation);
@@ -0,0 +1,169 @@
+#include "temporal_upscale.h"
+
+#include <algorithm>
+#include <cmath>
+
+void TemporalInternalSize(uint32_t output_width, uint32_t output_height, float scale, uint32_t& width, uint32_t& height) {
+	scale = std::min(std::max(scale, 0.1f), 1.0f);
+	width = std::max((uint32_t)std::lround((float)output_width * scale), 1u);
+	height = std::max((uint32_t)std::lround((float)output_height * scale), 1u);
+}
+
+// The index-th number of the Halton sequence with the given base, from 0 to 1
+static float TemporalHalton(uint32_t index, uint32_t base) {
+	float result = 0.0f;
+	float fraction = 1.0f;
+	while (index > 0) {
+		fraction /= (float)base;
+		result += fraction * (float)(index % base);
+		index /= base;
+	}
+	return result;
+}
+
+temporal_jitter_t TemporalJitter(uint64_t frame, uint32_t width, uint32_t height) {
+	// The sequence starts at 1, as its first number is 0 in every base
+	uint32_t index = (uint32_t)(frame % temporal_jitter_phases) + 1;
+	temporal_jitter_t jitter;
+	jitter.pixels = { TemporalHalton(index, 2) - 0.5f, TemporalHalton(index, 3) - 0.5f };
+
+	// To sample further right, the image has to move left, and normalized device coordinates point up
+	jitter.ndc = { 2.0f * jitter.pixels.x / (float)width, -2.0f * jitter.pixels.y / (float)height };
+	return jitter;
+}
+
+xr_mat4_t TemporalJitterProjection(const xr_mat4_t& projection, const temporal_jitter_t& jitter) {
+	// The third row is multiplied by the z of the view space position, and w ends up as -z, so after the divide by
+	// w, adding to this row moves the whole image by the negated amount, no matter how far away something is
+	xr_mat4_t result = projection;
+	result.m[2][0] += jitter.ndc.x;
+	result.m[2][1] += jitter.ndc.y;
+	return result;
+}
+
+void TemporalUpscaleInit(temporal_upscaler_t& upscaler, uint32_t input_width, uint32_t input_height, uint32_t output_width, uint32_t output_height) {
+	upscaler = {};
+	upscaler.input_width = input_width;
+	upscaler.input_height = input_height;
+	upscaler.output_width = output_width;
+	upscaler.output_height = output_height;
+	upscaler.history[0].resize((size_t)output_width * output_height * 4, 0.0f);
+	upscaler.history[1].resize((size_t)output_width * output_height * 4, 0.0f);
+	upscaler.clamp_history = true;
+}
+
+void TemporalUpscaleReset(temporal_upscaler_t& upscaler) {
+	upscaler.history_valid = false;
+}
+
+// Lookup in an RGBA image at a position in pixels (pixel centers at .5), with a Catmull-Rom filter over the 4x4
+// pixels around it, clamped to the edges. The history is looked up at a new position every frame, and a bilinear
+// lookup would blur it a little more each time. Catmull-Rom keeps it sharp
+static xr_vec4_t TemporalSampleCatmullRom(const float* image, uint32_t width, uint32_t height, float x, float y) {
+	x -= 0.5f;
+	y -= 0.5f;
+	float base_x = floorf(x);
+	float base_y = floorf(y);
+	float weights_x[4];
+	float weights_y[4];
+	for (int axis = 0; axis < 2; axis++) {
+		float t = axis == 0 ? x - base_x : y - base_y;
+		float* weights = axis == 0 ? weights_x : weights_y;
+		weights[0] = t * (-0.5f + t * (1.0f - 0.5f * t));
+		weights[1] = 1.0f + t * t * (-2.5f + 1.5f * t);
+		weights[2] = t * (0.5f + t * (2.0f - 1.5f * t));
+		weights[3] = t * t * (-0.5f + 0.5f * t);
+	}
+
+	xr_vec4_t result = XrVecSplat(0.0f);
+	for (int j = 0; j < 4; j++) {
+		int32_t row = std::min(std::max((int32_t)base_y - 1 + j, 0), (int32_t)height - 1);
+		xr_vec4_t row_sum = XrVecSplat(0.0f);
+		for (int i = 0; i < 4; i++) {
+			int32_t column = std::min(std::max((int32_t)base_x - 1 + i, 0), (int32_t)width - 1);
+			row_sum = XrVecMulAdd(XrVecLoadUnaligned(image + ((size_t)row * width + column) * 4), XrVecSplat(weights_x[i]), row_sum);
+		}
+		result = XrVecMulAdd(row_sum, XrVecSplat(weights_y[j]), result);
+	}
+	return result;
+}
+
+const float* TemporalUpscaleResolve(temporal_upscaler_t& upscaler, const float* color, const float* motion, const temporal_jitter_t& jitter) {
+	const uint32_t in_w = upscaler.input_width;
+	const uint32_t in_h = upscaler.input_height;
+	const uint32_t out_w = upscaler.output_width;
+	const uint32_t out_h = upscaler.output_height;
+	const float* history = upscaler.history[upscaler.current].data();
+	float* output = upscaler.history[upscaler.current ^ 1].data();
+	const float to_input_x = (float)in_w / (float)out_w;
+	const float to_input_y = (float)in_h / (float)out_h;
+
+	for (uint32_t oy = 0; oy < out_h; oy++) {
+		for (uint32_t ox = 0; ox < out_w; ox++) {
+			//----------------------------------------------------------------------------------
+			// The new sample closest to the center of the output pixel
+			//----------------------------------------------------------------------------------
+			// Input pixel (x, y) sampled the point (x + 0.5 + jitter.x, y + 0.5 + jitter.y) of the input image
+			float u = ((float)ox + 0.5f) / (float)out_w;
+			float v = ((float)oy + 0.5f) / (float)out_h;
+			float px = ((float)ox + 0.5f) * to_input_x;
+			float py = ((float)oy + 0.5f) * to_input_y;
+			int32_t ix = std::min(std::max((int32_t)floorf(px - jitter.pixels.x), 0), (int32_t)in_w - 1);
+			int32_t iy = std::min(std::max((int32_t)floorf(py - jitter.pixels.y), 0), (int32_t)in_h - 1);
+			float dx = (float)ix + 0.5f + jitter.pixels.x - px;
+			float dy = (float)iy + 0.5f + jitter.pixels.y - py;
+			size_t input_index = (size_t)iy * in_w + ix;
+			xr_vec4_t sample = XrVecLoadUnaligned(color + input_index * 4);
+
+			// The closer the sample is to the center of the output pixel, the more it counts
+			float weight = expf(-2.29f * (dx * dx + dy * dy));
+
+			//----------------------------------------------------------------------------------
+			// Where the pixel was in the last frame
+			//----------------------------------------------------------------------------------
+			float previous_u = u - motion[input_index * 2 + 0];
+			float previous_v = v - motion[input_index * 2 + 1];
+			bool has_history = upscaler.history_valid && previous_u >= 0.0f && previous_u <= 1.0f && previous_v >= 0.0f && previous_v <= 1.0f;
+			xr_vec4_t result = sample;
+			float samples = weight;
+			if (has_history) {
+				xr_vec4_t previous = TemporalSampleCatmullRom(history, out_w, out_h, previous_u * (float)out_w, previous_v * (float)out_h);
+				float previous_rgba[4];
+				XrVecStoreUnaligned(previous_rgba, previous);
+				float history_samples = std::max(previous_rgba[3], 0.0f);
+
+				// Clamp to the colors of the new samples around it, such that history that doesn't belong to
+				// this pixel anymore can't stay. The further the clamp had to move it, the less of it was right,
+				// and the less it counts from now on
+				if (upscaler.clamp_history) {
+					xr_vec4_t low = sample;
+					xr_vec4_t high = sample;
+					for (int32_t ny = std::max(iy - 1, 0); ny <= std::min(iy + 1, (int32_t)in_h - 1); ny++) {
+						for (int32_t nx = std::max(ix - 1, 0); nx <= std::min(ix + 1, (int32_t)in_w - 1); nx++) {
+							xr_vec4_t neighbor = XrVecLoadUnaligned(color + ((size_t)ny * in_w + nx) * 4);
+							low = XrVecMin(low, neighbor);
+							high = XrVecMax(high, neighbor);
+						}
+					}
+					xr_vec4_t clamped = XrVecMin(XrVecMax(previous, low), high);
+					float clamped_rgba[4];
+					XrVecStoreUnaligned(clamped_rgba, clamped);
+					float moved = fabsf(clamped_rgba[0] - previous_rgba[0]) + fabsf(clamped_rgba[1] - previous_rgba[1]) + fabsf(clamped_rgba[2] - previous_rgba[2]);
+					history_samples *= expf(-temporal_reject * moved);
+					previous = clamped;
+				}
+
+				// A short history is the average of its samples so far, a long one fades out with temporal_blend
+				float blend = std::max(weight / (history_samples + weight), temporal_blend * weight);
+				result = XrVecMulAdd(XrVecSub(sample, previous), XrVecSplat(blend), previous);
+				samples = std::min(history_samples + weight, 1.0f / temporal_blend);
+			}
+			XrVecStoreUnaligned(output + ((size_t)oy * out_w + ox) * 4, result);
+			output[((size_t)oy * out_w + ox) * 4 + 3] = samples;
+		}
+	}
+
+	upscaler.current ^= 1;
+	upscaler.history_valid = true;
+	return output;
+}
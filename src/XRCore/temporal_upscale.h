@@ -0,0 +1,92 @@
+#pragma once
+//###################################################################################################################
+// Temporal upscaling
+//###################################################################################################################
+// Shading every pixel of the recommended resolution is the largest part of the GPU work of a frame. With temporal
+// upscaling, the views are rendered at a lower internal resolution, and the missing pixels are filled in from
+// the frames before:
+//
+// - The projection of every frame is moved by a different sub-pixel offset (the jitter), so over a few frames,
+//   the pixels of the internal resolution sample different points of each pixel of the output.
+// - The shaders also write the motion vector of each pixel: where the surface of the pixel was on the screen in
+//   the last frame. That's the motion of the head and of the object itself, as every object has the world
+//   matrix of the last frame in its constants as well (see scene_draw_item_t). The particles don't write
+//   any, they are only blended on top.
+// - A resolve pass then blends each pixel of the output (the history) with the closest new sample. The history
+//   is looked up where the pixel was in the last frame, and clamped to the colors of the new samples around it.
+//   Where the history shows something that isn't there anymore (something moved in front of it, or it was
+//   outside of the view), the clamp replaces it by what is there now, which reduces ghosting.
+// - The alpha of the history counts how many samples it holds. A new or freshly uncovered pixel averages its
+//   first samples evenly instead of keeping 90% of the first one, and history that the clamp had to move
+//   loses its count, such that the new samples take over quickly.
+//
+// The resolve exists twice: here, on the CPU, such that the quality and the cost can be measured without a GPU
+// (see the temporal_upscale benchmark), and in UpscalePShader in shaders.shader, which does exactly the same on
+// the GPU.
+
+#include "xr_core_types.h"
+#include "xr_math.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+
+// The jitter cycles through this many offsets
+const uint32_t temporal_jitter_phases = 8;
+
+// How much of a new sample goes into the history if the sample lies exactly on the center of the output pixel.
+// Samples further away count less (see TemporalUpscaleResolve). Until the history of a pixel has 1 / temporal_blend
+// samples, every new sample counts as much as all the ones before
+const float temporal_blend = 0.1f;
+
+// How quickly the history of a pixel is forgotten where the clamp has to move it: by a factor of e for every
+// 0.02 the clamp moves the red, green and blue together
+const float temporal_reject = 50.0f;
+
+// The sub-pixel offset of the samples of a frame, once in pixels of the rendered image (from -0.5 to 0.5), and once
+// in normalized device coordinates, ready to be added to the projection
+struct temporal_jitter_t {
+	XrVector2f pixels;
+	XrVector2f ndc;
+};
+
+// The CPU backend of the resolve. The images have 4 floats (RGBA) per pixel
+struct temporal_upscaler_t {
+	uint32_t input_width; // The internal resolution the views are rendered at
+	uint32_t input_height;
+	uint32_t output_width; // The resolution of the swapchain
+	uint32_t output_height;
+	std::vector<float> history[2]; // The output of the last frame, and the one being written
+	uint32_t current; // Which of the two holds the output of the last resolve
+	bool history_valid; // False before the first frame, and after a reset
+	bool clamp_history; // Clamp the history to the new samples around it (only off to see what it prevents)
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+// The internal resolution for an output resolution, with scale (from 0 to 1) per axis
+void TemporalInternalSize(uint32_t output_width, uint32_t output_height, float scale, uint32_t& width, uint32_t& height);
+
+// The jitter of a frame, for an image of the given size. The offsets follow the Halton sequence (base 2 in x, base
+// 3 in y), which spreads them evenly over the pixel
+temporal_jitter_t TemporalJitter(uint64_t frame, uint32_t width, uint32_t height);
+
+// Moves a projection (see XrMathProjectionFov) by the jitter. Positive pixel offsets move the samples right and down
+xr_mat4_t TemporalJitterProjection(const xr_mat4_t& projection, const temporal_jitter_t& jitter);
+
+void TemporalUpscaleInit(temporal_upscaler_t& upscaler, uint32_t input_width, uint32_t input_height, uint32_t output_width, uint32_t output_height);
+
+// Forgets the history, e.g. after the view jumped somewhere else. The next resolve only uses the new samples
+void TemporalUpscaleReset(temporal_upscaler_t& upscaler);
+
+// Blends a new frame into the history and returns the output (output_width * output_height RGBA pixels), which
+// stays valid until the next resolve. color has the input_width * input_height pixels rendered with the jitter,
+// motion the motion vector of each of them, as two floats: the position of the pixel on the screen minus its
+// position in the last frame, in texture coordinates (0 to 1, y down). The alpha of the output is the number of
+// samples in the history, not the alpha of the image
+const float* TemporalUpscaleResolve(temporal_upscaler_t& upscaler, const float* color, const float* motion, const temporal_jitter_t& jitter);
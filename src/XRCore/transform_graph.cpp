@@ -0,0 +1,237 @@
+#include "transform_graph.h"
+
+#include <algorithm>
+
+void TransformGraphInit(transform_graph_t& graph) {
+	graph = {};
+	graph.sorted = true;
+}
+
+uint32_t TransformGraphAdd(transform_graph_t& graph, uint32_t parent, const xr_mat4_t& local) {
+	uint32_t node = (uint32_t)graph.node_slots.size();
+	uint32_t slot = (uint32_t)graph.slot_nodes.size();
+	uint32_t parent_slot = parent == transform_no_parent ? transform_no_parent : graph.node_slots[parent];
+	uint32_t depth = parent_slot == transform_no_parent ? 0 : graph.depths[parent_slot] + 1;
+
+	// The new node goes to the end for now, after its parent. That's enough for the update to be correct, but
+	// unless the parent is the last node or one of its ancestors, the subtree of the parent isn't in one piece
+	// anymore, and the update sorts the arrays again
+	if (graph.sorted && parent_slot != transform_no_parent) {
+		uint32_t ancestor = slot - 1;
+		while (ancestor != transform_no_parent && graph.depths[ancestor] > graph.depths[parent_slot]) {
+			ancestor = graph.parents[ancestor];
+		}
+		graph.sorted = ancestor == parent_slot;
+	}
+
+	graph.node_slots.push_back(slot);
+	graph.slot_nodes.push_back(node);
+	graph.parents.push_back(parent_slot);
+	graph.depths.push_back(depth);
+	graph.locals.emplace_back();
+	for (int row = 0; row < 4; row++) {
+		for (int column = 0; column < 3; column++) {
+			graph.locals.back().m[row][column] = local.m[row][column];
+		}
+	}
+	graph.worlds.push_back(local);
+	graph.dirty.push_back(1);
+	graph.changed.push_back(0);
+	graph.any_dirty = true;
+	return node;
+}
+
+// Sorts the slots depth first, such that every node is followed by its whole subtree, and the children of a node
+// stay in the order they were added
+static void TransformGraphSort(transform_graph_t& graph) {
+	uint32_t count = (uint32_t)graph.slot_nodes.size();
+
+	// The size of each subtree, from the back, as the children come after their parent
+	std::vector<uint32_t> sizes(count, 1);
+	for (uint32_t slot = count; slot-- > 0;) {
+		if (graph.parents[slot] != transform_no_parent) {
+			sizes[graph.parents[slot]] += sizes[slot];
+		}
+	}
+
+	// Every node gets the first free slot within the subtree of its parent, and leaves room for its own subtree
+	std::vector<uint32_t> new_slots(count);
+	std::vector<uint32_t> next_child(count);
+	uint32_t next_root = 0;
+	for (uint32_t slot = 0; slot < count; slot++) {
+		uint32_t parent = graph.parents[slot];
+		if (parent == transform_no_parent) {
+			new_slots[slot] = next_root;
+			next_root += sizes[slot];
+		} else {
+			new_slots[slot] = next_child[parent];
+			next_child[parent] += sizes[slot];
+		}
+		next_child[slot] = new_slots[slot] + 1;
+	}
+
+	// Move everything to its new slot. The parents are slots as well, so they're remapped on the way
+	std::vector<uint32_t> slot_nodes(count);
+	std::vector<uint32_t> parents(count);
+	std::vector<uint32_t> depths(count);
+	std::vector<transform_affine_t> locals(count);
+	std::vector<xr_mat4_t> worlds(count);
+	std::vector<uint8_t> dirty(count);
+	for (uint32_t slot = 0; slot < count; slot++) {
+		uint32_t to = new_slots[slot];
+		slot_nodes[to] = graph.slot_nodes[slot];
+		parents[to] = graph.parents[slot] == transform_no_parent ? transform_no_parent : new_slots[graph.parents[slot]];
+		depths[to] = graph.depths[slot];
+		locals[to] = graph.locals[slot];
+		worlds[to] = graph.worlds[slot];
+		dirty[to] = graph.dirty[slot];
+		graph.node_slots[graph.slot_nodes[slot]] = to;
+	}
+	graph.slot_nodes.swap(slot_nodes);
+	graph.parents.swap(parents);
+	graph.depths.swap(depths);
+	graph.locals.swap(locals);
+	graph.worlds.swap(worlds);
+	graph.dirty.swap(dirty);
+
+	graph.sorted = true;
+	graph.stats.sorts++;
+}
+
+// The world matrix of a root is its local matrix, with the last column filled in again
+static inline void TransformAffineToMatrix(const transform_affine_t& local, xr_mat4_t& world) {
+	for (int row = 0; row < 4; row++) {
+		world.m[row][0] = local.m[row][0];
+		world.m[row][1] = local.m[row][1];
+		world.m[row][2] = local.m[row][2];
+		world.m[row][3] = row == 3 ? 1.0f : 0.0f;
+	}
+}
+
+// local * parent for an affine local matrix. Its last column is 0, 0, 0, 1, so the rotation rows only need the
+// first three rows of the parent, and the translation row adds the last row of the parent on top
+static inline void TransformMultiplyAffine(const transform_affine_t& local, xr_vec4_t p0, xr_vec4_t p1, xr_vec4_t p2, xr_vec4_t p3, xr_mat4_t& world) {
+	for (int row = 0; row < 3; row++) {
+		xr_vec4_t r = XrVecMul(XrVecSplat(local.m[row][0]), p0);
+		r = XrVecMulAdd(XrVecSplat(local.m[row][1]), p1, r);
+		r = XrVecMulAdd(XrVecSplat(local.m[row][2]), p2, r);
+		XrVecStore(world.m[row], r);
+	}
+	xr_vec4_t r = XrVecMulAdd(XrVecSplat(local.m[3][0]), p0, p3);
+	r = XrVecMulAdd(XrVecSplat(local.m[3][1]), p1, r);
+	r = XrVecMulAdd(XrVecSplat(local.m[3][2]), p2, r);
+	XrVecStore(world.m[3], r);
+}
+
+// Every world matrix, without skipping the unchanged ones. The changed flags are still passed on, but without
+// branching on them
+static void TransformGraphUpdateAll(transform_graph_t& graph) {
+	uint32_t count = (uint32_t)graph.slot_nodes.size();
+	const uint32_t* parents = graph.parents.data();
+	const transform_affine_t* locals = graph.locals.data();
+	xr_mat4_t* worlds = graph.worlds.data();
+	uint8_t* dirty = graph.dirty.data();
+	uint8_t* changed = graph.changed.data();
+	uint32_t changed_count = 0;
+
+	uint32_t loaded_parent = transform_no_parent;
+	xr_vec4_t p0 = XrVecSplat(0.0f), p1 = p0, p2 = p0, p3 = p0;
+	for (uint32_t slot = 0; slot < count; slot++) {
+		uint32_t parent = parents[slot];
+		if (parent == transform_no_parent) {
+			TransformAffineToMatrix(locals[slot], worlds[slot]);
+			changed[slot] = dirty[slot];
+			changed_count += dirty[slot];
+			dirty[slot] = 0;
+			continue;
+		}
+		if (parent != loaded_parent) {
+			p0 = XrVecLoad(worlds[parent].m[0]);
+			p1 = XrVecLoad(worlds[parent].m[1]);
+			p2 = XrVecLoad(worlds[parent].m[2]);
+			p3 = XrVecLoad(worlds[parent].m[3]);
+			loaded_parent = parent;
+		}
+		TransformMultiplyAffine(locals[slot], p0, p1, p2, p3, worlds[slot]);
+		changed[slot] = dirty[slot] | changed[parent];
+		changed_count += changed[slot];
+		dirty[slot] = 0;
+	}
+
+	graph.any_dirty = false;
+	graph.stats.updated = count;
+	graph.stats.changed = changed_count;
+	graph.stats.full_passes++;
+}
+
+void TransformGraphUpdate(transform_graph_t& graph) {
+	if (!graph.sorted) {
+		TransformGraphSort(graph);
+	}
+
+	// Nothing moved, only the changed flags of the last update have to go
+	if (!graph.any_dirty) {
+		if (graph.stats.changed > 0) {
+			std::fill(graph.changed.begin(), graph.changed.end(), (uint8_t)0);
+			graph.stats.updated = 0;
+			graph.stats.changed = 0;
+		}
+		return;
+	}
+
+	// Half of the world matrices changed last time, so most of them probably change again
+	uint32_t count = (uint32_t)graph.slot_nodes.size();
+	if (graph.stats.changed * 2 >= count) {
+		TransformGraphUpdateAll(graph);
+		return;
+	}
+
+	// One pass from the roots to the leaves. A node changes if its local matrix was set or its parent changed,
+	// and the parent (in an earlier slot) already knows whether it did
+	const uint32_t* parents = graph.parents.data();
+	const transform_affine_t* locals = graph.locals.data();
+	xr_mat4_t* worlds = graph.worlds.data();
+	uint8_t* dirty = graph.dirty.data();
+	uint8_t* changed = graph.changed.data();
+	uint32_t updated = 0;
+
+	// Siblings without children of their own are next to each other in the arrays, so the rows of a parent stay
+	// in registers for all of them, and are only loaded again when the parent changes
+	uint32_t loaded_parent = transform_no_parent;
+	xr_vec4_t p0 = XrVecSplat(0.0f), p1 = p0, p2 = p0, p3 = p0;
+	for (uint32_t slot = 0; slot < count; slot++) {
+		uint32_t parent = parents[slot];
+		bool is_changed = dirty[slot] != 0 || (parent != transform_no_parent && changed[parent] != 0);
+		changed[slot] = is_changed ? 1 : 0;
+		dirty[slot] = 0;
+		if (!is_changed) {
+			continue;
+		}
+
+		if (parent == transform_no_parent) {
+			TransformAffineToMatrix(locals[slot], worlds[slot]);
+		} else {
+			if (parent != loaded_parent) {
+				p0 = XrVecLoad(worlds[parent].m[0]);
+				p1 = XrVecLoad(worlds[parent].m[1]);
+				p2 = XrVecLoad(worlds[parent].m[2]);
+				p3 = XrVecLoad(worlds[parent].m[3]);
+				loaded_parent = parent;
+			}
+			TransformMultiplyAffine(locals[slot], p0, p1, p2, p3, worlds[slot]);
+		}
+		updated++;
+	}
+
+	graph.any_dirty = false;
+	graph.stats.updated = updated;
+	graph.stats.changed = updated;
+}
+
+XrPosef TransformGraphWorldPose(const transform_graph_t& graph, uint32_t node) {
+	const xr_mat4_t& world = TransformGraphWorld(graph, node);
+	XrPosef pose;
+	pose.orientation = XrMathQuatFromMatrix(world);
+	pose.position = { world.m[3][0], world.m[3][1], world.m[3][2] };
+	return pose;
+}
@@ -0,0 +1,113 @@
+#pragma once
+//###################################################################################################################
+// Transform graph
+//###################################################################################################################
+// Parent / child relationships between transforms: the world matrix of a node is its local matrix (relative to
+// its parent) times the world matrix of its parent, so moving a node moves everything attached to it.
+//
+// The nodes are stored as flat arrays, sorted depth first (a node, then the subtree of its first child, then the
+// subtree of the next child, ...). That way, the parent of a node always comes before the node, and a single
+// pass from front to back over the arrays updates the whole graph: when we get to a node, the world matrix of
+// its parent is already up to date. The pass only reads and writes the arrays in order, without following
+// pointers around, which keeps it fast with a lot of nodes. Every subtree is in one piece, so the nodes of a
+// chain are next to each other, and adding nodes below the last one (as a hierarchy is usually built) keeps the
+// slots in the order the nodes were added, such that setting the local matrices in that order writes in order.
+//
+// Setting the local matrix of a node marks it dirty. The update passes the dirty flag on to the children during
+// the same pass, and only multiplies the matrices of the nodes that are dirty themselves or have a dirty parent,
+// i.e. only the subtrees that changed. The multiplication uses the SIMD functions of xr_math.h, and assumes that
+// the local matrices are affine (the last column is 0, 0, 0, 1), which saves a quarter of the work.
+//
+// When most of the graph changes anyway (a lot of nodes are set every frame, or a few nodes high up in deep chains
+// move), skipping the unchanged nodes costs more in branches than it saves. Once an update changed at least half
+// of the world matrices, the next one computes every world matrix in a plain pass that doesn't skip anything, and
+// only works out the changed flags on the side, such that it's not slower than computing everything again.
+//
+// Nodes are referred to by the index they got when they were added. Their position in the sorted arrays (their
+// slot) can change when a node is added, so only the graph itself uses the slots.
+
+#include "xr_core_types.h"
+#include "xr_math.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+
+// The parent of root nodes
+const uint32_t transform_no_parent = 0xFFFFFFFF;
+
+// An affine local matrix without its last column, which is always 0, 0, 0, 1. A quarter less to store and to
+// read again in the update
+struct transform_affine_t {
+	float m[4][3];
+};
+
+struct transform_graph_stats_t {
+	uint32_t updated; // World matrices computed by the last update
+	uint32_t changed; // World matrices that changed in the last update. Less than updated after a full pass
+	uint32_t full_passes; // Updates that computed every world matrix, see above
+	uint32_t sorts; // Number of times the arrays had to be sorted again, because a node was added
+};
+
+struct transform_graph_t {
+	// Per node, the slot it is in
+	std::vector<uint32_t> node_slots;
+
+	// Per slot, sorted depth first
+	std::vector<uint32_t> slot_nodes; // The node in the slot
+	std::vector<uint32_t> parents; // Slot of the parent, or transform_no_parent
+	std::vector<uint32_t> depths; // 0 for the roots
+	std::vector<transform_affine_t> locals;
+	std::vector<xr_mat4_t> worlds;
+	std::vector<uint8_t> dirty; // The local matrix was set since the last update
+	std::vector<uint8_t> changed; // The world matrix changed in the last update
+
+	bool sorted; // False after adding a node whose parent isn't the last node or one of its ancestors
+	bool any_dirty; // A node was marked dirty since the last update, false skips the update
+	transform_graph_stats_t stats;
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+void TransformGraphInit(transform_graph_t& graph);
+
+// Adds a node below parent (a node that was added before, or transform_no_parent for a root) and returns its
+// index. Its world matrix is valid after the next update
+uint32_t TransformGraphAdd(transform_graph_t& graph, uint32_t parent, const xr_mat4_t& local);
+
+// Sets the local matrix of a node, which must be affine, and marks it dirty. Inline, as it's called for every
+// node that moves, and a call per node would cost more than the copy
+inline void TransformGraphSetLocal(transform_graph_t& graph, uint32_t node, const xr_mat4_t& local) {
+	uint32_t slot = graph.node_slots[node];
+	transform_affine_t& to = graph.locals[slot];
+	// Each row is stored with a whole vector, and the next row overwrites the fourth value of it. The last row
+	// would write past the end that way, so it's copied on its own
+	XrVecStoreUnaligned(to.m[0], XrVecLoad(local.m[0]));
+	XrVecStoreUnaligned(to.m[1], XrVecLoad(local.m[1]));
+	XrVecStoreUnaligned(to.m[2], XrVecLoad(local.m[2]));
+	memcpy(to.m[3], local.m[3], sizeof(to.m[3]));
+	graph.dirty[slot] = 1;
+	graph.any_dirty = true;
+}
+
+// Sorts the arrays if nodes were added, and computes the world matrices of the dirty nodes and their children
+// in one pass over the nodes
+void TransformGraphUpdate(transform_graph_t& graph);
+
+inline const xr_mat4_t& TransformGraphWorld(const transform_graph_t& graph, uint32_t node) {
+	return graph.worlds[graph.node_slots[node]];
+}
+
+// True if the world matrix of the node changed in the last update
+inline bool TransformGraphChanged(const transform_graph_t& graph, uint32_t node) {
+	return graph.changed[graph.node_slots[node]] != 0;
+}
+
+// The position and orientation of the world matrix of a node, which must be rigid (no scale)
+XrPosef TransformGraphWorldPose(const transform_graph_t& graph, uint32_t node);
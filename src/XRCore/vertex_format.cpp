@@ -0,0 +1,130 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------------------------------
+// 16 bit floats
+//------------------------------------------------------------------------------------------------------
+float VertexHalfToFloat(uint16_t half) {
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+
+	uint32_t bits;
+	if (exponent == 0x1F) {
+		// Infinity or NaN
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	} else if (exponent != 0) {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	} else if (mantissa != 0) {
+		// Denormalized, which is a normal float
+		float value = ldexpf((float)mantissa, -24);
+		return sign ? -value : value;
+	} else {
+		bits = sign;
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+// Rounds to the nearest half, values too big for a half become infinity
+uint16_t VertexFloatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	if (magnitude >= 0x7F800000) {
+		return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+	}
+	if (magnitude >= 0x477FF000) {
+		return sign | 0x7C00;
+	}
+	if (magnitude < 0x38800000) {
+		// Denormalized (or 0) as a half
+		return sign | (uint16_t)lrintf(ldexpf(fabsf(value), 24));
+	}
+	uint32_t rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+	return sign | (uint16_t)((rounded - 0x38000000) >> 13);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Runtime formats
+//------------------------------------------------------------------------------------------------------
+XrVector3f VertexDecode3(vertex_component_t component, const uint8_t* data) {
+	switch (component) {
+	case vertex_component_float3:
+		return VertexDecode3<vertex_component_float3>(data);
+	case vertex_component_float4:
+		return VertexDecode3<vertex_component_float4>(data);
+	case vertex_component_half4:
+		return VertexDecode3<vertex_component_half4>(data);
+	case vertex_component_snorm8x4:
+		return VertexDecode3<vertex_component_snorm8x4>(data);
+	case vertex_component_unorm8x4:
+		return VertexDecode3<vertex_component_unorm8x4>(data);
+	default:
+		return { 0.0f, 0.0f, 0.0f };
+	}
+}
+
+void VertexEncode(vertex_component_t component, const float* values, uint8_t* data) {
+	switch (component) {
+	case vertex_component_float2:
+	case vertex_component_float3:
+	case vertex_component_float4:
+		memcpy(data, values, VertexComponentSize(component));
+		break;
+	case vertex_component_half2:
+	case vertex_component_half4:
+		for (uint32_t i = 0; i < VertexComponentSize(component) / 2; i++) {
+			uint16_t half = VertexFloatToHalf(values[i]);
+			memcpy(data + i * 2, &half, sizeof(half));
+		}
+		break;
+	case vertex_component_snorm8x4:
+		for (uint32_t i = 0; i < 4; i++) {
+			data[i] = (uint8_t)(int8_t)lrintf(std::min(std::max(values[i], -1.0f), 1.0f) * 127.0f);
+		}
+		break;
+	case vertex_component_unorm8x4:
+		for (uint32_t i = 0; i < 4; i++) {
+			data[i] = (uint8_t)lrintf(std::min(std::max(values[i], 0.0f), 1.0f) * 255.0f);
+		}
+		break;
+	}
+}
+
+void VertexTransform(const vertex_layout_t& layout, const void* vertices, size_t count, const xr_mat4_t& world, const xr_mat4_t& rotation, float* out_xyzw, XrVector3f* out_normals) {
+	const uint8_t* vertex = (const uint8_t*)vertices;
+	xr_vec4_t w0 = XrVecLoad(world.m[0]);
+	xr_vec4_t w1 = XrVecLoad(world.m[1]);
+	xr_vec4_t w2 = XrVecLoad(world.m[2]);
+	xr_vec4_t w3 = XrVecLoad(world.m[3]);
+
+	for (size_t i = 0; i < count; i++, vertex += layout.stride) {
+		for (uint32_t a = 0; a < layout.attribute_count; a++) {
+			const vertex_attribute_t& attribute = layout.attributes[a];
+			if (attribute.semantic == vertex_semantic_position) {
+				XrVector3f position = VertexDecode3(attribute.component, vertex + attribute.offset);
+				xr_vec4_t result = XrVecMulAdd(XrVecSplat(position.x), w0, w3);
+				result = XrVecMulAdd(XrVecSplat(position.y), w1, result);
+				result = XrVecMulAdd(XrVecSplat(position.z), w2, result);
+				XrVecStoreUnaligned(out_xyzw + i * 4, result);
+			} else if (attribute.semantic == vertex_semantic_normal) {
+				XrVector3f normal = VertexDecode3(attribute.component, vertex + attribute.offset);
+				const float(*r)[4] = rotation.m;
+				XrVector3f rotated = {
+					normal.x * r[0][0] + normal.y * r[1][0] + normal.z * r[2][0],
+					normal.x * r[0][1] + normal.y * r[1][1] + normal.z * r[2][1],
+					normal.x * r[0][2] + normal.y * r[1][2] + normal.z * r[2][2]
+				};
+				float length_squared = rotated.x * rotated.x + rotated.y * rotated.y + rotated.z * rotated.z;
+				float scale = length_squared > 0.0f ? 1.0f / sqrtf(length_squared) : 0.0f;
+				out_normals[i] = { rotated.x * scale, rotated.y * scale, rotated.z * scale };
+			}
+		}
+	}
+}
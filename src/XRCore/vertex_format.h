@@ -0,0 +1,248 @@
+#pragma once
+//###################################################################################################################
+// Vertex formats
+//###################################################################################################################
+// The layout of a vertex is needed in several places: the input layout tells the GPU where the attributes are,
+// the vertex buffer needs the stride, the index buffer the format of an index, and whatever reads the vertices
+// on the CPU (bounds, picking, CPU skinning, ...) needs to know how to decode them. Instead of writing all of
+// that by hand and hoping it stays in sync with the vertex struct, a format is described once as a type:
+//
+//     typedef vertex_format<
+//         vertex_attribute<vertex_semantic_position, vertex_component_float3>,
+//         vertex_attribute<vertex_semantic_normal, vertex_component_float3>> app_vertex_format;
+//
+// Everything else is derived from that at compile time: the offset of each attribute, the stride, and the
+// list of attributes the renderer turns into its input layout. The CPU functions are templates over the
+// format, so the offsets and the decoding of each attribute are constants in the generated code: every format
+// gets its own loop without any branches on the layout. For comparison, and for meshes whose format is only
+// known when they are loaded, there is also a version that looks at a vertex_layout_t at runtime.
+//
+// Nothing in here knows about D3D: the renderer maps the semantics and components to its own formats.
+
+#include "xr_core_types.h"
+#include "xr_math.h"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Enums
+//------------------------------------------------------------------------------------------------------
+enum vertex_semantic_t {
+	vertex_semantic_position = 0,
+	vertex_semantic_normal = 1,
+	vertex_semantic_color = 2,
+	vertex_semantic_texcoord = 3
+};
+
+// How an attribute is stored. Positions and normals need at least three components, the fourth is ignored
+enum vertex_component_t {
+	vertex_component_float2 = 0,
+	vertex_component_float3 = 1,
+	vertex_component_float4 = 2,
+	vertex_component_half2 = 3,
+	vertex_component_half4 = 4, // 16 bit floats
+	vertex_component_snorm8x4 = 5, // -127 to 127 is -1 to 1, good enough for normals
+	vertex_component_unorm8x4 = 6 // 0 to 255 is 0 to 1, for colors
+};
+
+enum vertex_index_type_t {
+	vertex_index_uint16 = 0,
+	vertex_index_uint32 = 1
+};
+
+struct vertex_attribute_t {
+	vertex_semantic_t semantic;
+	vertex_component_t component;
+	uint32_t offset; // In bytes, from the start of the vertex
+};
+
+const uint32_t vertex_max_attributes = 8;
+
+// A vertex format as plain data, for the code that branches on it at runtime
+struct vertex_layout_t {
+	uint32_t stride;
+	uint32_t attribute_count;
+	vertex_attribute_t attributes[vertex_max_attributes];
+};
+
+//------------------------------------------------------------------------------------------------------
+// Describing a format
+//------------------------------------------------------------------------------------------------------
+constexpr uint32_t VertexComponentSize(vertex_component_t component) {
+	return component == vertex_component_float2 ? 8 :
+		component == vertex_component_float3 ? 12 :
+		component == vertex_component_float4 ? 16 :
+		component == vertex_component_half2 ? 4 :
+		component == vertex_component_half4 ? 8 : 4;
+}
+
+template <vertex_semantic_t Semantic, vertex_component_t Component>
+struct vertex_attribute {
+	static constexpr vertex_semantic_t semantic = Semantic;
+	static constexpr vertex_component_t component = Component;
+	static constexpr uint32_t size = VertexComponentSize(Component);
+};
+
+// The attributes are packed in the order they are listed in
+template <typename... Attributes>
+constexpr std::array<vertex_attribute_t, sizeof...(Attributes)> VertexFormatAttributes() {
+	std::array<vertex_attribute_t, sizeof...(Attributes)> attributes = {};
+	const vertex_semantic_t semantics[] = { Attributes::semantic... };
+	const vertex_component_t components[] = { Attributes::component... };
+	uint32_t offset = 0;
+	for (size_t i = 0; i < sizeof...(Attributes); i++) {
+		attributes[i] = { semantics[i], components[i], offset };
+		offset += VertexComponentSize(components[i]);
+	}
+	return attributes;
+}
+
+template <typename... Attributes>
+struct vertex_format {
+	static_assert(sizeof...(Attributes) > 0 && sizeof...(Attributes) <= vertex_max_attributes, "A vertex format needs 1 to vertex_max_attributes attributes");
+
+	static constexpr uint32_t attribute_count = sizeof...(Attributes);
+	static constexpr uint32_t stride = (Attributes::size + ...);
+	static constexpr std::array<vertex_attribute_t, sizeof...(Attributes)> attributes = VertexFormatAttributes<Attributes...>();
+
+	static constexpr bool Has(vertex_semantic_t semantic) {
+		for (const vertex_attribute_t& attribute : attributes) {
+			if (attribute.semantic == semantic) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Only valid if the format has the semantic, check with Has first
+	static constexpr const vertex_attribute_t& Attribute(vertex_semantic_t semantic) {
+		size_t found = 0;
+		for (size_t i = 0; i < attributes.size(); i++) {
+			if (attributes[i].semantic == semantic) {
+				found = i;
+				break;
+			}
+		}
+		return attributes[found];
+	}
+
+	static constexpr bool SemanticsUnique() {
+		for (size_t i = 0; i < attributes.size(); i++) {
+			for (size_t j = i + 1; j < attributes.size(); j++) {
+				if (attributes[i].semantic == attributes[j].semantic) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+	static_assert(SemanticsUnique(), "Each semantic may only appear once in a vertex format");
+};
+
+// The runtime description of a format
+template <typename Format>
+constexpr vertex_layout_t VertexLayoutOf() {
+	vertex_layout_t layout = {};
+	layout.stride = Format::stride;
+	layout.attribute_count = Format::attribute_count;
+	for (uint32_t i = 0; i < Format::attribute_count; i++) {
+		layout.attributes[i] = Format::attributes[i];
+	}
+	return layout;
+}
+
+template <typename Index>
+constexpr vertex_index_type_t VertexIndexType() {
+	static_assert(sizeof(Index) == 2 || sizeof(Index) == 4, "Indices are either 16 or 32 bit");
+	return sizeof(Index) == 2 ? vertex_index_uint16 : vertex_index_uint32;
+}
+
+//------------------------------------------------------------------------------------------------------
+// Decoding attributes
+//------------------------------------------------------------------------------------------------------
+float VertexHalfToFloat(uint16_t half);
+uint16_t VertexFloatToHalf(float value);
+
+// Reads the first three components of an attribute. The component is a template parameter, so only one of the
+// branches is ever compiled in
+template <vertex_component_t Component>
+inline XrVector3f VertexDecode3(const uint8_t* data) {
+	if constexpr (Component == vertex_component_float3 || Component == vertex_component_float4) {
+		XrVector3f result;
+		memcpy(&result, data, sizeof(result));
+		return result;
+	} else if constexpr (Component == vertex_component_half4) {
+		uint16_t halves[3];
+		memcpy(halves, data, sizeof(halves));
+		return { VertexHalfToFloat(halves[0]), VertexHalfToFloat(halves[1]), VertexHalfToFloat(halves[2]) };
+	} else if constexpr (Component == vertex_component_snorm8x4) {
+		// -128 is -1 as well
+		const int8_t* values = (const int8_t*)data;
+		const float scale = 1.0f / 127.0f;
+		return { fmaxf(values[0] * scale, -1.0f), fmaxf(values[1] * scale, -1.0f), fmaxf(values[2] * scale, -1.0f) };
+	} else if constexpr (Component == vertex_component_unorm8x4) {
+		const float scale = 1.0f / 255.0f;
+		return { data[0] * scale, data[1] * scale, data[2] * scale };
+	} else {
+		static_assert(Component != Component, "The component has fewer than three values");
+		return {};
+	}
+}
+
+// The same, for a component only known at runtime
+XrVector3f VertexDecode3(vertex_component_t component, const uint8_t* data);
+
+// Writes up to four values as the given component, for building vertex buffers. Values the component
+// doesn't have are ignored
+void VertexEncode(vertex_component_t component, const float* values, uint8_t* data);
+
+template <typename Format, vertex_semantic_t Semantic>
+inline XrVector3f VertexFetch3(const uint8_t* vertex) {
+	static_assert(Format::Has(Semantic), "The vertex format doesn't have this semantic");
+	constexpr vertex_attribute_t attribute = Format::Attribute(Semantic);
+	return VertexDecode3<attribute.component>(vertex + attribute.offset);
+}
+
+//------------------------------------------------------------------------------------------------------
+// Processing vertices on the CPU
+//------------------------------------------------------------------------------------------------------
+
+// Transforms the positions of count vertices with world into out_xyzw (4 floats per vertex), and if the
+// format has normals, the normals with rotation into out_normals. Both matrices are used like in the vertex
+// shader. Normals that were quantized aren't exactly of length 1 anymore, so they are normalized again
+template <typename Format>
+void VertexTransform(const void* vertices, size_t count, const xr_mat4_t& world, const xr_mat4_t& rotation, float* out_xyzw, XrVector3f* out_normals) {
+	const uint8_t* vertex = (const uint8_t*)vertices;
+	xr_vec4_t w0 = XrVecLoad(world.m[0]);
+	xr_vec4_t w1 = XrVecLoad(world.m[1]);
+	xr_vec4_t w2 = XrVecLoad(world.m[2]);
+	xr_vec4_t w3 = XrVecLoad(world.m[3]);
+
+	for (size_t i = 0; i < count; i++, vertex += Format::stride) {
+		XrVector3f position = VertexFetch3<Format, vertex_semantic_position>(vertex);
+		xr_vec4_t result = XrVecMulAdd(XrVecSplat(position.x), w0, w3);
+		result = XrVecMulAdd(XrVecSplat(position.y), w1, result);
+		result = XrVecMulAdd(XrVecSplat(position.z), w2, result);
+		XrVecStoreUnaligned(out_xyzw + i * 4, result);
+
+		if constexpr (Format::Has(vertex_semantic_normal)) {
+			XrVector3f normal = VertexFetch3<Format, vertex_semantic_normal>(vertex);
+			const float(*r)[4] = rotation.m;
+			XrVector3f rotated = {
+				normal.x * r[0][0] + normal.y * r[1][0] + normal.z * r[2][0],
+				normal.x * r[0][1] + normal.y * r[1][1] + normal.z * r[2][1],
+				normal.x * r[0][2] + normal.y * r[1][2] + normal.z * r[2][2]
+			};
+			float length_squared = rotated.x * rotated.x + rotated.y * rotated.y + rotated.z * rotated.z;
+			float scale = length_squared > 0.0f ? 1.0f / sqrtf(length_squared) : 0.0f;
+			out_normals[i] = { rotated.x * scale, rotated.y * scale, rotated.z * scale };
+		}
+	}
+}
+
+// The same, but the format is only known at runtime, so every attribute of every vertex is looked up and
+// decoded with a switch on its component
+void VertexTransform(const vertex_layout_t& layout, const void* vertices, size_t count, const xr_mat4_t& world, const xr_mat4_t& rotation, float* out_xyzw, XrVector3f* out_normals);
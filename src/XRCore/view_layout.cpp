@@ -0,0 +1,102 @@
+#include "view_layout.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ViewLayoutBuild(const view_config_t* configs, uint32_t view_count, view_resolution_policy_t policy, float scale, bool pack_arrays, view_layout_t& layout) {
+	layout.swapchains.clear();
+	layout.views.clear();
+	layout.pixels = 0;
+
+	for (uint32_t i = 0; i < view_count; i++) {
+		const view_config_t& config = configs[i];
+		bool scaled = policy == view_resolution_scaled || (policy == view_resolution_foveated && view_count > 2 && i < 2);
+		float view_scale = scaled ? scale : 1.0f;
+
+		// Never more than the runtime allows, and never nothing
+		view_layout_view_t view = {};
+		view.width = std::min(std::max((uint32_t)std::lround(config.recommended_width * view_scale), 1u), std::max(config.max_width, 1u));
+		view.height = std::min(std::max((uint32_t)std::lround(config.recommended_height * view_scale), 1u), std::max(config.max_height, 1u));
+		uint32_t sample_count = std::max(config.sample_count, 1u);
+
+		// Look for a swapchain this view fits into as another array slice
+		view.swapchain = (uint32_t)layout.swapchains.size();
+		if (pack_arrays) {
+			for (uint32_t s = 0; s < (uint32_t)layout.swapchains.size(); s++) {
+				const view_layout_swapchain_t& swapchain = layout.swapchains[s];
+				if (swapchain.width == view.width && swapchain.height == view.height && swapchain.sample_count == sample_count) {
+					view.swapchain = s;
+					break;
+				}
+			}
+		}
+		if (view.swapchain == layout.swapchains.size()) {
+			layout.swapchains.push_back({ view.width, view.height, 0, sample_count });
+		}
+		view.array_index = layout.swapchains[view.swapchain].array_size++;
+
+		layout.views.push_back(view);
+		layout.pixels += (uint64_t)view.width * view.height;
+	}
+}
+
+view_frustum_t ViewFrustum(const XrPosef& pose, const XrFovf& fov, float near_z, float far_z, float margin) {
+	// The planes in view space, where the view looks along -z. A point at distance d in front of the view is
+	// inside the left plane if x >= d * tan(angle_left), i.e. x + z * tan(angle_left) >= 0, and so on
+	float tan_left = tanf(fov.angleLeft - margin);
+	float tan_right = tanf(fov.angleRight + margin);
+	float tan_down = tanf(fov.angleDown - margin);
+	float tan_up = tanf(fov.angleUp + margin);
+	const float view_planes[6][4] = {
+		{ 1.0f, 0.0f, tan_left, 0.0f },
+		{ -1.0f, 0.0f, -tan_right, 0.0f },
+		{ 0.0f, 1.0f, tan_down, 0.0f },
+		{ 0.0f, -1.0f, -tan_up, 0.0f },
+		{ 0.0f, 0.0f, -1.0f, -near_z },
+		{ 0.0f, 0.0f, 1.0f, far_z },
+	};
+
+	// Turn the normals into world space (the rows of the rotation are the axes of the view), and move the
+	// planes to the position of the view
+	xr_mat4_t rotation = XrMathQuatToMatrix(pose.orientation);
+	view_frustum_t frustum;
+	for (int i = 0; i < 6; i++) {
+		const float* plane = view_planes[i];
+		float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		XrVector3f normal = {
+			(plane[0] * rotation.m[0][0] + plane[1] * rotation.m[1][0] + plane[2] * rotation.m[2][0]) / length,
+			(plane[0] * rotation.m[0][1] + plane[1] * rotation.m[1][1] + plane[2] * rotation.m[2][1]) / length,
+			(plane[0] * rotation.m[0][2] + plane[1] * rotation.m[1][2] + plane[2] * rotation.m[2][2]) / length,
+		};
+		float distance = plane[3] / length - (normal.x * pose.position.x + normal.y * pose.position.y + normal.z * pose.position.z);
+		frustum.planes[i] = { normal.x, normal.y, normal.z, distance };
+	}
+	return frustum;
+}
+
+void ViewSplitDrawList(const scene_t& scene, const std::vector<uint32_t>& draw_list, const view_frustum_t* frustums, uint32_t view_count, std::vector<uint32_t>* view_lists) {
+	for (uint32_t view = 0; view < view_count; view++) {
+		view_lists[view].clear();
+	}
+
+	for (uint32_t object_index : draw_list) {
+		// The bounding sphere of the box
+		const scene_object_t& object = scene.objects[object_index];
+		const XrVector3f& center = object.position;
+		const XrVector3f& half = object.half_extents;
+		float radius = sqrtf(half.x * half.x + half.y * half.y + half.z * half.z);
+
+		for (uint32_t view = 0; view < view_count; view++) {
+			bool inside = true;
+			for (const XrVector4f& plane : frustums[view].planes) {
+				if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) {
+					inside = false;
+					break;
+				}
+			}
+			if (inside) {
+				view_lists[view].push_back(object_index);
+			}
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+//###################################################################################################################
+// View layout
+//###################################################################################################################
+// Not every headset has one view per eye. Quad view headsets (XR_VARJO_quad_views) have four: two wide outer
+// views for the whole field of view, and two narrow inner views with a much higher pixel density in the middle,
+// where the user looks. The compositor puts the inner views on top of the outer ones. Rendering each of them
+// like a full stereo pair would cost twice as much as stereo, so:
+//
+// - The resolution of each view comes from a policy. The foveated one renders the outer views of a quad view
+//   configuration at a lower resolution, as their middle is covered by the inner views anyway.
+// - Views with the same size share one swapchain as slices of a texture array, instead of one swapchain each.
+//   That's one acquire, wait and release per pair of views instead of per view.
+// - The culling and the scene traversal happen once for all views (see SimulationCull and SceneBuildDrawList).
+//   The draw list is then split into one list per view with a cheap frustum test, such that the narrow inner
+//   views only draw the few objects that are in the middle of the field of view.
+
+#include "scene.h"
+#include "xr_core_types.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+
+enum view_resolution_policy_t {
+	view_resolution_recommended, // What the runtime recommends for each view
+	view_resolution_scaled, // The recommended resolution of every view times a scale
+	view_resolution_foveated // With more than two views, the outer views (the first two) are scaled, the inner ones aren't
+};
+
+// What the runtime tells us about a view, see XrViewConfigurationView
+struct view_config_t {
+	uint32_t recommended_width;
+	uint32_t recommended_height;
+	uint32_t max_width;
+	uint32_t max_height;
+	uint32_t sample_count;
+};
+
+struct view_layout_swapchain_t {
+	uint32_t width;
+	uint32_t height;
+	uint32_t array_size; // Number of views in the swapchain, one per array slice
+	uint32_t sample_count;
+};
+
+// Where a view is rendered to
+struct view_layout_view_t {
+	uint32_t swapchain;
+	uint32_t array_index;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct view_layout_t {
+	std::vector<view_layout_swapchain_t> swapchains;
+	std::vector<view_layout_view_t> views;
+	uint64_t pixels; // Pixels of all views together, i.e. what the GPU has to shade per frame
+};
+
+// The 6 planes of the frustum of a view in world space (left, right, bottom, top, near, far). A point p is on
+// the inner side of a plane if dot(plane.xyz, p) + plane.w >= 0
+struct view_frustum_t {
+	XrVector4f planes[6];
+};
+
+//------------------------------------------------------------------------------------------------------
+// Functions
+//------------------------------------------------------------------------------------------------------
+
+// Decides the resolution of each view, and which views share a swapchain. With pack_arrays, views of the same
+// size and sample count are put into one array swapchain, otherwise each view gets its own
+void ViewLayoutBuild(const view_config_t* configs, uint32_t view_count, view_resolution_policy_t policy, float scale, bool pack_arrays, view_layout_t& layout);
+
+// The frustum of a view, made wider by margin (in radians) on each side, like SimulationCull does
+view_frustum_t ViewFrustum(const XrPosef& pose, const XrFovf& fov, float near_z, float far_z, float margin);
+
+// Splits the draw list (see SceneBuildDrawList) into one list per view, with the objects whose bounding sphere
+// touches the frustum of the view. This is one pass over the objects for all views
+void ViewSplitDrawList(const scene_t& scene, const std::vector<uint32_t>& draw_list, const view_frustum_t* frustums, uint32_t view_count, std::vector<uint32_t>* view_lists);
@@ -0,0 +1,59 @@
+#pragma once
+//###################################################################################################################
+// Core types
+//###################################################################################################################
+// The XRCore code is shared between the Windows application and the portable tools (benchmarks, replay) that
+// run on machines without an OpenXR SDK. If the OpenXR headers are available, we just use them. If not, we
+// declare layout compatible copies of the few plain data structs we need, such that the same code compiles
+// everywhere.
+
+#include <cstdint>
+
+#if __has_include(<openxr/openxr.h>)
+#include <openxr/openxr.h>
+#else
+typedef int64_t XrTime;
+typedef int64_t XrDuration;
+
+typedef struct XrVector2f {
+	float x;
+	float y;
+} XrVector2f;
+
+typedef struct XrVector3f {
+	float x;
+	float y;
+	float z;
+} XrVector3f;
+
+typedef struct XrVector4f {
+	float x;
+	float y;
+	float z;
+	float w;
+} XrVector4f;
+
+typedef struct XrQuaternionf {
+	float x;
+	float y;
+	float z;
+	float w;
+} XrQuaternionf;
+
+typedef struct XrPosef {
+	XrQuaternionf orientation;
+	XrVector3f position;
+} XrPosef;
+
+typedef struct XrExtent2Df {
+	float width;
+	float height;
+} XrExtent2Df;
+
+typedef struct XrFovf {
+	float angleLeft;
+	float angleRight;
+	float angleUp;
+	float angleDown;
+} XrFovf;
+#endif
@@ -0,0 +1,48 @@
+#include "xr_math.h"
+
+const xr_mat4_t& XrMathProjectionCached(xr_projection_cache_t& cache, const XrFovf& fov, float near_z, float far_z) {
+	for (uint32_t i = 0; i < xr_projection_cache_size; i++) {
+		xr_projection_t& entry = cache.entries[i];
+		if (entry.valid && entry.near_z == near_z && entry.far_z == far_z && memcmp(&entry.fov, &fov, sizeof(XrFovf)) == 0) {
+			return entry.matrix;
+		}
+	}
+
+	// Not in the cache yet, replace the oldest entry
+	xr_projection_t& entry = cache.entries[cache.next];
+	cache.next = (cache.next + 1) % xr_projection_cache_size;
+	cache.misses++;
+
+	entry.fov = fov;
+	entry.near_z = near_z;
+	entry.far_z = far_z;
+	entry.matrix = XrMathProjectionFov(fov, near_z, far_z);
+	entry.valid = true;
+	return entry.matrix;
+}
+
+void XrMathTransformPoints(const xr_mat4_t& matrix, const XrVector3f* points, float* out_xyzw, size_t count) {
+	xr_vec4_t r0 = XrVecLoad(matrix.m[0]);
+	xr_vec4_t r1 = XrVecLoad(matrix.m[1]);
+	xr_vec4_t r2 = XrVecLoad(matrix.m[2]);
+	xr_vec4_t r3 = XrVecLoad(matrix.m[3]);
+
+	for (size_t i = 0; i < count; i++) {
+		xr_vec4_t result = XrVecMulAdd(XrVecSplat(points[i].x), r0, r3);
+		result = XrVecMulAdd(XrVecSplat(points[i].y), r1, result);
+		result = XrVecMulAdd(XrVecSplat(points[i].z), r2, result);
+		XrVecStoreUnaligned(out_xyzw + i * 4, result);
+	}
+}
+
+void XrMathPosesToMatrices(const XrPosef* poses, xr_mat4_t* out_matrices, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		out_matrices[i] = XrMathPoseToMatrix(poses[i]);
+	}
+}
+
+void XrMathMultiplyBatch(const xr_mat4_t* a, const xr_mat4_t* b, xr_mat4_t* out_matrices, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		out_matrices[i] = XrMathMultiply(a[i], b[i]);
+	}
+}
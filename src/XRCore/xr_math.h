@@ -0,0 +1,395 @@
+#pragma once
+//###################################################################################################################
+// XR math
+//###################################################################################################################
+// Small, platform independent math library for the transforms we need every frame. It works directly on the
+// OpenXR types (XrPosef, XrFovf, ...), so we don't need to convert them to another library's types first.
+//
+// The matrices use the same conventions as DirectXMath: row major storage, row vectors (v' = v * M), and
+// the translation is stored in the last row. This way, the results can be used exactly like the matrices
+// DirectXMath produced before.
+//
+// The vector operations map to SSE on x86, to NEON on ARM, and to plain C++ everywhere else. Define
+// XR_MATH_FORCE_SCALAR to always use the plain C++ version.
+
+#include "xr_core_types.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//------------------------------------------------------------------------------------------------------
+// Backend selection
+//------------------------------------------------------------------------------------------------------
+#if defined(XR_MATH_FORCE_SCALAR)
+#define XR_MATH_SCALAR
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XR_MATH_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define XR_MATH_NEON
+#include <arm_neon.h>
+#else
+#define XR_MATH_SCALAR
+#endif
+
+//------------------------------------------------------------------------------------------------------
+// Structs & Typedefs
+//------------------------------------------------------------------------------------------------------
+#if defined(XR_MATH_SSE)
+typedef __m128 xr_vec4_t;
+#elif defined(XR_MATH_NEON)
+typedef float32x4_t xr_vec4_t;
+#else
+struct xr_vec4_t {
+	float v[4];
+};
+#endif
+
+struct alignas(16) xr_mat4_t {
+	float m[4][4];
+};
+
+// A projection matrix together with the fov it was built from, such that we only need to rebuild it
+// (and call tanf) when the fov actually changes, which is rare
+struct xr_projection_t {
+	XrFovf fov;
+	float near_z;
+	float far_z;
+	xr_mat4_t matrix;
+	bool valid;
+};
+
+// Remembers the projections of the last few fovs. One entry per view is enough, as the fov of a view
+// usually stays the same for the whole session
+const uint32_t xr_projection_cache_size = 4;
+struct xr_projection_cache_t {
+	xr_projection_t entries[xr_projection_cache_size];
+	uint32_t next; // Entry that gets replaced next
+	uint64_t misses; // Number of projections we had to build
+};
+
+//------------------------------------------------------------------------------------------------------
+// Vector functions
+//------------------------------------------------------------------------------------------------------
+#if defined(XR_MATH_SSE)
+inline xr_vec4_t XrVecLoad(const float* p) { return _mm_load_ps(p); }
+inline xr_vec4_t XrVecLoadUnaligned(const float* p) { return _mm_loadu_ps(p); }
+inline void XrVecStore(float* p, xr_vec4_t v) { _mm_store_ps(p, v); }
+inline void XrVecStoreUnaligned(float* p, xr_vec4_t v) { _mm_storeu_ps(p, v); }
+inline xr_vec4_t XrVecSet(float x, float y, float z, float w) { return _mm_set_ps(w, z, y, x); }
+inline xr_vec4_t XrVecSplat(float f) { return _mm_set1_ps(f); }
+inline xr_vec4_t XrVecAdd(xr_vec4_t a, xr_vec4_t b) { return _mm_add_ps(a, b); }
+inline xr_vec4_t XrVecSub(xr_vec4_t a, xr_vec4_t b) { return _mm_sub_ps(a, b); }
+inline xr_vec4_t XrVecMul(xr_vec4_t a, xr_vec4_t b) { return _mm_mul_ps(a, b); }
+inline xr_vec4_t XrVecMulAdd(xr_vec4_t a, xr_vec4_t b, xr_vec4_t c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+inline xr_vec4_t XrVecMin(xr_vec4_t a, xr_vec4_t b) { return _mm_min_ps(a, b); }
+inline xr_vec4_t XrVecMax(xr_vec4_t a, xr_vec4_t b) { return _mm_max_ps(a, b); }
+inline void XrVecTranspose(xr_vec4_t& r0, xr_vec4_t& r1, xr_vec4_t& r2, xr_vec4_t& r3) { _MM_TRANSPOSE4_PS(r0, r1, r2, r3); }
+inline xr_vec4_t XrVecGreaterEqual(xr_vec4_t a, xr_vec4_t b) { return _mm_cmpge_ps(a, b); }
+inline xr_vec4_t XrVecAnd(xr_vec4_t a, xr_vec4_t b) { return _mm_and_ps(a, b); }
+inline xr_vec4_t XrVecSelect(xr_vec4_t mask, xr_vec4_t a, xr_vec4_t b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline uint32_t XrVecMaskBits(xr_vec4_t mask) { return (uint32_t)_mm_movemask_ps(mask); }
+#elif defined(XR_MATH_NEON)
+inline xr_vec4_t XrVecLoad(const float* p) { return vld1q_f32(p); }
+inline xr_vec4_t XrVecLoadUnaligned(const float* p) { return vld1q_f32(p); }
+inline void XrVecStore(float* p, xr_vec4_t v) { vst1q_f32(p, v); }
+inline void XrVecStoreUnaligned(float* p, xr_vec4_t v) { vst1q_f32(p, v); }
+inline xr_vec4_t XrVecSet(float x, float y, float z, float w) { float v[4] = { x, y, z, w }; return vld1q_f32(v); }
+inline xr_vec4_t XrVecSplat(float f) { return vdupq_n_f32(f); }
+inline xr_vec4_t XrVecAdd(xr_vec4_t a, xr_vec4_t b) { return vaddq_f32(a, b); }
+inline xr_vec4_t XrVecSub(xr_vec4_t a, xr_vec4_t b) { return vsubq_f32(a, b); }
+inline xr_vec4_t XrVecMul(xr_vec4_t a, xr_vec4_t b) { return vmulq_f32(a, b); }
+inline xr_vec4_t XrVecMulAdd(xr_vec4_t a, xr_vec4_t b, xr_vec4_t c) { return vmlaq_f32(c, a, b); }
+inline xr_vec4_t XrVecMin(xr_vec4_t a, xr_vec4_t b) { return vminq_f32(a, b); }
+inline xr_vec4_t XrVecMax(xr_vec4_t a, xr_vec4_t b) { return vmaxq_f32(a, b); }
+inline void XrVecTranspose(xr_vec4_t& r0, xr_vec4_t& r1, xr_vec4_t& r2, xr_vec4_t& r3) {
+	float32x4x2_t t01 = vtrnq_f32(r0, r1);
+	float32x4x2_t t23 = vtrnq_f32(r2, r3);
+	r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+	r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+	r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+	r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+inline xr_vec4_t XrVecGreaterEqual(xr_vec4_t a, xr_vec4_t b) { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+inline xr_vec4_t XrVecAnd(xr_vec4_t a, xr_vec4_t b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+inline xr_vec4_t XrVecSelect(xr_vec4_t mask, xr_vec4_t a, xr_vec4_t b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+inline uint32_t XrVecMaskBits(xr_vec4_t mask) {
+	uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(mask), 31);
+	return vgetq_lane_u32(bits, 0) | (vgetq_lane_u32(bits, 1) << 1) | (vgetq_lane_u32(bits, 2) << 2) | (vgetq_lane_u32(bits, 3) << 3);
+}
+#else
+inline xr_vec4_t XrVecLoad(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+inline xr_vec4_t XrVecLoadUnaligned(const float* p) { return XrVecLoad(p); }
+inline void XrVecStore(float* p, xr_vec4_t v) { memcpy(p, v.v, sizeof(v.v)); }
+inline void XrVecStoreUnaligned(float* p, xr_vec4_t v) { XrVecStore(p, v); }
+inline xr_vec4_t XrVecSet(float x, float y, float z, float w) { return { { x, y, z, w } }; }
+inline xr_vec4_t XrVecSplat(float f) { return { { f, f, f, f } }; }
+inline xr_vec4_t XrVecAdd(xr_vec4_t a, xr_vec4_t b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+inline xr_vec4_t XrVecSub(xr_vec4_t a, xr_vec4_t b) { return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+inline xr_vec4_t XrVecMul(xr_vec4_t a, xr_vec4_t b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+inline xr_vec4_t XrVecMulAdd(xr_vec4_t a, xr_vec4_t b, xr_vec4_t c) { return XrVecAdd(XrVecMul(a, b), c); }
+inline xr_vec4_t XrVecMin(xr_vec4_t a, xr_vec4_t b) { return { { fminf(a.v[0], b.v[0]), fminf(a.v[1], b.v[1]), fminf(a.v[2], b.v[2]), fminf(a.v[3], b.v[3]) } }; }
+inline xr_vec4_t XrVecMax(xr_vec4_t a, xr_vec4_t b) { return { { fmaxf(a.v[0], b.v[0]), fmaxf(a.v[1], b.v[1]), fmaxf(a.v[2], b.v[2]), fmaxf(a.v[3], b.v[3]) } }; }
+inline void XrVecTranspose(xr_vec4_t& r0, xr_vec4_t& r1, xr_vec4_t& r2, xr_vec4_t& r3) {
+	xr_vec4_t rows[4] = { r0, r1, r2, r3 };
+	for (int i = 0; i < 4; i++) {
+		r0.v[i] = rows[i].v[0];
+		r1.v[i] = rows[i].v[1];
+		r2.v[i] = rows[i].v[2];
+		r3.v[i] = rows[i].v[3];
+	}
+}
+
+// The masks returned by the comparisons have all bits of a lane set (or none), like on SSE and NEON
+inline float XrVecLaneMask(bool set) { uint32_t bits = set ? 0xFFFFFFFFu : 0u; float f; memcpy(&f, &bits, sizeof(f)); return f; }
+inline uint32_t XrVecLaneBits(float f) { uint32_t bits; memcpy(&bits, &f, sizeof(bits)); return bits; }
+inline xr_vec4_t XrVecGreaterEqual(xr_vec4_t a, xr_vec4_t b) {
+	return { { XrVecLaneMask(a.v[0] >= b.v[0]), XrVecLaneMask(a.v[1] >= b.v[1]), XrVecLaneMask(a.v[2] >= b.v[2]), XrVecLaneMask(a.v[3] >= b.v[3]) } };
+}
+inline xr_vec4_t XrVecAnd(xr_vec4_t a, xr_vec4_t b) {
+	xr_vec4_t result;
+	for (int i = 0; i < 4; i++) {
+		result.v[i] = XrVecLaneMask((XrVecLaneBits(a.v[i]) & XrVecLaneBits(b.v[i])) != 0);
+	}
+	return result;
+}
+inline xr_vec4_t XrVecSelect(xr_vec4_t mask, xr_vec4_t a, xr_vec4_t b) {
+	return { { XrVecLaneBits(mask.v[0]) ? a.v[0] : b.v[0], XrVecLaneBits(mask.v[1]) ? a.v[1] : b.v[1], XrVecLaneBits(mask.v[2]) ? a.v[2] : b.v[2], XrVecLaneBits(mask.v[3]) ? a.v[3] : b.v[3] } };
+}
+inline uint32_t XrVecMaskBits(xr_vec4_t mask) {
+	return (XrVecLaneBits(mask.v[0]) >> 31) | ((XrVecLaneBits(mask.v[1]) >> 31) << 1) | ((XrVecLaneBits(mask.v[2]) >> 31) << 2) | ((XrVecLaneBits(mask.v[3]) >> 31) << 3);
+}
+#endif
+
+//------------------------------------------------------------------------------------------------------
+// Matrix functions
+//------------------------------------------------------------------------------------------------------
+inline xr_mat4_t XrMathIdentity() {
+	xr_mat4_t result = {};
+	result.m[0][0] = result.m[1][1] = result.m[2][2] = result.m[3][3] = 1.0f;
+	return result;
+}
+
+// Returns a * b, i.e. first transform by a, then by b
+inline xr_mat4_t XrMathMultiply(const xr_mat4_t& a, const xr_mat4_t& b) {
+	xr_vec4_t b0 = XrVecLoad(b.m[0]);
+	xr_vec4_t b1 = XrVecLoad(b.m[1]);
+	xr_vec4_t b2 = XrVecLoad(b.m[2]);
+	xr_vec4_t b3 = XrVecLoad(b.m[3]);
+
+	xr_mat4_t result;
+	for (int row = 0; row < 4; row++) {
+		xr_vec4_t r = XrVecMul(XrVecSplat(a.m[row][0]), b0);
+		r = XrVecMulAdd(XrVecSplat(a.m[row][1]), b1, r);
+		r = XrVecMulAdd(XrVecSplat(a.m[row][2]), b2, r);
+		r = XrVecMulAdd(XrVecSplat(a.m[row][3]), b3, r);
+		XrVecStore(result.m[row], r);
+	}
+	return result;
+}
+
+inline xr_mat4_t XrMathTranspose(const xr_mat4_t& a) {
+	xr_vec4_t r0 = XrVecLoad(a.m[0]);
+	xr_vec4_t r1 = XrVecLoad(a.m[1]);
+	xr_vec4_t r2 = XrVecLoad(a.m[2]);
+	xr_vec4_t r3 = XrVecLoad(a.m[3]);
+	XrVecTranspose(r0, r1, r2, r3);
+
+	xr_mat4_t result;
+	XrVecStore(result.m[0], r0);
+	XrVecStore(result.m[1], r1);
+	XrVecStore(result.m[2], r2);
+	XrVecStore(result.m[3], r3);
+	return result;
+}
+
+// Rotation matrix of a unit quaternion. Same result as XMMatrixRotationQuaternion
+inline xr_mat4_t XrMathQuatToMatrix(const XrQuaternionf& q) {
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+	xr_mat4_t result;
+	XrVecStore(result.m[0], XrVecSet(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f));
+	XrVecStore(result.m[1], XrVecSet(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f));
+	XrVecStore(result.m[2], XrVecSet(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f));
+	XrVecStore(result.m[3], XrVecSet(0.0f, 0.0f, 0.0f, 1.0f));
+	return result;
+}
+
+// Quaternion from pitch (around x), yaw (around y) and roll (around z), applied in the order roll, pitch,
+// yaw. Same result as XMQuaternionRotationRollPitchYaw
+inline XrQuaternionf XrMathQuatFromEuler(float pitch, float yaw, float roll) {
+	float sp = sinf(pitch * 0.5f), cp = cosf(pitch * 0.5f);
+	float sy = sinf(yaw * 0.5f), cy = cosf(yaw * 0.5f);
+	float sr = sinf(roll * 0.5f), cr = cosf(roll * 0.5f);
+
+	XrQuaternionf result;
+	result.x = sp * cy * cr + cp * sy * sr;
+	result.y = cp * sy * cr - sp * cy * sr;
+	result.z = cp * cy * sr - sp * sy * cr;
+	result.w = cp * cy * cr + sp * sy * sr;
+	return result;
+}
+
+// Unit quaternion of the rotation in the upper 3x3 of a matrix without scale, the inverse of XrMathQuatToMatrix.
+// Starts from the largest of w, x, y and z, such that we never divide by something close to zero
+inline XrQuaternionf XrMathQuatFromMatrix(const xr_mat4_t& m) {
+	XrQuaternionf result;
+	float trace = m.m[0][0] + m.m[1][1] + m.m[2][2];
+	if (trace > 0.0f) {
+		float s = sqrtf(trace + 1.0f) * 2.0f; // 4 * w
+		result.w = 0.25f * s;
+		result.x = (m.m[1][2] - m.m[2][1]) / s;
+		result.y = (m.m[2][0] - m.m[0][2]) / s;
+		result.z = (m.m[0][1] - m.m[1][0]) / s;
+	} else if (m.m[0][0] > m.m[1][1] && m.m[0][0] > m.m[2][2]) {
+		float s = sqrtf(1.0f + m.m[0][0] - m.m[1][1] - m.m[2][2]) * 2.0f; // 4 * x
+		result.w = (m.m[1][2] - m.m[2][1]) / s;
+		result.x = 0.25f * s;
+		result.y = (m.m[0][1] + m.m[1][0]) / s;
+		result.z = (m.m[2][0] + m.m[0][2]) / s;
+	} else if (m.m[1][1] > m.m[2][2]) {
+		float s = sqrtf(1.0f + m.m[1][1] - m.m[0][0] - m.m[2][2]) * 2.0f; // 4 * y
+		result.w = (m.m[2][0] - m.m[0][2]) / s;
+		result.x = (m.m[0][1] + m.m[1][0]) / s;
+		result.y = 0.25f * s;
+		result.z = (m.m[1][2] + m.m[2][1]) / s;
+	} else {
+		float s = sqrtf(1.0f + m.m[2][2] - m.m[0][0] - m.m[1][1]) * 2.0f; // 4 * z
+		result.w = (m.m[0][1] - m.m[1][0]) / s;
+		result.x = (m.m[2][0] + m.m[0][2]) / s;
+		result.y = (m.m[1][2] + m.m[2][1]) / s;
+		result.z = 0.25f * s;
+	}
+	return result;
+}
+
+// Scale, then rotate, then translate. Same result as XMMatrixAffineTransformation with the rotation
+// origin at zero, but without the matrix multiplications
+inline xr_mat4_t XrMathAffine(float scale, const XrQuaternionf& rotation, const XrVector3f& translation) {
+	xr_mat4_t result = XrMathQuatToMatrix(rotation);
+	xr_vec4_t s = XrVecSplat(scale);
+	XrVecStore(result.m[0], XrVecMul(XrVecLoad(result.m[0]), s));
+	XrVecStore(result.m[1], XrVecMul(XrVecLoad(result.m[1]), s));
+	XrVecStore(result.m[2], XrVecMul(XrVecLoad(result.m[2]), s));
+	XrVecStore(result.m[3], XrVecSet(translation.x, translation.y, translation.z, 1.0f));
+	return result;
+}
+
+// Same as above, but with a different scale along each axis
+inline xr_mat4_t XrMathAffine(const XrVector3f& scale, const XrQuaternionf& rotation, const XrVector3f& translation) {
+	xr_mat4_t result = XrMathQuatToMatrix(rotation);
+	XrVecStore(result.m[0], XrVecMul(XrVecLoad(result.m[0]), XrVecSplat(scale.x)));
+	XrVecStore(result.m[1], XrVecMul(XrVecLoad(result.m[1]), XrVecSplat(scale.y)));
+	XrVecStore(result.m[2], XrVecMul(XrVecLoad(result.m[2]), XrVecSplat(scale.z)));
+	XrVecStore(result.m[3], XrVecSet(translation.x, translation.y, translation.z, 1.0f));
+	return result;
+}
+
+// Matrix that transforms from the space of the pose into the space the pose is defined in
+inline xr_mat4_t XrMathPoseToMatrix(const XrPosef& pose) {
+	return XrMathAffine(1.0f, pose.orientation, pose.position);
+}
+
+// Inverse of XrMathPoseToMatrix, e.g. to get a view matrix from the pose of a view. A pose is a rigid
+// transform (rotation and translation only), so instead of a general 4x4 inverse we can just transpose
+// the rotation and rotate the negated translation with it
+inline xr_mat4_t XrMathRigidInverse(const XrPosef& pose) {
+	xr_mat4_t rotation = XrMathQuatToMatrix(pose.orientation);
+
+	// The transposed rotation. The fourth row of the input is (0, 0, 0, 1), so after the transpose,
+	// the fourth column is (0, 0, 0, 1) as well and we only have to fix up the last row
+	xr_vec4_t r0 = XrVecLoad(rotation.m[0]);
+	xr_vec4_t r1 = XrVecLoad(rotation.m[1]);
+	xr_vec4_t r2 = XrVecLoad(rotation.m[2]);
+	xr_vec4_t r3 = XrVecLoad(rotation.m[3]);
+	XrVecTranspose(r0, r1, r2, r3);
+
+	// -p * R^T
+	xr_vec4_t translation = XrVecMul(XrVecSplat(-pose.position.x), r0);
+	translation = XrVecMulAdd(XrVecSplat(-pose.position.y), r1, translation);
+	translation = XrVecMulAdd(XrVecSplat(-pose.position.z), r2, translation);
+
+	xr_mat4_t result;
+	XrVecStore(result.m[0], r0);
+	XrVecStore(result.m[1], r1);
+	XrVecStore(result.m[2], r2);
+	XrVecStore(result.m[3], translation);
+	result.m[3][3] = 1.0f;
+	return result;
+}
+
+// Inverse of an affine matrix (the last column is 0, 0, 0, 1), e.g. one made with XrMathAffine with a scale
+// that isn't the same on every axis. The inverse of the upper 3x3 part has the cross products of its rows as
+// columns, divided by the determinant, and the translation is the negated translation times that
+inline xr_mat4_t XrMathAffineInverse(const xr_mat4_t& m) {
+	const float(*r)[4] = m.m;
+	float cross[3][3] = {
+		{ r[1][1] * r[2][2] - r[1][2] * r[2][1], r[1][2] * r[2][0] - r[1][0] * r[2][2], r[1][0] * r[2][1] - r[1][1] * r[2][0] },
+		{ r[2][1] * r[0][2] - r[2][2] * r[0][1], r[2][2] * r[0][0] - r[2][0] * r[0][2], r[2][0] * r[0][1] - r[2][1] * r[0][0] },
+		{ r[0][1] * r[1][2] - r[0][2] * r[1][1], r[0][2] * r[1][0] - r[0][0] * r[1][2], r[0][0] * r[1][1] - r[0][1] * r[1][0] },
+	};
+	float determinant = r[0][0] * cross[0][0] + r[0][1] * cross[0][1] + r[0][2] * cross[0][2];
+	float inverse_determinant = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+
+	xr_mat4_t result = {};
+	for (int row = 0; row < 3; row++) {
+		for (int column = 0; column < 3; column++) {
+			result.m[row][column] = cross[column][row] * inverse_determinant;
+		}
+	}
+	for (int column = 0; column < 3; column++) {
+		result.m[3][column] = -(r[3][0] * result.m[0][column] + r[3][1] * result.m[1][column] + r[3][2] * result.m[2][column]);
+	}
+	result.m[3][3] = 1.0f;
+	return result;
+}
+
+// Right handed off-center perspective projection from the angles of an XrFovf, mapping depth to [0, 1].
+// Same result as XMMatrixPerspectiveOffCenterRH with left/right/top/bottom = near * tan(angle), but the
+// near distance cancels out, so we work directly with the tangents
+inline xr_mat4_t XrMathProjectionFov(const XrFovf& fov, float near_z, float far_z) {
+	float tan_left = tanf(fov.angleLeft);
+	float tan_right = tanf(fov.angleRight);
+	float tan_up = tanf(fov.angleUp);
+	float tan_down = tanf(fov.angleDown);
+
+	float reciprocal_width = 1.0f / (tan_right - tan_left);
+	float reciprocal_height = 1.0f / (tan_up - tan_down);
+	float range = far_z / (near_z - far_z);
+
+	xr_mat4_t result = {};
+	result.m[0][0] = 2.0f * reciprocal_width;
+	result.m[1][1] = 2.0f * reciprocal_height;
+	result.m[2][0] = (tan_left + tan_right) * reciprocal_width;
+	result.m[2][1] = (tan_up + tan_down) * reciprocal_height;
+	result.m[2][2] = range;
+	result.m[2][3] = -1.0f;
+	result.m[3][2] = range * near_z;
+	return result;
+}
+
+// Returns the projection for the fov from the cache, and only builds it if it isn't in there yet
+const xr_mat4_t& XrMathProjectionCached(xr_projection_cache_t& cache, const XrFovf& fov, float near_z, float far_z);
+
+// The transposed view-projection matrix of a view, ready to be copied into a constant buffer
+inline xr_mat4_t XrMathViewProjectionTransposed(const XrPosef& view_pose, const xr_mat4_t& projection) {
+	return XrMathTranspose(XrMathMultiply(XrMathRigidInverse(view_pose), projection));
+}
+
+//------------------------------------------------------------------------------------------------------
+// Batched functions
+//------------------------------------------------------------------------------------------------------
+
+// Transforms count points (x, y, z, with an implicit w = 1) by the matrix. The output has four floats
+// (x, y, z, w) per point
+void XrMathTransformPoints(const xr_mat4_t& matrix, const XrVector3f* points, float* out_xyzw, size_t count);
+
+// Converts count poses to matrices (see XrMathPoseToMatrix)
+void XrMathPosesToMatrices(const XrPosef* poses, xr_mat4_t* out_matrices, size_t count);
+
+// Multiplies each matrix of a with the matrix of b at the same index
+void XrMathMultiplyBatch(const xr_mat4_t* a, const xr_mat4_t* b, xr_mat4_t* out_matrices, size_t count);